@@ -32,16 +32,19 @@ void ofApp::draw(){
 	ofEnableDepthTest();
 
 	// draw left eye first
-	cv1.begin(ovrEye_Left);
-	ofClear(0, 255, 255);
-	drawScene();
+	// begin() returns false when the eye is skipped (e.g. headset not worn)
+	if (cv1.begin(ovrEye_Left)) {
+		ofClear(0, 255, 255);
+		drawScene();
+	}
 	cv1.end(ovrEye_Left);
 
 	// then right eye
 	// fyi--the order is critical!
-	cv1.begin(ovrEye_Right);
-	ofClear(0, 255, 255);
-	drawScene();
+	if (cv1.begin(ovrEye_Right)) {
+		ofClear(0, 255, 255);
+		drawScene();
+	}
 	cv1.end(ovrEye_Right);
 
 	// display the stereo view in the OF window (optional)
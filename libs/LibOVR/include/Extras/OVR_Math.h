@@ -88,15 +88,63 @@
 #endif
 
 
+//-------------------------------------------------------------------------------------
+// ***** OVR_MATH_SIMD
+//
+// Selects the vector backend used by the Matrix4<float> specializations. It is chosen
+// at compile time from the target architecture; define OVR_MATH_NO_SIMD to force the
+// scalar code everywhere (e.g. to compare results against it).
+
+//-------------------------------------------------------------------------------------
+// ***** OVR_MATH_CONSTEXPR
+//
+// C++11 constexpr where the compiler supports it (VS2015+, GCC and clang in C++11 mode),
+// otherwise nothing. Functions marked with it stick to what C++11 allows in a constexpr
+// function, which mostly means a single return statement.
+
+#if !defined(OVR_MATH_CONSTEXPR)
+    #if (defined(_MSC_VER) && (_MSC_VER >= 1900)) || (!defined(_MSC_VER) && defined(__cplusplus) && (__cplusplus >= 201103L))
+        #define OVR_MATH_CONSTEXPR constexpr
+        #define OVR_MATH_CONSTEXPR_ENABLED 1
+    #else
+        #define OVR_MATH_CONSTEXPR
+        #define OVR_MATH_CONSTEXPR_ENABLED 0
+    #endif
+#elif !defined(OVR_MATH_CONSTEXPR_ENABLED)
+    #define OVR_MATH_CONSTEXPR_ENABLED 0
+#endif
+
+
+#if !defined(OVR_MATH_NO_SIMD)
+    #if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+        #define OVR_MATH_SIMD_SSE 1
+        #include <xmmintrin.h>
+        #if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+            #define OVR_MATH_SIMD_SSE2 1
+            #include <emmintrin.h>
+        #endif
+    #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+        #define OVR_MATH_SIMD_NEON 1
+        #include <arm_neon.h>
+    #endif
+#endif
+
+#if defined(OVR_MATH_SIMD_SSE) || defined(OVR_MATH_SIMD_NEON)
+    #define OVR_MATH_SIMD 1
+#else
+    #define OVR_MATH_SIMD 0
+#endif
+
+
 
 namespace OVR {
 
 template<class T>
-const T OVRMath_Min(const T a, const T b)
+OVR_MATH_CONSTEXPR const T OVRMath_Min(const T a, const T b)
 { return (a < b) ? a : b; }
 
 template<class T>
-const T OVRMath_Max(const T a, const T b)
+OVR_MATH_CONSTEXPR const T OVRMath_Max(const T a, const T b)
 { return (b < a) ? a : b; }
 
 template<class T>
@@ -325,19 +373,19 @@ typedef Math<double> Mathd;
 
 // Conversion functions between degrees and radians
 // (non-templated to ensure passing int arguments causes warning)
-inline float  RadToDegree(float rad)         { return rad * MATH_FLOAT_RADTODEGREEFACTOR; }
-inline double RadToDegree(double rad)        { return rad * MATH_DOUBLE_RADTODEGREEFACTOR; }
+inline OVR_MATH_CONSTEXPR float  RadToDegree(float rad)         { return rad * MATH_FLOAT_RADTODEGREEFACTOR; }
+inline OVR_MATH_CONSTEXPR double RadToDegree(double rad)        { return rad * MATH_DOUBLE_RADTODEGREEFACTOR; }
 
-inline float  DegreeToRad(float deg)         { return deg * MATH_FLOAT_DEGREETORADFACTOR; }
-inline double DegreeToRad(double deg)        { return deg * MATH_DOUBLE_DEGREETORADFACTOR; }
+inline OVR_MATH_CONSTEXPR float  DegreeToRad(float deg)         { return deg * MATH_FLOAT_DEGREETORADFACTOR; }
+inline OVR_MATH_CONSTEXPR double DegreeToRad(double deg)        { return deg * MATH_DOUBLE_DEGREETORADFACTOR; }
 
 // Square function
 template<class T>
-inline T Sqr(T x) { return x*x; }
+inline OVR_MATH_CONSTEXPR T Sqr(T x) { return x*x; }
 
 // Sign: returns 0 if x == 0, -1 if x < 0, and 1 if x > 0
 template<class T>
-inline T Sign(T x) { return (x != T(0)) ? (x < T(0) ? T(-1) : T(1)) : T(0); }
+inline OVR_MATH_CONSTEXPR T Sign(T x) { return (x != T(0)) ? (x < T(0) ? T(-1) : T(1)) : T(0); }
 
 // Numerically stable acos function
 inline float Acos(float x)   { return (x > 1.0f) ? 0.0f : (x < -1.0f) ? MATH_FLOAT_PI : acosf(x); }
@@ -373,18 +421,18 @@ public:
 
     T x, y;
 
-    Vector2() : x(0), y(0) { }
-    Vector2(T x_, T y_) : x(x_), y(y_) { }
-    explicit Vector2(T s) : x(s), y(s) { }
-    explicit Vector2(const Vector2<typename Math<T>::OtherFloatType> &src)
+    OVR_MATH_CONSTEXPR Vector2() : x(0), y(0) { }
+    OVR_MATH_CONSTEXPR Vector2(T x_, T y_) : x(x_), y(y_) { }
+    explicit OVR_MATH_CONSTEXPR Vector2(T s) : x(s), y(s) { }
+    explicit OVR_MATH_CONSTEXPR Vector2(const Vector2<typename Math<T>::OtherFloatType> &src)
         : x((T)src.x), y((T)src.y) { }
 
-    static Vector2 Zero() { return Vector2(0, 0); }
+    static OVR_MATH_CONSTEXPR Vector2 Zero() { return Vector2(0, 0); }
 
     // C-interop support.
     typedef  typename CompatibleTypes<Vector2<T> >::Type CompatibleType;
 
-    Vector2(const CompatibleType& s) : x(s.x), y(s.y) {  }
+    OVR_MATH_CONSTEXPR Vector2(const CompatibleType& s) : x(s.x), y(s.y) {  }
 
     operator const CompatibleType& () const
     {
@@ -396,14 +444,14 @@ public:
     bool     operator== (const Vector2& b) const  { return x == b.x && y == b.y; }
     bool     operator!= (const Vector2& b) const  { return x != b.x || y != b.y; }
 
-    Vector2  operator+  (const Vector2& b) const  { return Vector2(x + b.x, y + b.y); }
+    OVR_MATH_CONSTEXPR Vector2  operator+  (const Vector2& b) const  { return Vector2(x + b.x, y + b.y); }
     Vector2& operator+= (const Vector2& b)        { x += b.x; y += b.y; return *this; }
-    Vector2  operator-  (const Vector2& b) const  { return Vector2(x - b.x, y - b.y); }
+    OVR_MATH_CONSTEXPR Vector2  operator-  (const Vector2& b) const  { return Vector2(x - b.x, y - b.y); }
     Vector2& operator-= (const Vector2& b)        { x -= b.x; y -= b.y; return *this; }
-    Vector2  operator- () const                   { return Vector2(-x, -y); }
+    OVR_MATH_CONSTEXPR Vector2  operator- () const                   { return Vector2(-x, -y); }
 
     // Scalar multiplication/division scales vector.
-    Vector2  operator*  (T s) const               { return Vector2(x*s, y*s); }
+    OVR_MATH_CONSTEXPR Vector2  operator*  (T s) const               { return Vector2(x*s, y*s); }
     Vector2& operator*= (T s)                     { x *= s; y *= s; return *this; }
 
     Vector2  operator/  (T s) const               { T rcp = T(1)/s;
@@ -552,18 +600,18 @@ public:
     // FIXME: default initialization of a vector class can be very expensive in a full-blown
     // application.  A few hundred thousand vector constructions is not unlikely and can add
     // up to milliseconds of time on processors like the PS3 PPU.
-    Vector3() : x(0), y(0), z(0) { }
-    Vector3(T x_, T y_, T z_ = 0) : x(x_), y(y_), z(z_) { }
-    explicit Vector3(T s) : x(s), y(s), z(s) { }
-    explicit Vector3(const Vector3<typename Math<T>::OtherFloatType> &src)
+    OVR_MATH_CONSTEXPR Vector3() : x(0), y(0), z(0) { }
+    OVR_MATH_CONSTEXPR Vector3(T x_, T y_, T z_ = 0) : x(x_), y(y_), z(z_) { }
+    explicit OVR_MATH_CONSTEXPR Vector3(T s) : x(s), y(s), z(s) { }
+    explicit OVR_MATH_CONSTEXPR Vector3(const Vector3<typename Math<T>::OtherFloatType> &src)
         : x((T)src.x), y((T)src.y), z((T)src.z) { }
 
-    static Vector3 Zero() { return Vector3(0, 0, 0); }
+    static OVR_MATH_CONSTEXPR Vector3 Zero() { return Vector3(0, 0, 0); }
 
     // C-interop support.
     typedef  typename CompatibleTypes<Vector3<T> >::Type CompatibleType;
 
-    Vector3(const CompatibleType& s) : x(s.x), y(s.y), z(s.z) {  }
+    OVR_MATH_CONSTEXPR Vector3(const CompatibleType& s) : x(s.x), y(s.y), z(s.z) {  }
 
     operator const CompatibleType& () const
     {
@@ -571,32 +619,31 @@ public:
         return reinterpret_cast<const CompatibleType&>(*this);
     }
 
-    bool     operator== (const Vector3& b) const  { return x == b.x && y == b.y && z == b.z; }
-    bool     operator!= (const Vector3& b) const  { return x != b.x || y != b.y || z != b.z; }
+    OVR_MATH_CONSTEXPR bool operator== (const Vector3& b) const  { return x == b.x && y == b.y && z == b.z; }
+    OVR_MATH_CONSTEXPR bool operator!= (const Vector3& b) const  { return x != b.x || y != b.y || z != b.z; }
 
-    Vector3  operator+  (const Vector3& b) const  { return Vector3(x + b.x, y + b.y, z + b.z); }
+    OVR_MATH_CONSTEXPR Vector3 operator+ (const Vector3& b) const  { return Vector3(x + b.x, y + b.y, z + b.z); }
     Vector3& operator+= (const Vector3& b)        { x += b.x; y += b.y; z += b.z; return *this; }
-    Vector3  operator-  (const Vector3& b) const  { return Vector3(x - b.x, y - b.y, z - b.z); }
+    OVR_MATH_CONSTEXPR Vector3 operator- (const Vector3& b) const  { return Vector3(x - b.x, y - b.y, z - b.z); }
     Vector3& operator-= (const Vector3& b)        { x -= b.x; y -= b.y; z -= b.z; return *this; }
-    Vector3  operator- () const                   { return Vector3(-x, -y, -z); }
+    OVR_MATH_CONSTEXPR Vector3 operator- () const   { return Vector3(-x, -y, -z); }
 
     // Scalar multiplication/division scales vector.
-    Vector3  operator*  (T s) const               { return Vector3(x*s, y*s, z*s); }
+    OVR_MATH_CONSTEXPR Vector3 operator* (T s) const { return Vector3(x*s, y*s, z*s); }
     Vector3& operator*= (T s)                     { x *= s; y *= s; z *= s; return *this; }
 
-    Vector3  operator/  (T s) const               { T rcp = T(1)/s;
-                                                    return Vector3(x*rcp, y*rcp, z*rcp); }
+    OVR_MATH_CONSTEXPR Vector3 operator/ (T s) const { return *this * (T(1)/s); }
     Vector3& operator/= (T s)                     { T rcp = T(1)/s;
                                                     x *= rcp; y *= rcp; z *= rcp;
                                                     return *this; }
 
-    static Vector3  Min(const Vector3& a, const Vector3& b)
+    static OVR_MATH_CONSTEXPR Vector3 Min(const Vector3& a, const Vector3& b)
     {
         return Vector3((a.x < b.x) ? a.x : b.x,
                        (a.y < b.y) ? a.y : b.y,
                        (a.z < b.z) ? a.z : b.z);
     }
-    static Vector3  Max(const Vector3& a, const Vector3& b)
+    static OVR_MATH_CONSTEXPR Vector3 Max(const Vector3& a, const Vector3& b)
     {
         return Vector3((a.x > b.x) ? a.x : b.x,
                        (a.y > b.y) ? a.y : b.y,
@@ -637,16 +684,16 @@ public:
     }
 
     // Entrywise product of two vectors
-    Vector3    EntrywiseMultiply(const Vector3& b) const    { return Vector3(x * b.x,
+    OVR_MATH_CONSTEXPR Vector3 EntrywiseMultiply(const Vector3& b) const    { return Vector3(x * b.x,
                                                                          y * b.y,
                                                                          z * b.z);}
 
     // Multiply and divide operators do entry-wise math
-    Vector3  operator*  (const Vector3& b) const        { return Vector3(x * b.x,
+    OVR_MATH_CONSTEXPR Vector3 operator* (const Vector3& b) const        { return Vector3(x * b.x,
                                                                          y * b.y,
                                                                          z * b.z); }
 
-    Vector3  operator/  (const Vector3& b) const        { return Vector3(x / b.x,
+    OVR_MATH_CONSTEXPR Vector3 operator/ (const Vector3& b) const        { return Vector3(x / b.x,
                                                                          y / b.y,
                                                                          z / b.z); }
 
@@ -654,12 +701,12 @@ public:
     // Dot product
     // Used to calculate angle q between two vectors among other things,
     // as (A dot B) = |a||b|cos(q).
-     T      Dot(const Vector3& b) const          { return x*b.x + y*b.y + z*b.z; }
+    OVR_MATH_CONSTEXPR T Dot(const Vector3& b) const          { return x*b.x + y*b.y + z*b.z; }
 
     // Compute cross product, which generates a normal vector.
     // Direction vector can be determined by right-hand rule: Pointing index finder in
     // direction a and middle finger in direction b, thumb will point in a.Cross(b).
-    Vector3 Cross(const Vector3& b) const        { return Vector3(y*b.z - z*b.y,
+    OVR_MATH_CONSTEXPR Vector3 Cross(const Vector3& b) const        { return Vector3(y*b.z - z*b.y,
                                                                   z*b.x - x*b.z,
                                                                   x*b.y - y*b.x); }
 
@@ -673,13 +720,13 @@ public:
     }
 
     // Return Length of the vector squared.
-    T       LengthSq() const                     { return (x * x + y * y + z * z); }
+    OVR_MATH_CONSTEXPR T LengthSq() const                     { return (x * x + y * y + z * z); }
 
     // Return vector length.
     T       Length() const                       { return (T)sqrt(LengthSq()); }
 
     // Returns squared distance between two points represented by vectors.
-    T       DistanceSq(Vector3 const& b) const         { return (*this - b).LengthSq(); }
+    OVR_MATH_CONSTEXPR T DistanceSq(Vector3 const& b) const         { return (*this - b).LengthSq(); }
 
     // Returns distance between two points represented by vectors.
     T       Distance(Vector3 const& b) const     { return (*this - b).Length(); }
@@ -753,19 +800,19 @@ public:
     // FIXME: default initialization of a vector class can be very expensive in a full-blown
     // application.  A few hundred thousand vector constructions is not unlikely and can add
     // up to milliseconds of time on processors like the PS3 PPU.
-    Vector4() : x(0), y(0), z(0), w(0) { }
-    Vector4(T x_, T y_, T z_, T w_) : x(x_), y(y_), z(z_), w(w_) { }
-    explicit Vector4(T s) : x(s), y(s), z(s), w(s) { }
-    explicit Vector4(const Vector3<T>& v, const T w_=T(1)) : x(v.x), y(v.y), z(v.z), w(w_) { }
-    explicit Vector4(const Vector4<typename Math<T>::OtherFloatType> &src)
+    OVR_MATH_CONSTEXPR Vector4() : x(0), y(0), z(0), w(0) { }
+    OVR_MATH_CONSTEXPR Vector4(T x_, T y_, T z_, T w_) : x(x_), y(y_), z(z_), w(w_) { }
+    explicit OVR_MATH_CONSTEXPR Vector4(T s) : x(s), y(s), z(s), w(s) { }
+    explicit OVR_MATH_CONSTEXPR Vector4(const Vector3<T>& v, const T w_=T(1)) : x(v.x), y(v.y), z(v.z), w(w_) { }
+    explicit OVR_MATH_CONSTEXPR Vector4(const Vector4<typename Math<T>::OtherFloatType> &src)
         : x((T)src.x), y((T)src.y), z((T)src.z), w((T)src.w) { }
 
-    static Vector4 Zero() { return Vector4(0, 0, 0, 0); }
+    static OVR_MATH_CONSTEXPR Vector4 Zero() { return Vector4(0, 0, 0, 0); }
 
     // C-interop support.
     typedef  typename CompatibleTypes< Vector4<T> >::Type CompatibleType;
 
-    Vector4(const CompatibleType& s) : x(s.x), y(s.y), z(s.z), w(s.w) {  }
+    OVR_MATH_CONSTEXPR Vector4(const CompatibleType& s) : x(s.x), y(s.y), z(s.z), w(s.w) {  }
 
     operator const CompatibleType& () const
     {
@@ -777,14 +824,14 @@ public:
     bool     operator== (const Vector4& b) const  { return x == b.x && y == b.y && z == b.z && w == b.w; }
     bool     operator!= (const Vector4& b) const  { return x != b.x || y != b.y || z != b.z || w != b.w; }
 
-    Vector4  operator+  (const Vector4& b) const  { return Vector4(x + b.x, y + b.y, z + b.z, w + b.w); }
+    OVR_MATH_CONSTEXPR Vector4  operator+  (const Vector4& b) const  { return Vector4(x + b.x, y + b.y, z + b.z, w + b.w); }
     Vector4& operator+= (const Vector4& b)        { x += b.x; y += b.y; z += b.z; w += b.w; return *this; }
-    Vector4  operator-  (const Vector4& b) const  { return Vector4(x - b.x, y - b.y, z - b.z, w - b.w); }
+    OVR_MATH_CONSTEXPR Vector4  operator-  (const Vector4& b) const  { return Vector4(x - b.x, y - b.y, z - b.z, w - b.w); }
     Vector4& operator-= (const Vector4& b)        { x -= b.x; y -= b.y; z -= b.z; w -= b.w; return *this; }
-    Vector4  operator- () const                   { return Vector4(-x, -y, -z, -w); }
+    OVR_MATH_CONSTEXPR Vector4  operator- () const                   { return Vector4(-x, -y, -z, -w); }
 
     // Scalar multiplication/division scales vector.
-    Vector4  operator*  (T s) const               { return Vector4(x*s, y*s, z*s, w*s); }
+    OVR_MATH_CONSTEXPR Vector4  operator*  (T s) const               { return Vector4(x*s, y*s, z*s, w*s); }
     Vector4& operator*= (T s)                     { x *= s; y *= s; z *= s; w *= s;return *this; }
 
     Vector4  operator/  (T s) const               { T rcp = T(1)/s;
@@ -1074,9 +1121,9 @@ public:
     // x,y,z = axis*sin(angle), w = cos(angle)
     T x, y, z, w;
 
-    Quat() : x(0), y(0), z(0), w(1) { }
-    Quat(T x_, T y_, T z_, T w_) : x(x_), y(y_), z(z_), w(w_) { }
-    explicit Quat(const Quat<typename Math<T>::OtherFloatType> &src)
+    OVR_MATH_CONSTEXPR Quat() : x(0), y(0), z(0), w(1) { }
+    OVR_MATH_CONSTEXPR Quat(T x_, T y_, T z_, T w_) : x(x_), y(y_), z(z_), w(w_) { }
+    explicit OVR_MATH_CONSTEXPR Quat(const Quat<typename Math<T>::OtherFloatType> &src)
         : x((T)src.x), y((T)src.y), z((T)src.z), w((T)src.w)
     {
         // NOTE: Converting a normalized Quat<float> to Quat<double>
@@ -1088,7 +1135,7 @@ public:
     typedef  typename CompatibleTypes<Quat<T> >::Type CompatibleType;
 
     // C-interop support.
-    Quat(const CompatibleType& s) : x(s.x), y(s.y), z(s.z), w(s.w) { }
+    OVR_MATH_CONSTEXPR Quat(const CompatibleType& s) : x(s.x), y(s.y), z(s.z), w(s.w) { }
 
     operator CompatibleType () const
     {
@@ -1135,9 +1182,9 @@ public:
         z = v[2];
     }
 
-    Quat operator-() { return Quat(-x, -y, -z, -w); }   // unary minus
+    OVR_MATH_CONSTEXPR Quat operator-() const { return Quat(-x, -y, -z, -w); }   // unary minus
 
-    static Quat Identity() { return Quat(0, 0, 0, 1); }
+    static OVR_MATH_CONSTEXPR Quat Identity() { return Quat(0, 0, 0, 1); }
 
     // Compute axis and angle from quaternion
     void GetAxisAngle(Vector3<T>* axis, T* angle) const
@@ -1338,15 +1385,15 @@ public:
         OVR_MATH_ASSERT(IsNormalized());    // Ensure input matrix is orthogonal
     }
 
-    bool operator== (const Quat& b) const   { return x == b.x && y == b.y && z == b.z && w == b.w; }
-    bool operator!= (const Quat& b) const   { return x != b.x || y != b.y || z != b.z || w != b.w; }
+    OVR_MATH_CONSTEXPR bool operator== (const Quat& b) const   { return x == b.x && y == b.y && z == b.z && w == b.w; }
+    OVR_MATH_CONSTEXPR bool operator!= (const Quat& b) const   { return x != b.x || y != b.y || z != b.z || w != b.w; }
 
-    Quat  operator+  (const Quat& b) const  { return Quat(x + b.x, y + b.y, z + b.z, w + b.w); }
+    OVR_MATH_CONSTEXPR Quat operator+ (const Quat& b) const  { return Quat(x + b.x, y + b.y, z + b.z, w + b.w); }
     Quat& operator+= (const Quat& b)        { w += b.w; x += b.x; y += b.y; z += b.z; return *this; }
-    Quat  operator-  (const Quat& b) const  { return Quat(x - b.x, y - b.y, z - b.z, w - b.w); }
+    OVR_MATH_CONSTEXPR Quat operator- (const Quat& b) const  { return Quat(x - b.x, y - b.y, z - b.z, w - b.w); }
     Quat& operator-= (const Quat& b)        { w -= b.w; x -= b.x; y -= b.y; z -= b.z; return *this; }
 
-    Quat  operator*  (T s) const            { return Quat(x * s, y * s, z * s, w * s); }
+    OVR_MATH_CONSTEXPR Quat operator* (T s) const            { return Quat(x * s, y * s, z * s, w * s); }
     Quat& operator*= (T s)                  { w *= s; x *= s; y *= s; z *= s; return *this; }
     Quat  operator/  (T s) const            { T rcp = T(1)/s; return Quat(x * rcp, y * rcp, z * rcp, w *rcp); }
     Quat& operator/= (T s)                  { T rcp = T(1)/s; w *= rcp; x *= rcp; y *= rcp; z *= rcp; return *this; }
@@ -1368,13 +1415,13 @@ public:
     static T Abs(const T v)                 { return (v >= 0) ? v : -v; }
 
     // Get Imaginary part vector
-    Vector3<T> Imag() const                 { return Vector3<T>(x,y,z); }
+    OVR_MATH_CONSTEXPR Vector3<T> Imag() const                 { return Vector3<T>(x,y,z); }
 
     // Get quaternion length.
     T       Length() const                  { return sqrt(LengthSq()); }
 
     // Get quaternion length squared.
-    T       LengthSq() const                { return (x * x + y * y + z * z + w * w); }
+    OVR_MATH_CONSTEXPR T LengthSq() const                { return (x * x + y * y + z * z + w * w); }
 
     // Simple Euclidean distance in R^4 (not SLERP distance, but at least respects Haar measure)
     T       Distance(const Quat& q) const
@@ -1391,7 +1438,7 @@ public:
         return (d1 < d2) ? d1 : d2;
     }
 
-    T       Dot(const Quat& q) const
+    OVR_MATH_CONSTEXPR T Dot(const Quat& q) const
     {
         return x * q.x + y * q.y + z * q.z + w * q.w;
     }
@@ -1439,11 +1486,11 @@ public:
     }
 
     // Returns conjugate of the quaternion. Produces inverse rotation if quaternion is normalized.
-    Quat    Conj() const                    { return Quat(-x, -y, -z, w); }
+    OVR_MATH_CONSTEXPR Quat Conj() const                    { return Quat(-x, -y, -z, w); }
 
     // Quaternion multiplication. Combines quaternion rotations, performing the one on the
     // right hand side first.
-    Quat  operator* (const Quat& b) const   { return Quat(w * b.x + x * b.w + y * b.z - z * b.y,
+    OVR_MATH_CONSTEXPR Quat operator* (const Quat& b) const   { return Quat(w * b.x + x * b.w + y * b.z - z * b.y,
                                                           w * b.y - x * b.z + y * b.w + z * b.x,
                                                           w * b.z + x * b.y - y * b.x + z * b.w,
                                                           w * b.w - x * b.x - y * b.y - z * b.z); }
@@ -1581,7 +1628,7 @@ public:
     }
 
     // Inversed quaternion rotates in the opposite direction.
-    Quat        Inverted() const
+    OVR_MATH_CONSTEXPR Quat Inverted() const
     {
         return Quat(-x, -y, -z, w);
     }
@@ -1961,6 +2008,31 @@ public:
     // Construct with no memory initialization.
     Matrix4(NoInitType) { }
 
+#if OVR_MATH_CONSTEXPR_ENABLED
+    // By default, we construct identity matrix.
+    constexpr Matrix4()
+        : M{ { T(1), T(0), T(0), T(0) },
+             { T(0), T(1), T(0), T(0) },
+             { T(0), T(0), T(1), T(0) },
+             { T(0), T(0), T(0), T(1) } } { }
+
+    constexpr Matrix4(T m11, T m12, T m13, T m14,
+                      T m21, T m22, T m23, T m24,
+                      T m31, T m32, T m33, T m34,
+                      T m41, T m42, T m43, T m44)
+        : M{ { m11, m12, m13, m14 },
+             { m21, m22, m23, m24 },
+             { m31, m32, m33, m34 },
+             { m41, m42, m43, m44 } } { }
+
+    constexpr Matrix4(T m11, T m12, T m13,
+                      T m21, T m22, T m23,
+                      T m31, T m32, T m33)
+        : M{ { m11,  m12,  m13,  T(0) },
+             { m21,  m22,  m23,  T(0) },
+             { m31,  m32,  m33,  T(0) },
+             { T(0), T(0), T(0), T(1) } } { }
+#else
     // By default, we construct identity matrix.
     Matrix4()
     {
@@ -1990,6 +2062,7 @@ public:
         M[2][0] = m31; M[2][1] = m32; M[2][2] = m33; M[2][3] = T(0);
         M[3][0] = T(0);   M[3][1] = T(0);   M[3][2] = T(0);   M[3][3] = T(1);
     }
+#endif
 
     explicit Matrix4(const Matrix3<T>& m)
     {
@@ -2080,7 +2153,7 @@ public:
         return result;
     }
 
-    static Matrix4 Identity()  { return Matrix4(); }
+    static OVR_MATH_CONSTEXPR Matrix4 Identity()  { return Matrix4(); }
 
     void SetIdentity()
     {
@@ -2096,7 +2169,7 @@ public:
         M[1][0] = v.y;
         M[2][0] = v.z;
     }
-    Vector3<T> GetXBasis() const
+    OVR_MATH_CONSTEXPR Vector3<T> GetXBasis() const
     {
         return Vector3<T>(M[0][0], M[1][0], M[2][0]);
     }
@@ -2107,7 +2180,7 @@ public:
         M[1][1] = v.y;
         M[2][1] = v.z;
     }
-    Vector3<T> GetYBasis() const
+    OVR_MATH_CONSTEXPR Vector3<T> GetYBasis() const
     {
         return Vector3<T>(M[0][1], M[1][1], M[2][1]);
     }
@@ -2118,7 +2191,7 @@ public:
         M[1][2] = v.y;
         M[2][2] = v.z;
     }
-    Vector3<T> GetZBasis() const
+    OVR_MATH_CONSTEXPR Vector3<T> GetZBasis() const
     {
         return Vector3<T>(M[0][2], M[1][2], M[2][2]);
     }
@@ -2237,7 +2310,7 @@ public:
                           M[3][0] * v.x + M[3][1] * v.y + M[3][2] * v.z + M[3][3] * v.w);
     }
 
-    Matrix4 Transposed() const
+    OVR_MATH_CONSTEXPR Matrix4 Transposed() const
     {
         return Matrix4(M[0][0], M[1][0], M[2][0], M[3][0],
                         M[0][1], M[1][1], M[2][1], M[3][1],
@@ -2412,23 +2485,18 @@ public:
 
 
     // Creates a matrix for translation by vector
-    static Matrix4 Translation(const Vector3<T>& v)
+    static OVR_MATH_CONSTEXPR Matrix4 Translation(const Vector3<T>& v)
     {
-        Matrix4 t;
-        t.M[0][3] = v.x;
-        t.M[1][3] = v.y;
-        t.M[2][3] = v.z;
-        return t;
+        return Translation(v.x, v.y, v.z);
     }
 
     // Creates a matrix for translation by vector
-    static Matrix4 Translation(T x, T y, T z = T(0))
+    static OVR_MATH_CONSTEXPR Matrix4 Translation(T x, T y, T z = T(0))
     {
-        Matrix4 t;
-        t.M[0][3] = x;
-        t.M[1][3] = y;
-        t.M[2][3] = z;
-        return t;
+        return Matrix4(T(1), T(0), T(0), x,
+                       T(0), T(1), T(0), y,
+                       T(0), T(0), T(1), z,
+                       T(0), T(0), T(0), T(1));
     }
 
     // Sets the translation part
@@ -2439,39 +2507,29 @@ public:
         M[2][3] = v.z;
     }
 
-    Vector3<T> GetTranslation() const
+    OVR_MATH_CONSTEXPR Vector3<T> GetTranslation() const
     {
         return Vector3<T>( M[0][3], M[1][3], M[2][3] );
     }
 
     // Creates a matrix for scaling by vector
-    static Matrix4 Scaling(const Vector3<T>& v)
+    static OVR_MATH_CONSTEXPR Matrix4 Scaling(const Vector3<T>& v)
     {
-        Matrix4 t;
-        t.M[0][0] = v.x;
-        t.M[1][1] = v.y;
-        t.M[2][2] = v.z;
-        return t;
+        return Scaling(v.x, v.y, v.z);
     }
 
     // Creates a matrix for scaling by vector
-    static Matrix4 Scaling(T x, T y, T z)
+    static OVR_MATH_CONSTEXPR Matrix4 Scaling(T x, T y, T z)
     {
-        Matrix4 t;
-        t.M[0][0] = x;
-        t.M[1][1] = y;
-        t.M[2][2] = z;
-        return t;
+        return Matrix4(x,    T(0), T(0),
+                       T(0), y,    T(0),
+                       T(0), T(0), z);
     }
 
     // Creates a matrix for scaling by constant
-    static Matrix4 Scaling(T s)
+    static OVR_MATH_CONSTEXPR Matrix4 Scaling(T s)
     {
-        Matrix4 t;
-        t.M[0][0] = s;
-        t.M[1][1] = s;
-        t.M[2][2] = s;
-        return t;
+        return Scaling(s, s, s);
     }
 
     // Simple L1 distance in R^12
@@ -2664,6 +2722,280 @@ public:
 typedef Matrix4<float>  Matrix4f;
 typedef Matrix4<double> Matrix4d;
 
+
+#if OVR_MATH_SIMD
+
+//-------------------------------------------------------------------------------------
+// ***** Matrix4f SIMD specializations
+//
+// Multiply, Transform, Determinant and Inverted for Matrix4<float> use four-wide
+// vector code instead of the element-by-element template versions above.
+//
+// Multiply and Transform perform the same products and sums in the same order as the
+// scalar code, so results are bit-identical unless the compiler contracts the scalar
+// version into fused multiply-adds (then they differ by at most 1 ULP per element).
+// Determinant and Inverted expand along the first row like Cofactor() does but share
+// 2x2 minors between cofactors, so they round differently. Both versions are within
+// about 16 * FLT_EPSILON * cond(M) * max|M^-1| of the exact inverse (cond in the
+// infinity norm), but not within a few ULP of each other element by element: an
+// element that is the small difference of large cofactor terms can differ by 1e-4
+// relative or more, even for random matrices with entries in [-1, 1].
+// tests/src/MathSimdTests.cpp checks both against a double-precision reference.
+
+namespace MathSimd {
+
+#if defined(OVR_MATH_SIMD_SSE)
+
+    typedef __m128 Vec4f;
+
+    inline Vec4f Load(const float* p)                   { return _mm_loadu_ps(p); }
+    inline void  Store(float* p, Vec4f v)               { _mm_storeu_ps(p, v); }
+    inline Vec4f Splat(float s)                         { return _mm_set1_ps(s); }
+    inline Vec4f Set(float x, float y, float z, float w){ return _mm_setr_ps(x, y, z, w); }
+    inline Vec4f Add(Vec4f a, Vec4f b)                  { return _mm_add_ps(a, b); }
+    inline Vec4f Sub(Vec4f a, Vec4f b)                  { return _mm_sub_ps(a, b); }
+    inline Vec4f Mul(Vec4f a, Vec4f b)                  { return _mm_mul_ps(a, b); }
+    inline Vec4f Div(Vec4f a, Vec4f b)                  { return _mm_div_ps(a, b); }
+    inline Vec4f Min(Vec4f a, Vec4f b)                  { return _mm_min_ps(a, b); }
+    inline Vec4f Max(Vec4f a, Vec4f b)                  { return _mm_max_ps(a, b); }
+    inline Vec4f Abs(Vec4f v)                           { return _mm_andnot_ps(_mm_set1_ps(-0.0f), v); }
+    inline Vec4f Sqrt(Vec4f v)                          { return _mm_sqrt_ps(v); }
+
+    // Hardware 1/sqrt estimate, relative error below 1.5 * 2^-12
+    enum { RSqrtEstimateBits = 11 };
+    inline Vec4f RSqrtEstimate(Vec4f v)                 { return _mm_rsqrt_ps(v); }
+    inline float RSqrtEstimate(float v)                 { return _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(v))); }
+
+    // Round to nearest integer, for |v| < 2^22
+    inline Vec4f Round(Vec4f v)
+    {
+    #if defined(OVR_MATH_SIMD_SSE2)
+        return _mm_cvtepi32_ps(_mm_cvtps_epi32(v));
+    #else
+        const Vec4f magic = _mm_or_ps(_mm_set1_ps(12582912.0f), _mm_and_ps(v, _mm_set1_ps(-0.0f)));
+        return _mm_sub_ps(_mm_add_ps(v, magic), magic);
+    #endif
+    }
+
+    // All bits set in the lanes where a > b, and choosing lanes by such a mask
+    inline Vec4f CmpGt(Vec4f a, Vec4f b)                { return _mm_cmpgt_ps(a, b); }
+    inline Vec4f Select(Vec4f mask, Vec4f a, Vec4f b)   { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+    // Sign bit of each lane, and flipping lanes by such a mask
+    inline Vec4f SignBits(Vec4f v)                      { return _mm_and_ps(v, _mm_set1_ps(-0.0f)); }
+    inline Vec4f Xor(Vec4f a, Vec4f b)                  { return _mm_xor_ps(a, b); }
+
+    // (y, x, w, z)
+    inline Vec4f SwapPairs(Vec4f v)                     { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)); }
+    // (z, z, x, x)
+    inline Vec4f SpreadZX(Vec4f v)                      { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 2, 2)); }
+    // (w, w, w, w)
+    inline Vec4f SplatW(Vec4f v)                        { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)); }
+
+    inline void Transpose(Vec4f& r0, Vec4f& r1, Vec4f& r2, Vec4f& r3)
+    {
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    }
+
+#elif defined(OVR_MATH_SIMD_NEON)
+
+    typedef float32x4_t Vec4f;
+
+    inline Vec4f Load(const float* p)                   { return vld1q_f32(p); }
+    inline void  Store(float* p, Vec4f v)               { vst1q_f32(p, v); }
+    inline Vec4f Splat(float s)                         { return vdupq_n_f32(s); }
+    inline Vec4f Set(float x, float y, float z, float w){ const float v[4] = { x, y, z, w }; return vld1q_f32(v); }
+    inline Vec4f Add(Vec4f a, Vec4f b)                  { return vaddq_f32(a, b); }
+    inline Vec4f Sub(Vec4f a, Vec4f b)                  { return vsubq_f32(a, b); }
+    inline Vec4f Mul(Vec4f a, Vec4f b)                  { return vmulq_f32(a, b); }
+
+    inline Vec4f Div(Vec4f a, Vec4f b)
+    {
+    #if defined(__aarch64__) || defined(_M_ARM64)
+        return vdivq_f32(a, b);
+    #else
+        // ARMv7 NEON has no divide; go through memory to keep the result exact.
+        float fa[4], fb[4];
+        vst1q_f32(fa, a); vst1q_f32(fb, b);
+        return Set(fa[0] / fb[0], fa[1] / fb[1], fa[2] / fb[2], fa[3] / fb[3]);
+    #endif
+    }
+
+    inline Vec4f Min(Vec4f a, Vec4f b)                  { return vminq_f32(a, b); }
+    inline Vec4f Max(Vec4f a, Vec4f b)                  { return vmaxq_f32(a, b); }
+    inline Vec4f Abs(Vec4f v)                           { return vabsq_f32(v); }
+
+    inline Vec4f Sqrt(Vec4f v)
+    {
+    #if defined(__aarch64__) || defined(_M_ARM64)
+        return vsqrtq_f32(v);
+    #else
+        float fv[4];
+        vst1q_f32(fv, v);
+        return Set(sqrtf(fv[0]), sqrtf(fv[1]), sqrtf(fv[2]), sqrtf(fv[3]));
+    #endif
+    }
+
+    // Hardware 1/sqrt estimate, relative error below 2^-8
+    enum { RSqrtEstimateBits = 8 };
+    inline Vec4f RSqrtEstimate(Vec4f v)                 { return vrsqrteq_f32(v); }
+    inline float RSqrtEstimate(float v)                 { return vget_lane_f32(vrsqrte_f32(vdup_n_f32(v)), 0); }
+
+    // Round to nearest integer, for |v| < 2^22
+    inline Vec4f Round(Vec4f v)
+    {
+    #if defined(__aarch64__) || defined(_M_ARM64)
+        return vrndnq_f32(v);
+    #else
+        const float32x4_t half = vbslq_f32(vdupq_n_u32(0x80000000u), v, vdupq_n_f32(0.5f));
+        return vcvtq_f32_s32(vcvtq_s32_f32(vaddq_f32(v, half)));
+    #endif
+    }
+
+    inline Vec4f CmpGt(Vec4f a, Vec4f b)                { return vreinterpretq_f32_u32(vcgtq_f32(a, b)); }
+    inline Vec4f Select(Vec4f mask, Vec4f a, Vec4f b)   { return vbslq_f32(vreinterpretq_u32_f32(mask), a, b); }
+
+    inline Vec4f SignBits(Vec4f v)                      { return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(v), vdupq_n_u32(0x80000000u))); }
+    inline Vec4f Xor(Vec4f a, Vec4f b)                  { return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+
+    inline Vec4f SwapPairs(Vec4f v)                     { return vrev64q_f32(v); }
+    inline Vec4f SpreadZX(Vec4f v)                      { return vcombine_f32(vdup_lane_f32(vget_high_f32(v), 0), vdup_lane_f32(vget_low_f32(v), 0)); }
+    inline Vec4f SplatW(Vec4f v)                        { return vdupq_lane_f32(vget_high_f32(v), 1); }
+
+    inline void Transpose(Vec4f& r0, Vec4f& r1, Vec4f& r2, Vec4f& r3)
+    {
+        const float32x4x2_t t01 = vtrnq_f32(r0, r1);
+        const float32x4x2_t t23 = vtrnq_f32(r2, r3);
+        r0 = vcombine_f32(vget_low_f32(t01.val[0]),  vget_low_f32(t23.val[0]));
+        r1 = vcombine_f32(vget_low_f32(t01.val[1]),  vget_low_f32(t23.val[1]));
+        r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+        r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+    }
+
+#endif
+
+    // Returns m0 * v.x + m1 * v.y + m2 * v.z + m3 * v.w, where m0..m3 are the matrix
+    // columns. Summed left to right to match the scalar Transform().
+    inline Vec4f TransformColumns(const Matrix4<float>& m, float x, float y, float z, float w)
+    {
+        Vec4f c0 = Load(m.M[0]), c1 = Load(m.M[1]), c2 = Load(m.M[2]), c3 = Load(m.M[3]);
+        Transpose(c0, c1, c2, c3);
+        Vec4f r = Mul(c0, Splat(x));
+        r = Add(r, Mul(c1, Splat(y)));
+        r = Add(r, Mul(c2, Splat(z)));
+        r = Add(r, Mul(c3, Splat(w)));
+        return r;
+    }
+
+    // Given two matrix columns a and b, returns the 2x2 minors of rows (2,3) and (0,1)
+    // of those columns laid out as (c, c, s, s).
+    inline Vec4f PairMinors(Vec4f a, Vec4f b)
+    {
+        return SpreadZX(Sub(Mul(a, SwapPairs(b)), Mul(SwapPairs(a), b)));
+    }
+
+    // Writes the adjugate of m into adj (row-major) and returns the determinant.
+    inline float Adjugate(const Matrix4<float>& m, float adj[4][4])
+    {
+        // Columns of m
+        Vec4f t0 = Load(m.M[0]), t1 = Load(m.M[1]), t2 = Load(m.M[2]), t3 = Load(m.M[3]);
+        Transpose(t0, t1, t2, t3);
+
+        // Each Pn holds one 2x2 minor from the lower rows (twice) and the matching
+        // minor from the upper rows (twice), so each adjugate row is three products.
+        const Vec4f p0 = PairMinors(t0, t1);
+        const Vec4f p1 = PairMinors(t0, t2);
+        const Vec4f p2 = PairMinors(t0, t3);
+        const Vec4f p3 = PairMinors(t1, t2);
+        const Vec4f p4 = PairMinors(t1, t3);
+        const Vec4f p5 = PairMinors(t2, t3);
+
+        // Column j as (m1j, m0j, m3j, m2j)
+        const Vec4f c0 = SwapPairs(t0), c1 = SwapPairs(t1), c2 = SwapPairs(t2), c3 = SwapPairs(t3);
+
+        const Vec4f signA = Set(1.0f, -1.0f, 1.0f, -1.0f);
+        const Vec4f signB = Set(-1.0f, 1.0f, -1.0f, 1.0f);
+
+        Store(adj[0], Mul(Add(Sub(Mul(c1, p5), Mul(c2, p4)), Mul(c3, p3)), signA));
+        Store(adj[1], Mul(Add(Sub(Mul(c0, p5), Mul(c2, p2)), Mul(c3, p1)), signB));
+        Store(adj[2], Mul(Add(Sub(Mul(c0, p4), Mul(c1, p2)), Mul(c3, p0)), signA));
+        Store(adj[3], Mul(Add(Sub(Mul(c0, p3), Mul(c1, p1)), Mul(c2, p0)), signB));
+
+        // First column of the adjugate holds the first-row cofactors
+        return m.M[0][0] * adj[0][0] + m.M[0][1] * adj[1][0] + m.M[0][2] * adj[2][0] + m.M[0][3] * adj[3][0];
+    }
+
+} // namespace MathSimd
+
+
+template<>
+inline Matrix4<float>& Matrix4<float>::Multiply(Matrix4<float>* d, const Matrix4<float>& a, const Matrix4<float>& b)
+{
+    OVR_MATH_ASSERT((d != &a) && (d != &b));
+    using namespace MathSimd;
+
+    const Vec4f b0 = Load(b.M[0]);
+    const Vec4f b1 = Load(b.M[1]);
+    const Vec4f b2 = Load(b.M[2]);
+    const Vec4f b3 = Load(b.M[3]);
+
+    int i = 0;
+    do {
+        Vec4f r = Mul(Splat(a.M[i][0]), b0);
+        r = Add(r, Mul(Splat(a.M[i][1]), b1));
+        r = Add(r, Mul(Splat(a.M[i][2]), b2));
+        r = Add(r, Mul(Splat(a.M[i][3]), b3));
+        Store(d->M[i], r);
+    } while((++i) < 4);
+
+    return *d;
+}
+
+template<>
+inline Vector3<float> Matrix4<float>::Transform(const Vector3<float>& v) const
+{
+    using namespace MathSimd;
+
+    const Vec4f r = TransformColumns(*this, v.x, v.y, v.z, 1.0f);
+    float out[4];
+    Store(out, Mul(r, Div(Splat(1.0f), SplatW(r))));
+    return Vector3<float>(out[0], out[1], out[2]);
+}
+
+template<>
+inline Vector4<float> Matrix4<float>::Transform(const Vector4<float>& v) const
+{
+    using namespace MathSimd;
+
+    float out[4];
+    Store(out, TransformColumns(*this, v.x, v.y, v.z, v.w));
+    return Vector4<float>(out[0], out[1], out[2], out[3]);
+}
+
+template<>
+inline float Matrix4<float>::Determinant() const
+{
+    float adj[4][4];
+    return MathSimd::Adjugate(*this, adj);
+}
+
+template<>
+inline Matrix4<float> Matrix4<float>::Inverted() const
+{
+    using namespace MathSimd;
+
+    Matrix4<float> result(Matrix4<float>::NoInit);
+    const float det = Adjugate(*this, result.M);
+    OVR_MATH_ASSERT(det != 0);
+
+    const Vec4f rcpDet = Splat(1.0f / det);
+    for (int i = 0; i < 4; i++)
+        Store(result.M[i], Mul(Load(result.M[i]), rcpDet));
+    return result;
+}
+
+#endif // OVR_MATH_SIMD
+
 //-------------------------------------------------------------------------------------
 // ***** Matrix3
 //
@@ -3694,7 +4026,7 @@ struct ScaleAndOffset2D
     Vector2f Scale;
     Vector2f Offset;
 
-    ScaleAndOffset2D(float sx = 0.0f, float sy = 0.0f, float ox = 0.0f, float oy = 0.0f)
+    OVR_MATH_CONSTEXPR ScaleAndOffset2D(float sx = 0.0f, float sy = 0.0f, float ox = 0.0f, float oy = 0.0f)
         : Scale(sx, sy), Offset(ox, oy)
     { }
 };
@@ -3723,13 +4055,13 @@ struct FovPort
     float LeftTan;
     float RightTan;
 
-    FovPort ( float sideTan = 0.0f ) :
+    OVR_MATH_CONSTEXPR FovPort ( float sideTan = 0.0f ) :
         UpTan(sideTan), DownTan(sideTan), LeftTan(sideTan), RightTan(sideTan) { }
-    FovPort ( float u, float d, float l, float r ) :
+    OVR_MATH_CONSTEXPR FovPort ( float u, float d, float l, float r ) :
         UpTan(u), DownTan(d), LeftTan(l), RightTan(r) { }
 
     // C-interop support: FovPort <-> ovrFovPort (implementation in OVR_CAPI.cpp).
-    FovPort(const ovrFovPort &src)
+    OVR_MATH_CONSTEXPR FovPort(const ovrFovPort &src)
         : UpTan(src.UpTan), DownTan(src.DownTan), LeftTan(src.LeftTan), RightTan(src.RightTan)
     { }
 
@@ -3768,7 +4100,7 @@ struct FovPort
     float GetHorizontalFovDegrees() const   { return RadToDegree(GetHorizontalFovRadians()); }
 
     // Compute maximum tangent value among all four sides.
-    float GetMaxSideTan() const
+    OVR_MATH_CONSTEXPR float GetMaxSideTan() const
     {
         return OVRMath_Max(OVRMath_Max(UpTan, DownTan), OVRMath_Max(LeftTan, RightTan));
     }
@@ -3798,26 +4130,214 @@ struct FovPort
     }
 
     // Compute per-channel minimum and maximum of Fov.
-    static FovPort Min(const FovPort& a, const FovPort& b)
+    static OVR_MATH_CONSTEXPR FovPort Min(const FovPort& a, const FovPort& b)
     {
-        FovPort fov( OVRMath_Min( a.UpTan   , b.UpTan    ),
-                     OVRMath_Min( a.DownTan , b.DownTan  ),
-                     OVRMath_Min( a.LeftTan , b.LeftTan  ),
-                     OVRMath_Min( a.RightTan, b.RightTan ) );
-        return fov;
+        return FovPort( OVRMath_Min( a.UpTan   , b.UpTan    ),
+                        OVRMath_Min( a.DownTan , b.DownTan  ),
+                        OVRMath_Min( a.LeftTan , b.LeftTan  ),
+                        OVRMath_Min( a.RightTan, b.RightTan ) );
     }
 
-    static FovPort Max(const FovPort& a, const FovPort& b)
+    static OVR_MATH_CONSTEXPR FovPort Max(const FovPort& a, const FovPort& b)
     {
-        FovPort fov( OVRMath_Max( a.UpTan   , b.UpTan    ),
-                     OVRMath_Max( a.DownTan , b.DownTan  ),
-                     OVRMath_Max( a.LeftTan , b.LeftTan  ),
-                     OVRMath_Max( a.RightTan, b.RightTan ) );
-        return fov;
+        return FovPort( OVRMath_Max( a.UpTan   , b.UpTan    ),
+                        OVRMath_Max( a.DownTan , b.DownTan  ),
+                        OVRMath_Max( a.LeftTan , b.LeftTan  ),
+                        OVRMath_Max( a.RightTan, b.RightTan ) );
     }
 };
 
 
+//-----------------------------------------------------------------------------------
+// ***** MathConstexpr
+//
+// Compile-time versions of the helpers above that need trig or sqrt, so rotation and
+// projection matrices for fixed angles and FOVs can be built into constant tables, e.g.
+//
+//     constexpr Matrix4f kTilt = MathConstexpr::RotationX(DegreeToRad(-30.0f));
+//
+// The libm based versions (Matrix4::RotationX, CreateProjection, ...) stay the ones to
+// use at run time; results here agree with them to within float rounding.
+
+#if OVR_MATH_CONSTEXPR_ENABLED
+
+namespace MathConstexpr {
+
+namespace Detail {
+
+    // Reduces to [-pi, pi]. Only meant for the angle ranges used for constant tables.
+    constexpr double WrapPi(double x)
+    {
+        return x - MATH_DOUBLE_TWOPI * (double)(long long)(x / MATH_DOUBLE_TWOPI + (x < 0.0 ? -0.5 : 0.5));
+    }
+
+    constexpr double SinSeries(double term, double x2, int n)
+    {
+        return (n > 25) ? 0.0 : term + SinSeries(-term * x2 / ((2 * n) * (2 * n + 1)), x2, n + 1);
+    }
+
+    constexpr double CosSeries(double term, double x2, int n)
+    {
+        return (n > 25) ? 0.0 : term + CosSeries(-term * x2 / ((2 * n - 1) * (2 * n)), x2, n + 1);
+    }
+
+    constexpr double SinReduced(double x) { return SinSeries(x, x * x, 1); }
+    constexpr double CosReduced(double x) { return CosSeries(1.0, x * x, 1); }
+
+    constexpr double SqrtNewton(double x, double guess, int n)
+    {
+        return (n == 0) ? guess : SqrtNewton(x, 0.5 * (guess + x / guess), n - 1);
+    }
+
+} // namespace Detail
+
+template<class T>
+constexpr T Sin(T x) { return T(Detail::SinReduced(Detail::WrapPi(double(x)))); }
+
+template<class T>
+constexpr T Cos(T x) { return T(Detail::CosReduced(Detail::WrapPi(double(x)))); }
+
+template<class T>
+constexpr T Tan(T x) { return T(Detail::SinReduced(Detail::WrapPi(double(x))) / Detail::CosReduced(Detail::WrapPi(double(x)))); }
+
+// Newton iteration from a guess of (x+1)/2, which converges for the magnitudes
+// constant tables use (up to ~1e12).
+template<class T>
+constexpr T Sqrt(T x) { return (x <= T(0)) ? T(0) : T(Detail::SqrtNewton(double(x), 0.5 * (double(x) + 1.0), 60)); }
+
+
+// Same conventions as Matrix4::RotationX/Y/Z: right-handed, counter-clockwise.
+template<class T>
+constexpr Matrix4<T> RotationX(T angle)
+{
+    return Matrix4<T>(T(1), T(0),         T(0),
+                      T(0), Cos(angle),   -Sin(angle),
+                      T(0), Sin(angle),   Cos(angle));
+}
+
+template<class T>
+constexpr Matrix4<T> RotationY(T angle)
+{
+    return Matrix4<T>(Cos(angle),  T(0), Sin(angle),
+                      T(0),        T(1), T(0),
+                      -Sin(angle), T(0), Cos(angle));
+}
+
+template<class T>
+constexpr Matrix4<T> RotationZ(T angle)
+{
+    return Matrix4<T>(Cos(angle), -Sin(angle), T(0),
+                      Sin(angle), Cos(angle),  T(0),
+                      T(0),       T(0),        T(1));
+}
+
+// axis must be normalized.
+template<class T>
+constexpr Quat<T> QuatFromAxisAngle(const Vector3<T>& axis, T angle)
+{
+    return Quat<T>(axis.x * Sin(angle * T(0.5)), axis.y * Sin(angle * T(0.5)),
+                   axis.z * Sin(angle * T(0.5)), Cos(angle * T(0.5)));
+}
+
+// Same as explicit Matrix4(const Quat<T>&); q must be normalized.
+template<class T>
+constexpr Matrix4<T> RotationMatrix(const Quat<T>& q)
+{
+    return Matrix4<T>(q.w*q.w + q.x*q.x - q.y*q.y - q.z*q.z, 2 * (q.x*q.y - q.w*q.z),               2 * (q.x*q.z + q.w*q.y),
+                      2 * (q.x*q.y + q.w*q.z),               q.w*q.w - q.x*q.x + q.y*q.y - q.z*q.z, 2 * (q.y*q.z - q.w*q.x),
+                      2 * (q.x*q.z - q.w*q.y),               2 * (q.y*q.z + q.w*q.x),               q.w*q.w - q.x*q.x - q.y*q.y + q.z*q.z);
+}
+
+// Rotates v by q, i.e. q.Rotate(v) for a normalized q.
+template<class T>
+constexpr Vector3<T> Rotate(const Quat<T>& q, const Vector3<T>& v)
+{
+    return (q * Quat<T>(v.x, v.y, v.z, T(0)) * q.Conj()).Imag();
+}
+
+namespace Detail {
+
+    template<class T>
+    constexpr T Dot4(const Matrix4<T>& a, const Matrix4<T>& b, int i, int j)
+    {
+        return a.M[i][0] * b.M[0][j] + a.M[i][1] * b.M[1][j] + a.M[i][2] * b.M[2][j] + a.M[i][3] * b.M[3][j];
+    }
+
+} // namespace Detail
+
+// a * b
+template<class T>
+constexpr Matrix4<T> Multiply(const Matrix4<T>& a, const Matrix4<T>& b)
+{
+    return Matrix4<T>(Detail::Dot4(a, b, 0, 0), Detail::Dot4(a, b, 0, 1), Detail::Dot4(a, b, 0, 2), Detail::Dot4(a, b, 0, 3),
+                      Detail::Dot4(a, b, 1, 0), Detail::Dot4(a, b, 1, 1), Detail::Dot4(a, b, 1, 2), Detail::Dot4(a, b, 1, 3),
+                      Detail::Dot4(a, b, 2, 0), Detail::Dot4(a, b, 2, 1), Detail::Dot4(a, b, 2, 2), Detail::Dot4(a, b, 2, 3),
+                      Detail::Dot4(a, b, 3, 0), Detail::Dot4(a, b, 3, 1), Detail::Dot4(a, b, 3, 2), Detail::Dot4(a, b, 3, 3));
+}
+
+// Same as Matrix4::Transform(const Vector3<T>&), translation included.
+template<class T>
+constexpr Vector3<T> Transform(const Matrix4<T>& m, const Vector3<T>& v)
+{
+    return Vector3<T>(m.M[0][0] * v.x + m.M[0][1] * v.y + m.M[0][2] * v.z + m.M[0][3],
+                      m.M[1][0] * v.x + m.M[1][1] * v.y + m.M[1][2] * v.z + m.M[1][3],
+                      m.M[2][0] * v.x + m.M[2][1] * v.y + m.M[2][2] * v.z + m.M[2][3]);
+}
+
+constexpr FovPort FovFromRadians(float horizontalFov, float verticalFov)
+{
+    return FovPort(Tan(verticalFov * 0.5f), Tan(verticalFov * 0.5f),
+                   Tan(horizontalFov * 0.5f), Tan(horizontalFov * 0.5f));
+}
+
+constexpr FovPort FovFromDegrees(float horizontalFovDegrees, float verticalFovDegrees)
+{
+    return FovFromRadians(DegreeToRad(horizontalFovDegrees), DegreeToRad(verticalFovDegrees));
+}
+
+// Same as FovPort::CreateNDCScaleAndOffsetFromFov.
+constexpr ScaleAndOffset2D NDCScaleAndOffsetFromFov(const FovPort& tanHalfFov)
+{
+    return ScaleAndOffset2D(2.0f / (tanHalfFov.LeftTan + tanHalfFov.RightTan),
+                            2.0f / (tanHalfFov.UpTan + tanHalfFov.DownTan),
+                            (tanHalfFov.LeftTan - tanHalfFov.RightTan) * (2.0f / (tanHalfFov.LeftTan + tanHalfFov.RightTan)) * 0.5f,
+                            (tanHalfFov.UpTan - tanHalfFov.DownTan) * (2.0f / (tanHalfFov.UpTan + tanHalfFov.DownTan)) * 0.5f);
+}
+
+namespace Detail {
+
+    constexpr Matrix4f Projection(const ScaleAndOffset2D& so, float h, bool isOpenGL,
+                                  float zNear, float zFar, bool flipZ, bool farAtInfinity)
+    {
+        return Matrix4f(so.Scale.x, 0.0f,       h * so.Offset.x,  0.0f,
+                        0.0f,       so.Scale.y, h * -so.Offset.y, 0.0f,
+                        0.0f,       0.0f,
+                        farAtInfinity ? (isOpenGL ? -h : 0.0f)
+                                      : (isOpenGL ? -h * (flipZ ? -1.0f : 1.0f) * (zNear + zFar) / (zNear - zFar)
+                                                  : -h * (flipZ ? -zNear : zFar) / (zNear - zFar)),
+                        farAtInfinity ? (isOpenGL ? 2.0f * zNear : zNear)
+                                      : (isOpenGL ? 2.0f * ((flipZ ? -zFar : zFar) * zNear) / (zNear - zFar)
+                                                  : ((flipZ ? -zFar : zFar) * zNear) / (zNear - zFar)),
+                        0.0f,       0.0f,       h,                0.0f);
+    }
+
+} // namespace Detail
+
+// Same as CreateProjection() in OVR_StereoProjection.h, including falling back to a
+// finite far plane when farAtInfinity is asked for without flipZ.
+constexpr Matrix4f Projection(bool leftHanded, bool isOpenGL, const FovPort& tanHalfFov,
+                              float zNear = 0.01f, float zFar = 10000.0f,
+                              bool flipZ = false, bool farAtInfinity = false)
+{
+    return Detail::Projection(NDCScaleAndOffsetFromFov(tanHalfFov), leftHanded ? 1.0f : -1.0f, isOpenGL,
+                              zNear, zFar, flipZ, flipZ && farAtInfinity);
+}
+
+} // namespace MathConstexpr
+
+#endif // OVR_MATH_CONSTEXPR_ENABLED
+
+
 } // Namespace OVR
 
 
@@ -0,0 +1,404 @@
+/********************************************************************************//**
+\file      OVR_MathApprox.h
+\brief     Approximate sqrt, 1/sqrt, atan2 and sin/cos kernels with selectable accuracy.
+\copyright Copyright 2014-2016 Oculus VR, LLC All Rights reserved.
+*************************************************************************************/
+
+#ifndef OVR_MathApprox_h
+#define OVR_MathApprox_h
+
+
+#include "Extras/OVR_Math.h"
+#include <float.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+
+namespace OVR {
+
+
+//-------------------------------------------------------------------------------------
+// ***** Approximate math kernels
+//
+// Replacements for the libm calls behind Length(), Normalized(), Quat::ToRotationVector,
+// GetEulerAngles and friends, in three accuracy tiers chosen per call site by a tag:
+//
+//     float len = MathApprox::Sqrt<MathFast>(lengthSq);
+//     MathApprox::SinCos<MathVeryFast>(angle, &s, &c);
+//
+//  MathPrecise   - libm / hardware sqrt, the same results as the rest of OVR_Math.
+//  MathFast      - relative error below 1e-6 for RSqrt and Sqrt, absolute error below
+//                  1e-6 for Atan2 (radians), Sin and Cos.
+//  MathVeryFast  - the same measures below 1e-3.
+//
+// Every kernel takes float or, when OVR_MATH_SIMD is on, MathSimd::Vec4f, so one call
+// site can handle a scalar or four lanes. double arguments always use MathPrecise.
+// The tiers bound the error, they don't fix the bits: results may differ between SIMD
+// backends and between the float and Vec4f versions.
+//
+// RSqrt expects x > 0; Sqrt also accepts 0. SinCos is meant for |angle| below about
+// 8000 radians, past that range reduction loses accuracy.
+
+struct MathPrecise  { };
+struct MathFast     { };
+struct MathVeryFast { };
+
+
+namespace MathApprox {
+
+namespace Detail {
+
+    // Lane-wise helpers for float, with Vec4f overloads below. A comparison result is a
+    // bool for float and a lane mask for Vec4f; it only feeds Select.
+    inline float SplatAs(float, float c)                { return c; }
+    inline float Div(float a, float b)                  { return a / b; }
+    inline float Min(float a, float b)                  { return OVRMath_Min(a, b); }
+    inline float Max(float a, float b)                  { return OVRMath_Max(a, b); }
+    inline float Abs(float v)                           { return fabsf(v); }
+    inline float Round(float v)                         { return float(int(v + (v < 0.0f ? -0.5f : 0.5f))); }
+    inline bool  CmpGt(float a, float b)                { return a > b; }
+    inline float Select(bool mask, float a, float b)    { return mask ? a : b; }
+
+    inline float SignBits(float v)
+    {
+        uint32_t bits;
+        memcpy(&bits, &v, 4);
+        bits &= 0x80000000u;
+        memcpy(&v, &bits, 4);
+        return v;
+    }
+
+    inline float Xor(float a, float b)
+    {
+        uint32_t ba, bb;
+        memcpy(&ba, &a, 4);
+        memcpy(&bb, &b, 4);
+        ba ^= bb;
+        memcpy(&a, &ba, 4);
+        return a;
+    }
+
+    inline float Add(float a, float b)                  { return a + b; }
+    inline float Sub(float a, float b)                  { return a - b; }
+    inline float Mul(float a, float b)                  { return a * b; }
+
+#if OVR_MATH_SIMD
+    using MathSimd::Vec4f;
+
+    inline Vec4f SplatAs(Vec4f, float c)                { return MathSimd::Splat(c); }
+    inline Vec4f Add(Vec4f a, Vec4f b)                  { return MathSimd::Add(a, b); }
+    inline Vec4f Sub(Vec4f a, Vec4f b)                  { return MathSimd::Sub(a, b); }
+    inline Vec4f Mul(Vec4f a, Vec4f b)                  { return MathSimd::Mul(a, b); }
+    inline Vec4f Div(Vec4f a, Vec4f b)                  { return MathSimd::Div(a, b); }
+    inline Vec4f Min(Vec4f a, Vec4f b)                  { return MathSimd::Min(a, b); }
+    inline Vec4f Max(Vec4f a, Vec4f b)                  { return MathSimd::Max(a, b); }
+    inline Vec4f Abs(Vec4f v)                           { return MathSimd::Abs(v); }
+    inline Vec4f Round(Vec4f v)                         { return MathSimd::Round(v); }
+    inline Vec4f CmpGt(Vec4f a, Vec4f b)                { return MathSimd::CmpGt(a, b); }
+    inline Vec4f Select(Vec4f mask, Vec4f a, Vec4f b)   { return MathSimd::Select(mask, a, b); }
+    inline Vec4f SignBits(Vec4f v)                      { return MathSimd::SignBits(v); }
+    inline Vec4f Xor(Vec4f a, Vec4f b)                  { return MathSimd::Xor(a, b); }
+
+    // Applies a float function to each lane, for the precise tier.
+    template<float (*F)(float)>
+    inline Vec4f PerLane(Vec4f v)
+    {
+        float f[4];
+        MathSimd::Store(f, v);
+        return MathSimd::Set(F(f[0]), F(f[1]), F(f[2]), F(f[3]));
+    }
+
+    inline float LibSin(float v)                        { return sinf(v); }
+    inline float LibCos(float v)                        { return cosf(v); }
+
+    inline Vec4f PreciseAtan2(Vec4f y, Vec4f x)
+    {
+        float fy[4], fx[4];
+        MathSimd::Store(fy, y);
+        MathSimd::Store(fx, x);
+        return MathSimd::Set(atan2f(fy[0], fx[0]), atan2f(fy[1], fx[1]), atan2f(fy[2], fx[2]), atan2f(fy[3], fx[3]));
+    }
+#endif
+
+
+    // 1/sqrt: a starting estimate refined by Newton steps until the tier's accuracy.
+    // The hardware estimate is used when there is one; otherwise the bit-level guess
+    // with the tuned first step from Moroz et al., "Modified Fast Inverse Square Root
+    // and Square Root Approximation Algorithms" (relative error 6.5e-4).
+#if OVR_MATH_SIMD
+    enum { RSqrtStepsFast = (MathSimd::RSqrtEstimateBits >= 11) ? 1 : 2,
+           RSqrtStepsVeryFast = (MathSimd::RSqrtEstimateBits >= 11) ? 0 : 1 };
+
+    inline float RSqrtEstimate(float x)                 { return MathSimd::RSqrtEstimate(x); }
+    inline Vec4f RSqrtEstimate(Vec4f x)                 { return MathSimd::RSqrtEstimate(x); }
+#else
+    enum { RSqrtStepsFast = 1, RSqrtStepsVeryFast = 0 };
+
+    inline float RSqrtEstimate(float x)
+    {
+        uint32_t bits;
+        memcpy(&bits, &x, 4);
+        bits = 0x5F1FFFF9u - (bits >> 1);
+        float y;
+        memcpy(&y, &bits, 4);
+        return y * 0.703952253f * (2.38924456f - x * y * y);
+    }
+#endif
+
+    template<class V>
+    inline V RSqrtNewton(V x, V y, int steps)
+    {
+        const V half = SplatAs(x, 0.5f), threeHalves = SplatAs(x, 1.5f);
+        const V halfX = Mul(half, x);
+        for (int i = 0; i < steps; i++)
+            y = Mul(y, Sub(threeHalves, Mul(halfX, Mul(y, y))));
+        return y;
+    }
+
+    template<class V> inline V RSqrt(V x, MathFast)     { return RSqrtNewton(x, RSqrtEstimate(x), RSqrtStepsFast); }
+    template<class V> inline V RSqrt(V x, MathVeryFast) { return RSqrtNewton(x, RSqrtEstimate(x), RSqrtStepsVeryFast); }
+    inline float RSqrt(float x, MathPrecise)            { return 1.0f / sqrtf(x); }
+
+    // x * 1/sqrt(x), with x clamped so that 0 gives 0 rather than 0 * inf.
+    template<class V, class Tier>
+    inline V Sqrt(V x, Tier tier)                       { return Mul(x, RSqrt(Max(x, SplatAs(x, FLT_MIN)), tier)); }
+    inline float Sqrt(float x, MathPrecise)             { return sqrtf(x); }
+
+#if OVR_MATH_SIMD
+    inline Vec4f RSqrt(Vec4f x, MathPrecise)            { return MathSimd::Div(MathSimd::Splat(1.0f), MathSimd::Sqrt(x)); }
+    inline Vec4f Sqrt(Vec4f x, MathPrecise)             { return MathSimd::Sqrt(x); }
+#endif
+
+
+    // atan on [0, 1]. MathFast uses the degree 15 polynomial of Abramowitz and Stegun
+    // 4.4.49; MathVeryFast a degree 5 minimax fit (error 6.1e-4).
+    template<class V>
+    inline V AtanUnit(V a, MathFast)
+    {
+        const V a2 = Mul(a, a);
+        V p = SplatAs(a, -0.0040540580f);
+        p = Add(Mul(p, a2), SplatAs(a,  0.0218612288f));
+        p = Add(Mul(p, a2), SplatAs(a, -0.0559098861f));
+        p = Add(Mul(p, a2), SplatAs(a,  0.0964200441f));
+        p = Add(Mul(p, a2), SplatAs(a, -0.1390853351f));
+        p = Add(Mul(p, a2), SplatAs(a,  0.1994653599f));
+        p = Add(Mul(p, a2), SplatAs(a, -0.3332985605f));
+        p = Add(Mul(p, a2), SplatAs(a,  0.9999993329f));
+        return Mul(p, a);
+    }
+
+    template<class V>
+    inline V AtanUnit(V a, MathVeryFast)
+    {
+        const V a2 = Mul(a, a);
+        V p = SplatAs(a, 0.0793379104f);
+        p = Add(Mul(p, a2), SplatAs(a, -0.2886891461f));
+        p = Add(Mul(p, a2), SplatAs(a,  0.9953577636f));
+        return Mul(p, a);
+    }
+
+    // Folds the angle into the first octant, evaluates there and unfolds.
+    template<class V, class Tier>
+    inline V Atan2(V y, V x, Tier tier)
+    {
+        const V ax = Abs(x), ay = Abs(y);
+        const V a = Div(Min(ax, ay), Max(Max(ax, ay), SplatAs(x, FLT_MIN)));
+
+        V r = AtanUnit(a, tier);
+        r = Select(CmpGt(ay, ax), Sub(SplatAs(x, MATH_FLOAT_PIOVER2), r), r);
+        r = Select(CmpGt(SplatAs(x, 0.0f), x), Sub(SplatAs(x, MATH_FLOAT_PI), r), r);
+        return Xor(r, SignBits(y));
+    }
+
+    inline float Atan2(float y, float x, MathPrecise)   { return atan2f(y, x); }
+#if OVR_MATH_SIMD
+    inline Vec4f Atan2(Vec4f y, Vec4f x, MathPrecise)   { return PreciseAtan2(y, x); }
+#endif
+
+
+    // sin and cos on [-pi/4, pi/4]. MathFast uses the Cephes sinf/cosf polynomials,
+    // MathVeryFast minimax fits of degree 3 and 4 (errors 1.5e-4 and 1e-5).
+    template<class V>
+    inline void SinCosReduced(V r, V& s, V& c, MathFast)
+    {
+        const V r2 = Mul(r, r);
+        V ps = SplatAs(r, -1.9515295891e-4f);
+        ps = Add(Mul(ps, r2), SplatAs(r,  8.3321608736e-3f));
+        ps = Add(Mul(ps, r2), SplatAs(r, -1.6666654611e-1f));
+        s = Add(r, Mul(Mul(ps, r2), r));
+
+        V pc = SplatAs(r, 2.443315711809948e-5f);
+        pc = Add(Mul(pc, r2), SplatAs(r, -1.388731625493765e-3f));
+        pc = Add(Mul(pc, r2), SplatAs(r,  4.166664568298827e-2f));
+        c = Add(Sub(SplatAs(r, 1.0f), Mul(SplatAs(r, 0.5f), r2)), Mul(Mul(pc, r2), r2));
+    }
+
+    template<class V>
+    inline void SinCosReduced(V r, V& s, V& c, MathVeryFast)
+    {
+        const V r2 = Mul(r, r);
+        s = Mul(r, Add(SplatAs(r, 0.9990313730f), Mul(r2, SplatAs(r, -0.1603438517f))));
+        c = Add(SplatAs(r, 0.9999900450f), Mul(r2, Add(SplatAs(r, -0.4997081971f), Mul(r2, SplatAs(r, 0.0403985986f)))));
+    }
+
+    // angle - q * pi/2 with pi/2 split in three so the products are exact (Cody-Waite).
+    // MathVeryFast gets by with one term.
+    template<class V>
+    inline V ReduceHalfPi(V angle, V q, MathFast)
+    {
+        V r = Sub(angle, Mul(q, SplatAs(q, 1.5703125f)));
+        r = Sub(r, Mul(q, SplatAs(q, 4.837512969970703125e-4f)));
+        return Sub(r, Mul(q, SplatAs(q, 7.54978995489188216e-8f)));
+    }
+
+    template<class V>
+    inline V ReduceHalfPi(V angle, V q, MathVeryFast)
+    {
+        return Sub(angle, Mul(q, SplatAs(q, MATH_FLOAT_PIOVER2)));
+    }
+
+    template<class V, class Tier>
+    inline void SinCos(V angle, V& sinOut, V& cosOut, Tier tier)
+    {
+        const V one = SplatAs(angle, 1.0f), two = SplatAs(angle, 2.0f);
+        const V half = SplatAs(angle, 0.5f), quarter = SplatAs(angle, 0.25f);
+
+        // Quadrant q, and its low two bits as 0 or 1 without integer ops:
+        // odd = q mod 2, high = floor(q / 2) mod 2.
+        const V q = Round(Mul(angle, SplatAs(angle, 2.0f / MATH_FLOAT_PI)));
+        const V qHalf = Round(Sub(Mul(q, half), quarter));
+        const V odd = Sub(q, Mul(two, qHalf));
+        const V high = Sub(qHalf, Mul(two, Round(Sub(Mul(qHalf, half), quarter))));
+
+        V s, c;
+        SinCosReduced(ReduceHalfPi(angle, q, tier), s, c, tier);
+
+        // Odd quadrants swap sin and cos. One of each pair of products is exactly zero.
+        const V even = Sub(one, odd);
+        const V sw = Add(Mul(odd, c), Mul(even, s));
+        const V cw = Add(Mul(odd, s), Mul(even, c));
+
+        // sin is negated in quadrants 2 and 3, cos in 1 and 2.
+        const V cosFlip = Sub(Add(odd, high), Mul(two, Mul(odd, high)));
+        sinOut = Mul(sw, Sub(one, Mul(two, high)));
+        cosOut = Mul(cw, Sub(one, Mul(two, cosFlip)));
+    }
+
+    inline void SinCos(float angle, float& s, float& c, MathPrecise)
+    {
+        s = sinf(angle);
+        c = cosf(angle);
+    }
+#if OVR_MATH_SIMD
+    inline void SinCos(Vec4f angle, Vec4f& s, Vec4f& c, MathPrecise)
+    {
+        s = PerLane<LibSin>(angle);
+        c = PerLane<LibCos>(angle);
+    }
+#endif
+
+} // namespace Detail
+
+
+template<class Tier, class V>
+inline V RSqrt(V x)                                     { return Detail::RSqrt(x, Tier()); }
+
+template<class Tier, class V>
+inline V Sqrt(V x)                                      { return Detail::Sqrt(x, Tier()); }
+
+template<class Tier, class V>
+inline V Atan2(V y, V x)                                { return Detail::Atan2(y, x, Tier()); }
+
+template<class Tier, class V>
+inline void SinCos(V angle, V* s, V* c)                 { Detail::SinCos(angle, *s, *c, Tier()); }
+
+template<class Tier, class V>
+inline V Sin(V angle)
+{
+    V s, c;
+    Detail::SinCos(angle, s, c, Tier());
+    return s;
+}
+
+template<class Tier, class V>
+inline V Cos(V angle)
+{
+    V s, c;
+    Detail::SinCos(angle, s, c, Tier());
+    return c;
+}
+
+// double always takes the precise path.
+template<class Tier> inline double RSqrt(double x)                          { return 1.0 / sqrt(x); }
+template<class Tier> inline double Sqrt(double x)                           { return sqrt(x); }
+template<class Tier> inline double Atan2(double y, double x)                { return atan2(y, x); }
+template<class Tier> inline double Sin(double angle)                        { return sin(angle); }
+template<class Tier> inline double Cos(double angle)                        { return cos(angle); }
+template<class Tier> inline void SinCos(double angle, double* s, double* c)
+{
+    *s = sin(angle);
+    *c = cos(angle);
+}
+
+
+// Tiered versions of the common OVR_Math callers.
+
+template<class Tier, class T>
+inline T Length(const Vector3<T>& v)                    { return Sqrt<Tier>(v.LengthSq()); }
+
+template<class Tier, class T>
+inline Vector3<T> Normalized(const Vector3<T>& v)
+{
+    const T lengthSq = v.LengthSq();
+    return (lengthSq > T(0)) ? v * RSqrt<Tier>(lengthSq) : v;
+}
+
+template<class Tier, class T>
+inline Quat<T> Normalized(const Quat<T>& q)
+{
+    const T lengthSq = q.LengthSq();
+    return (lengthSq > T(0)) ? q * RSqrt<Tier>(lengthSq) : q;
+}
+
+// Normalizes vectors stored as separate x, y and z arrays, four at a time for float with
+// the OVR_MATH_SIMD backend. Zero-length vectors are left as they are.
+template<class Tier>
+inline void NormalizeMany(float* xs, float* ys, float* zs, size_t count)
+{
+    size_t i = 0;
+
+#if OVR_MATH_SIMD
+    const MathSimd::Vec4f zero = MathSimd::Splat(0.0f);
+    for (; i + 4 <= count; i += 4)
+    {
+        const MathSimd::Vec4f x = MathSimd::Load(xs + i), y = MathSimd::Load(ys + i), z = MathSimd::Load(zs + i);
+        const MathSimd::Vec4f lengthSq = MathSimd::Add(MathSimd::Add(MathSimd::Mul(x, x), MathSimd::Mul(y, y)), MathSimd::Mul(z, z));
+        const MathSimd::Vec4f nonZero = MathSimd::CmpGt(lengthSq, zero);
+        const MathSimd::Vec4f scale = MathSimd::Select(nonZero, RSqrt<Tier>(MathSimd::Max(lengthSq, MathSimd::Splat(FLT_MIN))), MathSimd::Splat(1.0f));
+        MathSimd::Store(xs + i, MathSimd::Mul(x, scale));
+        MathSimd::Store(ys + i, MathSimd::Mul(y, scale));
+        MathSimd::Store(zs + i, MathSimd::Mul(z, scale));
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        const float lengthSq = xs[i] * xs[i] + ys[i] * ys[i] + zs[i] * zs[i];
+        if (lengthSq > 0.0f)
+        {
+            const float scale = RSqrt<Tier>(lengthSq);
+            xs[i] *= scale;
+            ys[i] *= scale;
+            zs[i] *= scale;
+        }
+    }
+}
+
+} // namespace MathApprox
+
+
+} // Namespace OVR
+
+
+#endif
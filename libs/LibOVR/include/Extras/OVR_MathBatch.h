@@ -0,0 +1,406 @@
+/********************************************************************************//**
+\file      OVR_MathBatch.h
+\brief     Batched versions of the OVR_Math.h point transforms and quaternion interpolation.
+\copyright Copyright 2014-2016 Oculus VR, LLC All Rights reserved.
+*************************************************************************************/
+
+#ifndef OVR_MathBatch_h
+#define OVR_MathBatch_h
+
+
+#include "Extras/OVR_Math.h"
+#include <stddef.h>
+
+
+namespace OVR {
+
+
+//-------------------------------------------------------------------------------------
+// ***** Batch point transforms
+//
+// These apply one Quat or Pose to many points stored as separate x, y and z arrays
+// (structure of arrays). Each point gives exactly the same result as the matching
+// single-point function (Quat::Rotate, Quat::InverseRotate, Pose::Transform,
+// Pose::InverseTransform). For float the points are processed four at a time with
+// the OVR_MATH_SIMD backend and the remainder with scalar code.
+//
+// Arrays need no particular alignment. The output arrays may be the same as the input
+// arrays to transform in place, but must not otherwise overlap them.
+
+namespace MathBatch {
+
+    template<class V> inline V Add(V a, V b) { return a + b; }
+    template<class V> inline V Sub(V a, V b) { return a - b; }
+    template<class V> inline V Mul(V a, V b) { return a * b; }
+
+#if OVR_MATH_SIMD
+    using MathSimd::Vec4f;
+    using MathSimd::Load;
+    using MathSimd::Store;
+    using MathSimd::Splat;
+
+    inline Vec4f Add(Vec4f a, Vec4f b) { return MathSimd::Add(a, b); }
+    inline Vec4f Sub(Vec4f a, Vec4f b) { return MathSimd::Sub(a, b); }
+    inline Vec4f Mul(Vec4f a, Vec4f b) { return MathSimd::Mul(a, b); }
+#endif
+
+    // Same operations and order as Quat::Rotate. Passing -w gives Quat::InverseRotate.
+    template<class V>
+    inline void Rotate(V qx, V qy, V qz, V qw, V two, V& x, V& y, V& z)
+    {
+        const V uvx = Mul(two, Sub(Mul(qy, z), Mul(qz, y)));
+        const V uvy = Mul(two, Sub(Mul(qz, x), Mul(qx, z)));
+        const V uvz = Mul(two, Sub(Mul(qx, y), Mul(qy, x)));
+
+        const V rx = Sub(Add(Add(x, Mul(qw, uvx)), Mul(qy, uvz)), Mul(qz, uvy));
+        const V ry = Sub(Add(Add(y, Mul(qw, uvy)), Mul(qz, uvx)), Mul(qx, uvz));
+        const V rz = Sub(Add(Add(z, Mul(qw, uvz)), Mul(qx, uvy)), Mul(qy, uvx));
+        x = rx; y = ry; z = rz;
+    }
+
+    // Rotation and translation in the order used by Pose::Transform (Inverse = false)
+    // or Pose::InverseTransform (Inverse = true).
+    template<bool Inverse, bool Translate, class V>
+    inline void Apply(V qx, V qy, V qz, V qw, V tx, V ty, V tz, V two, V& x, V& y, V& z)
+    {
+        if (Translate && Inverse)
+        {
+            x = Sub(x, tx); y = Sub(y, ty); z = Sub(z, tz);
+        }
+
+        Rotate(qx, qy, qz, qw, two, x, y, z);
+
+        if (Translate && !Inverse)
+        {
+            x = Add(x, tx); y = Add(y, ty); z = Add(z, tz);
+        }
+    }
+
+    // Handles as many whole groups of four as the backend allows, returns the count done.
+    template<bool Inverse, bool Translate, class T>
+    inline size_t RunVector(const Quat<T>&, const Vector3<T>&,
+                            const T*, const T*, const T*, T*, T*, T*, size_t)
+    {
+        return 0;
+    }
+
+#if OVR_MATH_SIMD
+    template<bool Inverse, bool Translate>
+    inline size_t RunVector(const Quat<float>& q, const Vector3<float>& t,
+                            const float* xs, const float* ys, const float* zs,
+                            float* outXs, float* outYs, float* outZs, size_t count)
+    {
+        const Vec4f qx = Splat(q.x), qy = Splat(q.y), qz = Splat(q.z);
+        const Vec4f qw = Splat(Inverse ? -q.w : q.w);
+        const Vec4f tx = Splat(t.x), ty = Splat(t.y), tz = Splat(t.z);
+        const Vec4f two = Splat(2.0f);
+
+        const size_t end = count & ~size_t(3);
+        for (size_t i = 0; i < end; i += 4)
+        {
+            Vec4f x = Load(xs + i), y = Load(ys + i), z = Load(zs + i);
+            Apply<Inverse, Translate>(qx, qy, qz, qw, tx, ty, tz, two, x, y, z);
+            Store(outXs + i, x);
+            Store(outYs + i, y);
+            Store(outZs + i, z);
+        }
+        return end;
+    }
+#endif
+
+    template<bool Inverse, bool Translate, class T>
+    inline void Run(const Quat<T>& q, const Vector3<T>& t,
+                    const T* xs, const T* ys, const T* zs,
+                    T* outXs, T* outYs, T* outZs, size_t count)
+    {
+        OVR_MATH_ASSERT(q.IsNormalized());
+
+        size_t i = RunVector<Inverse, Translate>(q, t, xs, ys, zs, outXs, outYs, outZs, count);
+
+        const T qw = Inverse ? -q.w : q.w;
+        for (; i < count; i++)
+        {
+            T x = xs[i], y = ys[i], z = zs[i];
+            Apply<Inverse, Translate>(q.x, q.y, q.z, qw, t.x, t.y, t.z, T(2), x, y, z);
+            outXs[i] = x;
+            outYs[i] = y;
+            outZs[i] = z;
+        }
+    }
+
+} // namespace MathBatch
+
+
+// Batched Quat::Rotate.
+template<class T>
+inline void RotateMany(const Quat<T>& q,
+                       const T* xs, const T* ys, const T* zs,
+                       T* outXs, T* outYs, T* outZs, size_t count)
+{
+    MathBatch::Run<false, false>(q, Vector3<T>(), xs, ys, zs, outXs, outYs, outZs, count);
+}
+
+// Batched Quat::InverseRotate.
+template<class T>
+inline void InverseRotateMany(const Quat<T>& q,
+                              const T* xs, const T* ys, const T* zs,
+                              T* outXs, T* outYs, T* outZs, size_t count)
+{
+    MathBatch::Run<true, false>(q, Vector3<T>(), xs, ys, zs, outXs, outYs, outZs, count);
+}
+
+// Batched Pose::Transform (and Pose::Apply).
+template<class T>
+inline void TransformPoints(const Pose<T>& pose,
+                            const T* xs, const T* ys, const T* zs,
+                            T* outXs, T* outYs, T* outZs, size_t count)
+{
+    MathBatch::Run<false, true>(pose.Rotation, pose.Translation, xs, ys, zs, outXs, outYs, outZs, count);
+}
+
+// In-place version of the above.
+template<class T>
+inline void TransformPoints(const Pose<T>& pose, T* xs, T* ys, T* zs, size_t count)
+{
+    TransformPoints(pose, xs, ys, zs, xs, ys, zs, count);
+}
+
+// Batched Pose::InverseTransform.
+template<class T>
+inline void InverseTransformPoints(const Pose<T>& pose,
+                                   const T* xs, const T* ys, const T* zs,
+                                   T* outXs, T* outYs, T* outZs, size_t count)
+{
+    MathBatch::Run<true, true>(pose.Rotation, pose.Translation, xs, ys, zs, outXs, outYs, outZs, count);
+}
+
+// In-place version of the above.
+template<class T>
+inline void InverseTransformPoints(const Pose<T>& pose, T* xs, T* ys, T* zs, size_t count)
+{
+    InverseTransformPoints(pose, xs, ys, zs, xs, ys, zs, count);
+}
+
+
+//-------------------------------------------------------------------------------------
+// ***** Batch quaternion interpolation
+//
+// SlerpMany interpolates arrays of rotations, a[i] towards b[i], along the shortest arc
+// like Quat::Slerp. s is either one blend factor for every element or one per element.
+// out may be the same array as a or b.
+//
+// Slerp_Accurate uses the usual sin/acos weights per element, with results within
+// float rounding of Quat::Slerp. Slerp_Fast evaluates the slerp weights as a degree 8
+// polynomial in cos(angle) (Eberly, "A Fast and Accurate Algorithm for Computing
+// SLERP"), with no transcendentals or branches, four rotations at a time for float.
+// The weights are within 1e-6 of the exact ones for rotations up to 120 degrees apart,
+// growing to about 3e-5 as they approach 180 degrees. Results are not renormalized.
+
+enum SlerpMode
+{
+    Slerp_Accurate,
+    Slerp_Fast
+};
+
+namespace MathBatch {
+
+    // Per-backend helpers for the fast kernel. For scalars a sign is +1 or -1,
+    // for vectors it is a sign bit mask.
+    template<class V> inline V SplatAs(V, float c)      { return V(c); }
+    template<class V> inline V SignOf(V x)              { return (x < V(0)) ? V(-1) : V(1); }
+    template<class V> inline V ApplySign(V v, V sign)   { return v * sign; }
+
+#if OVR_MATH_SIMD
+    inline Vec4f SplatAs(Vec4f, float c)                { return Splat(c); }
+    inline Vec4f SignOf(Vec4f x)                        { return MathSimd::SignBits(x); }
+    inline Vec4f ApplySign(Vec4f v, Vec4f sign)         { return MathSimd::Xor(v, sign); }
+#endif
+
+    // Coefficients of the slerp polynomial: u[i] = 1/((i+1)(2i+3)), v[i] = (i+1)/(2i+3),
+    // with the last term scaled by 1 + mu to balance the truncation error.
+    struct SlerpCoefficients
+    {
+        static float U(int i)
+        {
+            static const float u[8] = {
+                1.0f / (1 * 3), 1.0f / (2 * 5), 1.0f / (3 * 7), 1.0f / (4 * 9),
+                1.0f / (5 * 11), 1.0f / (6 * 13), 1.0f / (7 * 15), 1.90110745351730037f / (8 * 17) };
+            return u[i];
+        }
+        static float V(int i)
+        {
+            static const float v[8] = {
+                1.0f / 3, 2.0f / 5, 3.0f / 7, 4.0f / 9,
+                5.0f / 11, 6.0f / 13, 7.0f / 15, 1.90110745351730037f * 8 / 17 };
+            return v[i];
+        }
+    };
+
+    template<class V>
+    inline void FastSlerp(V ax, V ay, V az, V aw, V bx, V by, V bz, V bw, V t,
+                          V& rx, V& ry, V& rz, V& rw)
+    {
+        const V one = SplatAs(t, 1.0f);
+
+        // Take the shortest arc by flipping b when the rotations are over 180 degrees apart
+        V cosAngle = Add(Add(Add(Mul(ax, bx), Mul(ay, by)), Mul(az, bz)), Mul(aw, bw));
+        const V sign = SignOf(cosAngle);
+        cosAngle = ApplySign(cosAngle, sign);
+        bx = ApplySign(bx, sign);
+        by = ApplySign(by, sign);
+        bz = ApplySign(bz, sign);
+        bw = ApplySign(bw, sign);
+
+        const V xm1 = Sub(cosAngle, one);
+        const V d = Sub(one, t);
+        const V sqrT = Mul(t, t);
+        const V sqrD = Mul(d, d);
+
+        V cT = one, cD = one;
+        for (int i = 7; i >= 0; i--)
+        {
+            const V u = SplatAs(t, SlerpCoefficients::U(i));
+            const V v = SplatAs(t, SlerpCoefficients::V(i));
+            cT = Add(one, Mul(Mul(Sub(Mul(u, sqrT), v), xm1), cT));
+            cD = Add(one, Mul(Mul(Sub(Mul(u, sqrD), v), xm1), cD));
+        }
+        cT = Mul(t, cT);
+        cD = Mul(d, cD);
+
+        rx = Add(Mul(cD, ax), Mul(cT, bx));
+        ry = Add(Mul(cD, ay), Mul(cT, by));
+        rz = Add(Mul(cD, az), Mul(cT, bz));
+        rw = Add(Mul(cD, aw), Mul(cT, bw));
+    }
+
+    template<class T>
+    inline Quat<T> AccurateSlerp(const Quat<T>& a, Quat<T> b, T t)
+    {
+        T cosAngle = a.Dot(b);
+        if (cosAngle < T(0))
+        {
+            cosAngle = -cosAngle;
+            b = -b;
+        }
+
+        T wa = T(1) - t;
+        T wb = t;
+        // Below about 0.1 degrees the weights are indistinguishable from a lerp
+        if (cosAngle < T(1) - T(1e-6))
+        {
+            const T angle = acos(cosAngle);
+            const T rcpSin = T(1) / sqrt(T(1) - cosAngle * cosAngle);
+            wa = sin(wa * angle) * rcpSin;
+            wb = sin(wb * angle) * rcpSin;
+        }
+        return Quat<T>(wa * a.x + wb * b.x, wa * a.y + wb * b.y,
+                       wa * a.z + wb * b.z, wa * a.w + wb * b.w).Normalized();
+    }
+
+    // Handles as many whole groups of four as the backend allows, returns the count done.
+    template<class T>
+    inline size_t FastSlerpVector(const Quat<T>*, const Quat<T>*, const T*, size_t, Quat<T>*, size_t)
+    {
+        return 0;
+    }
+
+#if OVR_MATH_SIMD
+    inline size_t FastSlerpVector(const Quat<float>* a, const Quat<float>* b, const float* s, size_t sStep,
+                                  Quat<float>* out, size_t count)
+    {
+        const size_t end = count & ~size_t(3);
+        for (size_t i = 0; i < end; i += 4)
+        {
+            Vec4f ax = Load(&a[i].x), ay = Load(&a[i + 1].x), az = Load(&a[i + 2].x), aw = Load(&a[i + 3].x);
+            Vec4f bx = Load(&b[i].x), by = Load(&b[i + 1].x), bz = Load(&b[i + 2].x), bw = Load(&b[i + 3].x);
+            MathSimd::Transpose(ax, ay, az, aw);
+            MathSimd::Transpose(bx, by, bz, bw);
+            const Vec4f t = sStep ? Load(s + i) : Splat(*s);
+
+            Vec4f rx, ry, rz, rw;
+            FastSlerp(ax, ay, az, aw, bx, by, bz, bw, t, rx, ry, rz, rw);
+
+            MathSimd::Transpose(rx, ry, rz, rw);
+            Store(&out[i].x, rx);
+            Store(&out[i + 1].x, ry);
+            Store(&out[i + 2].x, rz);
+            Store(&out[i + 3].x, rw);
+        }
+        return end;
+    }
+#endif
+
+    template<class T>
+    inline void SlerpRun(const Quat<T>* a, const Quat<T>* b, const T* s, size_t sStep,
+                         Quat<T>* out, size_t count, SlerpMode mode)
+    {
+        if (mode == Slerp_Accurate)
+        {
+            for (size_t i = 0; i < count; i++)
+                out[i] = AccurateSlerp(a[i], b[i], s[i * sStep]);
+            return;
+        }
+
+        size_t i = FastSlerpVector(a, b, s, sStep, out, count);
+        for (; i < count; i++)
+        {
+            T rx, ry, rz, rw;
+            FastSlerp(a[i].x, a[i].y, a[i].z, a[i].w, b[i].x, b[i].y, b[i].z, b[i].w, s[i * sStep],
+                      rx, ry, rz, rw);
+            out[i] = Quat<T>(rx, ry, rz, rw);
+        }
+    }
+
+} // namespace MathBatch
+
+
+// Interpolates every a[i] towards b[i] by the same factor s.
+template<class T>
+inline void SlerpMany(const Quat<T>* a, const Quat<T>* b, T s, Quat<T>* out, size_t count,
+                      SlerpMode mode = Slerp_Accurate)
+{
+    MathBatch::SlerpRun(a, b, &s, 0, out, count, mode);
+}
+
+// Interpolates every a[i] towards b[i] by s[i].
+template<class T>
+inline void SlerpMany(const Quat<T>* a, const Quat<T>* b, const T* s, Quat<T>* out, size_t count,
+                      SlerpMode mode = Slerp_Accurate)
+{
+    MathBatch::SlerpRun(a, b, s, 1, out, count, mode);
+}
+
+
+//-------------------------------------------------------------------------------------
+// ***** Vector3 array layout conversion
+//
+// Converts between an array of Vector3 (array of structures) and separate x, y and z
+// arrays as used by the batch transforms above.
+
+template<class T>
+inline void Vector3ToSoA(const Vector3<T>* src, T* xs, T* ys, T* zs, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        xs[i] = src[i].x;
+        ys[i] = src[i].y;
+        zs[i] = src[i].z;
+    }
+}
+
+template<class T>
+inline void Vector3FromSoA(const T* xs, const T* ys, const T* zs, Vector3<T>* dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        dst[i].x = xs[i];
+        dst[i].y = ys[i];
+        dst[i].z = zs[i];
+    }
+}
+
+
+} // Namespace OVR
+
+
+#endif
@@ -65,6 +65,47 @@ Matrix4f            CreateOrthoSubProjection ( bool rightHanded, StereoEye eyeTy
 ScaleAndOffset2D    CreateNDCScaleAndOffsetFromFov ( FovPort fov );
 
 
+//-----------------------------------------------------------------------------------
+// ***** Batched point projection
+//
+// Projects many points into one eye's view at once, e.g. for gaze picking and UI
+// hit-testing. eyeToNDC is CreateNDCScaleAndOffsetFromFov() of that eye's FOV and the
+// NDC x and y match what the CreateProjection() matrix gives after the divide by w
+// (+Y up, eye looking down -Z). Depth is the distance in front of the eye along -Z;
+// points with a depth <= 0 are behind the eye and their NDC is meaningless.
+//
+// Each batch function gives exactly the same results as the single point function
+// before it. Points are processed four at a time with the OVR_MATH_SIMD backend.
+// The depth arrays are optional on output (pass NULL when not needed).
+
+Vector2f            ProjectPoint ( const Posef& eyePose, const ScaleAndOffset2D& eyeToNDC,
+                                   const Vector3f& worldPoint, float* depth = NULL );
+
+void                ProjectPoints ( const Posef& eyePose, const ScaleAndOffset2D& eyeToNDC,
+                                    const Vector3f* worldPoints, Vector2f* ndcPoints,
+                                    float* depths, size_t count );
+
+// Inverse of ProjectPoint() for a known depth.
+Vector3f            UnprojectPoint ( const Posef& eyePose, const ScaleAndOffset2D& eyeToNDC,
+                                     const Vector2f& ndcPoint, float depth );
+
+void                UnprojectPoints ( const Posef& eyePose, const ScaleAndOffset2D& eyeToNDC,
+                                      const Vector2f* ndcPoints, const float* depths,
+                                      Vector3f* worldPoints, size_t count );
+
+// Moves points seen from one eye pose to where they are seen from another, e.g. to
+// reuse last frame's results after the head moved. Goes through the relative pose
+// of the two eyes, not through world space.
+Vector2f            ReprojectPoint ( const Posef& fromEyePose, const ScaleAndOffset2D& fromEyeToNDC,
+                                     const Posef& toEyePose, const ScaleAndOffset2D& toEyeToNDC,
+                                     const Vector2f& ndcPoint, float depth, float* newDepth = NULL );
+
+void                ReprojectPoints ( const Posef& fromEyePose, const ScaleAndOffset2D& fromEyeToNDC,
+                                      const Posef& toEyePose, const ScaleAndOffset2D& toEyeToNDC,
+                                      const Vector2f* ndcPoints, const float* depths,
+                                      Vector2f* newNdcPoints, float* newDepths, size_t count );
+
+
 } //namespace OVR
 
 #endif // OVR_StereoProjection_h
@@ -25,6 +25,7 @@ limitations under the License.
 *************************************************************************************/
 
 #include <Extras/OVR_StereoProjection.h>
+#include <Extras/OVR_MathBatch.h>
 
 
 namespace OVR {
@@ -221,6 +222,189 @@ Matrix4f CreateOrthoSubProjection ( bool /*rightHanded*/, StereoEye eyeType,
 }
 
 
+//-----------------------------------------------------------------------------------
+// Batched point projection
+//
+// The batch versions work through the points in chunks held as separate x, y and z
+// arrays on the stack, so the pose transforms can use OVR_MathBatch and the divides
+// can run four at a time. The per-point math is written out in the same order in the
+// single point and the batch versions to keep them bit-identical.
+
+static const size_t ProjectionChunkSize = 64;
+
+// Eye space points to NDC in place: x and y become NDC, z becomes the depth.
+static void ProjectEyeSpace(const ScaleAndOffset2D& eyeToNDC, float* xs, float* ys, float* zs, size_t count)
+{
+    size_t i = 0;
+
+#if OVR_MATH_SIMD
+    const MathSimd::Vec4f sx = MathSimd::Splat(eyeToNDC.Scale.x);
+    const MathSimd::Vec4f sy = MathSimd::Splat(eyeToNDC.Scale.y);
+    const MathSimd::Vec4f ox = MathSimd::Splat(eyeToNDC.Offset.x);
+    const MathSimd::Vec4f oy = MathSimd::Splat(eyeToNDC.Offset.y);
+    const MathSimd::Vec4f negate = MathSimd::Splat(-0.0f);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        const MathSimd::Vec4f depth = MathSimd::Xor(MathSimd::Load(zs + i), negate);
+        MathSimd::Store(xs + i, MathSimd::Add(MathSimd::Mul(MathSimd::Div(MathSimd::Load(xs + i), depth), sx), ox));
+        MathSimd::Store(ys + i, MathSimd::Sub(MathSimd::Mul(MathSimd::Div(MathSimd::Load(ys + i), depth), sy), oy));
+        MathSimd::Store(zs + i, depth);
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        const float depth = -zs[i];
+        xs[i] = (xs[i] / depth) * eyeToNDC.Scale.x + eyeToNDC.Offset.x;
+        ys[i] = (ys[i] / depth) * eyeToNDC.Scale.y - eyeToNDC.Offset.y;
+        zs[i] = depth;
+    }
+}
+
+// NDC and depth to eye space points in place, the inverse of ProjectEyeSpace.
+static void UnprojectEyeSpace(const ScaleAndOffset2D& eyeToNDC, float* xs, float* ys, float* zs, size_t count)
+{
+    size_t i = 0;
+
+#if OVR_MATH_SIMD
+    const MathSimd::Vec4f sx = MathSimd::Splat(eyeToNDC.Scale.x);
+    const MathSimd::Vec4f sy = MathSimd::Splat(eyeToNDC.Scale.y);
+    const MathSimd::Vec4f ox = MathSimd::Splat(eyeToNDC.Offset.x);
+    const MathSimd::Vec4f oy = MathSimd::Splat(eyeToNDC.Offset.y);
+    const MathSimd::Vec4f negate = MathSimd::Splat(-0.0f);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        const MathSimd::Vec4f depth = MathSimd::Load(zs + i);
+        MathSimd::Store(xs + i, MathSimd::Mul(MathSimd::Div(MathSimd::Sub(MathSimd::Load(xs + i), ox), sx), depth));
+        MathSimd::Store(ys + i, MathSimd::Mul(MathSimd::Div(MathSimd::Add(MathSimd::Load(ys + i), oy), sy), depth));
+        MathSimd::Store(zs + i, MathSimd::Xor(depth, negate));
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        const float depth = zs[i];
+        xs[i] = ((xs[i] - eyeToNDC.Offset.x) / eyeToNDC.Scale.x) * depth;
+        ys[i] = ((ys[i] + eyeToNDC.Offset.y) / eyeToNDC.Scale.y) * depth;
+        zs[i] = -depth;
+    }
+}
+
+static void LoadNDC(const Vector2f* ndcPoints, const float* depths, float* xs, float* ys, float* zs, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        xs[i] = ndcPoints[i].x;
+        ys[i] = ndcPoints[i].y;
+        zs[i] = depths[i];
+    }
+}
+
+static void StoreNDC(const float* xs, const float* ys, const float* zs, Vector2f* ndcPoints, float* depths, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        ndcPoints[i].x = xs[i];
+        ndcPoints[i].y = ys[i];
+    }
+    if (depths)
+    {
+        for (size_t i = 0; i < count; i++)
+            depths[i] = zs[i];
+    }
+}
+
+
+Vector2f ProjectPoint ( const Posef& eyePose, const ScaleAndOffset2D& eyeToNDC,
+                        const Vector3f& worldPoint, float* depth /*= NULL*/ )
+{
+    Vector3f p = eyePose.InverseTransform(worldPoint);
+    ProjectEyeSpace(eyeToNDC, &p.x, &p.y, &p.z, 1);
+    if (depth)
+        *depth = p.z;
+    return Vector2f(p.x, p.y);
+}
+
+void ProjectPoints ( const Posef& eyePose, const ScaleAndOffset2D& eyeToNDC,
+                     const Vector3f* worldPoints, Vector2f* ndcPoints,
+                     float* depths, size_t count )
+{
+    float xs[ProjectionChunkSize], ys[ProjectionChunkSize], zs[ProjectionChunkSize];
+
+    for (size_t start = 0; start < count; start += ProjectionChunkSize)
+    {
+        const size_t n = OVRMath_Min(count - start, ProjectionChunkSize);
+
+        Vector3ToSoA(worldPoints + start, xs, ys, zs, n);
+        InverseTransformPoints(eyePose, xs, ys, zs, n);
+        ProjectEyeSpace(eyeToNDC, xs, ys, zs, n);
+        StoreNDC(xs, ys, zs, ndcPoints + start, depths ? depths + start : NULL, n);
+    }
+}
+
+Vector3f UnprojectPoint ( const Posef& eyePose, const ScaleAndOffset2D& eyeToNDC,
+                          const Vector2f& ndcPoint, float depth )
+{
+    Vector3f p(ndcPoint.x, ndcPoint.y, depth);
+    UnprojectEyeSpace(eyeToNDC, &p.x, &p.y, &p.z, 1);
+    return eyePose.Transform(p);
+}
+
+void UnprojectPoints ( const Posef& eyePose, const ScaleAndOffset2D& eyeToNDC,
+                       const Vector2f* ndcPoints, const float* depths,
+                       Vector3f* worldPoints, size_t count )
+{
+    float xs[ProjectionChunkSize], ys[ProjectionChunkSize], zs[ProjectionChunkSize];
+
+    for (size_t start = 0; start < count; start += ProjectionChunkSize)
+    {
+        const size_t n = OVRMath_Min(count - start, ProjectionChunkSize);
+
+        LoadNDC(ndcPoints + start, depths + start, xs, ys, zs, n);
+        UnprojectEyeSpace(eyeToNDC, xs, ys, zs, n);
+        TransformPoints(eyePose, xs, ys, zs, n);
+        Vector3FromSoA(xs, ys, zs, worldPoints + start, n);
+    }
+}
+
+Vector2f ReprojectPoint ( const Posef& fromEyePose, const ScaleAndOffset2D& fromEyeToNDC,
+                          const Posef& toEyePose, const ScaleAndOffset2D& toEyeToNDC,
+                          const Vector2f& ndcPoint, float depth, float* newDepth /*= NULL*/ )
+{
+    const Posef fromToEye = toEyePose.Inverted() * fromEyePose;
+
+    Vector3f p(ndcPoint.x, ndcPoint.y, depth);
+    UnprojectEyeSpace(fromEyeToNDC, &p.x, &p.y, &p.z, 1);
+    p = fromToEye.Transform(p);
+    ProjectEyeSpace(toEyeToNDC, &p.x, &p.y, &p.z, 1);
+    if (newDepth)
+        *newDepth = p.z;
+    return Vector2f(p.x, p.y);
+}
+
+void ReprojectPoints ( const Posef& fromEyePose, const ScaleAndOffset2D& fromEyeToNDC,
+                       const Posef& toEyePose, const ScaleAndOffset2D& toEyeToNDC,
+                       const Vector2f* ndcPoints, const float* depths,
+                       Vector2f* newNdcPoints, float* newDepths, size_t count )
+{
+    const Posef fromToEye = toEyePose.Inverted() * fromEyePose;
+    float xs[ProjectionChunkSize], ys[ProjectionChunkSize], zs[ProjectionChunkSize];
+
+    for (size_t start = 0; start < count; start += ProjectionChunkSize)
+    {
+        const size_t n = OVRMath_Min(count - start, ProjectionChunkSize);
+
+        LoadNDC(ndcPoints + start, depths + start, xs, ys, zs, n);
+        UnprojectEyeSpace(fromEyeToNDC, xs, ys, zs, n);
+        TransformPoints(fromToEye, xs, ys, zs, n);
+        ProjectEyeSpace(toEyeToNDC, xs, ys, zs, n);
+        StoreNDC(xs, ys, zs, newNdcPoints + start, newDepths ? newDepths + start : NULL, n);
+    }
+}
+
+
 
 } //namespace OVR
 
@@ -25,6 +25,7 @@ limitations under the License.
     #include "Kernel/OVR_Win32_IncludeWindows.h"
 #endif // OVR_OS_WIN32
 #include <string.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string>
 #include <assert.h>
@@ -62,9 +63,10 @@ limitations under the License.
     // Example usage:
     //     GLELoadProc(glCopyTexSubImage3D, glCopyTexSubImage3D);
     // Expands to:
-    //     gleCopyTexSubImage3D = (OVRTypeof(gleCopyTexSubImage3D)) GLEGetProcAddress("glCopyTexSubImage3D");
+    //     gleCopyTexSubImage3D = (OVRTypeof(gleCopyTexSubImage3D)) ResolveFunction("glCopyTexSubImage3D");
+    // Must be used within a GLEContext member function.
     
-    #define GLELoadProc(var, name) var = (OVRTypeof(var))GLEGetProcAddress(#name)
+    #define GLELoadProc(var, name) var = (OVRTypeof(var))ResolveFunction(#name)
     
 
     // Disable some #defines, as we need to call these functions directly.
@@ -122,6 +124,71 @@ limitations under the License.
     {
         GLECurrentContext = p;
     }
+
+    OVR::GLEContext* OVR::GLEContext::GetExtensionContext()
+    {
+        OVR::GLEContext* p = GLECurrentContext;
+
+        // We can only read the extension list once Init has found a context (IsInitialized). Before
+        // that only the platform booleans (e.g. gle_WGL_ARB_create_context) are meaningful anyway.
+        if(!p->ExtensionSupportInitialized && p->IsInitialized())
+            p->InitExtensionSupport();
+
+        return p;
+    }
+
+    void* OVR::GLEContext::ResolveFunction(const char* name)
+    {
+        void* address = GLEGetProcAddress(name);
+
+        if(address)
+            ++ResolvedFunctionCount;
+
+        return address;
+    }
+
+    // Functions that InitExtensionLoad maps to an equivalent under another name when the driver doesn't
+    // have them. Lazy loading applies the same mapping, one function at a time.
+    struct FunctionFallback
+    {
+        const char* Name;
+        const char* FallbackName;
+    };
+
+    static const FunctionFallback FunctionFallbacks[] =
+    {
+        // GL_EXT_framebuffer_object is basically a subset of GL_ARB_framebuffer_object, but we use only that subset.
+        { "glBindFramebuffer",                     "glBindFramebufferEXT" },
+        { "glBindRenderbuffer",                    "glBindRenderbufferEXT" },
+        { "glCheckFramebufferStatus",              "glCheckFramebufferStatusEXT" },
+        { "glDeleteFramebuffers",                  "glDeleteFramebuffersEXT" },
+        { "glDeleteRenderbuffers",                 "glDeleteRenderbuffersEXT" },
+        { "glFramebufferRenderbuffer",             "glFramebufferRenderbufferEXT" },
+        { "glFramebufferTexture1D",                "glFramebufferTexture1DEXT" },
+        { "glFramebufferTexture2D",                "glFramebufferTexture2DEXT" },
+        { "glFramebufferTexture3D",                "glFramebufferTexture3DEXT" },
+        { "glGenFramebuffers",                     "glGenFramebuffersEXT" },
+        { "glGenRenderbuffers",                    "glGenRenderbuffersEXT" },
+        { "glGenerateMipmap",                      "glGenerateMipmapEXT" },
+        { "glGetFramebufferAttachmentParameteriv", "glGetFramebufferAttachmentParameterivEXT" },
+        { "glGetRenderbufferParameteriv",          "glGetRenderbufferParameterivEXT" },
+        { "glIsFramebuffer",                       "glIsFramebufferEXT" },
+        { "glIsRenderbuffer",                      "glIsRenderbufferEXT" },
+        { "glRenderbufferStorage",                 "glRenderbufferStorageEXT" }
+    };
+
+    void* OVR::GLEContext::ResolveLazyFunction(const char* name)
+    {
+        void* address = ResolveFunction(name);
+
+        for(size_t i = 0; !address && (i < OVR_ARRAY_COUNT(FunctionFallbacks)); i++)
+        {
+            if(strcmp(name, FunctionFallbacks[i].Name) == 0)
+                address = ResolveFunction(FunctionFallbacks[i].FallbackName);
+        }
+
+        return address;
+    }
         
 
     
@@ -135,6 +202,8 @@ limitations under the License.
       , PlatformMajorVersion(0)
       , PlatformMinorVersion(0)
       , PlatformWholeVersion(0)
+      , ExtensionSupportInitialized(false)
+      , ResolvedFunctionCount(0)
     {
         // The following sequence is not thread-safe. Two threads could set the context to this at the same time.
         if(GetCurrentContext() == NULL)
@@ -155,8 +224,13 @@ limitations under the License.
         if(!IsInitialized())
         {
             InitVersion();
-            InitExtensionLoad();
-            InitExtensionSupport();
+
+            #if !defined(GLE_LAZY_LOAD_ENABLED)
+                InitExtensionLoad();
+                InitExtensionSupport();
+            #endif
+            // Else function pointers are resolved on their first call and the extension support
+            // booleans on their first query. See GLEContext::GetLazyFunction / GetExtensionContext.
         }
     }
     
@@ -661,6 +735,7 @@ limitations under the License.
 
         if(!glBindFramebuffer_Impl) // This will rarely if ever be the case in practice with modern computers and drivers.
         {
+            // Keep in sync with FunctionFallbacks, which lazy loading uses instead.
             // See if we can map GL_EXT_framebuffer_object to GL_ARB_framebuffer_object. The former is basically a subset of the latter, but we use only that subset.
             GLELoadProc(glBindFramebuffer_Impl, glBindFramebufferEXT);
             GLELoadProc(glBindRenderbuffer_Impl, glBindRenderbufferEXT);
@@ -763,14 +838,76 @@ limitations under the License.
     };
 
 
+    // Open-addressed hash set of the extensions we are interested in, so that each extension
+    // the driver reports costs one hash and (usually) no string compares, instead of a strcmp
+    // against every entry of the ValueStringPair array.
+    class ExtensionHashSet
+    {
+    public:
+        ExtensionHashSet(ValueStringPair* pValueStringPairArray, size_t arrayCount)
+          : Pairs(pValueStringPairArray)
+        {
+            memset(Index, 0, sizeof(Index));
+
+            assert(arrayCount < (kSize / 2)); // Keep the load factor low.
+
+            for(size_t i = 0; i < arrayCount; i++)
+            {
+                const char* name = Pairs[i].ExtensionName;
+                uint32_t h = Hash(name, name + strlen(name));
+                size_t slot = h & (kSize - 1);
+
+                while(Index[slot])
+                    slot = (slot + 1) & (kSize - 1);
+
+                Index[slot] = (uint16_t)(i + 1);
+                Hashes[slot] = h;
+            }
+        }
+
+        // Marks the entry matching [p, pEnd) as present, if there is one.
+        void Mark(const char* p, const char* pEnd)
+        {
+            const size_t length = (size_t)(pEnd - p);
+            const uint32_t h = Hash(p, pEnd);
+
+            for(size_t slot = h & (kSize - 1); Index[slot]; slot = (slot + 1) & (kSize - 1))
+            {
+                if(Hashes[slot] == h)
+                {
+                    ValueStringPair& vsp = Pairs[Index[slot] - 1];
+
+                    if((strncmp(vsp.ExtensionName, p, length) == 0) && (vsp.ExtensionName[length] == '\0')) // case-sensitive compare
+                        vsp.IsPresent = true;
+                }
+            }
+        }
+
+    protected:
+        enum { kSize = 256 };  // Power of two.
+
+        static uint32_t Hash(const char* p, const char* pEnd) // FNV-1a
+        {
+            uint32_t h = 2166136261u;
+            while(p != pEnd)
+                h = (h ^ (uint8_t)*p++) * 16777619u;
+            return h;
+        }
+
+        ValueStringPair* Pairs;
+        uint16_t         Index[kSize];  // 1-based index into Pairs, 0 for an empty slot.
+        uint32_t         Hashes[kSize];
+    };
+
+
     // Helper function for InitExtensionSupport.
     static void CheckExtensions(ValueStringPair* pValueStringPairArray, size_t arrayCount, const char* extensions)
     {
-        // We search the extesion list string for each of the individual extensions we are interested in. 
-        // We do this by walking over the string and comparing each entry in turn to our array of entries of interest.
+        // We walk over the extension list string once and look each entry up in a hash set of the
+        // extensions we are interested in.
         // Example string (with patholigical extra spaces): "   ext1 ext2   ext3  "
-           
-        char extension[64];
+        
+        ExtensionHashSet hashSet(pValueStringPairArray, arrayCount);
         const char* p = extensions; // p points to the beginning of the current word
         const char* pEnd;           // pEnd points to one-past the last character of the current word. It is where the trailing '\0' of the string would be.
            
@@ -784,19 +921,8 @@ limitations under the License.
             while((*pEnd != '\0') && (*pEnd != ' ')) // Find the next word end.
                 ++pEnd;
                
-            if(((pEnd - p) > 0) && ((size_t)(pEnd - p) < OVR_ARRAY_COUNT(extension)))
-            {
-                memcpy(extension, p, pEnd - p); // To consider: Revise this code to directly read from p/pEnd instead of doing a memcpy.
-                extension[pEnd - p] = '\0';
-                   
-                for(size_t i = 0; i < arrayCount; i++) // For each extension we are interested in...
-                {
-                    ValueStringPair& vsp = pValueStringPairArray[i];
- 
-                    if(strcmp(extension, vsp.ExtensionName) == 0) // case-sensitive compare
-                        pValueStringPairArray[i].IsPresent = true;
-                }
-            }
+            if(pEnd > p)
+                hashSet.Mark(p, pEnd);
                
             p = pEnd;
         }
@@ -869,10 +995,9 @@ limitations under the License.
             if(MajorVersion >= 3) // If glGetIntegerv(GL_NUM_EXTENSIONS, ...) is supported...
             {
                 // In this case we need to match an array of individual extensions against an array of
-                // externsions provided by glGetStringi. This is an O(n^2) operation, but at least we
-                // are doing this only once on startup. There are a few tricks we can employ to speed
-                // up the logic below, but they may not be worth much.
+                // externsions provided by glGetStringi. We do this with one hash lookup per extension.
                
+                ExtensionHashSet hashSet(vspArray, OVR_ARRAY_COUNT(vspArray));
                 GLint extensionCount = 0;
                 glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
                 GLenum err = glGetError();
@@ -890,13 +1015,7 @@ limitations under the License.
                             sExtensions += " ";
                             sExtensions += extension;
  
-                            for(size_t i = 0; i < OVR_ARRAY_COUNT(vspArray); i++) // For each extension we are interested in...
-                            {
-                                ValueStringPair& vsp = vspArray[i];
- 
-                                if(strcmp(extension, vsp.ExtensionName) == 0) // case-sensitive compare
-                                    vspArray[i].IsPresent = true;
-                            }
+                            hashSet.Mark(extension, extension + strlen(extension));
                         }
                         else
                             break;
@@ -924,6 +1043,8 @@ limitations under the License.
             }
         #endif
 
+        ExtensionSupportInitialized = true;
+
     } // GLEContext::InitExtensionSupport()
         
 
@@ -195,6 +195,29 @@ namespace OVR
         // Sets the default instance of this class. This should be called after enabling a new OpenGL context.
         // This sets the current GLEContext; it does not set the underlying OpenGL context itself.
         static void SetCurrentContext(GLEContext*);
+
+        // Returns the current instance, with the extension support booleans computed if they haven't 
+        // been yet. Used by GLEGetCurrentVariable when GLE_LAZY_LOAD_ENABLED is defined.
+        static GLEContext* GetExtensionContext();
+
+        // Looks up a function by name and counts it in ResolvedFunctionCount if found.
+        void* ResolveFunction(const char* name);
+
+        // Like ResolveFunction, but falls back to the equivalents InitExtensionLoad would use if the
+        // driver doesn't have the function (e.g. glBindFramebufferEXT for glBindFramebuffer).
+        void* ResolveLazyFunction(const char* name);
+
+        // Returns the given function pointer, resolving and storing it first if this is the first call.
+        // Used by GLEGetCurrentFunction when GLE_LAZY_LOAD_ENABLED is defined. Two threads racing on
+        // the first call both resolve the same address, so no locking is done.
+        template <typename Fn>
+        Fn GetLazyFunction(Fn GLEContext::* function, const char* name)
+        {
+            Fn& fn = this->*function;
+            if(!fn)
+                fn = (Fn)ResolveLazyFunction(name);
+            return fn;
+        }
         
     public:
         // OpenGL version information
@@ -209,6 +232,9 @@ namespace OVR
         int   PlatformMinorVersion;
         int   PlatformWholeVersion;
 
+        bool     ExtensionSupportInitialized;   // True once InitExtensionSupport has run.
+        unsigned ResolvedFunctionCount;         // Number of function pointers successfully looked up so far.
+
         void InitVersion();             // Initializes the version information (e.g. MajorVersion). Called by the public Init function.
         void InitExtensionLoad();       // Loads the function addresses into the function pointers.
         void InitExtensionSupport();    // Loads the boolean extension support booleans.
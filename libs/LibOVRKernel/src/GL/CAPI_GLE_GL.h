@@ -135,11 +135,24 @@ limitations under the License.
     #define GLE_HOOKING_ENABLED 1
 #endif
 
+// GLE_LAZY_LOAD_ENABLED
+// When enabled, GLEContext::Init doesn't load every function pointer and extension flag up front.
+// Each function pointer is resolved (and stored) the first time it's called, and the extension flags
+// are computed on the first query of any of them. Define it before including this header.
+// Not used with hooking, as the hook functions test the _Impl pointers directly, nor with CGL, as
+// InitExtensionLoad reroutes some ARB functions to their APPLE equivalents.
+#if defined(GLE_LAZY_LOAD_ENABLED) && (defined(GLE_HOOKING_ENABLED) || defined(GLE_CGL_ENABLED))
+    #undef GLE_LAZY_LOAD_ENABLED
+#endif
+
 // When using hooking, we map all OpenGL function usage to our member functions that end with _Hook. 
 // These member hook functions will internally call the actual OpenGL functions after doing some internal processing.
 #if defined(GLE_HOOKING_ENABLED)
     #define GLEGetCurrentFunction(x) OVR::GLEContext::GetCurrentContext()->x##_Hook
     #define GLEGetCurrentVariable(x) OVR::GLEContext::GetCurrentContext()->x
+#elif defined(GLE_LAZY_LOAD_ENABLED)
+    #define GLEGetCurrentFunction(x) OVR::GLEContext::GetCurrentContext()->GetLazyFunction(&OVR::GLEContext::x##_Impl, #x)
+    #define GLEGetCurrentVariable(x) OVR::GLEContext::GetExtensionContext()->x
 #else
     #define GLEGetCurrentFunction(x) OVR::GLEContext::GetCurrentContext()->x##_Impl
     #define GLEGetCurrentVariable(x) OVR::GLEContext::GetCurrentContext()->x
@@ -30,10 +30,12 @@ limitations under the License.
 #include "Util/Util_SystemInfo.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <math.h>
 #include <exception>
 #include <algorithm>
 #include <sstream>
 #include <memory>
+#include <thread>
 
 #if defined(_MSC_VER)
     #include <crtdbg.h>
@@ -47,6 +49,13 @@ limitations under the License.
     #include <execinfo.h>
 #endif
 
+#if defined(OVR_OS_LINUX)
+    #include <sys/syscall.h>
+    #include <malloc.h>
+#elif defined(OVR_OS_MAC)
+    #include <malloc/malloc.h>
+#endif
+
 
 
 //-----------------------------------------------------------------------------------
@@ -103,6 +112,19 @@ limitations under the License.
 #endif
 
 
+//-----------------------------------------------------------------------------------
+// ***** OVR_ALLOCATOR_POOL_HEAP_ENABLED
+//
+// Defined as 0 or 1.
+// If enabled then we use our PoolHeap instead of a regular heap by default.
+// However, even if this is disabled it can still be enabled at runtime by manually
+// setting the appropriate environment variable/registry key.
+//
+#ifndef OVR_ALLOCATOR_POOL_HEAP_ENABLED
+    #define OVR_ALLOCATOR_POOL_HEAP_ENABLED 0
+#endif
+
+
 //-----------------------------------------------------------------------------------
 // ***** OVR_ALLOCATOR_TRACKING_ENABLED
 //
@@ -345,6 +367,23 @@ static int HuntUntrackedAllocHook(int, void*, size_t, int, long, const unsigned
 #endif // OVR_HUNT_UNTRACKED_ALLOCS
 
 
+//-----------------------------------------------------------------------------------
+// ***** OVR_ALLOCATION_BUDGET_CRT_HOOK
+//
+// Defined as 0 or 1.
+// If enabled then AllocationBudgetScope also counts allocations made directly through the
+// CRT (malloc, operator new, etc.), by way of a debug CRT allocation hook. The release CRT
+// has no such hook, so release builds only see allocations that go through the Allocator.
+//
+#ifndef OVR_ALLOCATION_BUDGET_CRT_HOOK
+    #if defined(_MSC_VER) && OVR_DEBUG_CRT_PRESENT
+        #define OVR_ALLOCATION_BUDGET_CRT_HOOK 1
+    #else
+        #define OVR_ALLOCATION_BUDGET_CRT_HOOK 0
+    #endif
+#endif
+
+
 
 //-----------------------------------------------------------------------------------
 // ***** OVR_BENCHMARK_ALLOCATOR
@@ -970,2183 +1009,5277 @@ AllocatorAutoCreate allocatorAutoCreate;
 
 
 //-----------------------------------------------------------------------------------
-// ***** Allocator
+// ***** StackTraceTable
 //
 
-Allocator* Allocator::DefaultAllocator    = nullptr;
-uint64_t   Allocator::ReferenceHeapTimeNs = 0;  // Don't set this to GetCurrentHeapTimeNs() because we may need to initialize it earlier than that construction occurs.
+StackTraceTable::StackTraceTable()
+  : Slots(nullptr)
+  , SlotCapacity(0)
+  , MaxCount(0)
+  , Frames(nullptr)
+  , FrameCapacity(0)
+  , FrameUsed(0)
+  , Count(0)
+{
+}
 
-Allocator* Allocator::GetInstance(bool create)
+
+StackTraceTable::~StackTraceTable()
 {
-    if(!DefaultAllocator && create)
+    Shutdown();
+}
+
+
+bool StackTraceTable::Init(size_t slotCapacity, size_t frameCapacity)
+{
+    if (Slots.load(std::memory_order_acquire))
+        return true;
+
+    size_t capacity = 64;
+    while (capacity < slotCapacity)
+        capacity *= 2;
+
+    // SafeMMapAlloc memory is 0-filled, which is the unused state of every Slot.
+    Slot*  slots  = static_cast<Slot*>(SafeMMapAlloc(capacity * sizeof(Slot)));
+    void** frames = static_cast<void**>(SafeMMapAlloc(frameCapacity * sizeof(void*)));
+
+    if (!slots || !frames)
     {
-        // This is not thread-safe. Two calls could race to this point.
-        #if defined(_WIN32)
-            // Cannot allocate memory while doing the following.
-            wchar_t moduleNameW[MAX_PATH];
-            char    defaultAllocatorName[MAX_PATH * 6] = {}; // Maximum possible requirement for a UTF16 to UTF8 conversion.
-            DWORD   nameStrlen = GetModuleFileNameW(nullptr, moduleNameW, MAX_PATH);
-            WideCharToMultiByte(CP_UTF8, 0, moduleNameW, nameStrlen + 1, defaultAllocatorName, sizeof(defaultAllocatorName), nullptr, nullptr); // +1 because WideCharToMultiByte will only 0-terminate if you include the 0 as part of the input.
-            defaultAllocatorName[sizeof(defaultAllocatorName)-1] = '\0';
-            std::transform(defaultAllocatorName, defaultAllocatorName + strlen(defaultAllocatorName), defaultAllocatorName, [](char c) { return ((c == '/') ? '\\' : c); }); // Convert any / to \.
-            const char* lastSeparator = strrchr(defaultAllocatorName, '\\');
-            if (lastSeparator)
-                memmove(defaultAllocatorName, lastSeparator + 1, strlen(lastSeparator + 1) + 1);
-            OVR_strlcat(defaultAllocatorName, " Default Allocator", sizeof(defaultAllocatorName));
-        #else
-            const char* defaultAllocatorName = "Default Allocator";
-        #endif
-        DefaultAllocator = new(SysMemAlloc(sizeof(Allocator))) Allocator(defaultAllocatorName);
-        DefaultAllocator->Init();
+        if (slots)
+            SafeMMapFree(slots, capacity * sizeof(Slot));
+        if (frames)
+            SafeMMapFree(frames, frameCapacity * sizeof(void*));
+        return false;
     }
 
-    return DefaultAllocator;
-}
+    SlotCapacity  = capacity;
+    MaxCount      = (capacity / 4) * 3;
+    Frames        = frames;
+    FrameCapacity = frameCapacity;
+    FrameUsed     = 0;
+    Count         = 0;
 
+    // Intern and GetFrames may already be running on other threads (tracking can be enabled
+    // after Init), so Slots is stored last and with release ordering.
+    Slots.store(slots, std::memory_order_release);
+
+    return true;
+}
 
 
-void Allocator::DestroyInstance()
+void StackTraceTable::Shutdown()
 {
-    if (DefaultAllocator)
+    Slot* slots = Slots.load(std::memory_order_acquire);
+
+    if (slots)
     {
-        // This is not thread-safe. Two calls could race to this line.
-        DefaultAllocator->Shutdown();
-        DefaultAllocator->~Allocator();
-        SysMemFree(DefaultAllocator, sizeof(Allocator));
-        DefaultAllocator = nullptr;
+        Slots.store(nullptr, std::memory_order_release);
+        SafeMMapFree(slots, SlotCapacity * sizeof(Slot));
+        SafeMMapFree(Frames, FrameCapacity * sizeof(void*));
+        SlotCapacity  = 0;
+        MaxCount      = 0;
+        Frames        = nullptr;
+        FrameCapacity = 0;
+        FrameUsed     = 0;
+        Count         = 0;
     }
 }
 
 
-Allocator::Allocator(const char* allocatorName)
-   : AllocatorName{}
-   , Heap(nullptr)
-   , DebugPageHeapEnabled(false)
-   , OSHeapEnabled(false)
-   , MallocRedirectEnabled(false)
-   , MallocRedirect(nullptr)
-   , TrackingEnabled(false)
-   , TraceAllocationsOnShutdown(false)
-   , TrackLock()
-   , TrackIterator()
-   , AllocationMap()
-   , DelayedFreeList()
-   , DelayedAlignedFreeList()
-   , CurrentCounter()
-   , SymbolLookupEnabled(false)
-   , TagMap()
-   , TagMapLock()
+uint32_t StackTraceTable::Intern(void* const* frames, size_t frameCount)
 {
-    SetAllocatorName(allocatorName);
+    Slot* const slots = Slots.load(std::memory_order_acquire);
 
-    if (ReferenceHeapTimeNs == 0)   // There is a thread race condition for the case that on startup two threads somehow execute this line at the same time.
-        ReferenceHeapTimeNs = GetCurrentHeapTimeNs();
+    if (!slots || (frameCount == 0))
+        return 0;
+
+    // FNV-1a over the frame addresses. 0 is reserved for unused slots.
+    uint64_t hash = UINT64_C(14695981039346656037);
+    for (size_t i = 0; i < frameCount; ++i)
+    {
+        hash ^= (uint64_t)(uintptr_t)frames[i];
+        hash *= UINT64_C(1099511628211);
+    }
+    hash ^= frameCount;
+    if (hash == 0)
+        hash = 1;
+
+    const size_t mask = (SlotCapacity - 1);
+    size_t offset = FrameCapacity; // Frames reserved for a new slot, once we know we need one.
+
+    for (size_t probe = 0, i = (size_t)hash & mask; probe < SlotCapacity; ++probe, i = ((i + 1) & mask))
+    {
+        Slot& slot = slots[i];
+        uint64_t slotHash = slot.Hash.load(std::memory_order_acquire);
+
+        if (slotHash == 0)
+        {
+            // This stack isn't in the table. Reserve its frames before claiming the slot, so
+            // that a full table or frame store gives 0 without using up a slot. If another
+            // thread takes the slot first with the same stack, the reservation is wasted.
+            if (offset == FrameCapacity)
+            {
+                if (Count.load(std::memory_order_relaxed) >= MaxCount)
+                    return 0;
+
+                offset = FrameUsed.load(std::memory_order_relaxed);
+                do
+                {
+                    if ((frameCount > FrameCapacity) || (offset > (FrameCapacity - frameCount)))
+                        return 0;
+                } while (!FrameUsed.compare_exchange_weak(offset, offset + frameCount, std::memory_order_relaxed));
+            }
+
+            if (slot.Hash.compare_exchange_strong(slotHash, hash, std::memory_order_acq_rel))
+            {
+                // We own this slot. Copy the frames, then publish them via FrameCount.
+                memcpy(Frames + offset, frames, frameCount * sizeof(void*));
+                slot.FrameOffset = (uint32_t)offset;
+                slot.FrameCount.store((uint32_t)frameCount + 1, std::memory_order_release);
+                ++Count;
+
+                return (uint32_t)(i + 1);
+            }
+            // Else another thread just took this slot. slotHash now has its hash; fall through and compare.
+        }
+
+        if (slotHash == hash)
+        {
+            uint32_t storedCount;
+            while ((storedCount = slot.FrameCount.load(std::memory_order_acquire)) == 0) // Wait for the other thread to finish writing it.
+                std::this_thread::yield();
+
+            if (((storedCount - 1) == frameCount) && (memcmp(Frames + slot.FrameOffset, frames, frameCount * sizeof(void*)) == 0))
+                return (uint32_t)(i + 1);
+        }
+    }
+
+    return 0; // The table is full.
 }
 
 
-void Allocator::SetAllocatorName(const char* allocatorName)
+size_t StackTraceTable::GetFrames(uint32_t stackId, void* const*& frames) const
 {
-    if (allocatorName)
-        OVR::OVR_strlcpy(AllocatorName, allocatorName, OVR_ARRAY_COUNT(AllocatorName));
+    frames = nullptr;
+
+    const Slot* const slots = Slots.load(std::memory_order_acquire);
+
+    if (!slots || (stackId == 0) || (stackId > SlotCapacity))
+        return 0;
+
+    const Slot& slot = slots[stackId - 1];
+    uint32_t storedCount = slot.FrameCount.load(std::memory_order_acquire);
+
+    if (storedCount <= 1)
+        return 0;
+
+    frames = Frames + slot.FrameOffset;
+    return (storedCount - 1);
 }
 
 
-const char* Allocator::GetAllocatorName() const
+//-----------------------------------------------------------------------------------
+// ***** TrackedAllocTable
+//
+
+TrackedAllocTable::TrackedAllocTable()
+  : Shards()
 {
-    return AllocatorName;
 }
 
 
-Allocator::~Allocator()
+TrackedAllocTable::~TrackedAllocTable()
 {
-    Allocator::Shutdown();
+    Clear();
 }
 
 
-bool Allocator::Init()
+size_t TrackedAllocTable::FindSlot(const Shard& shard, const void* p, uint64_t hash)
 {
-    if (!Heap) // If not already initialized...
+    if (shard.Capacity)
     {
-        // Potentially redirect the CRT malloc family of functions.
-        if (!MallocRedirectEnabled) // If not programmatically enabled before this init call...
-        {
-            #if OVR_REDIRECT_CRT_MALLOC
-                MallocRedirectEnabled = true;
-            #else
-                MallocRedirectEnabled = OVR::Util::GetRegistryBoolW(L"Software\\Oculus", L"MallocRedirectEnabled", false); // "HKEY_LOCAL_MACHINE\SOFTWARE\Oculus\MallocRedirectEnabled", REG_DWORD of 0 or 1.
-            #endif
+        const size_t mask = (shard.Capacity - 1);
 
-            if (Allocator::GetInstance(false) != this) // Only redirect malloc if we are the default heap.
-                MallocRedirectEnabled = false;
+        for (size_t i = GetHomeSlot(hash, shard.Capacity); shard.Entries[i].Alloc; i = ((i + 1) & mask))
+        {
+            if (shard.Entries[i].Alloc == p)
+                return i;
         }
+    }
 
-        if (MallocRedirectEnabled)
-        {
-            // We will need to enable tracking so that we can distinguish between our pointers and pointers allocated via malloc before we did this redirect.
-            TrackingEnabled = true;
+    return shard.Capacity;
+}
 
-            // Make a struct of our override function pointers.
-            OVR::InterceptCRTMalloc::MallocFunctionPointers mfp;
 
-            mfp.malloc_ptr = ovr_malloc;
-            mfp.calloc_ptr = ovr_calloc;
-            mfp.realloc_ptr = ovr_realloc;
-            mfp.recalloc_ptr = ovr_recalloc;
-            mfp.msize_ptr = ovr_msize;
-            mfp.free_ptr = ovr_free;
-            mfp.aligned_malloc_ptr = ovr_aligned_malloc;
-            mfp.aligned_offset_malloc_ptr = ovr_aligned_offset_malloc;
-            mfp.aligned_realloc_ptr = ovr_aligned_realloc;
-            mfp.aligned_offset_realloc_ptr = ovr_aligned_offset_realloc;
-            mfp.aligned_recalloc_ptr = ovr_aligned_recalloc;
-            mfp.aligned_offset_recalloc_ptr = ovr_aligned_offset_recalloc;
-            mfp.aligned_msize_ptr = ovr_aligned_msize;
-            mfp.aligned_free_ptr = ovr_aligned_free;
+void TrackedAllocTable::RemoveSlot(Shard& shard, size_t slot)
+{
+    // Backward-shift deletion: move later members of the probe run back into the hole,
+    // so lookups never need tombstones.
+    const size_t mask = (shard.Capacity - 1);
 
-            #ifdef OVR_DEBUG_CRT_PRESENT
-                mfp.malloc_dbg_ptr = ovr_malloc_dbg;
-                mfp.calloc_dbg_ptr = ovr_calloc_dbg;
-                mfp.realloc_dbg_ptr = ovr_realloc_dbg;
-                mfp.recalloc_dbg_ptr = ovr_recalloc_dbg;
-                mfp.msize_dbg_ptr = ovr_msize_dbg;
-                mfp.free_dbg_ptr = ovr_free_dbg;
-                mfp.aligned_malloc_dbg_ptr = ovr_aligned_malloc_dbg;
-                mfp.aligned_offset_malloc_dbg_ptr = ovr_aligned_offset_malloc_dbg;
-                mfp.aligned_realloc_dbg_ptr = ovr_aligned_realloc_dbg;
-                mfp.aligned_offset_realloc_dbg_ptr = ovr_aligned_offset_realloc_dbg;
-                mfp.aligned_recalloc_dbg_ptr = ovr_aligned_recalloc_dbg;
-                mfp.aligned_offset_recalloc_dbg_ptr = ovr_aligned_offset_recalloc_dbg;
-                mfp.aligned_msize_dbg_ptr = ovr_aligned_msize_dbg;
-                mfp.aligned_free_dbg_ptr = ovr_aligned_free_dbg;
-            #endif
+    for (size_t j = ((slot + 1) & mask); shard.Entries[j].Alloc; j = ((j + 1) & mask))
+    {
+        size_t home = GetHomeSlot(HashPointer(shard.Entries[j].Alloc), shard.Capacity);
 
-            MallocRedirect = new (SysMemAlloc(sizeof(OVR::InterceptCRTMalloc))) OVR::InterceptCRTMalloc;
-            MallocRedirect->ReplaceCRTMalloc(mfp);
+        // The entry at j can move to the hole only if its home slot is not cyclically within (slot, j].
+        bool homeInRange = (slot <= j) ? ((slot < home) && (home <= j)) : ((slot < home) || (home <= j));
+
+        if (!homeInRange)
+        {
+            shard.Entries[slot] = shard.Entries[j];
+            slot = j;
         }
+    }
 
+    shard.Entries[slot].Alloc = nullptr;
+    shard.Size--;
+}
 
-        // Potentially enable the debug page heap.
-        if (!DebugPageHeapEnabled) // If not programmatically enabled before this init call...
-        {
-            // The debug page heap is restricted to 64 bit platforms due to the potential for address space exhaustion on 32-bit platforms.
-            #if defined(OVR_CPU_X86_64)
-                #if OVR_ALLOCATOR_DEBUG_PAGE_HEAP_ENABLED // If we should try to enable the debug heap...
-                    DebugPageHeapEnabled = true;
-                #else
-                    DebugPageHeapEnabled = OVR::Util::GetRegistryBoolW(L"Software\\Oculus", L"DebugPageHeapEnabled", DebugPageHeapEnabled); // "HKEY_LOCAL_MACHINE\SOFTWARE\Oculus\DebugPageHeapEnabled", REG_DWORD of 0 or 1.
-                #endif
 
-                #if defined(OVR_BUILD_DEBUG) && defined(_MSC_VER)
-                    if (DebugPageHeapEnabled)
-                    {
-                        // Make _CrtIsValidHeapPointer always return true. The VC++ concurrency library has a bug in that
-                        // it's calling _CrtIsValidHeapPointer, which is invalid and recommended against by Microsoft themselves.
-                        // We need to deal with this nevertheless. The problem is that the VC++ concurrency library is
-                        // calling _CrtIsValidHeapPointer on the default heap instead of the current heap (DebugPageHeap).
-                        // So we modify the _CrtIsValidHeapPointer implementation to always return true. The primary risk
-                        // with this change is that there's some code somewhere that uses it for a non-diagnostic purpose.
-                        // However this os Oculus-debug-internal and so has no effect on any formally published software.
-                        DebugPageHeapEnabled = OVR::KillCdeclFunction(_CrtIsValidHeapPointer, true); // If we can successfully kill _CrtIsValidHeapPointer, enable our debug heap.
-                    }
-                #endif
-            #endif
-        }
+bool TrackedAllocTable::Grow(Shard& shard)
+{
+    size_t newCapacity = (shard.Capacity ? (shard.Capacity * 2) : 256);
+    TrackedAllocEntry* newEntries = static_cast<TrackedAllocEntry*>(SysMemAlloc(newCapacity * sizeof(TrackedAllocEntry)));
 
-        if (DebugPageHeapEnabled)
-        {
-            // We will need to enable tracking so that we can distinguish between our pointers and pointers allocated via malloc before we did this redirect.
-            TrackingEnabled = true;
+    if (!newEntries)
+        return false;
 
-            Heap = new(SysMemAlloc(sizeof(DebugPageHeap))) DebugPageHeap;
-            Heap->Init();
-        }
-        else if(MallocRedirectEnabled)
-        {
-            // We will need to enable tracking so that we can distinguish between our pointers and pointers allocated via malloc before we did this redirect.
-            TrackingEnabled = true;
-            OSHeapEnabled = true;
+    memset(newEntries, 0, newCapacity * sizeof(TrackedAllocEntry));
 
-            // If we are redirecting CRT malloc then we can't use the default heap, because it used CRT malloc, which would we be circular.
-            Heap = new(SysMemAlloc(sizeof(OSHeap))) OSHeap;
-            Heap->Init();
-        }
-        else // Else default heap (which uses malloc).
+    for (size_t i = 0; i < shard.Capacity; ++i)
+    {
+        if (shard.Entries[i].Alloc)
         {
-            Heap = new(SysMemAlloc(sizeof(DefaultHeap))) DefaultHeap;
-            Heap->Init();
+            size_t j = GetHomeSlot(HashPointer(shard.Entries[i].Alloc), newCapacity);
+            while (newEntries[j].Alloc)
+                j = ((j + 1) & (newCapacity - 1));
+            newEntries[j] = shard.Entries[i];
         }
+    }
 
+    if (shard.Entries)
+        SysMemFree(shard.Entries, shard.Capacity * sizeof(TrackedAllocEntry));
 
-        // Potentially enable allocation tracking.
-        if (!TrackingEnabled) // If not programmatically enabled before this init call...
+    shard.Entries  = newEntries;
+    shard.Capacity = newCapacity;
+
+    return true;
+}
+
+
+bool TrackedAllocTable::Insert(const TrackedAllocEntry& entry)
+{
+    const uint64_t hash = HashPointer(entry.Alloc);
+    Shard& shard = GetShard(hash);
+    Lock::Locker locker(&shard.ShardLock);
+
+    size_t slot = FindSlot(shard, entry.Alloc, hash);
+
+    if (slot == shard.Capacity) // If not already present...
+    {
+        // Keep the load factor at or below 3/4 so that probe runs stay short.
+        if (((shard.Size + 1) * 4) > (shard.Capacity * 3))
         {
-            #if OVR_ALLOCATOR_TRACKING_ENABLED
-                TrackingEnabled = true;
-            #else
-                TrackingEnabled = IsHeapTrackingRegKeyEnabled(TrackingEnabled);
-            #endif
+            if (!Grow(shard) && ((shard.Size + 1) >= shard.Capacity))
+                return false;
         }
 
+        const size_t mask = (shard.Capacity - 1);
+        for (slot = GetHomeSlot(hash, shard.Capacity); shard.Entries[slot].Alloc; slot = ((slot + 1) & mask))
+            { }
 
-        // Initialize the symbol and backtrace utility library
-        SymbolLookupEnabled = SymbolLookup::Initialize();
+        shard.Size++;
     }
 
+    shard.Entries[slot] = entry;
+
     return true;
 }
 
 
-void Allocator::Shutdown()
+bool TrackedAllocTable::Remove(const void* p, TrackedAllocEntry* removed)
 {
-    if (Heap) // If we were initialized...
-    {
-        if (TraceAllocationsOnShutdown)
-            TraceTrackedAllocations(nullptr, 0);
+    const uint64_t hash = HashPointer(p);
+    Shard& shard = GetShard(hash);
+    Lock::Locker locker(&shard.ShardLock);
 
-        if (SymbolLookupEnabled)
-            SymbolLookup::Shutdown();
+    size_t slot = FindSlot(shard, p, hash);
 
-        if (MallocRedirectEnabled)
-        {
-            MallocRedirect->RestoreCRTMalloc();
-            MallocRedirect->~InterceptCRTMalloc();
-            SysMemFree(MallocRedirect, sizeof(OVR::InterceptCRTMalloc));
-            MallocRedirect = nullptr;
-        }
+    if (slot == shard.Capacity)
+        return false;
 
-        for(auto p: DelayedAlignedFreeList)
-            _aligned_free(p);
-        DelayedAlignedFreeList.clear();
+    if (removed)
+        *removed = shard.Entries[slot];
+    RemoveSlot(shard, slot);
+    return true;
+}
 
-        for(auto p: DelayedFreeList)
-            free(p);
-        DelayedFreeList.clear();
 
-        AllocationMap.clear();
-        TagMap.clear();
-        CurrentCounter = 0;
+bool TrackedAllocTable::Find(const void* p, TrackedAllocEntry* entry)
+{
+    const uint64_t hash = HashPointer(p);
+    Shard& shard = GetShard(hash);
+    Lock::Locker locker(&shard.ShardLock);
+
+    size_t slot = FindSlot(shard, p, hash);
+
+    if (slot == shard.Capacity)
+        return false;
+
+    if (entry)
+        *entry = shard.Entries[slot];
+    return true;
+}
+
+
+void TrackedAllocTable::RemoveRange(const void* begin, const void* end)
+{
+    for (size_t s = 0; s < ShardCount; ++s)
+    {
+        Shard& shard = Shards[s];
+        Lock::Locker locker(&shard.ShardLock);
 
-        // Free the heap.
-        if (Heap)
+        for (size_t i = 0; i < shard.Capacity; )
         {
-            Heap->Shutdown();
-            Heap->~Heap();
-            if (DebugPageHeapEnabled)
-                SysMemFree(Heap, sizeof(DebugPageHeap));
+            const void* p = shard.Entries[i].Alloc;
+
+            if (p && (p >= begin) && (p < end))
+                RemoveSlot(shard, i); // This may shift another entry into slot i, so look at i again.
             else
-                SysMemFree(Heap, sizeof(DefaultHeap));
+                ++i;
         }
-        Heap = nullptr;
     }
 }
 
 
-void* Allocator::Alloc(size_t size, const char* tag)
+void TrackedAllocTable::Clear()
 {
-    return AllocDebug(size, tag, nullptr, 0);
+    for (size_t s = 0; s < ShardCount; ++s)
+    {
+        Shard& shard = Shards[s];
+        Lock::Locker locker(&shard.ShardLock);
+
+        if (shard.Entries)
+            SysMemFree(shard.Entries, shard.Capacity * sizeof(TrackedAllocEntry));
+
+        shard.Entries  = nullptr;
+        shard.Capacity = 0;
+        shard.Size     = 0;
+    }
 }
 
 
-void* Allocator::Calloc(size_t count, size_t size, const char* tag)
+size_t TrackedAllocTable::GetCount() const
 {
-    return CallocDebug(count, size, tag, nullptr, 0);
+    size_t count = 0;
+
+    for (size_t s = 0; s < ShardCount; ++s)
+        count += Shards[s].Size;
+
+    return count;
 }
 
 
-void* Allocator::AllocAligned(size_t size, size_t align, const char* tag)
+void TrackedAllocTable::LockAll()
 {
-    return AllocAlignedDebug(size, align, tag, nullptr, 0);
+    for (size_t s = 0; s < ShardCount; ++s)
+        Shards[s].ShardLock.DoLock();
 }
 
 
-void* Allocator::AllocDebug(size_t size, const char* tag, const char* file, unsigned line)
+void TrackedAllocTable::UnlockAll()
 {
-    OVR_ALLOC_BENCHMARK_START();
+    for (size_t s = ShardCount; s > 0; --s)
+        Shards[s - 1].ShardLock.Unlock();
+}
 
-    void* p = Heap->Alloc(size);
 
-    if (p)
+const TrackedAllocEntry* TrackedAllocTable::GetNext(size_t& shardIndex, size_t& slotIndex) const
+{
+    for (; shardIndex < ShardCount; ++shardIndex, slotIndex = 0)
     {
-        TrackAlloc(p, size, tag, file, line);
-    }
+        const Shard& shard = Shards[shardIndex];
 
-    OVR_ALLOC_BENCHMARK_END();
+        while (slotIndex < shard.Capacity)
+        {
+            const TrackedAllocEntry& entry = shard.Entries[slotIndex++];
 
-    return p;
+            if (entry.Alloc)
+                return &entry;
+        }
+    }
+
+    return nullptr;
 }
 
 
-void* Allocator::CallocDebug(size_t count, size_t size, const char* tag, const char* file, unsigned line)
+void TrackedAllocTable::Snapshot(TrackedAllocEntryVector& entries)
 {
-    void* p = AllocDebug(count * size,  tag, file, line);
-
-    if (p)
+    for (size_t s = 0; s < ShardCount; ++s)
     {
-        memset(p, 0, count * size);
+        Shard& shard = Shards[s];
+
+        // Grow the vector before taking the lock so the lock is held only for the copy. 
+        // The unlocked read of Size is just a hint; push_back still grows it if needed.
+        const size_t expected = shard.Size;
+        if (entries.capacity() < (entries.size() + expected))
+            entries.reserve(entries.size() + expected + (expected / 8) + 16);
+
+        Lock::Locker locker(&shard.ShardLock);
+
+        for (size_t i = 0; i < shard.Capacity; ++i)
+        {
+            if (shard.Entries[i].Alloc)
+                entries.push_back(shard.Entries[i]);
+        }
     }
+}
 
-    return p;
+
+//-----------------------------------------------------------------------------------
+// ***** AllocationProfiler
+//
+
+// The calling thread's bytes left until its next sample, and the state of the random 
+// generator that picks the sample intervals. A random state of 0 means the thread hasn't
+// sampled yet.
+static OVR_THREAD_LOCAL int64_t  ProfilerBytesUntilSample;
+static OVR_THREAD_LOCAL uint64_t ProfilerRandom;
+
+AllocationProfiler::AllocationProfiler()
+  : Initialized(false)
+  , Enabled(false)
+  , SampleInterval(0)
+  , Stacks()
+  , StackStats(nullptr)
+  , StackStatsCount(0)
+  , Tags(nullptr)
+  , Samples()
+  , SampledFilter(nullptr)
+  , TimeSeriesTimes(nullptr)
+  , TimeSeriesValues(nullptr)
+  , TimeSeriesNext(0)
+  , TimeSeriesCount(0)
+  , TimeSeriesLock()
+{
 }
 
 
-void* Allocator::AllocAlignedDebug(size_t size, size_t align, const char* tag, const char* file, unsigned line)
+AllocationProfiler::~AllocationProfiler()
 {
-    OVR_ALLOC_BENCHMARK_START();
+    Shutdown();
+}
 
-    void* p = Heap->AllocAligned(size, align);
 
-    if (p)
+bool AllocationProfiler::Init(uint64_t sampleIntervalBytes)
+{
+    SampleInterval = OVR::Alg::Max<uint64_t>(sampleIntervalBytes, 1);
+
+    if (!IsInitialized())
     {
-        TrackAlloc(p, size, tag, file, line);
+        // All of this memory is 0-filled, which is the initial state of the counters.
+        if (!Stacks.Init(16384, 262144))
+            return false;
+
+        StackStatsCount  = Stacks.GetCapacity() + 1;
+        StackStats       = static_cast<Counters*>(SafeMMapAlloc(StackStatsCount * sizeof(Counters)));
+        Tags             = static_cast<TagSlot*>(SafeMMapAlloc((TagCapacity + 1) * sizeof(TagSlot)));
+        SampledFilter    = static_cast<std::atomic<uint32_t>*>(SafeMMapAlloc(SampledFilterSize * sizeof(std::atomic<uint32_t>)));
+        TimeSeriesTimes  = static_cast<uint64_t*>(SafeMMapAlloc(TimeSeriesCapacity * sizeof(uint64_t)));
+        TimeSeriesValues = static_cast<int64_t*>(SafeMMapAlloc(TimeSeriesCapacity * (TagCapacity + 1) * sizeof(int64_t)));
+
+        if (!StackStats || !Tags || !SampledFilter || !TimeSeriesTimes || !TimeSeriesValues)
+        {
+            Shutdown();
+            return false;
+        }
+
+        Tags[TagCapacity].Tag = "(other)";
+        Initialized.store(true, std::memory_order_release);
     }
 
-    OVR_ALLOC_BENCHMARK_END();
+    SetEnabled(true);
+    return true;
+}
 
-    return p;
+
+void AllocationProfiler::Shutdown()
+{
+    Enabled = false;
+    Initialized = false;
+
+    Samples.Clear();
+    Stacks.Shutdown();
+
+    if (StackStats)
+        SafeMMapFree(StackStats, StackStatsCount * sizeof(Counters));
+    if (Tags)
+        SafeMMapFree(Tags, (TagCapacity + 1) * sizeof(TagSlot));
+    if (SampledFilter)
+        SafeMMapFree(SampledFilter, SampledFilterSize * sizeof(std::atomic<uint32_t>));
+    if (TimeSeriesTimes)
+        SafeMMapFree(TimeSeriesTimes, TimeSeriesCapacity * sizeof(uint64_t));
+    if (TimeSeriesValues)
+        SafeMMapFree(TimeSeriesValues, TimeSeriesCapacity * (TagCapacity + 1) * sizeof(int64_t));
+
+    StackStats       = nullptr;
+    StackStatsCount  = 0;
+    Tags             = nullptr;
+    SampledFilter    = nullptr;
+    TimeSeriesTimes  = nullptr;
+    TimeSeriesValues = nullptr;
+    TimeSeriesNext   = 0;
+    TimeSeriesCount  = 0;
 }
 
 
-size_t Allocator::GetAllocSize(const void* p) const
+uint64_t AllocationProfiler::NextSampleInterval()
 {
-    return Heap->GetAllocSize(p);
+    // xorshift64*, seeded per thread from the address of a thread-local.
+    uint64_t r = (ProfilerRandom ? ProfilerRandom : ((uint64_t)(uintptr_t)&ProfilerRandom | 1));
+    r ^= (r >> 12);
+    r ^= (r << 25);
+    r ^= (r >> 27);
+    ProfilerRandom = r;
+
+    // Exponentially distributed with a mean of SampleInterval: -ln(u) * SampleInterval, for u in (0, 1].
+    double u = (double)(((r * UINT64_C(2685821657736338717)) >> 11) + 1) * (1.0 / 9007199254740992.0);
+    double interval = -log(u) * (double)SampleInterval;
+
+    return (uint64_t)OVR::Alg::Clamp<double>(interval, 1.0, 1e15);
 }
 
 
-size_t Allocator::GetAllocAlignedSize(const void* p, size_t align) const
+bool AllocationProfiler::ShouldSample(size_t size)
 {
-    return Heap->GetAllocAlignedSize(p, align);
+    ProfilerBytesUntilSample -= (int64_t)size;
+
+    if (ProfilerBytesUntilSample > 0)
+        return false;
+
+    // A thread's countdown starts at 0 rather than at a random interval, so its first expiry isn't a sample.
+    const bool firstUse = (ProfilerRandom == 0);
+    ProfilerBytesUntilSample = (int64_t)NextSampleInterval();
+
+    return !firstUse;
 }
 
 
-void Allocator::Free(void* p)
+size_t AllocationProfiler::GetTagSlot(const char* tag)
 {
-    OVR_ALLOC_BENCHMARK_START();
+    if (!tag)
+        tag = OVR_ALLOCATOR_UNSPECIFIED_TAG;
 
-    if (p)
+    // Tags are matched by content, as the same tag can come from string literals in different modules.
+    uint32_t hash = 2166136261u;
+    for (const char* c = tag; *c; ++c)
+        hash = ((hash ^ (uint8_t)*c) * 16777619u);
+
+    for (size_t probe = 0, i = (hash & (TagCapacity - 1)); probe < TagCapacity; ++probe, i = ((i + 1) & (TagCapacity - 1)))
     {
-        if(UntrackAlloc(p)) // If this pointer is recognized as belonging to us...
+        const char* slotTag = Tags[i].Tag.load(std::memory_order_acquire);
+
+        if (!slotTag)
         {
-            Heap->Free(p);
+            if (Tags[i].Tag.compare_exchange_strong(slotTag, tag, std::memory_order_acq_rel))
+                return i;
+            // Else another thread just took this slot. slotTag now has its tag.
         }
-        else
-        {
-            // We don't recognize the pointer being freed. That almost always means one of two things:
-            //     - We are overriding malloc/free and somebody is freeing memory that they allocated before we 
-            //       started overriding malloc and free. 
-            //     - We are not overriding malloc/free and somebody is freeing memory via operater delete
-            //       which they allocated with malloc(). That's disallowed C++ but in fact it happens.
-            // We have a number of options for dealing with this and try to choose the best option:
-            //     - Call CRT free function.
-            //       Can't do this if we are overriding CRT free and have lost access to the original CRT free function.
-            //     - Call the CRT underlying _free_base function.
-            //       Can't do this if the debug CRT is active, because p is not the actual pointer to free.
-            //     - Call the OS underlying HeapFree function.
-            //       Can't do this if the debug CRT is active, because this method results in the debug heap structures being corrupt.
-            //     - Put the pointer in a list which we free later, in the case that we are overriding CRT free and have lost access to the original CRT free function.
-            //       This works fairly well.
-            //     - Do nothing and let the memory leak in the underlying heap.
-            //       This works fairly well but results in there looking like there was a CRT memory leak.
 
-            if (MallocRedirect)
-            {
-                #if OVR_DEBUG_CRT_PRESENT || (_MSC_VER < 1900) // VS2013 doesn't expose _free_base, so use this delayed approach with VS2013.
-                    // In this case we can't just call the internal CRT _free_base function becase the debug heap is active and 
-                    // we would need to call a dbg function. The best way for us to do that would be to implement our own function
-                    // which works the same as _free_dbg(). However, for now we just add this pointer to the delayed free list and 
-                    // simply free it the normal way later when we shutdown.
-                    DelayedFreeList.push_back(p); // We will call free on the pointer later when we've restored the MallocRedirect.
-                #else
-                    // In this case we can just call the internal CRT _free_base function that underlies all CRT malloc functions.
-                    _free_base(p);
-                #endif
-            }
-            else
-            {
-                free(p);
-            }
-        }
+        if ((slotTag == tag) || (strcmp(slotTag, tag) == 0))
+            return i;
     }
 
-    OVR_ALLOC_BENCHMARK_END();
+    return TagCapacity;
 }
 
 
-void Allocator::FreeAligned(void* p)
+void AllocationProfiler::RecordSample(const void* p, size_t size, const char* tag)
 {
-    OVR_ALLOC_BENCHMARK_START();
+    // An allocation of size bytes contains at least one sample point with probability 1 - e^(-size/interval),
+    // so dividing by that makes the expected weight equal to size.
+    const double   ratio  = (double)size / (double)SampleInterval;
+    const uint64_t weight = (uint64_t)((ratio > 0) ? ((double)size / -expm1(-ratio)) : (double)SampleInterval);
+
+    void*  frames[MaxFrames];
+    size_t frameCount = Symbols.GetBacktrace(frames, OVR_ARRAY_COUNT(frames), 3);
+
+    TrackedAllocEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.Alloc     = p;
+    entry.StackId   = Stacks.Intern(frames, frameCount);
+    entry.Tag       = tag;
+    entry.AllocSize = size;
+    entry.BlockSize = weight;
+
+    if (Samples.Insert(entry))
+        SampledFilter[GetFilterIndex(p)].fetch_add(1, std::memory_order_relaxed);
+
+    for (Counters* stats : { &StackStats[entry.StackId], &Tags[GetTagSlot(tag)].Stats })
+    {
+        stats->LiveBytes.fetch_add((int64_t)weight, std::memory_order_relaxed);
+        stats->LiveCount.fetch_add(1, std::memory_order_relaxed);
+        stats->TotalBytes.fetch_add(weight, std::memory_order_relaxed);
+        stats->TotalCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
 
-    if (p)
+
+void AllocationProfiler::OnFree(const void* p)
+{
+    std::atomic<uint32_t>& filter = SampledFilter[GetFilterIndex(p)];
+
+    if (filter.load(std::memory_order_relaxed) == 0) // If no sampled pointer has this hash...
+        return;
+
+    TrackedAllocEntry entry;
+
+    if (Samples.Remove(p, &entry))
     {
-        if(UntrackAlloc(p))
+        filter.fetch_sub(1, std::memory_order_relaxed);
+
+        for (Counters* stats : { &StackStats[entry.StackId], &Tags[GetTagSlot(entry.Tag)].Stats })
         {
-           Heap->FreeAligned(p);
+            stats->LiveBytes.fetch_sub((int64_t)entry.BlockSize, std::memory_order_relaxed);
+            stats->LiveCount.fetch_sub(1, std::memory_order_relaxed);
         }
-        else
+    }
+}
+
+
+size_t AllocationProfiler::GetTagStats(TagStats* stats, size_t capacity) const
+{
+    size_t count = 0;
+
+    if (IsInitialized())
+    {
+        for (size_t i = 0; i <= TagCapacity; ++i)
         {
-            if (MallocRedirect)
-            {
-                #if OVR_DEBUG_CRT_PRESENT || (_MSC_VER < 1900) // VS2013 doesn't expose _aligned_free_base, so use this delayed approach with VS2013.
-                    // In this case we can't just call the internal CRT _aligned_free_base function becase the debug heap is active and 
-                    // we would need to call a dbg function. The best way for us to do that would be to implement our own function
-                    // which works the same as _aligned_free_dbg(). However, for now we just add this pointer to the delayed free list and 
-                    // simply free it the normal way later when we shutdown.
-                    DelayedAlignedFreeList.push_back(p); // We will call _aligned_free on the pointer later when we've restored the MallocRedirect.
-                #else
-                    // In this case we can just call the internal CRT _free_base function that underlies all CRT malloc functions.
-                    _aligned_free_base(p);
-                #endif
-            }
-            else
+            const TagSlot& slot = Tags[i];
+            const char* tag = slot.Tag.load(std::memory_order_acquire);
+
+            if (tag && ((i < TagCapacity) || slot.Stats.TotalCount)) // Skip the "(other)" slot unless it was used.
             {
-                _aligned_free(p);
+                if (count < capacity)
+                {
+                    stats[count].Tag        = tag;
+                    stats[count].LiveBytes  = slot.Stats.LiveBytes;
+                    stats[count].LiveCount  = slot.Stats.LiveCount;
+                    stats[count].TotalBytes = slot.Stats.TotalBytes;
+                    stats[count].TotalCount = slot.Stats.TotalCount;
+                }
+                count++;
             }
         }
     }
 
-    OVR_ALLOC_BENCHMARK_END();
+    return count;
 }
 
 
-void* Allocator::Realloc(void* p, size_t newSize)
+int64_t AllocationProfiler::GetCounterValue(const Counters& counters, ProfileValue value)
 {
-    return ReallocDebug(p, newSize, nullptr, 0);
+    switch (value)
+    {
+        case PVLiveBytes:  return counters.LiveBytes;
+        case PVLiveCount:  return counters.LiveCount;
+        case PVTotalBytes: return (int64_t)counters.TotalBytes;
+        case PVTotalCount: return (int64_t)counters.TotalCount;
+    }
+
+    return 0;
 }
 
 
-void* Allocator::Recalloc(void* p, size_t count, size_t newSize)
+size_t AllocationProfiler::ExportFoldedStacks(ProfileValue value, bool symbolize, ProfileTextCallback callback, uintptr_t context) const
 {
-    return RecallocDebug(p, count, newSize, nullptr, 0);
-}
+    if (!IsInitialized())
+        return 0;
 
+    const bool symbolLookupWasInitialized = SymbolLookup::IsInitialized();
+    const bool symbolLookupAvailable = (symbolize && SymbolLookup::Initialize());
 
-void* Allocator::ReallocAligned(void* p, size_t newSize, size_t newAlign)
-{
-    return ReallocAlignedDebug(p, newSize, newAlign, nullptr, 0);
+    if (symbolLookupAvailable && !symbolLookupWasInitialized) // If this was the first initialization, we need to refresh the Symbols view of modules, etc.
+        Symbols.Refresh();
+
+    SysAllocatedString line;
+    SymbolInfo symbolInfo;
+    char buffer[64];
+    size_t lineCount = 0;
+
+    for (size_t stackId = 0; stackId < StackStatsCount; ++stackId)
+    {
+        int64_t stackValue = GetCounterValue(StackStats[stackId], value);
+
+        if (stackValue <= 0)
+            continue;
+
+        void* const* frames;
+        size_t frameCount = Stacks.GetFrames((uint32_t)stackId, frames);
+
+        line.clear();
+
+        if (frameCount == 0)
+            line += "(no backtrace)";
+
+        for (size_t i = frameCount; i > 0; --i) // Outermost frame first.
+        {
+            if (i != frameCount)
+                line += ';';
+
+            if (symbolLookupAvailable && Symbols.LookupSymbol((uint64_t)(uintptr_t)frames[i - 1], symbolInfo) && symbolInfo.function[0])
+            {
+                line += symbolInfo.function;
+            }
+            else
+            {
+                snprintf(buffer, OVR_ARRAY_COUNT(buffer), "0x%p", frames[i - 1]);
+                line += buffer;
+            }
+        }
+
+        snprintf(buffer, OVR_ARRAY_COUNT(buffer), " %lld\n", (long long)stackValue);
+        line += buffer;
+
+        callback(context, line.c_str());
+        ++lineCount;
+    }
+
+    if (symbolLookupAvailable)
+        SymbolLookup::Shutdown();
+
+    return lineCount;
 }
 
 
-void* Allocator::RecallocAligned(void* p, size_t count, size_t newSize, size_t newAlign)
+void AllocationProfiler::RecordTimePoint()
 {
-    return RecallocAlignedDebug(p, count, newSize, newAlign, nullptr, 0);
+    if (!IsInitialized())
+        return;
+
+    Lock::Locker locker(&TimeSeriesLock);
+
+    int64_t* row = &TimeSeriesValues[TimeSeriesNext * (TagCapacity + 1)];
+
+    for (size_t i = 0; i <= TagCapacity; ++i)
+        row[i] = Tags[i].Stats.LiveBytes;
+
+    TimeSeriesTimes[TimeSeriesNext] = Allocator::GetCurrentHeapTimeNs();
+    TimeSeriesNext = ((TimeSeriesNext + 1) % TimeSeriesCapacity);
+    TimeSeriesCount = OVR::Alg::Min(TimeSeriesCount + 1, TimeSeriesCapacity);
 }
 
 
-void* Allocator::ReallocDebug(void* p, size_t newSize, const char* file, unsigned line)
+size_t AllocationProfiler::ExportTimeSeries(ProfileTextCallback callback, uintptr_t context)
 {
-    OVR_ALLOC_BENCHMARK_START();
+    if (!IsInitialized())
+        return 0;
 
-    // We have a tedious problem to solve here. If we have overridden malloc and the memory p was allocated by malloc before we
-    // did the override, then p belongs to the original malloc heap. We can attempt to reallocate it here with our own heap or 
-    // we can reallocate it in the original heap it came from. The latter is simpler.
+    Lock::Locker locker(&TimeSeriesLock);
 
-    AllocMetadata metadata;
-    bool valid = true; // realloc allows you to reallocate NULL, so set this to true by default.
-    void* pNew = nullptr;
+    // Tags are only ever added, so the tags present now are a superset of those present at any recorded point.
+    size_t tagIndexes[TagCapacity + 1];
+    size_t tagCount = 0;
+    SysAllocatedString line("time_ms");
+    char buffer[64];
 
-    if (p)
+    for (size_t i = 0; i <= TagCapacity; ++i)
     {
-        GetAllocMetadata(p, metadata);
-        valid = UntrackAlloc(p); // valid will be true if p is NULL, which is what we want.
+        const char* tag = Tags[i].Tag.load(std::memory_order_acquire);
+
+        if (tag && ((i < TagCapacity) || Tags[i].Stats.TotalCount))
+        {
+            tagIndexes[tagCount++] = i;
+            line += ",\"";
+            line += tag;
+            line += '"';
+        }
     }
 
-    if (valid)
+    line += '\n';
+    callback(context, line.c_str());
+
+    for (size_t p = 0; p < TimeSeriesCount; ++p)
     {
-        pNew = Heap->Realloc(p, newSize);
+        size_t index = ((TimeSeriesNext + TimeSeriesCapacity - TimeSeriesCount + p) % TimeSeriesCapacity);
+        const int64_t* row = &TimeSeriesValues[index * (TagCapacity + 1)];
 
-        if (pNew)
+        snprintf(buffer, OVR_ARRAY_COUNT(buffer), "%.3f", (double)TimeSeriesTimes[index] / 1e6);
+        line = buffer;
+
+        for (size_t t = 0; t < tagCount; ++t)
         {
-            TrackAlloc(pNew, newSize, metadata.Tag, file, line);
+            snprintf(buffer, OVR_ARRAY_COUNT(buffer), ",%lld", (long long)row[tagIndexes[t]]);
+            line += buffer;
         }
+
+        line += '\n';
+        callback(context, line.c_str());
     }
-    else if (MallocRedirect) // Else p came from the CRT heap. It was likely malloc'd before we redirected malloc.
-    {
-        #if OVR_DEBUG_CRT_PRESENT || (_MSC_VER < 1900) // VS2013 doesn't expose _realloc_base, so use this delayed approach with VS2013.
-            #if OVR_DEBUG_CRT_PRESENT
-                size_t originalSize = header_from_block(p)->data_size; // We have to read internal debug data.
-                pNew = crt_malloc_dbg(newSize, _NORMAL_BLOCK, file, line);
-            #else
-                size_t originalSize = HeapSize(GetCRTHeapHandle(), 0, p);
-                pNew = HeapAlloc(GetCRTHeapHandle(), 0, newSize);
-            #endif
-            if (pNew)
-            {
-                size_t copySize = std::min(originalSize, newSize);
-                memcpy(pNew, p, copySize);
-                DelayedFreeList.push_back(p);
-            }
-            // Else don't free p and return nullptr.
-        #else
-            pNew = _realloc_base(p, newSize);
-        #endif
-    }
-    else
-    {
-        pNew = realloc(p, newSize);
-    }
-
-    OVR_ALLOC_BENCHMARK_END();
 
-    return pNew;
+    return TimeSeriesCount;
 }
 
 
-void* Allocator::RecallocDebug(void* p, size_t count, size_t newSize, const char* file, unsigned line)
-{
-    void* pNew = nullptr;
+//-----------------------------------------------------------------------------------
+// ***** AllocationBudgetScope
+//
 
-    if (!OVR::Alg::UnsignedMultiplyWouldOverflow(count, newSize))
-    {
-        newSize *= count;
+// The calling thread's innermost scope. It's cleared while OnAlloc runs, so that allocations
+// made while reporting a violation aren't counted.
+static OVR_THREAD_LOCAL AllocationBudgetScope* BudgetScopeCurrent;
 
-        size_t oldSize;
-        bool valid = IsAllocTracked(p);
+static AllocationBudgetScope::ViolationCallback BudgetViolationCallback = nullptr;
+static uintptr_t                                BudgetViolationContext = 0;
+static std::atomic<uint64_t>                    BudgetTotalViolationCount(0);
 
-        if (valid)
-        {
-            oldSize = GetAllocSize(p);
-        }
-        else if (MallocRedirect)
-        {
-            #if OVR_DEBUG_CRT_PRESENT
-                oldSize = header_from_block(p)->data_size; // We have to read internal debug data.
-            #else
-                oldSize = HeapSize(GetCRTHeapHandle(), 0, p);
-            #endif
-        }
-        else
-        {
-            // So which heap does this allocation come from?
-            oldSize = _msize(p);
-        }
 
-        pNew = ReallocDebug(p, newSize, file, line);
+#if OVR_ALLOCATION_BUDGET_CRT_HOOK
+// Set while an Allocator heap runs, as DefaultHeap is built on malloc and TrackAlloc counts
+// that allocation itself.
+static OVR_THREAD_LOCAL bool BudgetInAllocatorHeap;
 
-        if (pNew && (newSize > oldSize))
-        {
-            memset(reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(pNew) + oldSize), 0, (newSize - oldSize));
-        }
-    }
+static std::atomic<bool> BudgetCRTHookInstalled(false);
+static _CRT_ALLOC_HOOK   BudgetPreviousCRTHook = nullptr;
 
-    return pNew;
-}
+// Called by the debug CRT before each allocation, so the pointer isn't known yet. Note that 
+// this runs with the CRT heap lock held, which a violation report (and callback) does too.
+static int __cdecl BudgetCRTAllocHook(int allocType, void* userData, size_t size, int blockType, long requestNumber, 
+                                      const unsigned char* fileName, int lineNumber)
+{
+    if (BudgetScopeCurrent && !BudgetInAllocatorHeap && (allocType != _HOOK_FREE) && (_BLOCK_TYPE(blockType) != _CRT_BLOCK))
+        AllocationBudgetScope::OnAlloc(nullptr, size, "CRT", (const char*)fileName, lineNumber);
 
+    return (BudgetPreviousCRTHook ? BudgetPreviousCRTHook(allocType, userData, size, blockType, requestNumber, fileName, lineNumber) : TRUE);
+}
 
-void* Allocator::ReallocAlignedDebug(void* p, size_t newSize, size_t newAlign, const char* file, unsigned line)
+// The hook stays installed for the rest of the process once a scope has been enabled. Threads
+// without a scope pay one thread-local load per CRT allocation.
+static void BudgetInstallCRTHook()
 {
-    OVR_ALLOC_BENCHMARK_START();
+    bool expected = false;
 
-    AllocMetadata metadata;
-    bool valid = true; // realloc allows you to reallocate NULL, so set this to true by default.
-    void* pNew = nullptr;
-
-    if (p)
+    if (!BudgetCRTHookInstalled.load(std::memory_order_relaxed) && 
+        BudgetCRTHookInstalled.compare_exchange_strong(expected, true))
     {
-        GetAllocMetadata(p, metadata);
-        valid = UntrackAlloc(p); // valid will be true if p is NULL, which is what we want.
+        BudgetPreviousCRTHook = _CrtSetAllocHook(BudgetCRTAllocHook);
     }
+}
 
-    if (valid)
-    {
-        pNew = Heap->ReallocAligned(p, newSize, newAlign);
+// Hides the heap call of an Allocator allocation from the CRT hook.
+struct BudgetHeapCall
+{
+    BudgetHeapCall() : Previous(BudgetInAllocatorHeap) { BudgetInAllocatorHeap = true; }
+   ~BudgetHeapCall() { BudgetInAllocatorHeap = Previous; }
+    bool Previous;
+};
+#define OVR_BUDGET_HEAP_CALL() BudgetHeapCall budgetHeapCall
+#else
+#define OVR_BUDGET_HEAP_CALL()
+#endif
 
-        if (pNew)
-        {
-            TrackAlloc(pNew, newSize, metadata.Tag, file, line);
-        }
 
-        return pNew;
-    }
-    else if (MallocRedirect) // Else this must go to the CRT heap. It was likely malloc'd before we existed.
+AllocationBudgetScope::AllocationBudgetScope(const char* name, uint64_t maxAllocCount, uint64_t maxAllocBytes, bool enabled)
+  : Name(name ? name : "(unnamed)"),
+    MaxAllocCount(maxAllocCount),
+    MaxAllocBytes(maxAllocBytes),
+    AllocCount(0),
+    AllocBytes(0),
+    ViolationCount(0),
+    Parent(nullptr),
+    Enabled(enabled)
+{
+    if (Enabled)
     {
-        #if OVR_DEBUG_CRT_PRESENT || (_MSC_VER < 1900)
-            // To do. This function in practice is not used by the CRT and so is not very important to us, especially as this is debug-build only.
-            OVR_FAIL_M("Allocator::ReallocAlignedDebug not implemented yet."); 
-        #else
-            pNew = _aligned_realloc_base(p, newSize, newAlign);
+        #if OVR_ALLOCATION_BUDGET_CRT_HOOK
+            BudgetInstallCRTHook();
         #endif
-    }
-    else
-    {
-        pNew = _aligned_realloc(p, newSize, newAlign);
-    }
-
-    OVR_ALLOC_BENCHMARK_END();
 
-    return pNew;
+        Parent = BudgetScopeCurrent;
+        BudgetScopeCurrent = this;
+    }
 }
 
 
-void* Allocator::RecallocAlignedDebug(void* p, size_t count, size_t newSize, size_t newAlign, const char* file, unsigned line)
+AllocationBudgetScope::~AllocationBudgetScope()
 {
-    void* pNew = nullptr;
-
-    if (!OVR::Alg::UnsignedMultiplyWouldOverflow(count, newSize))
+    if (Enabled)
     {
-        newSize *= count;
-
-        size_t oldSize;
-        bool valid = IsAllocTracked(p);
-
-        if (valid)
-        {
-            oldSize = GetAllocAlignedSize(p, newAlign); // We really want the original alignment, not the new alignment.
-        }
-        else if (MallocRedirect)
-        {
-            #if OVR_DEBUG_CRT_PRESENT
-                oldSize = header_from_block(p)->data_size; // We have to read internal debug data.
-            #else
-                oldSize = HeapSize(GetCRTHeapHandle(), 0, p);
-            #endif
-        }
-        else
-        {
-            // So which heap does this allocation come from?
-            oldSize = _aligned_msize(p, newAlign, 0); // We really want the original alignment, not the new alignment.
-        }
-
-        pNew = ReallocAlignedDebug(p, newSize, newAlign, file, line);
-
-        if (pNew && (newSize > oldSize))
-        {
-            memset(reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(pNew) + oldSize), 0, (newSize - oldSize));
-        }
+        OVR_ASSERT(BudgetScopeCurrent == this); // Scopes must end in reverse order of creation.
+        BudgetScopeCurrent = Parent;
     }
-
-    return pNew;
 }
 
 
-uint64_t Allocator::GetCurrentHeapTimeNs()
+void AllocationBudgetScope::SetViolationCallback(ViolationCallback callback, uintptr_t context)
 {
-    #if defined(_WIN32)
-        LARGE_INTEGER tickCount;
-        ::QueryPerformanceCounter(&tickCount);
-
-        LARGE_INTEGER qpfFrequency;
-        ::QueryPerformanceFrequency(&qpfFrequency); // To do: Move this to a single call on startup.
-
-        return (uint64_t)((tickCount.QuadPart * UINT64_C(1000000000)) / qpfFrequency.QuadPart) - ReferenceHeapTimeNs;
-    #else
-        return (uint64_t)(time(NULL) * UINT64_C(1000000000)) - ReferenceHeapTimeNs; // Crude value. Should improve this.
-    #endif
+    BudgetViolationCallback = callback;
+    BudgetViolationContext = context;
 }
 
 
-static uint32_t GetThreadId()
+uint64_t AllocationBudgetScope::GetTotalViolationCount()
 {
-    #if defined(_WIN32)
-        return ::GetCurrentThreadId();
-    #else
-        return pthread_self();
-    #endif
+    return BudgetTotalViolationCount.load(std::memory_order_relaxed);
 }
 
 
-static bool ThreadIdIsValid(uint32_t threadId)
+AllocationBudgetScope* AllocationBudgetScope::GetCurrent()
 {
-    #if defined(_WIN32)
-        bool result = false;
-        HANDLE h = ::OpenThread(THREAD_QUERY_LIMITED_INFORMATION, TRUE, threadId);
-
-        if (h)
-        {
-            DWORD exitCode;
-            BOOL  bResult = ::GetExitCodeThread(h, &exitCode);
-            result = ((bResult != FALSE) && (exitCode != STILL_ACTIVE));
-            ::CloseHandle(h);
-        }
-
-        return result;
-    #else
-        return true;
-    #endif
+    return BudgetScopeCurrent;
 }
 
 
-void Allocator::PushTag(const char* tag)
+void AllocationBudgetScope::OnAlloc(const void* p, size_t size, const char* tag, const char* file, int line)
 {
-    uint32_t threadId = GetThreadId();
+    AllocationBudgetScope* innermost = BudgetScopeCurrent;
 
-    Lock::Locker locker(&TagMapLock);
+    if (!innermost)
+        return;
 
-    TagMap[threadId].push_back(tag);
+    BudgetScopeCurrent = nullptr;
 
-    if(TagMap.size() > 128) // This is some number that should be more than the number of unique threads we ever have.
-        PurgeTagMap();
-}
+    for (AllocationBudgetScope* scope = innermost; scope; scope = scope->Parent)
+    {
+        scope->AllocCount += 1;
+        scope->AllocBytes += size;
 
-void Allocator::PopTag()
-{
-    uint32_t threadId = GetThreadId();
+        if ((scope->AllocCount > scope->MaxAllocCount) || (scope->AllocBytes > scope->MaxAllocBytes))
+        {
+            BudgetTotalViolationCount.fetch_add(1, std::memory_order_relaxed);
+
+            if (++scope->ViolationCount <= MaxReportedViolations)
+                scope->ReportViolation(p, size, tag, file, line);
+        }
+    }
 
-    Lock::Locker locker(&TagMapLock);
+    BudgetScopeCurrent = innermost;
+}
 
-    // We do some error checking to make sure we don't crash if this facility is mis-used.
-    ThreadIdToTagVectorMap::iterator it = TagMap.find(threadId);
 
-    if (it != TagMap.end())
+void AllocationBudgetScope::ReportViolation(const void* p, size_t size, const char* tag, const char* file, int line)
+{
+    Violation violation;
+    violation.Scope = this;
+    violation.Alloc = p;
+    violation.Size = size;
+    violation.Tag = tag;
+    violation.File = file;
+    violation.Line = line;
+    violation.BacktraceCount = Symbols.GetBacktrace(violation.Backtrace, OVR_ARRAY_COUNT(violation.Backtrace), 3); // Skip this function, OnAlloc and TrackAlloc.
+
+    if (BudgetViolationCallback)
     {
-        if (!it->second.empty())
-            it->second.pop_back();
+        BudgetViolationCallback(BudgetViolationContext, violation);
+        return;
     }
-}
 
-const char* Allocator::GetTag(const char* defaultTag)
-{
-    Lock::Locker locker(&TagMapLock);
+    const bool symbolLookupWasInitialized = SymbolLookup::IsInitialized();
+    const bool symbolLookupAvailable = SymbolLookup::Initialize();
+
+    if (symbolLookupAvailable && !symbolLookupWasInitialized) // If this was the first initialization, we need to refresh the Symbols view of modules, etc.
+        Symbols.Refresh();
+
+    char report[4096];
+    char frameText[512];
+    SymbolInfo symbolInfo;
 
-    uint32_t threadId = GetThreadId();
-    ThreadIdToTagVectorMap::const_iterator it = TagMap.find(threadId);
+    snprintf(report, OVR_ARRAY_COUNT(report), "Allocation budget exceeded in %.64s (%llu allocs, %llu bytes; budget: %llu allocs, %llu bytes)\n0x%p, size: %llu, tag: %.64s, file/line: %.128s(%d)\n",
+             Name, AllocCount, AllocBytes, MaxAllocCount, MaxAllocBytes, p, (uint64_t)size, tag ? tag : "none", file ? file : "unknown", line);
 
-    if (it != TagMap.end())
+    for (size_t i = 0; i < violation.BacktraceCount; ++i)
     {
-        if (!it->second.empty())
-            return it->second.back();
+        if (symbolLookupAvailable && Symbols.LookupSymbol((uint64_t)(uintptr_t)violation.Backtrace[i], symbolInfo) && symbolInfo.function[0])
+        {
+            if (symbolInfo.filePath[0])
+                snprintf(frameText, OVR_ARRAY_COUNT(frameText), "%2u: %.256s(%d): %.200s\n", (unsigned)i, symbolInfo.filePath, symbolInfo.fileLineNumber, symbolInfo.function);
+            else
+                snprintf(frameText, OVR_ARRAY_COUNT(frameText), "%2u: 0x%p: %.200s\n", (unsigned)i, violation.Backtrace[i], symbolInfo.function);
+        }
+        else
+            snprintf(frameText, OVR_ARRAY_COUNT(frameText), "%2u: 0x%p (symbols unavailable)\n", (unsigned)i, violation.Backtrace[i]);
+
+        OVR_strlcat(report, frameText, OVR_ARRAY_COUNT(report));
     }
 
-    if (defaultTag)
-        return defaultTag;
+    if (ViolationCount == MaxReportedViolations)
+        OVR_strlcat(report, "Further violations in this scope are counted but not reported.\n", OVR_ARRAY_COUNT(report));
 
-    return OVR_ALLOCATOR_UNSPECIFIED_TAG;
+    ::OutputDebugStringA(report);
 }
 
-void Allocator::PurgeTagMap()
-{
-    Lock::Locker locker(&TagMapLock);
 
-    for(ThreadIdToTagVectorMap::iterator it = TagMap.begin(); it != TagMap.end(); )
-    {
-        uint32_t threadId = it->first;
+//-----------------------------------------------------------------------------------
+// ***** Allocator
+//
 
-        if(!ThreadIdIsValid(threadId))
-            it = TagMap.erase(it);
-        else
-            ++it;
-    }
-}
+Allocator* Allocator::DefaultAllocator    = nullptr;
+uint64_t   Allocator::ReferenceHeapTimeNs = 0;  // Don't set this to GetCurrentHeapTimeNs() because we may need to initialize it earlier than that construction occurs.
 
+// Source of Allocator::TagInstanceId values. 0 is never used, so a thread that has never
+// pushed a tag doesn't match any Allocator.
+static std::atomic<uint64_t> AllocatorTagInstanceCounter(0);
 
-void Allocator::SetNewBlockMetadata(Allocator* allocator, AllocMetadata& amd, const void* alloc, uint64_t allocSize, uint64_t blockSize, 
-                                const char* file, int line, const char* tag, void** backtraceArray, size_t backtraceArraySize)
-{
-    amd.Alloc = alloc;
-    amd.Backtrace.assign(backtraceArray, backtraceArray + backtraceArraySize);
-    amd.BacktraceSymbols.clear(); // This is only set when needed.
-    amd.File = file;
-    amd.Line = line;
-    amd.TimeNs = Allocator::GetCurrentHeapTimeNs();
-    amd.Count = allocator->GetAndUpdateCounter();
-    amd.AllocSize = allocSize;
-    amd.BlockSize = blockSize;
-    amd.Tag = tag;
-    amd.ThreadId = GetThreadId();
-    OVR::Thread::GetCurrentThreadName(amd.ThreadName, sizeof(amd.ThreadName)); // Currently works on Windows only for threads that were named via our OVR thread naming API.
-}
+// The calling thread's tag stack for the Allocator it most recently used tags with. 
+// Other Allocators find theirs through their OS thread-local slot, which is slower.
+static OVR_THREAD_LOCAL uint64_t AllocatorTlsTagInstanceId;
+static OVR_THREAD_LOCAL void*    AllocatorTlsTagStack;
 
+#if defined(_WIN32)
+    static void NTAPI AllocatorTagFlsCallback(void* tagStack)
+    {
+        Allocator::OnTagThreadExit(tagStack);
+    }
+#endif
 
-void Allocator::TrackAlloc(const void* p, size_t size, const char* tag, const char* file, int line)
+Allocator* Allocator::GetInstance(bool create)
 {
-    if (p && TrackingEnabled) // To consider: Make TrackingEnabled an atomic.
+    if(!DefaultAllocator && create)
     {
-        auto AlignSizeUp = [](size_t value, size_t alignment) -> size_t { // To do: Have a centralized version of this.
-            return ((value + (alignment - 1)) & ~(alignment - 1));
-        };
-
-        TrackedAllocMap::value_type value(p, AllocMetadata());
-
-        #if defined(_WIN64)
-            void* addressArray[128];
-            size_t frameCount = Symbols.GetBacktrace(addressArray, OVR_ARRAY_COUNT(addressArray), 2);
+        // This is not thread-safe. Two calls could race to this point.
+        #if defined(_WIN32)
+            // Cannot allocate memory while doing the following.
+            wchar_t moduleNameW[MAX_PATH];
+            char    defaultAllocatorName[MAX_PATH * 6] = {}; // Maximum possible requirement for a UTF16 to UTF8 conversion.
+            DWORD   nameStrlen = GetModuleFileNameW(nullptr, moduleNameW, MAX_PATH);
+            WideCharToMultiByte(CP_UTF8, 0, moduleNameW, nameStrlen + 1, defaultAllocatorName, sizeof(defaultAllocatorName), nullptr, nullptr); // +1 because WideCharToMultiByte will only 0-terminate if you include the 0 as part of the input.
+            defaultAllocatorName[sizeof(defaultAllocatorName)-1] = '\0';
+            std::transform(defaultAllocatorName, defaultAllocatorName + strlen(defaultAllocatorName), defaultAllocatorName, [](char c) { return ((c == '/') ? '\\' : c); }); // Convert any / to \.
+            const char* lastSeparator = strrchr(defaultAllocatorName, '\\');
+            if (lastSeparator)
+                memmove(defaultAllocatorName, lastSeparator + 1, strlen(lastSeparator + 1) + 1);
+            OVR_strlcat(defaultAllocatorName, " Default Allocator", sizeof(defaultAllocatorName));
         #else
-            // Currently 32 bit backtrace reading is too slow. We can fix it by writing our own version
-            // that reads the stack frames, but it's not a high priority since we work mostly with 64 bit.
-            void* addressArray[1] = { nullptr };
-            size_t frameCount = 0;
+            const char* defaultAllocatorName = "Default Allocator";
         #endif
+        DefaultAllocator = new(SysMemAlloc(sizeof(Allocator))) Allocator(defaultAllocatorName);
+        DefaultAllocator->Init();
+    }
 
-        if (!tag)
-            tag = GetTag();
+    return DefaultAllocator;
+}
 
-        SetNewBlockMetadata(this, value.second, p, size, 
-                            AlignSizeUp(size, 8),       // This is only a default value, and may be under-represented at time time, until we can have that passed into this function as well.
-                            file, line, tag, addressArray, frameCount);
 
-        Lock::Locker locker(&TrackLock);
 
-        if (TrackingEnabled) // To consider: Do we really need to do this?
-        {
-            AllocationMap.insert(value);
-        }
+void Allocator::DestroyInstance()
+{
+    if (DefaultAllocator)
+    {
+        // This is not thread-safe. Two calls could race to this line.
+        DefaultAllocator->Shutdown();
+        DefaultAllocator->~Allocator();
+        SysMemFree(DefaultAllocator, sizeof(Allocator));
+        DefaultAllocator = nullptr;
     }
 }
 
 
-bool Allocator::UntrackAlloc(const void* p)
+Allocator::Allocator(const char* allocatorName)
+   : AllocatorName{}
+   , Heap(nullptr)
+   , ExternalHeap(nullptr)
+   , DebugPageHeapEnabled(false)
+   , OSHeapEnabled(false)
+   , PoolHeapEnabled(false)
+   , MallocRedirectEnabled(false)
+   , MallocRedirect(nullptr)
+   , TrackingEnabled(false)
+   , TraceAllocationsOnShutdown(false)
+   , TrackingSampleRate(1)
+   , TrackLock()
+   , AllocationTable()
+   , BacktraceTable()
+   , TrackIteratorShard(0)
+   , TrackIteratorSlot(0)
+   , TrackIteratorMetadata()
+   , Profiler()
+   , DelayedFreeList()
+   , DelayedAlignedFreeList()
+   , CurrentCounter()
+   , SymbolLookupEnabled(false)
+   , TagInstanceId(++AllocatorTagInstanceCounter)
+   , TagTlsKey(0)
+   , TagTlsKeyValid(false)
+   , TagStackList(nullptr)
+   , TagStackCount(0)
+   , TagStackLock()
 {
-    if (!TrackingEnabled)
-        return true; // Just assume the pointer is valid.
+    SetAllocatorName(allocatorName);
 
-    if (p)
-    {
-        Lock::Locker locker(&TrackLock);
+    #if defined(_WIN32)
+        DWORD flsIndex = FlsAlloc(AllocatorTagFlsCallback);
+        TagTlsKeyValid = (flsIndex != FLS_OUT_OF_INDEXES);
+        TagTlsKey = flsIndex;
+    #else
+        pthread_key_t key;
+        TagTlsKeyValid = (pthread_key_create(&key, OnTagThreadExit) == 0);
+        TagTlsKey = (uintptr_t)key;
+    #endif
 
-        TrackedAllocMap::iterator it = AllocationMap.find(p);
+    if (ReferenceHeapTimeNs == 0)   // There is a thread race condition for the case that on startup two threads somehow execute this line at the same time.
+        ReferenceHeapTimeNs = GetCurrentHeapTimeNs();
+}
 
-        if(it != AllocationMap.end())
-        {
-            AllocationMap.erase(it);
-            return true;
-        }
-    }
 
-    return false;
+void Allocator::SetAllocatorName(const char* allocatorName)
+{
+    if (allocatorName)
+        OVR::OVR_strlcpy(AllocatorName, allocatorName, OVR_ARRAY_COUNT(AllocatorName));
 }
 
 
-bool Allocator::IsAllocTracked(const void* p)
+const char* Allocator::GetAllocatorName() const
 {
-    if (!TrackingEnabled)
-        return true; // Just assume the pointer is valid.
-
-    if (p)
-    {
-        Lock::Locker locker(&TrackLock);
+    return AllocatorName;
+}
 
-        return (AllocationMap.find(p) != AllocationMap.end());
-    }
 
-    return false;
+Allocator::~Allocator()
+{
+    Allocator::Shutdown();
+    ReleaseTagStacks();
 }
 
 
-bool Allocator::GetAllocMetadata(const void* p, AllocMetadata& metadata)
+bool Allocator::Init()
 {
-    Lock::Locker locker(&TrackLock);
+    if (!Heap) // If not already initialized...
+    {
+        // Potentially redirect the CRT malloc family of functions.
+        if (!MallocRedirectEnabled) // If not programmatically enabled before this init call...
+        {
+            #if OVR_REDIRECT_CRT_MALLOC
+                MallocRedirectEnabled = true;
+            #else
+                MallocRedirectEnabled = OVR::Util::GetRegistryBoolW(L"Software\\Oculus", L"MallocRedirectEnabled", false); // "HKEY_LOCAL_MACHINE\SOFTWARE\Oculus\MallocRedirectEnabled", REG_DWORD of 0 or 1.
+            #endif
 
-    TrackedAllocMap::iterator it = AllocationMap.find(p);
+            if (Allocator::GetInstance(false) != this) // Only redirect malloc if we are the default heap.
+                MallocRedirectEnabled = false;
+        }
 
-    if (it != AllocationMap.end())
-    {
-        const TrackedAllocMap::value_type& v = *it;
-        metadata = v.second;
-        return true;
-    }
+        if (MallocRedirectEnabled)
+        {
+            // We will need to enable tracking so that we can distinguish between our pointers and pointers allocated via malloc before we did this redirect.
+            TrackingEnabled = true;
 
-    return false;
-}
+            // Make a struct of our override function pointers.
+            OVR::InterceptCRTMalloc::MallocFunctionPointers mfp;
 
+            mfp.malloc_ptr = ovr_malloc;
+            mfp.calloc_ptr = ovr_calloc;
+            mfp.realloc_ptr = ovr_realloc;
+            mfp.recalloc_ptr = ovr_recalloc;
+            mfp.msize_ptr = ovr_msize;
+            mfp.free_ptr = ovr_free;
+            mfp.aligned_malloc_ptr = ovr_aligned_malloc;
+            mfp.aligned_offset_malloc_ptr = ovr_aligned_offset_malloc;
+            mfp.aligned_realloc_ptr = ovr_aligned_realloc;
+            mfp.aligned_offset_realloc_ptr = ovr_aligned_offset_realloc;
+            mfp.aligned_recalloc_ptr = ovr_aligned_recalloc;
+            mfp.aligned_offset_recalloc_ptr = ovr_aligned_offset_recalloc;
+            mfp.aligned_msize_ptr = ovr_aligned_msize;
+            mfp.aligned_free_ptr = ovr_aligned_free;
 
-bool Allocator::EnableTracking(bool enable)
-{
-    bool result = false;
+            #ifdef OVR_DEBUG_CRT_PRESENT
+                mfp.malloc_dbg_ptr = ovr_malloc_dbg;
+                mfp.calloc_dbg_ptr = ovr_calloc_dbg;
+                mfp.realloc_dbg_ptr = ovr_realloc_dbg;
+                mfp.recalloc_dbg_ptr = ovr_recalloc_dbg;
+                mfp.msize_dbg_ptr = ovr_msize_dbg;
+                mfp.free_dbg_ptr = ovr_free_dbg;
+                mfp.aligned_malloc_dbg_ptr = ovr_aligned_malloc_dbg;
+                mfp.aligned_offset_malloc_dbg_ptr = ovr_aligned_offset_malloc_dbg;
+                mfp.aligned_realloc_dbg_ptr = ovr_aligned_realloc_dbg;
+                mfp.aligned_offset_realloc_dbg_ptr = ovr_aligned_offset_realloc_dbg;
+                mfp.aligned_recalloc_dbg_ptr = ovr_aligned_recalloc_dbg;
+                mfp.aligned_offset_recalloc_dbg_ptr = ovr_aligned_offset_recalloc_dbg;
+                mfp.aligned_msize_dbg_ptr = ovr_aligned_msize_dbg;
+                mfp.aligned_free_dbg_ptr = ovr_aligned_free_dbg;
+            #endif
 
-    // We may need to deal with the case that this is called when we 
-    // have already started memory allocation activity. Currently disabled.
-    Lock::Locker locker(&TrackLock);
+            MallocRedirect = new (SysMemAlloc(sizeof(OVR::InterceptCRTMalloc))) OVR::InterceptCRTMalloc;
+            MallocRedirect->ReplaceCRTMalloc(mfp);
+        }
 
-    if (!Heap) // If we haven't initialized yet...
-    {
-        TrackingEnabled = enable;
-        result = true;
-    }
-    else if(TrackingEnabled != enable) // if there is a change being requested...
-    {
-        // Currently we support the enabling and disabling of tracking after initialization
-        // only if we aren't using the page debug heap. We may be able to work around that
-        // in the future if needed. Tracking is enabled by default before initialization when 
-        // the page debug heap is enabled, so it's only a matter here of attempting to 
-        // disable tracking after it's been enabled, in practice.
-        if (!DebugPageHeapEnabled)  
+
+        // Potentially enable the debug page heap.
+        if (!DebugPageHeapEnabled && !ExternalHeap) // If not programmatically enabled before this init call...
         {
-            TrackingEnabled = enable;
+            // The debug page heap is restricted to 64 bit platforms due to the potential for address space exhaustion on 32-bit platforms.
+            #if defined(OVR_CPU_X86_64)
+                #if OVR_ALLOCATOR_DEBUG_PAGE_HEAP_ENABLED // If we should try to enable the debug heap...
+                    DebugPageHeapEnabled = true;
+                #else
+                    DebugPageHeapEnabled = OVR::Util::GetRegistryBoolW(L"Software\\Oculus", L"DebugPageHeapEnabled", DebugPageHeapEnabled); // "HKEY_LOCAL_MACHINE\SOFTWARE\Oculus\DebugPageHeapEnabled", REG_DWORD of 0 or 1.
+                #endif
 
-            if(!TrackingEnabled) // If we are disabling tracking...
-            {
-                AllocationMap.clear(); // Clear all the tracking we've done so far.
-            }
+                #if defined(OVR_BUILD_DEBUG) && defined(_MSC_VER)
+                    if (DebugPageHeapEnabled)
+                    {
+                        // Make _CrtIsValidHeapPointer always return true. The VC++ concurrency library has a bug in that
+                        // it's calling _CrtIsValidHeapPointer, which is invalid and recommended against by Microsoft themselves.
+                        // We need to deal with this nevertheless. The problem is that the VC++ concurrency library is
+                        // calling _CrtIsValidHeapPointer on the default heap instead of the current heap (DebugPageHeap).
+                        // So we modify the _CrtIsValidHeapPointer implementation to always return true. The primary risk
+                        // with this change is that there's some code somewhere that uses it for a non-diagnostic purpose.
+                        // However this os Oculus-debug-internal and so has no effect on any formally published software.
+                        DebugPageHeapEnabled = OVR::KillCdeclFunction(_CrtIsValidHeapPointer, true); // If we can successfully kill _CrtIsValidHeapPointer, enable our debug heap.
+                    }
+                #endif
+            #endif
+        }
 
-            result = true;
-        } // Else don't allow the change.
-    }
-    else //Else there's no change.
-    {
-        result = true;
-    }
+        // Potentially enable the pool heap.
+        if (!PoolHeapEnabled && !DebugPageHeapEnabled && !ExternalHeap) // If not programmatically enabled before this init call...
+        {
+            #if OVR_ALLOCATOR_POOL_HEAP_ENABLED
+                PoolHeapEnabled = true;
+            #else
+                PoolHeapEnabled = OVR::Util::GetRegistryBoolW(L"Software\\Oculus", L"PoolHeapEnabled", false); // "HKEY_LOCAL_MACHINE\SOFTWARE\Oculus\PoolHeapEnabled", REG_DWORD of 0 or 1.
+            #endif
+        }
 
-    return result;
-}
+        if (ExternalHeap) // If the user supplied a heap via SetHeap...
+        {
+            Heap = ExternalHeap;
+        }
+        else if (DebugPageHeapEnabled)
+        {
+            // We will need to enable tracking so that we can distinguish between our pointers and pointers allocated via malloc before we did this redirect.
+            TrackingEnabled = true;
 
+            Heap = new(SysMemAlloc(sizeof(DebugPageHeap))) DebugPageHeap;
+            Heap->Init();
+        }
+        else if (PoolHeapEnabled)
+        {
+            // The pool heap gets its memory from the OS and OSHeap rather than malloc, so it works when we are redirecting CRT malloc too.
+            if (MallocRedirectEnabled)
+                TrackingEnabled = true;
 
-bool Allocator::EnableDebugPageHeap(bool enable)
-{
-    bool result = false;
+            Heap = new(SysMemAlloc(sizeof(PoolHeap))) PoolHeap;
+            Heap->Init(); // If this fails then everything goes to its large object heap.
+        }
+        else if(MallocRedirectEnabled)
+        {
+            // We will need to enable tracking so that we can distinguish between our pointers and pointers allocated via malloc before we did this redirect.
+            TrackingEnabled = true;
+            OSHeapEnabled = true;
 
-    if (!Heap) // If we haven't initialized yet...
-    {
-        DebugPageHeapEnabled = enable;
-        result = true;
-    }
+            // If we are redirecting CRT malloc then we can't use the default heap, because it used CRT malloc, which would we be circular.
+            Heap = new(SysMemAlloc(sizeof(OSHeap))) OSHeap;
+            Heap->Init();
+        }
+        else // Else default heap (which uses malloc).
+        {
+            Heap = new(SysMemAlloc(sizeof(DefaultHeap))) DefaultHeap;
+            Heap->Init();
+        }
 
-    return result;
-}
 
+        // Potentially enable allocation tracking.
+        if (!TrackingEnabled) // If not programmatically enabled before this init call...
+        {
+            #if OVR_ALLOCATOR_TRACKING_ENABLED
+                TrackingEnabled = true;
+            #else
+                TrackingEnabled = IsHeapTrackingRegKeyEnabled(TrackingEnabled);
+            #endif
+        }
+
+        // Sampling isn't possible when we rely on tracking to tell our pointers apart from others.
+        if (MallocRedirectEnabled || DebugPageHeapEnabled)
+            TrackingSampleRate = 1;
 
-bool Allocator::EnableMallocRedirect()
-{
-    bool result = false;
+        if (TrackingEnabled)
+            BacktraceTable.Init(); // If this fails then allocations are tracked without backtraces.
 
-    if (!Heap)
-    {
-        MallocRedirectEnabled = true;
-        result = true;
+        // Initialize the symbol and backtrace utility library
+        SymbolLookupEnabled = SymbolLookup::Initialize();
     }
 
-    return result;
+    return true;
 }
 
-bool Allocator::IsHeapTrackingRegKeyEnabled(bool defaultValue)
-{
-    // "HKEY_LOCAL_MACHINE\SOFTWARE\Oculus\HeapTrackingEnabled", REG_DWORD of 0 or 1.
-    return OVR::Util::GetRegistryBoolW(L"Software\\Oculus", L"HeapTrackingEnabled", defaultValue);
-}
 
-const AllocMetadata* Allocator::IterateHeapBegin()
+void Allocator::Shutdown()
 {
-    TrackLock.DoLock(); // Will be unlocked in IterateHeapEnd().
-
-    if (TrackingEnabled)
+    if (Heap) // If we were initialized...
     {
-        // We have a problem in the case that a single thread calls IterateHeapBegin twice 
-        // before calling IterateHeapEnd. It can be resolved the application calling IterateHeapEnd 
-        // twice as well, but do we want to support that usage? It's probably easier to just disallow it.
+        if (TraceAllocationsOnShutdown)
+            TraceTrackedAllocations(nullptr, 0);
+
+        if (SymbolLookupEnabled)
+            SymbolLookup::Shutdown();
 
-        if (!AllocationMap.empty())
+        if (MallocRedirectEnabled)
         {
-            TrackIterator = AllocationMap.begin();
-            return &TrackIterator->second;
+            MallocRedirect->RestoreCRTMalloc();
+            MallocRedirect->~InterceptCRTMalloc();
+            SysMemFree(MallocRedirect, sizeof(OVR::InterceptCRTMalloc));
+            MallocRedirect = nullptr;
         }
-    }
 
-    return nullptr;
-}
+        for(auto p: DelayedAlignedFreeList)
+            _aligned_free(p);
+        DelayedAlignedFreeList.clear();
 
-const AllocMetadata* Allocator::IterateHeapNext()
-{
-    ++TrackIterator;
+        for(auto p: DelayedFreeList)
+            free(p);
+        DelayedFreeList.clear();
 
-    if(TrackIterator == AllocationMap.end())
-        return nullptr;
+        AllocationTable.Clear();
+        BacktraceTable.Shutdown();
+        Profiler.Shutdown();
+        CurrentCounter = 0;
 
-    return &TrackIterator->second;
+        // Free the heap, unless it belongs to the user.
+        if (Heap && (Heap != ExternalHeap))
+        {
+            Heap->Shutdown();
+            Heap->~Heap();
+            if (DebugPageHeapEnabled)
+                SysMemFree(Heap, sizeof(DebugPageHeap));
+            else if (PoolHeapEnabled)
+                SysMemFree(Heap, sizeof(PoolHeap));
+            else
+                SysMemFree(Heap, sizeof(DefaultHeap));
+        }
+        Heap = nullptr;
+    }
 }
 
-void Allocator::IterateHeapEnd()
+
+void* Allocator::Alloc(size_t size, const char* tag)
 {
-        TrackLock.Unlock();
-    }
+    return AllocDebug(size, tag, nullptr, 0);
+}
 
 
-size_t Allocator::DescribeAllocation(const AllocMetadata* amd, int amdFlags, char* description, size_t descriptionCapacity, size_t appendedNewlineCount)
+void* Allocator::Calloc(size_t count, size_t size, const char* tag)
 {
-    SysAllocatedString descriptionString;
-    char buffer[2048];
+    return CallocDebug(count, size, tag, nullptr, 0);
+}
 
-    if (amdFlags & AMFAlloc)
+
+void* Allocator::AllocAligned(size_t size, size_t align, const char* tag)
+{
+    return AllocAlignedDebug(size, align, tag, nullptr, 0);
+}
+
+
+void* Allocator::AllocDebug(size_t size, const char* tag, const char* file, unsigned line)
+{
+    OVR_ALLOC_BENCHMARK_START();
+    OVR_BUDGET_HEAP_CALL();
+
+    void* p = Heap->Alloc(size);
+
+    if (p)
     {
-        snprintf(buffer, OVR_ARRAY_COUNT(buffer), "0x%p", amd->Alloc);
-        descriptionString += buffer;
+        TrackAlloc(p, size, tag, file, line);
     }
 
-    if (amdFlags & AMFAllocSize)
+    OVR_ALLOC_BENCHMARK_END();
+
+    return p;
+}
+
+
+void* Allocator::CallocDebug(size_t count, size_t size, const char* tag, const char* file, unsigned line)
+{
+    void* p = AllocDebug(count * size,  tag, file, line);
+
+    if (p)
     {
-        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", size: %llu", amd->AllocSize);
-        descriptionString += buffer;
+        memset(p, 0, count * size);
     }
 
-    if (amdFlags & AMFBlockSize)
+    return p;
+}
+
+
+void* Allocator::AllocAlignedDebug(size_t size, size_t align, const char* tag, const char* file, unsigned line)
+{
+    OVR_ALLOC_BENCHMARK_START();
+    OVR_BUDGET_HEAP_CALL();
+
+    void* p = Heap->AllocAligned(size, align);
+
+    if (p)
     {
-        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", block size: %llu", amd->BlockSize);
-        descriptionString += buffer;
+        TrackAlloc(p, size, tag, file, line);
     }
 
-    if (amdFlags & AMFTime)
+    OVR_ALLOC_BENCHMARK_END();
+
+    return p;
+}
+
+
+size_t Allocator::GetAllocSize(const void* p) const
+{
+    return Heap->GetAllocSize(p);
+}
+
+
+size_t Allocator::GetAllocAlignedSize(const void* p, size_t align) const
+{
+    return Heap->GetAllocAlignedSize(p, align);
+}
+
+
+void Allocator::Free(void* p)
+{
+    OVR_ALLOC_BENCHMARK_START();
+
+    if (p)
     {
-        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", time: %llus", amd->TimeNs / UINT64_C(1000000000));
-        descriptionString += buffer;
+        if(UntrackAlloc(p)) // If this pointer is recognized as belonging to us...
+        {
+            Heap->Free(p);
+        }
+        else
+        {
+            // We don't recognize the pointer being freed. That almost always means one of two things:
+            //     - We are overriding malloc/free and somebody is freeing memory that they allocated before we 
+            //       started overriding malloc and free. 
+            //     - We are not overriding malloc/free and somebody is freeing memory via operater delete
+            //       which they allocated with malloc(). That's disallowed C++ but in fact it happens.
+            // We have a number of options for dealing with this and try to choose the best option:
+            //     - Call CRT free function.
+            //       Can't do this if we are overriding CRT free and have lost access to the original CRT free function.
+            //     - Call the CRT underlying _free_base function.
+            //       Can't do this if the debug CRT is active, because p is not the actual pointer to free.
+            //     - Call the OS underlying HeapFree function.
+            //       Can't do this if the debug CRT is active, because this method results in the debug heap structures being corrupt.
+            //     - Put the pointer in a list which we free later, in the case that we are overriding CRT free and have lost access to the original CRT free function.
+            //       This works fairly well.
+            //     - Do nothing and let the memory leak in the underlying heap.
+            //       This works fairly well but results in there looking like there was a CRT memory leak.
+
+            if (MallocRedirect)
+            {
+                #if OVR_DEBUG_CRT_PRESENT || (_MSC_VER < 1900) // VS2013 doesn't expose _free_base, so use this delayed approach with VS2013.
+                    // In this case we can't just call the internal CRT _free_base function becase the debug heap is active and 
+                    // we would need to call a dbg function. The best way for us to do that would be to implement our own function
+                    // which works the same as _free_dbg(). However, for now we just add this pointer to the delayed free list and 
+                    // simply free it the normal way later when we shutdown.
+                    DelayedFreeList.push_back(p); // We will call free on the pointer later when we've restored the MallocRedirect.
+                #else
+                    // In this case we can just call the internal CRT _free_base function that underlies all CRT malloc functions.
+                    _free_base(p);
+                #endif
+            }
+            else
+            {
+                free(p);
+            }
+        }
     }
 
-    if (amdFlags & AMFCount)
+    OVR_ALLOC_BENCHMARK_END();
+}
+
+
+void Allocator::FreeAligned(void* p)
+{
+    OVR_ALLOC_BENCHMARK_START();
+
+    if (p)
     {
-        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", #: %llu", amd->Count);
-        descriptionString += buffer;
+        if(UntrackAlloc(p))
+        {
+           Heap->FreeAligned(p);
+        }
+        else
+        {
+            if (MallocRedirect)
+            {
+                #if OVR_DEBUG_CRT_PRESENT || (_MSC_VER < 1900) // VS2013 doesn't expose _aligned_free_base, so use this delayed approach with VS2013.
+                    // In this case we can't just call the internal CRT _aligned_free_base function becase the debug heap is active and 
+                    // we would need to call a dbg function. The best way for us to do that would be to implement our own function
+                    // which works the same as _aligned_free_dbg(). However, for now we just add this pointer to the delayed free list and 
+                    // simply free it the normal way later when we shutdown.
+                    DelayedAlignedFreeList.push_back(p); // We will call _aligned_free on the pointer later when we've restored the MallocRedirect.
+                #else
+                    // In this case we can just call the internal CRT _free_base function that underlies all CRT malloc functions.
+                    _aligned_free_base(p);
+                #endif
+            }
+            else
+            {
+                _aligned_free(p);
+            }
+        }
     }
 
-    if (amdFlags & AMFTag)
+    OVR_ALLOC_BENCHMARK_END();
+}
+
+
+void* Allocator::Realloc(void* p, size_t newSize)
+{
+    return ReallocDebug(p, newSize, nullptr, 0);
+}
+
+
+void* Allocator::Recalloc(void* p, size_t count, size_t newSize)
+{
+    return RecallocDebug(p, count, newSize, nullptr, 0);
+}
+
+
+void* Allocator::ReallocAligned(void* p, size_t newSize, size_t newAlign)
+{
+    return ReallocAlignedDebug(p, newSize, newAlign, nullptr, 0);
+}
+
+
+void* Allocator::RecallocAligned(void* p, size_t count, size_t newSize, size_t newAlign)
+{
+    return RecallocAlignedDebug(p, count, newSize, newAlign, nullptr, 0);
+}
+
+
+void* Allocator::ReallocDebug(void* p, size_t newSize, const char* file, unsigned line)
+{
+    OVR_ALLOC_BENCHMARK_START();
+
+    // We have a tedious problem to solve here. If we have overridden malloc and the memory p was allocated by malloc before we
+    // did the override, then p belongs to the original malloc heap. We can attempt to reallocate it here with our own heap or 
+    // we can reallocate it in the original heap it came from. The latter is simpler.
+
+    const char* tag = nullptr;
+    bool valid = true; // realloc allows you to reallocate NULL, so set this to true by default.
+    void* pNew = nullptr;
+
+    if (p)
     {
-        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", tag: %s", amd->Tag ? amd->Tag : OVR_ALLOCATOR_UNSPECIFIED_TAG);
-        descriptionString += buffer;
+        tag = GetAllocTag(p);
+        valid = UntrackAlloc(p); // valid will be true if p is NULL, which is what we want.
     }
 
-    if (amdFlags & AMFThreadId)
+    if (valid)
     {
-        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", tid: %u", amd->ThreadId);
-        descriptionString += buffer;
-    }
+        OVR_BUDGET_HEAP_CALL();
+        pNew = Heap->Realloc(p, newSize);
 
-    if (amdFlags & AMFThreadName)
+        if (pNew)
+        {
+            TrackAlloc(pNew, newSize, tag, file, line);
+        }
+    }
+    else if (MallocRedirect) // Else p came from the CRT heap. It was likely malloc'd before we redirected malloc.
     {
-        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", thread name: %s", amd->ThreadName);
-        descriptionString += buffer;
+        #if OVR_DEBUG_CRT_PRESENT || (_MSC_VER < 1900) // VS2013 doesn't expose _realloc_base, so use this delayed approach with VS2013.
+            #if OVR_DEBUG_CRT_PRESENT
+                size_t originalSize = header_from_block(p)->data_size; // We have to read internal debug data.
+                pNew = crt_malloc_dbg(newSize, _NORMAL_BLOCK, file, line);
+            #else
+                size_t originalSize = HeapSize(GetCRTHeapHandle(), 0, p);
+                pNew = HeapAlloc(GetCRTHeapHandle(), 0, newSize);
+            #endif
+            if (pNew)
+            {
+                size_t copySize = std::min(originalSize, newSize);
+                memcpy(pNew, p, copySize);
+                DelayedFreeList.push_back(p);
+            }
+            // Else don't free p and return nullptr.
+        #else
+            pNew = _realloc_base(p, newSize);
+        #endif
     }
-
-    if ((amdFlags & AMFFile) || (amdFlags & AMFLine))
+    else
     {
-        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", file/line: %s(%d)", amd->File, amd->Line);
-        descriptionString += buffer;
+        pNew = realloc(p, newSize);
     }
 
-    if (amdFlags & (AMFBacktrace | AMFBacktraceSymbols))
+    OVR_ALLOC_BENCHMARK_END();
+
+    return pNew;
+}
+
+
+void* Allocator::RecallocDebug(void* p, size_t count, size_t newSize, const char* file, unsigned line)
+{
+    void* pNew = nullptr;
+
+    if (!OVR::Alg::UnsignedMultiplyWouldOverflow(count, newSize))
+    {
+        newSize *= count;
+
+        size_t oldSize;
+        bool valid = IsAllocTracked(p);
+
+        if (valid)
+        {
+            oldSize = GetAllocSize(p);
+        }
+        else if (MallocRedirect)
+        {
+            #if OVR_DEBUG_CRT_PRESENT
+                oldSize = header_from_block(p)->data_size; // We have to read internal debug data.
+            #else
+                oldSize = HeapSize(GetCRTHeapHandle(), 0, p);
+            #endif
+        }
+        else
+        {
+            // So which heap does this allocation come from?
+            oldSize = _msize(p);
+        }
+
+        pNew = ReallocDebug(p, newSize, file, line);
+
+        if (pNew && (newSize > oldSize))
+        {
+            memset(reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(pNew) + oldSize), 0, (newSize - oldSize));
+        }
+    }
+
+    return pNew;
+}
+
+
+void* Allocator::ReallocAlignedDebug(void* p, size_t newSize, size_t newAlign, const char* file, unsigned line)
+{
+    OVR_ALLOC_BENCHMARK_START();
+
+    const char* tag = nullptr;
+    bool valid = true; // realloc allows you to reallocate NULL, so set this to true by default.
+    void* pNew = nullptr;
+
+    if (p)
+    {
+        tag = GetAllocTag(p);
+        valid = UntrackAlloc(p); // valid will be true if p is NULL, which is what we want.
+    }
+
+    if (valid)
+    {
+        OVR_BUDGET_HEAP_CALL();
+        pNew = Heap->ReallocAligned(p, newSize, newAlign);
+
+        if (pNew)
+        {
+            TrackAlloc(pNew, newSize, tag, file, line);
+        }
+
+        return pNew;
+    }
+    else if (MallocRedirect) // Else this must go to the CRT heap. It was likely malloc'd before we existed.
+    {
+        #if OVR_DEBUG_CRT_PRESENT || (_MSC_VER < 1900)
+            // To do. This function in practice is not used by the CRT and so is not very important to us, especially as this is debug-build only.
+            OVR_FAIL_M("Allocator::ReallocAlignedDebug not implemented yet."); 
+        #else
+            pNew = _aligned_realloc_base(p, newSize, newAlign);
+        #endif
+    }
+    else
+    {
+        pNew = _aligned_realloc(p, newSize, newAlign);
+    }
+
+    OVR_ALLOC_BENCHMARK_END();
+
+    return pNew;
+}
+
+
+void* Allocator::RecallocAlignedDebug(void* p, size_t count, size_t newSize, size_t newAlign, const char* file, unsigned line)
+{
+    void* pNew = nullptr;
+
+    if (!OVR::Alg::UnsignedMultiplyWouldOverflow(count, newSize))
+    {
+        newSize *= count;
+
+        size_t oldSize;
+        bool valid = IsAllocTracked(p);
+
+        if (valid)
+        {
+            oldSize = GetAllocAlignedSize(p, newAlign); // We really want the original alignment, not the new alignment.
+        }
+        else if (MallocRedirect)
+        {
+            #if OVR_DEBUG_CRT_PRESENT
+                oldSize = header_from_block(p)->data_size; // We have to read internal debug data.
+            #else
+                oldSize = HeapSize(GetCRTHeapHandle(), 0, p);
+            #endif
+        }
+        else
+        {
+            // So which heap does this allocation come from?
+            oldSize = _aligned_msize(p, newAlign, 0); // We really want the original alignment, not the new alignment.
+        }
+
+        pNew = ReallocAlignedDebug(p, newSize, newAlign, file, line);
+
+        if (pNew && (newSize > oldSize))
+        {
+            memset(reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(pNew) + oldSize), 0, (newSize - oldSize));
+        }
+    }
+
+    return pNew;
+}
+
+
+uint64_t Allocator::GetCurrentHeapTimeNs()
+{
+    #if defined(_WIN32)
+        LARGE_INTEGER tickCount;
+        ::QueryPerformanceCounter(&tickCount);
+
+        LARGE_INTEGER qpfFrequency;
+        ::QueryPerformanceFrequency(&qpfFrequency); // To do: Move this to a single call on startup.
+
+        return (uint64_t)((tickCount.QuadPart * UINT64_C(1000000000)) / qpfFrequency.QuadPart) - ReferenceHeapTimeNs;
+    #else
+        return (uint64_t)(time(NULL) * UINT64_C(1000000000)) - ReferenceHeapTimeNs; // Crude value. Should improve this.
+    #endif
+}
+
+
+static uint32_t GetThreadId()
+{
+    #if defined(_WIN32)
+        return ::GetCurrentThreadId();
+    #else
+        return pthread_self();
+    #endif
+}
+
+
+void Allocator::PushTag(const char* tag)
+{
+    ThreadTagStack* stack = GetThreadTagStack(true);
+
+    if (stack)
+    {
+        uint32_t depth = stack->Depth.load(std::memory_order_relaxed);
+
+        if (depth < MaxTagDepth)
+            stack->Tags[depth] = tag;
+
+        stack->Depth.store(depth + 1, std::memory_order_release); // Release so that EnumerateTagStacks sees the tag.
+    }
+}
+
+void Allocator::PopTag()
+{
+    ThreadTagStack* stack = GetThreadTagStack(false);
+
+    // We do some error checking to make sure we don't crash if this facility is mis-used.
+    if (stack)
+    {
+        uint32_t depth = stack->Depth.load(std::memory_order_relaxed);
+
+        if (depth)
+            stack->Depth.store(depth - 1, std::memory_order_relaxed);
+    }
+}
+
+const char* Allocator::GetTag(const char* defaultTag)
+{
+    ThreadTagStack* stack = GetThreadTagStack(false);
+
+    if (stack)
+    {
+        uint32_t depth = stack->Depth.load(std::memory_order_relaxed);
+
+        if (depth)
+            return stack->Tags[OVR::Alg::Min<uint32_t>(depth, MaxTagDepth) - 1];
+    }
+
+    if (defaultTag)
+        return defaultTag;
+
+    return OVR_ALLOCATOR_UNSPECIFIED_TAG;
+}
+
+void Allocator::EnumerateTagStacks(TagStackCallback callback, uintptr_t context)
+{
+    Lock::Locker locker(&TagStackLock);
+
+    for (ThreadTagStack* stack = TagStackList; stack; stack = stack->Next)
+    {
+        const char* tags[MaxTagDepth];
+        uint32_t depth = OVR::Alg::Min<uint32_t>(stack->Depth.load(std::memory_order_acquire), MaxTagDepth);
+
+        memcpy(tags, stack->Tags, depth * sizeof(const char*));
+        callback(context, stack->ThreadId, tags, depth);
+    }
+}
+
+Allocator::ThreadTagStack* Allocator::GetThreadTagStack(bool create)
+{
+    if (AllocatorTlsTagInstanceId == TagInstanceId)
+        return static_cast<ThreadTagStack*>(AllocatorTlsTagStack);
+
+    if (!TagTlsKeyValid)
+        return nullptr;
+
+    #if defined(_WIN32)
+        ThreadTagStack* stack = static_cast<ThreadTagStack*>(FlsGetValue((DWORD)TagTlsKey));
+    #else
+        ThreadTagStack* stack = static_cast<ThreadTagStack*>(pthread_getspecific((pthread_key_t)TagTlsKey));
+    #endif
+
+    if (!stack)
+    {
+        if (!create)
+            return nullptr;
+
+        void* memory = SysMemAlloc(sizeof(ThreadTagStack));
+        if (!memory)
+            return nullptr;
+
+        stack = new(memory) ThreadTagStack();
+        stack->Owner = this;
+        stack->ThreadId = GetThreadId();
+
+        #if defined(_WIN32)
+            FlsSetValue((DWORD)TagTlsKey, stack);
+        #else
+            pthread_setspecific((pthread_key_t)TagTlsKey, stack);
+        #endif
+
+        Lock::Locker locker(&TagStackLock);
+
+        stack->Next = TagStackList;
+        if (TagStackList)
+            TagStackList->Prev = stack;
+        TagStackList = stack;
+        TagStackCount++;
+    }
+
+    AllocatorTlsTagInstanceId = TagInstanceId;
+    AllocatorTlsTagStack = stack;
+
+    return stack;
+}
+
+void Allocator::OnTagThreadExit(void* tagStack)
+{
+    ThreadTagStack* stack = static_cast<ThreadTagStack*>(tagStack);
+
+    if (stack)
+        stack->Owner->ReleaseThreadTagStack(stack);
+}
+
+void Allocator::ReleaseThreadTagStack(ThreadTagStack* stack)
+{
+    // A tag pushed by this thread from here on (e.g. in other thread-exit callbacks) 
+    // gets a new stack, which the OS calls us back about again.
+    if (AllocatorTlsTagStack == stack)
+    {
+        AllocatorTlsTagInstanceId = 0;
+        AllocatorTlsTagStack = nullptr;
+    }
+
+    {
+        Lock::Locker locker(&TagStackLock);
+
+        if (stack->Prev)
+            stack->Prev->Next = stack->Next;
+        else
+            TagStackList = stack->Next;
+        if (stack->Next)
+            stack->Next->Prev = stack->Prev;
+        TagStackCount--;
+    }
+
+    stack->~ThreadTagStack();
+    SysMemFree(stack, sizeof(ThreadTagStack));
+}
+
+void Allocator::ReleaseTagStacks()
+{
+    // Threads that exit from here on don't call us back. Freeing the slot may itself
+    // call back for threads that still have a stack, which releases those stacks.
+    if (TagTlsKeyValid)
+    {
+        #if defined(_WIN32)
+            FlsFree((DWORD)TagTlsKey);
+        #else
+            pthread_key_delete((pthread_key_t)TagTlsKey);
+        #endif
+        TagTlsKeyValid = false;
+    }
+
+    TagInstanceId = 0; // Invalidates the AllocatorTlsTagStack values of all threads.
+
+    Lock::Locker locker(&TagStackLock);
+
+    while (TagStackList)
+    {
+        ThreadTagStack* stack = TagStackList;
+        TagStackList = stack->Next;
+        stack->~ThreadTagStack();
+        SysMemFree(stack, sizeof(ThreadTagStack));
+    }
+
+    TagStackCount = 0;
+}
+
+
+void Allocator::SetNewBlockMetadata(Allocator* allocator, TrackedAllocEntry& entry, const void* alloc, uint64_t allocSize, uint64_t blockSize, 
+                                const char* file, int line, const char* tag, void** backtraceArray, size_t backtraceArraySize)
+{
+    entry.Alloc = alloc;
+    entry.StackId = allocator->BacktraceTable.Intern(backtraceArray, backtraceArraySize);
+    entry.File = file;
+    entry.Line = line;
+    entry.TimeNs = Allocator::GetCurrentHeapTimeNs();
+    entry.Count = allocator->GetAndUpdateCounter();
+    entry.AllocSize = allocSize;
+    entry.BlockSize = blockSize;
+    entry.Tag = tag;
+    entry.ThreadId = GetThreadId();
+    OVR::Thread::GetCurrentThreadName(entry.ThreadName, sizeof(entry.ThreadName)); // Currently works on Windows only for threads that were named via our OVR thread naming API.
+}
+
+
+void Allocator::GetEntryMetadata(const TrackedAllocEntry& entry, AllocMetadata& amd) const
+{
+    void* const* frames;
+    size_t frameCount = BacktraceTable.GetFrames(entry.StackId, frames);
+
+    amd.Alloc = entry.Alloc;
+    amd.Backtrace.assign(frames, frames + frameCount);
+    amd.BacktraceSymbols.clear(); // This is only set when needed.
+    amd.File = entry.File;
+    amd.Line = entry.Line;
+    amd.TimeNs = entry.TimeNs;
+    amd.Count = entry.Count;
+    amd.AllocSize = entry.AllocSize;
+    amd.BlockSize = entry.BlockSize;
+    amd.Tag = entry.Tag;
+    amd.ThreadId = entry.ThreadId;
+    OVR_strlcpy(amd.ThreadName, entry.ThreadName, sizeof(amd.ThreadName));
+}
+
+
+// The calling thread's countdown to the next allocation TrackAlloc records when sampling, 
+// and the state of the random generator that picks the countdown.
+static OVR_THREAD_LOCAL uint32_t TrackSampleCountdown;
+static OVR_THREAD_LOCAL uint32_t TrackSampleRandom;
+
+void Allocator::TrackAlloc(const void* p, size_t size, const char* tag, const char* file, int line)
+{
+    if (p && Profiler.IsEnabled() && Profiler.ShouldSample(size))
+        Profiler.RecordSample(p, size, (tag ? tag : GetTag()));
+
+    if (p && BudgetScopeCurrent)
+        AllocationBudgetScope::OnAlloc(p, size, (tag ? tag : GetTag()), file, line);
+
+    if (p && TrackingEnabled) // To consider: Make TrackingEnabled an atomic.
+    {
+        if (TrackingSampleRate > 1) // If sampling...
+        {
+            if (TrackSampleCountdown > 1)
+            {
+                --TrackSampleCountdown;
+                return;
+            }
+
+            // Choose the next sample at random within [1, 2 * TrackingSampleRate - 1]. That averages
+            // one in TrackingSampleRate, but can't lock onto a periodic allocation pattern.
+            uint32_t r = (TrackSampleRandom ? TrackSampleRandom : (GetThreadId() | 1)); // xorshift32
+            r ^= (r << 13);
+            r ^= (r >> 17);
+            r ^= (r << 5);
+            TrackSampleRandom = r;
+            TrackSampleCountdown = 1 + (r % ((2 * TrackingSampleRate) - 1));
+        }
+
+        auto AlignSizeUp = [](size_t value, size_t alignment) -> size_t { // To do: Have a centralized version of this.
+            return ((value + (alignment - 1)) & ~(alignment - 1));
+        };
+
+        #if defined(_WIN64)
+            void* addressArray[128];
+            size_t frameCount = Symbols.GetBacktrace(addressArray, OVR_ARRAY_COUNT(addressArray), 2);
+        #else
+            // Currently 32 bit backtrace reading is too slow. We can fix it by writing our own version
+            // that reads the stack frames, but it's not a high priority since we work mostly with 64 bit.
+            void* addressArray[1] = { nullptr };
+            size_t frameCount = 0;
+        #endif
+
+        if (!tag)
+            tag = GetTag();
+
+        TrackedAllocEntry entry;
+        SetNewBlockMetadata(this, entry, p, size, 
+                            AlignSizeUp(size, 8),       // This is only a default value, and may be under-represented at time time, until we can have that passed into this function as well.
+                            file, line, tag, addressArray, frameCount);
+
+        if (TrackingEnabled) // To consider: Do we really need to do this?
+        {
+            AllocationTable.Insert(entry);
+        }
+    }
+}
+
+
+bool Allocator::UntrackAlloc(const void* p)
+{
+    if (p && Profiler.IsInitialized())
+        Profiler.OnFree(p);
+
+    if (!TrackingEnabled)
+        return true; // Just assume the pointer is valid.
+
+    if (p)
+    {
+        if (AllocationTable.Remove(p))
+            return true;
+
+        return (TrackingSampleRate > 1); // An allocation that wasn't sampled isn't in the table, so assume it's valid.
+    }
+
+    return false;
+}
+
+
+void Allocator::UntrackRange(const void* begin, const void* end)
+{
+    if (TrackingEnabled)
+    {
+        AllocationTable.RemoveRange(begin, end);
+    }
+}
+
+
+void Allocator::UntrackPointer(const void* p)
+{
+    if (TrackingEnabled && p)
+    {
+        AllocationTable.Remove(p);
+    }
+}
+
+
+bool Allocator::IsAllocTracked(const void* p)
+{
+    if (!TrackingEnabled)
+        return true; // Just assume the pointer is valid.
+
+    if (p)
+    {
+        return (AllocationTable.Find(p, nullptr) || (TrackingSampleRate > 1));
+    }
+
+    return false;
+}
+
+
+bool Allocator::GetAllocMetadata(const void* p, AllocMetadata& metadata)
+{
+    TrackedAllocEntry entry;
+
+    if (AllocationTable.Find(p, &entry))
+    {
+        GetEntryMetadata(entry, metadata);
+        return true;
+    }
+
+    return false;
+}
+
+
+const char* Allocator::GetAllocTag(const void* p)
+{
+    TrackedAllocEntry entry;
+
+    if (AllocationTable.Find(p, &entry))
+        return entry.Tag;
+
+    return nullptr;
+}
+
+
+bool Allocator::EnableAllocationProfiler(uint64_t sampleIntervalBytes)
+{
+    Lock::Locker locker(&TrackLock);
+
+    return Profiler.Init(sampleIntervalBytes);
+}
+
+
+void Allocator::DisableAllocationProfiler()
+{
+    Profiler.SetEnabled(false);
+}
+
+
+bool Allocator::SetTrackingSampleRate(uint32_t sampleRate)
+{
+    bool result = false;
+
+    if (!Heap) // If we haven't initialized yet...
+    {
+        TrackingSampleRate = OVR::Alg::Clamp<uint32_t>(sampleRate, 1, 0x7fffffff);
+        result = true;
+    }
+
+    return result;
+}
+
+
+bool Allocator::EnableTracking(bool enable)
+{
+    bool result = false;
+
+    // We may need to deal with the case that this is called when we 
+    // have already started memory allocation activity. Currently disabled.
+    Lock::Locker locker(&TrackLock);
+
+    if (!Heap) // If we haven't initialized yet...
+    {
+        TrackingEnabled = enable;
+        result = true;
+    }
+    else if(TrackingEnabled != enable) // if there is a change being requested...
+    {
+        // Currently we support the enabling and disabling of tracking after initialization
+        // only if we aren't using the page debug heap. We may be able to work around that
+        // in the future if needed. Tracking is enabled by default before initialization when 
+        // the page debug heap is enabled, so it's only a matter here of attempting to 
+        // disable tracking after it's been enabled, in practice.
+        if (!DebugPageHeapEnabled)  
+        {
+            if(!enable) // If we are disabling tracking...
+            {
+                TrackingEnabled = false;
+                AllocationTable.Clear(); // Clear all the tracking we've done so far.
+            }
+            else
+            {
+                // The backtrace table is kept until Shutdown, as other threads may be reading it. It's
+                // initialized before tracking is turned on, so the first tracked allocation can use it.
+                BacktraceTable.Init();
+                TrackingEnabled = true;
+            }
+
+            result = true;
+        } // Else don't allow the change.
+    }
+    else //Else there's no change.
+    {
+        result = true;
+    }
+
+    return result;
+}
+
+
+bool Allocator::EnableDebugPageHeap(bool enable)
+{
+    bool result = false;
+
+    if (!Heap) // If we haven't initialized yet...
+    {
+        DebugPageHeapEnabled = enable;
+        result = true;
+    }
+
+    return result;
+}
+
+
+bool Allocator::EnablePoolHeap(bool enable)
+{
+    bool result = false;
+
+    if (!Heap) // If we haven't initialized yet...
+    {
+        PoolHeapEnabled = enable;
+        result = true;
+    }
+
+    return result;
+}
+
+
+bool Allocator::SetHeap(OVR::Heap* heap)
+{
+    bool result = false;
+
+    if (!Heap) // If we haven't initialized yet...
+    {
+        ExternalHeap = heap;
+        result = true;
+    }
+
+    return result;
+}
+
+
+bool Allocator::EnableMallocRedirect()
+{
+    bool result = false;
+
+    if (!Heap)
+    {
+        MallocRedirectEnabled = true;
+        result = true;
+    }
+
+    return result;
+}
+
+bool Allocator::IsHeapTrackingRegKeyEnabled(bool defaultValue)
+{
+    // "HKEY_LOCAL_MACHINE\SOFTWARE\Oculus\HeapTrackingEnabled", REG_DWORD of 0 or 1.
+    return OVR::Util::GetRegistryBoolW(L"Software\\Oculus", L"HeapTrackingEnabled", defaultValue);
+}
+
+const AllocMetadata* Allocator::IterateHeapBegin()
+{
+    TrackLock.DoLock();         // Will be unlocked in IterateHeapEnd().
+    AllocationTable.LockAll();  // "
+
+    // We have a problem in the case that a single thread calls IterateHeapBegin twice 
+    // before calling IterateHeapEnd. It can be resolved the application calling IterateHeapEnd 
+    // twice as well, but do we want to support that usage? It's probably easier to just disallow it.
+    TrackIteratorShard = (TrackingEnabled ? 0 : TrackedAllocTable::ShardCount);
+    TrackIteratorSlot  = 0;
+
+    return IterateHeapNext();
+}
+
+const AllocMetadata* Allocator::IterateHeapNext()
+{
+    const TrackedAllocEntry* entry = AllocationTable.GetNext(TrackIteratorShard, TrackIteratorSlot);
+
+    if (!entry)
+        return nullptr;
+
+    GetEntryMetadata(*entry, TrackIteratorMetadata);
+    return &TrackIteratorMetadata;
+}
+
+void Allocator::IterateHeapEnd()
+{
+    AllocationTable.UnlockAll();
+    TrackLock.Unlock();
+}
+
+size_t Allocator::SnapshotTrackedAllocations(TrackedAllocEntryVector& entries)
+{
+    entries.clear();
+
+    Lock::Locker locker(&TrackLock); // Allocation doesn't use TrackLock. This just keeps tracking from being disabled and cleared mid-copy.
+
+    if (TrackingEnabled)
+    {
+        entries.reserve(AllocationTable.GetCount() + (AllocationTable.GetCount() / 8));
+        AllocationTable.Snapshot(entries);
+    }
+
+    return entries.size();
+}
+
+
+size_t Allocator::DescribeAllocation(const AllocMetadata* amd, int amdFlags, char* description, size_t descriptionCapacity, size_t appendedNewlineCount)
+{
+    SysAllocatedString descriptionString;
+    char buffer[2048];
+
+    if (amdFlags & AMFAlloc)
+    {
+        snprintf(buffer, OVR_ARRAY_COUNT(buffer), "0x%p", amd->Alloc);
+        descriptionString += buffer;
+    }
+
+    if (amdFlags & AMFAllocSize)
+    {
+        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", size: %llu", amd->AllocSize);
+        descriptionString += buffer;
+    }
+
+    if (amdFlags & AMFBlockSize)
+    {
+        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", block size: %llu", amd->BlockSize);
+        descriptionString += buffer;
+    }
+
+    if (amdFlags & AMFTime)
+    {
+        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", time: %llus", amd->TimeNs / UINT64_C(1000000000));
+        descriptionString += buffer;
+    }
+
+    if (amdFlags & AMFCount)
+    {
+        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", #: %llu", amd->Count);
+        descriptionString += buffer;
+    }
+
+    if (amdFlags & AMFTag)
+    {
+        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", tag: %s", amd->Tag ? amd->Tag : OVR_ALLOCATOR_UNSPECIFIED_TAG);
+        descriptionString += buffer;
+    }
+
+    if (amdFlags & AMFThreadId)
+    {
+        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", tid: %u", amd->ThreadId);
+        descriptionString += buffer;
+    }
+
+    if (amdFlags & AMFThreadName)
+    {
+        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", thread name: %s", amd->ThreadName);
+        descriptionString += buffer;
+    }
+
+    if ((amdFlags & AMFFile) || (amdFlags & AMFLine))
+    {
+        snprintf(buffer, OVR_ARRAY_COUNT(buffer), ", file/line: %s(%d)", amd->File, amd->Line);
+        descriptionString += buffer;
+    }
+
+    if (amdFlags & (AMFBacktrace | AMFBacktraceSymbols))
+    {
+        if (!descriptionString.empty()) // If anything was written above...
+            descriptionString += "\n";
+
+        for (size_t j = 0, jEnd = amd->Backtrace.size(); (j < jEnd) && (descriptionString.length() < descriptionCapacity); ++j)
+        {
+            const bool shouldLookupSymbols = (SymbolLookupEnabled && ((amdFlags & AMFBacktraceSymbols) != 0));
+            SymbolInfo symbolInfo;
+
+            if (shouldLookupSymbols && Symbols.LookupSymbol((uint64_t)amd->Backtrace[j], symbolInfo) && (symbolInfo.filePath[0] || symbolInfo.function[0]))
+            {
+                if (symbolInfo.filePath[0])
+                    snprintf(buffer, OVR_ARRAY_COUNT(buffer), "%2u: %s(%d): %s\n", (unsigned)j, symbolInfo.filePath, symbolInfo.fileLineNumber, symbolInfo.function[0] ? symbolInfo.function : "(unknown function)");
+                else
+                    snprintf(buffer, OVR_ARRAY_COUNT(buffer), "%2u: 0x%p (unknown source file): %s\n", (unsigned)j, amd->Backtrace[j], symbolInfo.function);
+            }
+            else
+            {
+                snprintf(buffer, OVR_ARRAY_COUNT(buffer), "%2u: 0x%p (symbols unavailable)\n", (unsigned)j, amd->Backtrace[j]);
+            }
+
+            descriptionString += buffer;
+        }
+
+        descriptionString.erase(descriptionString.size() - 1); // Remove the last newline. We may add back below.
+    }
+
+    for(size_t i = 0; i < appendedNewlineCount; ++i)
+        descriptionString += '\n';
+
+    return OVR_strlcpy(description, descriptionString.c_str(), descriptionCapacity);
+}
+
+
+// Symbolized text for each distinct return address of a leak report. A report usually has 
+// thousands of allocations from the same few call sites, so each address is looked up once 
+// here rather than once per allocation and frame, in batches. The lookups are made on the 
+// calling thread: TraceTrackedAllocations runs from Allocator::Shutdown, which can be under 
+// the loader lock (e.g. from a static destructor), where joining a worker thread deadlocks.
+class BacktraceSymbolCache
+{
+public:
+    // Adds the addresses of a backtrace. Must be called before Resolve.
+    void AddFrames(void* const* frames, size_t frameCount)
+        { Addresses.insert(Addresses.end(), frames, frames + frameCount); }
+
+    // Formats the added addresses, with their symbols if symbols is non-null.
+    void Resolve(SymbolLookup* symbols);
+
+    // Returns the text for an address that was added before Resolve, or nullptr if it wasn't. 
+    const char* GetText(const void* address) const;
+
+protected:
+    static const size_t BatchSize = 32;
+
+    typedef std::vector<const void*, StdAllocatorSysMem<const void*>> AddressVector;
+
+    AddressVector            Addresses;     // Sorted and unique after Resolve.
+    SysAllocatedStringVector Texts;         // Texts[i] is the text for Addresses[i].
+};
+
+
+void BacktraceSymbolCache::Resolve(SymbolLookup* symbols)
+{
+    std::sort(Addresses.begin(), Addresses.end());
+    Addresses.erase(std::unique(Addresses.begin(), Addresses.end()), Addresses.end());
+    Texts.clear();
+    Texts.resize(Addresses.size());
+
+    // SymbolInfo is a few KB, so the batch doesn't go on the stack.
+    std::vector<SymbolInfo, StdAllocatorSysMem<SymbolInfo>> symbolInfoArray(symbols ? BatchSize : 0);
+    uint64_t addressArray[BatchSize];
+    char     buffer[2048];
+
+    for (size_t begin = 0; begin < Addresses.size(); begin += BatchSize)
+    {
+        const size_t count = std::min(BatchSize, Addresses.size() - begin);
+
+        for (size_t i = 0; i < count; ++i)
+            addressArray[i] = (uint64_t)(uintptr_t)Addresses[begin + i];
+
+        const bool found = (symbols && symbols->LookupSymbols(addressArray, symbolInfoArray.data(), count));
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const SymbolInfo* symbolInfo = (found ? &symbolInfoArray[i] : nullptr);
+
+            if (symbolInfo && symbolInfo->filePath[0])
+                snprintf(buffer, OVR_ARRAY_COUNT(buffer), "%s(%d): %s", symbolInfo->filePath, symbolInfo->fileLineNumber, symbolInfo->function[0] ? symbolInfo->function : "(unknown function)");
+            else if (symbolInfo && symbolInfo->function[0])
+                snprintf(buffer, OVR_ARRAY_COUNT(buffer), "0x%p (unknown source file): %s", Addresses[begin + i], symbolInfo->function);
+            else
+                snprintf(buffer, OVR_ARRAY_COUNT(buffer), "0x%p (symbols unavailable)", Addresses[begin + i]);
+
+            Texts[begin + i] = buffer;
+        }
+    }
+}
+
+
+const char* BacktraceSymbolCache::GetText(const void* address) const
+{
+    AddressVector::const_iterator it = std::lower_bound(Addresses.begin(), Addresses.end(), address);
+
+    if ((it == Addresses.end()) || (*it != address))
+        return nullptr;
+
+    return Texts[it - Addresses.begin()].c_str();
+}
+
+
+size_t Allocator::TraceTrackedAllocations(AllocationTraceCallback callback, uintptr_t context)
+{
+    const bool symbolLookupWasInitialized = SymbolLookup::IsInitialized();
+    const bool symbolLookupAvailable = SymbolLookup::Initialize();
+
+    if(!symbolLookupWasInitialized) // If SymbolLookup::Initialize was the first time being initialized, we need to refresh the Symbols view of modules, etc.
+        Symbols.Refresh();
+
+    // Work from a copy of the tracking records, so that LibOVR isn't stalled on the tracking 
+    // locks while we symbolize if we're dumping while it's running.
+    TrackedAllocEntryVector entries;
+    const size_t measuredLeakCount = SnapshotTrackedAllocations(entries);
+    size_t       reportedLeakCount = 0;      // = measuredLeakCount minus leaks we ignore (e.g. C++ runtime concurrency leaks).
+    size_t       reportedStackCount = 0;
+
+    // Group the leaks by backtrace. Leaks without a backtrace are grouped by tag instead.
+    std::sort(entries.begin(), entries.end(), 
+        [](const TrackedAllocEntry& a, const TrackedAllocEntry& b)
+        {
+            if (a.StackId != b.StackId)
+                return (a.StackId < b.StackId);
+            return ((a.StackId == 0) && ((uintptr_t)a.Tag < (uintptr_t)b.Tag));
+        });
+
+    struct LeakGroup
+    {
+        size_t   Begin;    // Range of entries.
+        size_t   End;
+        uint64_t Bytes;
+    };
+
+    std::vector<LeakGroup, StdAllocatorSysMem<LeakGroup>> groups;
+    BacktraceSymbolCache symbolCache;
+
+    for (size_t i = 0; i < entries.size(); i = groups.back().End)
+    {
+        LeakGroup group = { i, i, 0 };
+
+        for (; (group.End < entries.size()) && (entries[group.End].StackId == entries[i].StackId) && 
+                (entries[i].StackId || (entries[group.End].Tag == entries[i].Tag)); ++group.End)
+            group.Bytes += entries[group.End].AllocSize;
+
+        void* const* frames;
+        size_t frameCount = BacktraceTable.GetFrames(entries[i].StackId, frames);
+        symbolCache.AddFrames(frames, frameCount);
+
+        groups.push_back(group);
+    }
+
+    symbolCache.Resolve((SymbolLookupEnabled && symbolLookupAvailable) ? &Symbols : nullptr);
+
+    std::sort(groups.begin(), groups.end(), [](const LeakGroup& a, const LeakGroup& b) { return (a.Bytes > b.Bytes); }); // Largest first.
+
+    // Print out each unique backtrace, but filtering away some that we ignore.
+    SysAllocatedString leakReport;
+
+    for (const LeakGroup& group : groups)
+    {
+        const TrackedAllocEntry& entry = entries[group.Begin];
+        const size_t count = (group.End - group.Begin);
+
+        char line[256];
+        snprintf(line, OVR_ARRAY_COUNT(line), "\ncount: %llu, total size: %llu, tag: %.64s, first: 0x%p, size: %u\n", 
+                    (uint64_t)count, group.Bytes, entry.Tag ? entry.Tag : "none", entry.Alloc, (unsigned)entry.AllocSize); // Limit the tag length so that this can't exhaust the line buffer.
+        leakReport = line;
+
+        void* const* frames;
+        size_t frameCount = BacktraceTable.GetFrames(entry.StackId, frames);
+
+        if (frameCount == 0)
+            leakReport += "(backtrace unavailable)\n";
+        else
+        {
+            for (size_t j = 0; j < frameCount; ++j)
+            {
+                snprintf(line, OVR_ARRAY_COUNT(line), "%2u: ", (unsigned)j);
+                leakReport += line;
+                leakReport += symbolCache.GetText(frames[j]);
+                leakReport += '\n';
+            }
+
+            // There are some leaks that aren't real because they are allocated by the Standard Library at runtime but 
+            // aren't freed until shutdown. We don't want to report those, and so we filter them out here.
+            const char* ignoredPhrases[] = { "Concurrency::details" /*add any additional strings here*/ };
+
+            for(size_t j = 0; j < OVR_ARRAY_COUNT(ignoredPhrases); ++j)
+            {
+                if (strstr(leakReport.c_str(), ignoredPhrases[j])) // If we should ignore this leak...
+                {
+                    leakReport.clear();
+                } 
+            }
+        }
+
+        if (!leakReport.empty()) // If we are to report this as a bonafide leak...
+        {
+            reportedLeakCount += count;
+            ++reportedStackCount;
+
+            // We cannot use normal logging system here because it will allocate more memory!
+            if (callback)
+                callback(context, leakReport.c_str());
+            else
+                ::OutputDebugStringA(leakReport.c_str());
+        }
+    }
+
+    char summaryBuffer[160];
+    snprintf(summaryBuffer, OVR_ARRAY_COUNT(summaryBuffer), "Measured leak count: %llu, Reported leak count: %llu, Reported backtrace count: %llu\n", 
+                (uint64_t)measuredLeakCount, (uint64_t)reportedLeakCount, (uint64_t)reportedStackCount);
+
+    if (callback)
+        callback(context, summaryBuffer);
+    else
+        ::OutputDebugStringA(summaryBuffer);
+
+    if(symbolLookupAvailable)
+        SymbolLookup::Shutdown();
+
+    return reportedLeakCount;
+}
+
+
+
+//------------------------------------------------------------------------
+// ***** HeapIterationFilterRPN
+//
+
+HeapIterationFilterRPN::HeapIterationFilterRPN()
+  : AllocatorInstance(nullptr), Filter(nullptr), Instructions{}, InstructionCount(0), CurrentHeapTimeNs(Allocator::GetCurrentHeapTimeNs()),
+    Snapshot(), MatchFlags(), MatchCount(0), SnapshotIndex(0), CurrentMetadata()
+{
+}
+
+bool HeapIterationFilterRPN::SetFilter(Allocator* allocator, const char* filter)
+{
+    AllocatorInstance = allocator;
+    Filter = filter;
+    return Compile(filter);    
+}
+
+const AllocMetadata* HeapIterationFilterRPN::IterateHeapBegin()
+{
+    const size_t count = AllocatorInstance->SnapshotTrackedAllocations(Snapshot);
+
+    MatchFlags.assign(count, 0);
+
+    // Evaluation is independent per entry, so large snapshots are split into contiguous ranges 
+    // across threads. No heap lock is held here, so the workers are free to allocate.
+    const size_t minEntriesPerThread = 32768;
+    size_t threadCount = std::thread::hardware_concurrency();
+
+    if (threadCount > (count / minEntriesPerThread))
+        threadCount = (count / minEntriesPerThread);
+
+    if (threadCount <= 1)
+        EvaluateRange(0, count);
+    else
+    {
+        const size_t chunkSize = (count / threadCount);
+        std::vector<std::thread> workers;
+        workers.reserve(threadCount - 1);
+
+        for (size_t i = 1; i < threadCount; i++)
+        {
+            const size_t begin = (chunkSize * i);
+            const size_t end   = (i + 1 < threadCount) ? (begin + chunkSize) : count;
+
+            workers.emplace_back([=]() { EvaluateRange(begin, end); });
+        }
+
+        EvaluateRange(0, chunkSize); // The calling thread does the first chunk.
+
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    MatchCount = 0;
+    for (size_t i = 0; i < count; ++i)
+        MatchCount += MatchFlags[i];
+
+    SnapshotIndex = 0;
+    return IterateHeapNext();
+}
+
+const AllocMetadata* HeapIterationFilterRPN::IterateHeapNext()
+{
+    while ((SnapshotIndex < Snapshot.size()) && !MatchFlags[SnapshotIndex])
+        ++SnapshotIndex;
+
+    if (SnapshotIndex >= Snapshot.size())
+        return nullptr;
+
+    AllocatorInstance->GetEntryMetadata(Snapshot[SnapshotIndex++], CurrentMetadata);
+    return &CurrentMetadata;
+}
+
+void HeapIterationFilterRPN::IterateHeapEnd()
+{
+    // Release the snapshot's memory, which for a large heap can be considerable.
+    TrackedAllocEntryVector().swap(Snapshot);
+    MatchFlagVector().swap(MatchFlags);
+    SnapshotIndex = 0;
+}
+
+
+bool HeapIterationFilterRPN::Compile(const char* filter)
+{
+    bool success = true; // To consider: We can report syntax errors and associated line numbers.
+
+    static_assert(std::is_standard_layout<Instruction>::value, "Instructions is presumed to be a POD here.");
+    memset(Instructions, 0, sizeof(Instructions));
+
+    for(size_t instructionCount = 0; success && (instructionCount < OVR_ARRAY_COUNT(Instructions)); ++instructionCount) // While reading each line until the end of the text...
+    {
+        while(isspace(*filter)) // Move past whitespace. Currently we need this only because of our isOperandLine check below.
+            ++filter;
+
+        Instruction instruction{};
+        char        tempDataType[12], tempCompare[8], tempComparand[256], tempOperation[8], *nextChar;
+        size_t      i;
+        bool        isOperandLine = _strnicmp(filter, "and", 3) && _strnicmp(filter, "or", 2); // To consider: Find a cleaner way to discern which of the two kinds of lines this is (operand or operation).
+
+        if ((*filter == '\r') || (*filter == '\n') || (*filter == '/'))
+        {
+            // Ignore lines that are empty or begin with / 
+        }
+        else if (isOperandLine && (sscanf_s(filter, "%11s %7s %255[^;\r\n]s", tempDataType,  (unsigned)sizeof(tempDataType),
+                                                                          tempCompare,   (unsigned)sizeof(tempCompare),
+                                                                          tempComparand, (unsigned)sizeof(tempComparand)) == 3)) // If this line looks like an operand (e.g. AllocSize > 100)...
+        {
+            static_assert(sizeof(tempComparand) == 256, "The format string here assumes 256. Fix the format string and this assert if tempComparand changes.");
+ 
+            struct OperandTypePair{ const char* str; AllocMetadataFlags value; } 
+            operandTypeMap[] = { {"File", AMFFile}, {"Line", AMFLine}, {"Time", AMFTime}, {"Count", AMFCount}, {"Size", AMFAllocSize}, {"AllocSize", AMFAllocSize}, {"BlockSize", AMFBlockSize}, {"Tag", AMFTag}, {"ThreadId", AMFThreadId}, {"ThreadName", AMFThreadName} };
+
+            // Read the operand (e.g. size)
+            for(i = 0; i < OVR_ARRAY_COUNT(operandTypeMap) && (instruction.operand.metadataType == AMFNone); ++i)
+            {
+                if(OVR_stricmp(tempDataType, operandTypeMap[i].str) == 0)
+                    instruction.operand.metadataType = operandTypeMap[i].value;
+            }
+            success = success && (instruction.operand.metadataType != AMFNone); // Successful if a match was found.
+
+            // Read the compare type (e.g. >=)
+            struct CompareTypePair{ const char* str; Comparison value; } 
+            compareTypeMap[] = { {"==", CmpE}, {"<", CmpL}, {"<=", CmpLE}, {">", CmpG}, {">=", CmpGE}, {"has", CmpHas} };
+
+            for(i = 0; i < OVR_ARRAY_COUNT(compareTypeMap) && (instruction.operand.comparison == CmpNone); ++i)
+            {
+                if(OVR_stricmp(tempCompare, compareTypeMap[i].str) == 0)
+                    instruction.operand.comparison = compareTypeMap[i].value;
+            }
+            success = success && (instruction.operand.comparison != CmpNone); // Successful if a match was found.
+
+            // Read the comparand (e.g. 4096)
+            instruction.operand.numValue = strtoll(tempComparand, &nextChar, 10);    // Just read it as both types here; we'll
+            strcpy(instruction.operand.strValue, tempComparand);                     // decide at execution time which to use.
+
+            if (instruction.operand.metadataType == AMFTime)
+            {
+                if (*nextChar == 's')                                                                       // If the filter is specifying time in seconds instead of nanoseconds...
+                    instruction.operand.numValue *= 1000000000;                                             //     convert numValue from seconds to nanoseconds (which is what we internally use).
+                if (instruction.operand.numValue < 0)                                                       // Handle the case that a negative time was passed, which
+                    instruction.operand.numValue += CurrentHeapTimeNs;                                      //     means to refer to time relative to current time.
+            }
+            else if ((instruction.operand.metadataType == AMFCount) && (instruction.operand.numValue < 0))  // Handle the case that a negative count was passed, which
+                instruction.operand.numValue += AllocatorInstance->GetCounter();                            //     means to refer to the last N allocations.
+        }
+        else if (sscanf_s(filter, "%7[^;\r\n]s", tempOperation, (unsigned)sizeof(tempOperation)) == 1) // If this line looks like an operation (e.g. And or Or).
+        {
+            if (OVR_stricmp(tempOperation, "and") == 0)
+                instruction.operation = OpAnd;
+            else if(OVR_stricmp(tempOperation, "or") == 0)
+                instruction.operation = OpOr;
+            else
+                success = false;
+        }
+        else
+            success = false;
+
+        if (success)
+        {
+            if (instructionCount < OVR_ARRAY_COUNT(Instructions))
+                Instructions[instructionCount] = instruction;
+            else
+                success = false; // Out of space.
+        }
+
+        // Move to the start of the next statement (delimited by ; or \n)
+        filter = strpbrk(filter, ";\n");
+        if (filter)
+            filter++;
+        else
+            break;
+    }
+
+    // Find the end of the program and lowercase the string comparands, so that string 
+    // operands can be evaluated without case-folding the comparand for every allocation.
+    for (InstructionCount = 0; (InstructionCount < OVR_ARRAY_COUNT(Instructions)) && 
+                               ((Instructions[InstructionCount].operation != OpNone) || (Instructions[InstructionCount].operand.comparison != CmpNone)); ++InstructionCount)
+    {
+        Operand& operand = Instructions[InstructionCount].operand;
+
+        for (operand.strLength = 0; operand.strValue[operand.strLength]; ++operand.strLength)
+            operand.strValue[operand.strLength] = (char)OVR_tolower((unsigned char)operand.strValue[operand.strLength]);
+    }
+
+    return success;
+}
+
+// Case-insensitive == or has comparison of str against the (already lowercased) comparand.
+bool HeapIterationFilterRPN::MatchString(const Operand& operand, const char* str)
+{
+    const char* comparand = operand.strValue;
+
+    if (!str)
+        str = "";
+
+    if (operand.comparison == CmpE)
+    {
+        for (; *comparand; ++str, ++comparand)
+        {
+            if (OVR_tolower((unsigned char)*str) != *comparand) // Also stops at the end of str, as *comparand is non-zero.
+                return false;
+        }
+
+        return (*str == '\0');
+    }
+
+    if (operand.comparison == CmpHas)
+    {
+        if (operand.strLength == 0)
+            return true;
+
+        for (; *str; ++str)
+        {
+            if (OVR_tolower((unsigned char)*str) == comparand[0])
+            {
+                size_t i = 1;
+
+                while ((i < operand.strLength) && (OVR_tolower((unsigned char)str[i]) == comparand[i]))
+                    ++i;
+
+                if (i == operand.strLength)
+                    return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+// Evaluates an individual operand, such as (AllocSize < 32).
+bool HeapIterationFilterRPN::EvaluateOperand(const Operand& operand, const TrackedAllocEntry& entry, StringMatchCache& cache) const
+{
+    switch ((int)operand.metadataType) // Cast to int in order to avoid compiler warnings about unhandled enumerants.
+    {
+        case AMFFile: case AMFTag: // String-based operands whose strings are nearly always literals, so we memoize by address.
+        {
+            const char*  p    = ((operand.metadataType == AMFFile) ? entry.File : entry.Tag);
+            const size_t slot = (size_t)(((uintptr_t)p >> 3) ^ ((uintptr_t)p >> 11)) & (OVR_ARRAY_COUNT(cache.Key) - 1);
+
+            if (!p || (cache.Key[slot] != p))
+            {
+                cache.Key[slot]    = p;
+                cache.Result[slot] = MatchString(operand, p);
+            }
+
+            return cache.Result[slot];
+        }
+
+        case AMFThreadName:
+            return MatchString(operand, entry.ThreadName);
+    
+        case AMFLine: case AMFTime: case AMFCount: case AMFAllocSize: case AMFBlockSize: case AMFThreadId: // Integer-based operands
+        {
+            int64_t n;
+
+            switch ((int)operand.metadataType)
+            {
+                default:
+                case AMFLine:      n = entry.Line;                break;
+                case AMFTime:      n = (int64_t)entry.TimeNs;    break;
+                case AMFCount:     n = (int64_t)entry.Count;     break;
+                case AMFAllocSize: n = (int64_t)entry.AllocSize; break;
+                case AMFBlockSize: n = (int64_t)entry.BlockSize; break;
+                case AMFThreadId:  n = entry.ThreadId;            break;
+            }
+
+            switch ((int)operand.comparison)
+            {
+                case CmpE:  return (n == operand.numValue);
+                case CmpL:  return (n <  operand.numValue);
+                case CmpLE: return (n <= operand.numValue);
+                case CmpG:  return (n >  operand.numValue);
+                case CmpGE: return (n >= operand.numValue);
+            }
+        }
+    }
+
+    return false;
+}
+
+bool HeapIterationFilterRPN::Evaluate(const TrackedAllocEntry& entry, StringMatchCache* caches) const
+{
+    // We execute an RPN (a.k.a. postfix) stack here. Because our language here involves 
+    // only logical operations, our stack need be only a stack of bool, which we keep as 
+    // the bits of an integer with bit 0 as the top. It can't overflow, as there are at 
+    // most 32 instructions.
+    uint64_t stack = 1; // By default the state is true. An empty instruction set evaluates as true.
+
+    for (size_t i = 0; i < InstructionCount; ++i)
+    {
+        const Instruction& instruction = Instructions[i];
+
+        if (instruction.operation == OpAnd)
+            stack = ((stack >> 2) << 1) | (stack & (stack >> 1) & 1);
+        else if (instruction.operation == OpOr)
+            stack = ((stack >> 2) << 1) | ((stack | (stack >> 1)) & 1);
+        else // Else this is an operand push.
+            stack = (stack << 1) | (EvaluateOperand(instruction.operand, entry, caches[i]) ? 1 : 0);
+    }
+
+    return ((stack & 1) != 0);
+}
+
+void HeapIterationFilterRPN::EvaluateRange(size_t begin, size_t end)
+{
+    StringMatchCache caches[OVR_ARRAY_COUNT(Instructions)];
+    memset(caches, 0, sizeof(caches));
+
+    for (size_t i = begin; i < end; ++i)
+        MatchFlags[i] = (Evaluate(Snapshot[i], caches) ? 1 : 0);
+}
+
+
+void HeapIterationFilterRPN::TraceTrackedAllocations(Allocator* allocator, const char* filter, Allocator::AllocationTraceCallback callback, uintptr_t context)
+{
+    OVR::HeapIterationFilterRPN hifRPN;
+
+    hifRPN.SetFilter(allocator, filter);
+
+    for(const OVR::AllocMetadata* amd = hifRPN.IterateHeapBegin(); amd; amd = hifRPN.IterateHeapNext())
+    {
+        char description[16384];
+        allocator->DescribeAllocation(amd, 0xffff, description, sizeof(description), 0);
+        callback(context, description);
+    }
+
+    hifRPN.IterateHeapEnd();
+}
+
+
+
+//------------------------------------------------------------------------
+// ***** DefaultHeap
+//
+
+bool DefaultHeap::Init()
+{
+    // Nothing to do.
+    return true;
+}
+
+void DefaultHeap::Shutdown()
+{
+    // Nothing to do.
+}
+
+
+void* DefaultHeap::Alloc(size_t size)
+{
+    void* p = malloc(size);
+
+    return p;
+}
+
+
+void* DefaultHeap::AllocAligned(size_t size, size_t align)
+{
+    #if defined(_MSC_VER)
+        void* p = _aligned_malloc(size, align);
+    #else
+        void* p = memalign(align, size);
+    #endif
+
+    return p;
+}
+
+
+size_t DefaultHeap::GetAllocSize(const void* p) const
+{
+    #if defined(_MSC_VER)
+        return _msize(const_cast<void*>(p));
+    #else
+        return malloc_usable_size(p);
+    #endif
+}
+
+
+size_t DefaultHeap::GetAllocAlignedSize(const void* p, size_t align) const
+{
+    #if defined(_MSC_VER)
+        return _aligned_msize(const_cast<void*>(p), align, 0);
+    #else
+        OVR_UNUSED(align);
+        return malloc_usable_size(p);
+    #endif
+}
+
+
+void DefaultHeap::Free(void *p)
+{
+    free(p);
+}
+
+void DefaultHeap::FreeAligned(void* p)
+{
+    #if defined(_MSC_VER)
+        _aligned_free(p);
+    #else
+        free(p); // No special function required.
+    #endif
+}
+
+
+void* DefaultHeap::Realloc(void* p, size_t newSize)
+{
+    void* newP = realloc(p, newSize);
+
+    return newP;
+}
+
+void* DefaultHeap::ReallocAligned(void* p, size_t newSize, size_t newAlign)
+{
+    #if defined(_MSC_VER)
+        void* pNew = _aligned_realloc(p, newSize, newAlign);
+    #else
+        void* pNew = realloc(p, newSize); // We expect the implementation to know its alignment. There is no standard posix_memalign_realloc.
+    #endif
+
+    return pNew;
+}
+
+
+
+//------------------------------------------------------------------------
+// ***** OSHeap
+//
+
+static size_t AlignSizeUp(size_t value, size_t alignment)
+{
+    return ((value + (alignment - 1)) & ~(alignment - 1));
+}
+
+static size_t AlignSizeDown(size_t value, size_t alignment)
+{
+    return (value & ~(alignment - 1));
+}
+
+template <typename Pointer>
+Pointer AlignPointerUp(Pointer p, size_t alignment)
+{
+    return reinterpret_cast<Pointer>(((reinterpret_cast<size_t>(p) + (alignment - 1)) & ~(alignment - 1)));
+}
+
+template <typename Pointer>
+Pointer AlignPointerDown(Pointer p, size_t alignment)
+{
+    return reinterpret_cast<Pointer>(reinterpret_cast<size_t>(p) & ~(alignment-1));
+}
+
+
+#if defined(_WIN32)
+    // MEM_LARGE_PAGES requires the process to hold SeLockMemoryPrivilege, which the account must 
+    // have been granted ("Lock pages in memory") and which must then be enabled in the token.
+    static bool EnableLockMemoryPrivilege()
+    {
+        HANDLE token;
+
+        if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+            return false;
+
+        TOKEN_PRIVILEGES privileges;
+        privileges.PrivilegeCount = 1;
+        privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+        // AdjustTokenPrivileges succeeds with ERROR_NOT_ALL_ASSIGNED if the account doesn't hold the privilege.
+        const bool result = (LookupPrivilegeValueW(nullptr, L"SeLockMemoryPrivilege", &privileges.Privileges[0].Luid) &&
+                             AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) &&
+                             (GetLastError() == ERROR_SUCCESS));
+        CloseHandle(token);
+        return result;
+    }
+#elif defined(OVR_OS_LINUX)
+    // Returns the default huge page size, which MAP_HUGETLB uses, or 0 if unknown.
+    static size_t GetDefaultHugePageSize()
+    {
+        size_t hugePageSize = 0;
+        FILE*  file = fopen("/proc/meminfo", "r");
+
+        if (file)
+        {
+            char          line[128];
+            unsigned long sizeKB;
+
+            while (!hugePageSize && fgets(line, sizeof(line), file))
+            {
+                if (sscanf(line, "Hugepagesize: %lu kB", &sizeKB) == 1)
+                    hugePageSize = ((size_t)sizeKB * 1024);
+            }
+
+            fclose(file);
+        }
+
+        return hugePageSize;
+    }
+
+    // Returns the size of a transparent huge page, or 0 if unknown. That's the PMD mapping size,
+    // which needn't be the default explicit huge page size, e.g. where that's set to 1 GB.
+    static size_t GetTransparentHugePageSize()
+    {
+        size_t             hugePageSize = 0;
+        FILE*              file = fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r");
+        unsigned long long size;
+
+        if (file)
+        {
+            if (fscanf(file, "%llu", &size) == 1)
+                hugePageSize = (size_t)size;
+
+            fclose(file);
+        }
+
+        return hugePageSize;
+    }
+
+    // We call mbind directly, as its declaration in <numaif.h> comes with libnuma rather than the system.
+    static bool BindToNumaNode(void* p, size_t size, int numaNode)
+    {
+        #if defined(SYS_mbind)
+            const int     mpolBind = 2; // MPOL_BIND
+            const size_t  bitsPerLong = (8 * sizeof(unsigned long));
+            unsigned long nodeMask[1024 / (8 * sizeof(unsigned long))] = {};
+
+            if ((numaNode < 0) || ((size_t)numaNode >= (OVR_ARRAY_COUNT(nodeMask) * bitsPerLong)))
+                return false;
+
+            nodeMask[numaNode / bitsPerLong] |= (1UL << (numaNode % bitsPerLong));
+
+            // The kernel reads maxnode - 1 bits of the mask.
+            return (syscall(SYS_mbind, p, size, mpolBind, nodeMask, (unsigned long)(OVR_ARRAY_COUNT(nodeMask) * bitsPerLong + 1), 0) == 0);
+        #else
+            OVR_UNUSED3(p, size, numaNode);
+            return false;
+        #endif
+    }
+#endif
+
+
+OSHeap::OSHeap()
+  :
+  #if defined(_WIN32)
+    Heap(nullptr),
+  #endif
+    LargeBlockThreshold(0),
+    LargePageMode(PageModeNormal),
+    NumaNode(-1),
+    PageSize(4096),
+    HugePageSize(0),
+    TransparentPageSize(0),
+    StatCount(),
+    FallbackCount(0),
+    NumaFailureCount(0),
+    LiveCount(0),
+    LiveBytes(0)
+{
+}
+
+OSHeap::~OSHeap()
+{
+    OSHeap::Shutdown();
+}
+
+void OSHeap::SetLargeBlockOptions(size_t largeBlockThreshold, PageMode pageMode, int numaNode)
+{
+    LargeBlockThreshold = largeBlockThreshold;
+    LargePageMode = pageMode;
+    NumaNode = numaNode;
+}
+
+void OSHeap::GetLargeBlockStats(LargeBlockStats& stats) const
+{
+    stats.ExplicitCount    = StatCount[PageModeExplicit].load(std::memory_order_relaxed);
+    stats.TransparentCount = StatCount[PageModeTransparent].load(std::memory_order_relaxed);
+    stats.NormalCount      = StatCount[PageModeNormal].load(std::memory_order_relaxed);
+    stats.FallbackCount    = FallbackCount.load(std::memory_order_relaxed);
+    stats.NumaFailureCount = NumaFailureCount.load(std::memory_order_relaxed);
+    stats.LiveCount        = LiveCount.load(std::memory_order_relaxed);
+    stats.LiveBytes        = LiveBytes.load(std::memory_order_relaxed);
+}
+
+bool OSHeap::Init()
+{
+    #if defined(_WIN32)
+        Heap = GetProcessHeap(); // This never fails.
+
+        SYSTEM_INFO systemInfo;
+        GetSystemInfo(&systemInfo);
+        PageSize = systemInfo.dwPageSize;
+        HugePageSize = GetLargePageMinimum(); // 0 if the processor doesn't support large pages.
+
+        if (LargeBlockThreshold && (LargePageMode == PageModeExplicit) && HugePageSize)
+            EnableLockMemoryPrivilege(); // If this fails then large page allocations fail and we fall back to normal pages.
+    #else
+        PageSize = (size_t)getpagesize();
+
+        #if defined(OVR_OS_LINUX)
+            HugePageSize = GetDefaultHugePageSize();
+            TransparentPageSize = GetTransparentHugePageSize();
+        #endif
+    #endif
+
+    for (size_t i = 0; i < OVR_ARRAY_COUNT(StatCount); ++i)
+        StatCount[i] = 0;
+    FallbackCount = 0;
+    NumaFailureCount = 0;
+
+    return true;
+}
+
+void OSHeap::Shutdown()
+{
+    // Do not free this heap. Its lifetime is maintained by the OS.
+    #if defined(_WIN32)
+        Heap = nullptr;
+    #endif
+}
+
+bool OSHeap::IsLargeBlock(const void* p) const
+{
+    // The user pointer of a large block is LargeBlockHeaderSize bytes into a page. For other 
+    // pointers which happen to be too, the header position is in the same page as p and so is 
+    // readable, and the magic tells them apart.
+    if (!LargeBlockThreshold || (((uintptr_t)p & (PageSize - 1)) != LargeBlockHeaderSize))
+        return false;
+
+    const LargeBlockHeader* header = reinterpret_cast<const LargeBlockHeader*>(static_cast<const uint8_t*>(p) - LargeBlockHeaderSize);
+    return (header->Magic == (LargeBlockMagic ^ (uint64_t)(uintptr_t)header));
+}
+
+void* OSHeap::MapLargeBlock(size_t size, size_t& mappingSize, PageMode& mode)
+{
+    void* mapping = nullptr;
+
+    mode = LargePageMode;
+
+    if ((mode == PageModeExplicit) && !HugePageSize)
+        mode = PageModeTransparent;
+
+    if ((mode == PageModeTransparent) && !TransparentPageSize) // Always the case on Windows, which has no transparent huge pages.
+        mode = PageModeNormal;
+
+    #if defined(_WIN32)
+
+        for (;;)
+        {
+            const DWORD allocationType = (MEM_RESERVE | MEM_COMMIT | ((mode == PageModeExplicit) ? MEM_LARGE_PAGES : 0));
+
+            mappingSize = AlignSizeUp(size, ((mode == PageModeExplicit) ? HugePageSize : PageSize));
+
+            if (NumaNode >= 0)
+                mapping = VirtualAllocExNuma(GetCurrentProcess(), nullptr, mappingSize, allocationType, PAGE_READWRITE, (DWORD)NumaNode);
+
+            if (!mapping)
+            {
+                mapping = VirtualAlloc(nullptr, mappingSize, allocationType, PAGE_READWRITE);
+
+                if (mapping && (NumaNode >= 0))
+                    ++NumaFailureCount;
+            }
+
+            if (mapping || (mode == PageModeNormal))
+                break;
+
+            mode = PageModeNormal; // We lack the privilege, or physical memory is too fragmented for large pages.
+        }
+
+    #elif defined(OVR_OS_MAC) || defined(OVR_OS_UNIX)
+        #if defined(MAP_HUGETLB)
+            if (mode == PageModeExplicit)
+            {
+                mappingSize = AlignSizeUp(size, HugePageSize);
+                mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_HUGETLB, -1, 0);
+
+                if (mapping == MAP_FAILED) // No huge pages are reserved (see /proc/sys/vm/nr_hugepages), or none are left.
+                {
+                    mapping = nullptr;
+                    mode = (TransparentPageSize ? PageModeTransparent : PageModeNormal);
+                }
+            }
+        #else
+            if (mode == PageModeExplicit)
+                mode = (TransparentPageSize ? PageModeTransparent : PageModeNormal);
+        #endif
+
+        if (!mapping)
+        {
+            // Transparent huge pages only back huge page aligned ranges, so we over-map and trim to alignment.
+            const size_t alignment = ((mode == PageModeTransparent) ? TransparentPageSize : PageSize);
+            const size_t rawSize = (AlignSizeUp(size, alignment) + alignment - PageSize);
+            uint8_t*     raw = static_cast<uint8_t*>(mmap(nullptr, rawSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0));
+
+            if (raw == MAP_FAILED)
+                return nullptr;
+
+            uint8_t* aligned = AlignPointerUp(raw, alignment);
+            mappingSize = AlignSizeUp(size, alignment);
+
+            if (aligned != raw)
+                munmap(raw, (size_t)(aligned - raw));
+            if ((raw + rawSize) != (aligned + mappingSize))
+                munmap(aligned + mappingSize, (size_t)((raw + rawSize) - (aligned + mappingSize)));
+
+            mapping = aligned;
+
+            #if defined(MADV_HUGEPAGE)
+                if ((mode == PageModeTransparent) && (madvise(mapping, mappingSize, MADV_HUGEPAGE) != 0)) // Fails if the kernel lacks transparent huge page support.
+                    mode = PageModeNormal;
+            #else
+                mode = PageModeNormal;
+            #endif
+        }
+
+        // Bind before the memory is first touched, as that's when pages are placed.
+        #if defined(OVR_OS_LINUX)
+            if ((NumaNode >= 0) && !BindToNumaNode(mapping, mappingSize, NumaNode))
+                ++NumaFailureCount;
+        #else
+            if (NumaNode >= 0)
+                ++NumaFailureCount;
+        #endif
+    #endif
+
+    return mapping;
+}
+
+void OSHeap::UnmapLargeBlock(void* mapping, size_t mappingSize)
+{
+    #if defined(_WIN32)
+        OVR_UNUSED(mappingSize);
+        VirtualFree(mapping, 0, MEM_RELEASE);
+    #elif defined(OVR_OS_MAC) || defined(OVR_OS_UNIX)
+        munmap(mapping, mappingSize);
+    #endif
+}
+
+void* OSHeap::AllocLarge(size_t size)
+{
+    size_t   mappingSize = 0;
+    PageMode mode;
+    void*    mapping = MapLargeBlock(size + LargeBlockHeaderSize, mappingSize, mode);
+
+    if (!mapping)
+        return nullptr;
+
+    LargeBlockHeader* header = static_cast<LargeBlockHeader*>(mapping);
+    header->Magic = (LargeBlockMagic ^ (uint64_t)(uintptr_t)header);
+    header->MappingSize = mappingSize;
+    header->UserSize = size;
+    header->Mode = mode;
+
+    ++StatCount[mode];
+    if (mode != LargePageMode)
+        ++FallbackCount;
+    ++LiveCount;
+    LiveBytes += mappingSize;
+
+    return static_cast<uint8_t*>(mapping) + LargeBlockHeaderSize;
+}
+
+void OSHeap::FreeLarge(void* p)
+{
+    LargeBlockHeader* header = reinterpret_cast<LargeBlockHeader*>(static_cast<uint8_t*>(p) - LargeBlockHeaderSize);
+    const size_t mappingSize = header->MappingSize;
+
+    header->Magic = 0; // Such that a double free fails the IsLargeBlock test, if the page happens to be mapped again.
+    --LiveCount;
+    LiveBytes -= mappingSize;
+
+    UnmapLargeBlock(header, mappingSize);
+}
+
+void* OSHeap::Alloc(size_t size)
+{
+    if (LargeBlockThreshold && (size >= LargeBlockThreshold))
+    {
+        void* p = AllocLarge(size);
+
+        if (p)
+            return p;
+        // Else fall back to the OS heap.
+    }
+
+    #if defined(_WIN32)
+        return HeapAlloc(Heap, 0, size);
+    #else
+        return malloc(size);
+    #endif
+}
+
+void* OSHeap::AllocAligned(size_t size, size_t align)
+{
+    if (LargeBlockThreshold && (size >= LargeBlockThreshold) && (align <= LargeBlockHeaderSize)) // Large blocks are 64 byte aligned.
+    {
+        void* p = AllocLarge(size);
+
+        if (p)
+            return p;
+    }
+
+    // We need to solve this if we are to support aligned memory. We'll need to allocate exta memory up front, return an internal pointer, and store info to find the base pointer.
+    OVR_FAIL_M("OSHeap::AllocAligned not yet supported.");
+    return Alloc(size);
+}
+
+size_t OSHeap::GetAllocSize(const void* p) const
+{
+    if (IsLargeBlock(p))
+        return reinterpret_cast<const LargeBlockHeader*>(static_cast<const uint8_t*>(p) - LargeBlockHeaderSize)->UserSize;
+
+    #if defined(_WIN32)
+        return HeapSize(Heap, 0, p);
+    #elif defined(OVR_OS_MAC)
+        return malloc_size(p);
+    #else
+        return malloc_usable_size(const_cast<void*>(p));
+    #endif
+}
+
+size_t OSHeap::GetAllocAlignedSize(const void* p, size_t /*align*/) const
+{
+    if (IsLargeBlock(p))
+        return GetAllocSize(p);
+
+    // We need to solve this if we are to support aligned memory.
+    OVR_FAIL_M("OSHeap::AllocAligned not yet supported.");
+    return GetAllocSize(p);
+}
+
+void OSHeap::Free(void* p)
+{
+    if (IsLargeBlock(p))
+    {
+        FreeLarge(p);
+        return;
+    }
+
+    #if defined(_WIN32)
+        BOOL result = HeapFree(Heap, 0, p);
+        OVR_ASSERT_AND_UNUSED(result, result);
+    #else
+        free(p);
+    #endif
+}
+
+void OSHeap::FreeAligned(void* p)
+{
+    if (IsLargeBlock(p))
+    {
+        FreeLarge(p);
+        return;
+    }
+
+    OVR_FAIL_M("OSHeap::AllocAligned not yet supported.");
+    Free(p);
+}
+
+void* OSHeap::Realloc(void* p, size_t newSize)
+{
+    if (!p)
+        return Alloc(newSize);
+
+    if (IsLargeBlock(p))
+    {
+        LargeBlockHeader* header = reinterpret_cast<LargeBlockHeader*>(static_cast<uint8_t*>(p) - LargeBlockHeaderSize);
+
+        if ((newSize + LargeBlockHeaderSize) <= header->MappingSize) // If it still fits in the mapping...
+        {
+            header->UserSize = newSize;
+            return p;
+        }
+
+        void* pNew = Alloc(newSize);
+
+        if (pNew)
+        {
+            memcpy(pNew, p, header->UserSize); // newSize is larger than UserSize, as it didn't fit.
+            FreeLarge(p);
+        }
+
+        return pNew;
+    }
+
+    if (LargeBlockThreshold && (newSize >= LargeBlockThreshold)) // If an OS heap block is growing into a large block...
+    {
+        void* pNew = AllocLarge(newSize);
+
+        if (pNew)
+        {
+            memcpy(pNew, p, Alg::Min(GetAllocSize(p), newSize));
+            Free(p);
+            return pNew;
+        }
+    }
+
+    #if defined(_WIN32)
+        return HeapReAlloc(Heap, 0, p, newSize);
+    #else
+        return realloc(p, newSize);
+    #endif
+}
+
+void* OSHeap::ReallocAligned(void* p, size_t newSize, size_t /*newAlign*/)
+{
+    // We need to solve this if we are to support aligned memory.
+    return Realloc(p, newSize);
+}
+
+
+
+//------------------------------------------------------------------------
+// ***** SafeMMapAlloc / SafeMMapFree
+//
+
+void* SafeMMapAlloc(size_t size)
+{
+    #if defined(_WIN32)
+        return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE); // size is rounded up to a page. // Returned memory is 0-filled.
+
+    #elif defined(OVR_OS_MAC) || defined(OVR_OS_UNIX)
+        #if !defined(MAP_FAILED)
+            #define MAP_FAILED ((void*)-1)
+        #endif
+
+        void* result = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0); // Returned memory is 0-filled.
+        if(result == MAP_FAILED) // mmap returns MAP_FAILED (-1) upon failure.
+            result = nullptr;
+        return result;
+    #endif
+}
+
+void SafeMMapFree(const void* memory, size_t size)
+{
+    #if defined(_WIN32)
+        OVR_UNUSED(size);
+        VirtualFree(const_cast<void*>(memory), 0, MEM_RELEASE);
+
+    #elif defined(OVR_OS_MAC) || defined(OVR_OS_UNIX)
+        size_t pageSize = getpagesize();
+        size = (((size + (pageSize - 1)) / pageSize) * pageSize);
+        munmap(const_cast<void*>(memory), size); // Must supply the size to munmap.
+    #endif
+}
+
+
+
+
+//------------------------------------------------------------------------
+// ***** DebugPageHeap
+
+const size_t kFreedBlockArrayMaxSizeDefault = 16384;
+
+
+
+DebugPageHeap::DebugPageHeap()
+  : FreedBlockArray(nullptr)
+  , FreedBlockArrayMaxSize(0)
+  , FreedBlockArraySize(0)
+  , FreedBlockArrayOldest(0)
+  , AllocationCount(0)
+  , OverrunPageEnabled(true)
+  #if defined(OVR_BUILD_DEBUG)
+  , OverrunGuardBytesEnabled(true)
+  #else
+  , OverrunGuardBytesEnabled(false)
+  #endif
+  //PageSize(0)
+  , Lock()
+{
+    #if OVR_HUNT_UNTRACKED_ALLOCS
+        _CrtSetAllocHook(HuntUntrackedAllocHook);
+    #endif
+
+    #if defined(_WIN32)
+        SYSTEM_INFO systemInfo;
+        GetSystemInfo(&systemInfo);
+        PageSize = (size_t)systemInfo.dwPageSize;
+    #else
+        PageSize = 4096;
+    #endif
+
+    SetMaxDelayedFreeCount(kFreedBlockArrayMaxSizeDefault);
+}
+
+
+DebugPageHeap::~DebugPageHeap()
+{
+    Shutdown();
+}
+
+
+bool DebugPageHeap::Init()
+{
+    // Nothing to do.
+    return true;
+}
+
+void DebugPageHeap::Shutdown()
+{
+    Lock::Locker autoLock(&Lock);
+
+    for(size_t i = 0; i < FreedBlockArraySize; i++)
+    {
+        if(FreedBlockArray[i].BlockPtr)
+        {
+            FreePageMemory(FreedBlockArray[i].BlockPtr, FreedBlockArray[i].BlockSize);
+            FreedBlockArray[i].Clear();
+        }
+    }
+
+    SetMaxDelayedFreeCount(0);
+    FreedBlockArraySize = 0;
+    FreedBlockArrayOldest = 0;
+}
+
+
+void DebugPageHeap::EnableOverrunDetection(bool enableOverrunDetection, bool enableOverrunGuardBytes)
+{
+    // Assert that no allocations have been made, which is a requirement for changing these properties. 
+    // Otherwise future deallocations of these allocations can fail to work properly because these 
+    // settings have changed behind their back.
+    OVR_ASSERT_M(AllocationCount == 0, "DebugPageHeap::EnableOverrunDetection called when DebugPageHeap is not in a newly initialized state.");
+
+    OverrunPageEnabled       = enableOverrunDetection;
+    OverrunGuardBytesEnabled = (enableOverrunDetection && enableOverrunGuardBytes); // Set OverrunGuardBytesEnabled to false if enableOverrunDetection is false.
+}
+
+
+void DebugPageHeap::SetMaxDelayedFreeCount(size_t maxDelayedFreeCount)
+{
+    if(FreedBlockArray)
+    {
+        SafeMMapFree(FreedBlockArray, FreedBlockArrayMaxSize * sizeof(Block));
+        FreedBlockArrayMaxSize = 0;
+    }
+
+    if(maxDelayedFreeCount)
+    {
+        FreedBlockArray = (Block*)SafeMMapAlloc(maxDelayedFreeCount * sizeof(Block));
+        OVR_ASSERT(FreedBlockArray);
+
+        if(FreedBlockArray)
+        {
+            FreedBlockArrayMaxSize = maxDelayedFreeCount;
+            #if defined(OVR_BUILD_DEBUG)
+                memset(FreedBlockArray, 0, maxDelayedFreeCount * sizeof(Block));
+            #endif
+        }
+    }
+}
+
+
+size_t DebugPageHeap::GetMaxDelayedFreeCount() const
+{
+    return FreedBlockArrayMaxSize;
+}
+
+
+void* DebugPageHeap::Alloc(size_t size)
+{
+    #if defined(_WIN32)
+        return AllocAligned(size, DefaultAlignment);
+    #else
+        return malloc(size);
+    #endif
+}
+
+
+void* DebugPageHeap::AllocAligned(size_t size, size_t align)
+{
+    #if defined(_WIN32)
+        OVR_ASSERT(align <= PageSize);
+
+        Lock::Locker autoLock(&Lock);
+
+        if(align < DefaultAlignment)
+            align = DefaultAlignment;
+
+        // The actual needed size may be a little less than this, but it's hard to tell how the size and alignments will play out.
+        size_t maxRequiredSize = AlignSizeUp(size, align) + SizeStorageSize;
+
+        if(align > SizeStorageSize)
+        {
+            // Must do: more sophisticated fitting, as maxRequiredSize is potentially too small.
+            OVR_ASSERT(SizeStorageSize <= align);
+        }
+
+        size_t blockSize = AlignSizeUp(maxRequiredSize, PageSize);
+
+        if(OverrunPageEnabled)
+            blockSize += PageSize; // We add another page which will be uncommitted, so any read or write with it will except.
+
+        void* pBlockPtr;
+
+        if((FreedBlockArraySize == FreedBlockArrayMaxSize) && FreedBlockArrayMaxSize &&     // If there is an old block we can recycle...
+           (FreedBlockArray[FreedBlockArrayOldest].BlockSize == blockSize))                 // We require it to be the exact size, as there would be some headaches for us if it was over-sized.
+        {
+            pBlockPtr = EnablePageMemory(FreedBlockArray[FreedBlockArrayOldest].BlockPtr, blockSize);  // Convert this memory from PAGE_NOACCESS back to PAGE_READWRITE.
+            FreedBlockArray[FreedBlockArrayOldest].Clear();
+            
+            if(++FreedBlockArrayOldest == FreedBlockArrayMaxSize)
+                FreedBlockArrayOldest = 0;
+        }
+        else
+        {
+            pBlockPtr = AllocCommittedPageMemory(blockSize); // Allocate a new block of one or more pages (via VirtualAlloc).
+        }
+
+        if(pBlockPtr)
+        {
+            void*   pUserPtr = GetUserPosition(pBlockPtr, blockSize, size, align);
+            size_t* pSizePos = GetSizePosition(pUserPtr);
+
+            pSizePos[UserSizeIndex] = size;
+            pSizePos[BlockSizeIndex] = blockSize;
+            AllocationCount++;
+
+            return pUserPtr;
+        }
+
+        return nullptr;
+    #else
+        OVR_ASSERT_AND_UNUSED(align <= DefaultAlignment, align);
+        return DebugPageHeap::Alloc(size);
+    #endif
+}
+
+
+size_t DebugPageHeap::GetUserSize(const void* p)
+{
+    #if defined(_WIN32)
+        return GetSizePosition(p)[UserSizeIndex];
+    #elif defined(__APPLE__)
+        return malloc_size(p);
+    #else
+        return malloc_usable_size(const_cast<void*>(p));
+    #endif
+}
+
+
+size_t DebugPageHeap::GetBlockSize(const void* p)
+{
+    #if defined(_WIN32)
+        return GetSizePosition(p)[BlockSizeIndex];
+    #else
+        OVR_UNUSED(p);
+        return 0;
+    #endif
+}
+
+
+size_t* DebugPageHeap::GetSizePosition(const void* p)
+{
+    // No thread safety required as per our design, as we assume that anybody 
+    // who owns a pointer returned by Alloc cannot have another thread take it away.
+
+    // We assume the pointer is a valid pointer allocated by this allocator.
+    // We store some size values into the memory returned to the user, a few bytes before it.
+    size_t  value    = reinterpret_cast<size_t>(p);
+    size_t  valuePos = (value - SizeStorageSize);
+    size_t* pSize    = reinterpret_cast<size_t*>(valuePos);
+
+    return pSize;
+}
+
+
+void* DebugPageHeap::Realloc(void* p, size_t newSize)
+{
+    #if defined(_WIN32)
+        return ReallocAligned(p, newSize, DefaultAlignment);
+    #else
+        void* newP = realloc(p, newSize);
+
+        if(newP) // Need to check newP because realloc doesn't free p unless it returns a valid newP.
+        {
+            #if !defined(__clang_analyzer__) // The analyzer complains that we are using p after it was freed.
+                untrackAlloc(p);
+            #endif
+        }
+        trackAlloc(newP, newSize);
+        return newP;
+    #endif
+}
+
+
+void* DebugPageHeap::ReallocAligned(void* p, size_t newSize, size_t newAlign)
+{
+    #if defined(_WIN32)
+        // The ISO C99 standard states:
+        //     The realloc function deallocates the old object pointed to by ptr and 
+        //     returns a pointer to a new object that has the size specified by size. 
+        //     The contents of the new object shall be the same as that of the old 
+        //     object prior to deallocation, up to the lesser of the new and old sizes. 
+        //     Any bytes in the new object beyond the size of the old object have
+        //     indeterminate values.
+        //
+        //     If ptr is a null pointer, the realloc function behaves like the malloc 
+        //     function for the specified size. Otherwise, if ptr does not match a 
+        //     pointer earlier returned by the calloc, malloc, or realloc function, 
+        //     or if the space has been deallocated by a call to the free or realloc 
+        //     function, the behavior is undefined. If memory for the new object 
+        //     cannot be allocated, the old object is not deallocated and its value 
+        //     is unchanged.
+        //     
+        //     The realloc function returns a pointer to the new object (which may have 
+        //     the same value as a pointer to the old object), or a null pointer if 
+        //     the new object could not be allocated.
+
+        // A mutex lock isn't required, as the functions below will handle it internally.
+        // But having it here is a little more efficient because it woudl otherwise be 
+        // locked and unlocked multiple times below, with possible context switches in between.
+        Lock::Locker autoLock(&Lock);
+
+        void* pReturn = nullptr;
+
+        if(p)
+        {
+            if(newSize)
+            {
+                pReturn = AllocAligned(newSize, newAlign);
+
+                if(pReturn)
+                {
+                    size_t prevSize = GetUserSize(p);
+
+                    if(newSize > prevSize)
+                        newSize = prevSize;
+
+                    memcpy(pReturn, p, newSize);
+                    Free(p);
+                } // Else fall through, leaving p's memory unmodified and returning nullptr.
+            }
+            else
+            {
+                Free(p);
+            }
+        }
+        else if(newSize)
+        {
+            pReturn = AllocAligned(newSize, newAlign);
+        }
+
+        return pReturn;
+    #else
+        OVR_ASSERT_AND_UNUSED(newAlign <= DefaultAlignment, newAlign);
+        return DebugPageHeap::Realloc(p, newSize);
+    #endif
+}
+
+
+void DebugPageHeap::Free(void *p)
+{
+    #if defined(_WIN32)
+        if(p)
+        {
+            // Creating a scope for the lock
+            {
+                Lock::Locker autoLock(&Lock);
+
+                if(FreedBlockArrayMaxSize)  // If we have a delayed free list...
+                {
+                    // We don't free the page(s) associated with this but rather put them in the FreedBlockArray in an inaccessible state for later freeing.
+                    // We do this because we don't want those pages to be available again in the near future, so we can detect use-after-free misakes.
+                    Block* pBlockNew;
+
+                    if(FreedBlockArraySize == FreedBlockArrayMaxSize) // If we have reached freed block capacity... we can start purging old elements from it as a circular queue.
+                    {
+                        pBlockNew = &FreedBlockArray[FreedBlockArrayOldest];
+
+                        // The oldest element in the container is FreedBlockArrayOldest.
+                        if(pBlockNew->BlockPtr) // Currently this should always be true.
+                        {
+                            FreePageMemory(pBlockNew->BlockPtr, pBlockNew->BlockSize);
+                            pBlockNew->Clear();
+                        }
+
+                        if(++FreedBlockArrayOldest == FreedBlockArrayMaxSize)
+                            FreedBlockArrayOldest = 0;
+                    }
+                    else // Else we are still building the container and not yet treating it a circular.
+                    {
+                        pBlockNew = &FreedBlockArray[FreedBlockArraySize++];
+                    }
+
+                    pBlockNew->BlockPtr  = GetBlockPtr(p);
+                    pBlockNew->BlockSize = GetBlockSize(p);
+
+                    #if defined(OVR_BUILD_DEBUG)
+                        if(OverrunGuardBytesEnabled) // If we have extra bytes at the end of the user's allocation between it and an inaccessible guard page...
+                        {
+                            const size_t   userSize = GetUserSize(p);
+                            const uint8_t* pUserEnd = (static_cast<uint8_t*>(p) + userSize);
+                            const uint8_t* pPageEnd = AlignPointerUp(pUserEnd, PageSize);
+
+                            while(pUserEnd != pPageEnd)
+                            {
+                                if(*pUserEnd++ != GuardFillByte)
+                                {
+                                    OVR_FAIL();
+                                    break;
+                                }
+                            }
+                        }
+                    #endif
+
+                    DisablePageMemory(pBlockNew->BlockPtr, pBlockNew->BlockSize); // Make it so that future attempts to use this memory result in an exception.
+                }
+                else
+                {
+                    FreePageMemory(GetBlockPtr(p), GetBlockSize(p));
+                }
+
+                AllocationCount--;
+            }
+        }
+    #else
+        untrackAlloc(p);
+        return free(p);
+    #endif
+}
+
+
+void DebugPageHeap::FreeAligned(void* p)
+{
+    return Free(p);
+}
+
+
+// Converts a user pointer to the beginning of its page.
+void* DebugPageHeap::GetBlockPtr(void* p)
+{
+    // We store size info before p in memory, and this will, by design, be always somewhere within 
+    // the first page of a block of pages. So just align down to the beginning of its page.
+    return AlignPointerDown(GetSizePosition(p), PageSize);
+}
+
+
+void* DebugPageHeap::GetUserPosition(void* pPageMemory, size_t blockSize, size_t userSize, size_t userAlignment)
+{
+    uint8_t* pUserPosition;
+
+    if(OverrunPageEnabled)
     {
-        if (!descriptionString.empty()) // If anything was written above...
-            descriptionString += "\n";
+        // We need to return the highest position within the page memory that fits the user size while being aligned to userAlignment.
+        const size_t pageEnd      = reinterpret_cast<size_t>(pPageMemory) + (blockSize - PageSize); // pageEnd points to the beginning of the final guard page.
+        const size_t userPosition = AlignSizeDown(pageEnd - userSize, userAlignment);
+        pUserPosition = reinterpret_cast<uint8_t*>(userPosition);
+        OVR_ASSERT((userPosition + userSize) <= pageEnd);
 
-        for (size_t j = 0, jEnd = amd->Backtrace.size(); (j < jEnd) && (descriptionString.length() < descriptionCapacity); ++j)
+        // If userSize is not a multiple of userAlignment then there will be (userAlignment - userSize) bytes
+        // of unused memory between the user allocated space and the end of the page. There is no way around having this.
+        // For example, a user allocation of 3 bytes with 8 byte alignment will leave 5 unused bytes at the end of the page.
+        // We optionally fill those unused bytes with a pattern and upon Free verify that the pattern is undisturbed.
+        // This won't detect reads or writes in that area immediately as with reads or writes beyond that, but it will
+        // at least detect them at some point (e.g. upon Free).
+        #if defined(OVR_BUILD_DEBUG)
+            if(OverrunGuardBytesEnabled)
+            {
+                uint8_t* const pUserEnd = (pUserPosition + userSize);
+                const size_t remainingByteCount = (reinterpret_cast<uint8_t*>(pageEnd) - pUserEnd);
+                if(remainingByteCount) // If there are any left-over bytes...
+                    memset(pUserEnd, GuardFillByte, remainingByteCount);
+            }
+        #endif
+    }
+    else
+    {
+        // We need to return the first position in the first page after SizeStorageSize bytes which is aligned to userAlignment.
+        const size_t lowestPossiblePos = reinterpret_cast<size_t>(pPageMemory) + SizeStorageSize;
+        const size_t userPosition = AlignSizeUp(lowestPossiblePos, userAlignment);
+        pUserPosition = reinterpret_cast<uint8_t*>(userPosition);
+        OVR_ASSERT((userPosition + userSize) <= (reinterpret_cast<size_t>(pPageMemory) + blockSize));
+    }
+
+    // Assert that the returned user pointer (actually the size info before it) will be within the first page.
+    // This is important because it verifieds that we haven't wasted memory and because 
+    // our functionality for telling the start of the page block depends on it.
+    OVR_ASSERT(AlignPointerDown(GetSizePosition(pUserPosition), PageSize) == pPageMemory);
+
+    return pUserPosition;
+}
+
+
+void* DebugPageHeap::AllocCommittedPageMemory(size_t blockSize)
+{
+    #if defined(_WIN32)
+        void* p;
+    
+        if(OverrunPageEnabled)
+        {
+            // We need to make it so that last page is MEM_RESERVE and the previous pages are MEM_COMMIT + PAGE_READWRITE.
+            OVR_ASSERT(blockSize > PageSize); // There should always be at least one extra page.
+
+            // Reserve blockSize amount of pages.
+            // We could possibly use PAGE_GUARD here for the last page. This differs from simply leaving it reserved
+            // because the OS will generate a one-time-only gaurd page exception. We probabl don't want this, as it's
+            // more useful for maintaining your own stack than for catching unintended overruns.
+            p = VirtualAlloc(nullptr, blockSize, MEM_RESERVE, PAGE_READWRITE);
+
+            if(p)
+            {
+                // Commit all but the last page. Leave the last page as merely reserved so that reads from or writes
+                // to it result in an immediate exception.
+                p = VirtualAlloc(p, blockSize - PageSize, MEM_COMMIT, PAGE_READWRITE);
+            }
+        }
+        else
         {
-            const bool shouldLookupSymbols = (SymbolLookupEnabled && ((amdFlags & AMFBacktraceSymbols) != 0));
-            SymbolInfo symbolInfo;
+            // We need to make it so that all pages are MEM_COMMIT + PAGE_READWRITE.
+            p = VirtualAlloc(nullptr, blockSize, MEM_COMMIT, PAGE_READWRITE);
+        }
 
-            if (shouldLookupSymbols && Symbols.LookupSymbol((uint64_t)amd->Backtrace[j], symbolInfo) && (symbolInfo.filePath[0] || symbolInfo.function[0]))
+        #if defined(OVR_BUILD_DEBUG)
+            if(!p)
             {
-                if (symbolInfo.filePath[0])
-                    snprintf(buffer, OVR_ARRAY_COUNT(buffer), "%2u: %s(%d): %s\n", (unsigned)j, symbolInfo.filePath, symbolInfo.fileLineNumber, symbolInfo.function[0] ? symbolInfo.function : "(unknown function)");
+                // To consider: Make a generic OVRKernel function for formatting system errors. We could move 
+                // the OVRError GetSysErrorCodeString from LibOVR/OVRError.h to LibOVRKernel/OVR_DebugHelp.h
+                DWORD dwLastError = GetLastError();
+                WCHAR osError[256];
+                DWORD osErrorBufferCapacity = OVR_ARRAY_COUNT(osError);
+                CHAR  reportedError[384];
+                DWORD length = FormatMessageW(FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS, nullptr, (DWORD)dwLastError, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), osError, osErrorBufferCapacity, nullptr);
+        
+                if (length)
+                {
+                    std::string errorBuff = UCSStringToUTF8String(osError, length + 1);
+                    snprintf(reportedError, OVR_ARRAY_COUNT(reportedError), "DebugPageHeap: VirtualAlloc failed with error: %s", errorBuff.c_str());
+                }
                 else
-                    snprintf(buffer, OVR_ARRAY_COUNT(buffer), "%2u: 0x%p (unknown source file): %s\n", (unsigned)j, amd->Backtrace[j], symbolInfo.function);
-            }
-            else
-            {
-                snprintf(buffer, OVR_ARRAY_COUNT(buffer), "%2u: 0x%p (symbols unavailable)\n", (unsigned)j, amd->Backtrace[j]);
+                {
+                    snprintf(reportedError, OVR_ARRAY_COUNT(reportedError), "DebugPageHeap: VirtualAlloc failed with error: %d.", dwLastError);
+                }
+
+                //LogError("%s", reportedError); Disabled because this call turns around and allocates memory, yet we may be in a broken or exhausted memory situation.
+                OVR_FAIL_M(reportedError);
             }
+        #endif
 
-            descriptionString += buffer;
-        }
+        return p;
+    #else
+        OVR_UNUSED2(blockSize, OverrunPageEnabled);
+        return nullptr;
+    #endif
+}
 
-        descriptionString.erase(descriptionString.size() - 1); // Remove the last newline. We may add back below.
-    }
 
-    for(size_t i = 0; i < appendedNewlineCount; ++i)
-        descriptionString += '\n';
+// We convert disabled page memory (see DisablePageMemory) to enabled page memory. The output is the same 
+// as with AllocPageMemory.
+void* DebugPageHeap::EnablePageMemory(void* pPageMemory, size_t blockSize)
+{
+    #if defined(_WIN32)
+        // Make sure the entire range of memory is of type PAGE_READWRITE.
+        DWORD dwPrevAccess = 0;
+        BOOL result = VirtualProtect(pPageMemory, OverrunPageEnabled ? (blockSize - PageSize) : blockSize, PAGE_READWRITE, &dwPrevAccess);
+        OVR_ASSERT_AND_UNUSED(result, result);
+    #else
+        OVR_UNUSED3(pPageMemory, blockSize, OverrunPageEnabled);
+    #endif
 
-    return OVR_strlcpy(description, descriptionString.c_str(), descriptionCapacity);
+    return pPageMemory;
 }
 
 
-size_t Allocator::TraceTrackedAllocations(AllocationTraceCallback callback, uintptr_t context)
+void DebugPageHeap::DisablePageMemory(void* pPageMemory, size_t blockSize)
 {
-    const bool symbolLookupWasInitialized = SymbolLookup::IsInitialized();
-    const bool symbolLookupAvailable = SymbolLookup::Initialize();
-
-    if(!symbolLookupWasInitialized) // If SymbolLookup::Initialize was the first time being initialized, we need to refresh the Symbols view of modules, etc.
-        Symbols.Refresh();
+    #if defined(_WIN32)
+        // Disable access to the page(s). It's faster for us to change the page access than it is to decommit or free the pages.
+        // However, this results in more committed physical memory usage than we would need if we instead decommitted the memory.
+        DWORD dwPrevAccesss = 0;
+        BOOL result = VirtualProtect(pPageMemory, OverrunPageEnabled ?  (blockSize - PageSize) : blockSize, PAGE_NOACCESS, &dwPrevAccesss);
+        OVR_ASSERT_AND_UNUSED(result, result);
+    #else
+        OVR_UNUSED2(pPageMemory, blockSize);
+    #endif
+}
 
-    // If we're dumping while LibOVR is running, then we should hold the lock.
-    Allocator* pAlloc = Allocator::GetInstance();
 
-    // It's possible this is being called after the Allocator was shut down, at which 
-    // point we assume we are the only instance that can be executing at his time.
-    Lock* lock = pAlloc ? &pAlloc->TrackLock : nullptr;
-    if (lock) 
-        lock->DoLock();
+void DebugPageHeap::FreePageMemory(void* pPageMemory, size_t /*blockSize*/)
+{
+    #if defined(_WIN32)    
+        BOOL result = VirtualFree(pPageMemory, 0, MEM_RELEASE);
+        OVR_ASSERT_AND_UNUSED(result, result);
+    #else
+        OVR_UNUSED(pPageMemory);
+    #endif
+}
 
-    size_t       measuredLeakCount = 0;
-    size_t       reportedLeakCount = 0;      // = realLeakCount minus leaks we ignore (e.g. C++ runtime concurrency leaks).
-    const size_t leakReportBufferSize = 8192;
-    char*        leakReportBuffer = nullptr;
 
-    // Print out detail for each leaked pointer, but filtering away some that we ignore.
-    for (TrackedAllocMap::const_iterator it = AllocationMap.begin(); it != AllocationMap.end(); ++it)
-    {
-        const TrackedAllocMap::value_type& v = *it;
-        const void* p = v.first;
-        const AllocMetadata& amd = v.second;
 
-        measuredLeakCount++;
+//------------------------------------------------------------------------
+// ***** LinearArenaHeap
+//
 
-        if (!leakReportBuffer) // Lazy allocate this, as it wouldn't be needed unless we had a leak, which we aim to be an unusual case.
-        {
-            leakReportBuffer = static_cast<char*>(SafeMMapAlloc(leakReportBufferSize));
-            if (!leakReportBuffer)
-                break;
-        }
-        leakReportBuffer[0] = '\0';
+LinearArenaHeap::LinearArenaHeap(size_t capacity, OVR::Heap* overflowHeap)
+  : Base(nullptr)
+  , Capacity(0)
+  , NewCapacity(capacity)
+  , Top(0)
+  , OverflowHeap(overflowHeap ? overflowHeap : &DefaultOverflowHeap)
+  , DefaultOverflowHeap()
+  , OverflowList(nullptr)
+  , OverflowListBytes(0)
+  , OverflowLock()
+  , GrowOnOverflow(false)
+  , ThreadSafe(true)
+  , TrackingAllocator(nullptr)
+  , Records(nullptr)
+  , RecordCapacity(0)
+  , RecordCount(0)
+  , PeakBytes(0)
+  , AllocCount(0)
+  , OverflowCount(0)
+  , OverflowBytes(0)
+  , ResetCount(0)
+{
+}
 
-        char line[2048];
-        snprintf(line, OVR_ARRAY_COUNT(line), "\n0x%p, size: %u, tag: %.64s\n", p, (unsigned)amd.AllocSize, amd.Tag ? amd.Tag : "none"); // Limit the tag length so that this can't exhaust the dest buffer. We need more dest buffer space below.
-        size_t currentStrlen = OVR_strlcat(leakReportBuffer, line, leakReportBufferSize);
+LinearArenaHeap::~LinearArenaHeap()
+{
+    LinearArenaHeap::Shutdown();
+}
 
-        if (amd.Backtrace.empty())
-        {
-            snprintf(line, OVR_ARRAY_COUNT(line), "(backtrace unavailable)\n");
-            OVR_strlcat(leakReportBuffer, line, leakReportBufferSize);
-        }
-        else
-        {
-            size_t remainingCapacity = (leakReportBufferSize - currentStrlen);
-            DescribeAllocation(&amd, (AMFBacktrace | AMFBacktraceSymbols), leakReportBuffer + currentStrlen, remainingCapacity, 1);
+bool LinearArenaHeap::Init()
+{
+    if (OverflowHeap == &DefaultOverflowHeap)
+        DefaultOverflowHeap.Init();
 
-            // There are some leaks that aren't real because they are allocated by the Standard Library at runtime but 
-            // aren't freed until shutdown. We don't want to report those, and so we filter them out here.
-            const char* ignoredPhrases[] = { "Concurrency::details" /*add any additional strings here*/ };
+    if (TrackingAllocator && !Records)
+        ReserveRecords(std::max<size_t>(NewCapacity / 256, 256));
 
-            for(size_t j = 0; j < OVR_ARRAY_COUNT(ignoredPhrases); ++j)
-            {
-                if (strstr(leakReportBuffer, ignoredPhrases[j])) // If we should ignore this leak...
-                {
-                    leakReportBuffer[0] = '\0';
-                } 
-            }
-        }
+    if (!Base)
+        return MapBlock(NewCapacity);
 
-        if (leakReportBuffer[0]) // If we are to report this as a bonafide leak...
-        {
-            ++reportedLeakCount;
+    return true;
+}
 
-            // We cannot use normal logging system here because it will allocate more memory!
-            if (callback)
-                callback(context, leakReportBuffer);
-            else
-                ::OutputDebugStringA(leakReportBuffer);
-        }
-    }
+void LinearArenaHeap::Shutdown()
+{
+    ReleaseOverflow();
+    UnmapBlock();
+    FreeRecords();
+    Top = 0;
+}
 
-    char summaryBuffer[128];
-    snprintf(summaryBuffer, OVR_ARRAY_COUNT(summaryBuffer), "Measured leak count: %llu, Reported leak count: %llu\n", (uint64_t)measuredLeakCount, (uint64_t)reportedLeakCount);
+void LinearArenaHeap::SetCapacity(size_t capacity)
+{
+    NewCapacity = capacity;
+}
 
-    if (callback)
-        callback(context, summaryBuffer);
-    else
-        ::OutputDebugStringA(summaryBuffer);
+void LinearArenaHeap::SetAllocator(Allocator* allocator)
+{
+    TrackingAllocator = allocator;
 
-    if (leakReportBuffer)
+    // To start with, enough records for a block full of 256 byte allocations. Reset
+    // grows Records if a frame makes more allocations than that.
+    if (TrackingAllocator)
     {
-        SafeMMapFree(leakReportBuffer, leakReportBufferSize);
-        leakReportBuffer = nullptr;
+        if (!Records)
+            ReserveRecords(std::max<size_t>(NewCapacity / 256, 256));
     }
-
-    if (lock)
-        lock->Unlock();
-
-    if(symbolLookupAvailable)
-        SymbolLookup::Shutdown();
-
-    return reportedLeakCount;
+    else
+        FreeRecords();
 }
 
-
-
-//------------------------------------------------------------------------
-// ***** HeapIterationFilterRPN
-//
-
-HeapIterationFilterRPN::HeapIterationFilterRPN()
-  : AllocatorInstance(nullptr), Filter(nullptr), Instructions{}, CurrentHeapTimeNs(Allocator::GetCurrentHeapTimeNs())
+void LinearArenaHeap::SetOverflowHeap(OVR::Heap* overflowHeap)
 {
+    OVR_ASSERT(!Base); // Else allocations already made would be freed to the wrong heap.
+    OverflowHeap = (overflowHeap ? overflowHeap : &DefaultOverflowHeap);
 }
 
-bool HeapIterationFilterRPN::SetFilter(Allocator* allocator, const char* filter)
+bool LinearArenaHeap::MapBlock(size_t capacity)
 {
-    AllocatorInstance = allocator;
-    Filter = filter;
-    return Compile(filter);    
+    // SafeMMapAlloc rather than the overflow heap, so that a big block doesn't fragment it.
+    Base = (capacity ? static_cast<uint8_t*>(SafeMMapAlloc(capacity)) : nullptr);
+    Capacity = (Base ? capacity : 0);
+    NewCapacity = capacity;
+    return (Base != nullptr) || (capacity == 0);
 }
 
-const AllocMetadata* HeapIterationFilterRPN::IterateHeapBegin()
+void LinearArenaHeap::UnmapBlock()
 {
-    const AllocMetadata* amd = AllocatorInstance->IterateHeapBegin();
-
-    while(amd && !Evaluate(amd))
-        amd = AllocatorInstance->IterateHeapNext();
-
-    return amd;
+    if (Base)
+        SafeMMapFree(Base, Capacity);
+    Base = nullptr;
+    Capacity = 0;
 }
 
-const AllocMetadata* HeapIterationFilterRPN::IterateHeapNext()
+// Sets Top to desired if it's still expected, else updates expected to the current Top.
+bool LinearArenaHeap::MoveTop(size_t& expected, size_t desired)
 {
-    const AllocMetadata* amd = AllocatorInstance->IterateHeapNext();
+    if (ThreadSafe)
+        return Top.compare_exchange_strong(expected, desired, std::memory_order_relaxed);
+
+    const size_t top = Top.load(std::memory_order_relaxed);
 
-    while(amd && !Evaluate(amd))
-        amd = AllocatorInstance->IterateHeapNext();
+    if (top != expected)
+    {
+        expected = top;
+        return false;
+    }
 
-    return amd;
+    Top.store(desired, std::memory_order_relaxed);
+    return true;
 }
 
-void HeapIterationFilterRPN::IterateHeapEnd()
+void LinearArenaHeap::CountAlloc(std::atomic_ullong& counter, uint64_t amount)
 {
-    AllocatorInstance->IterateHeapEnd();
+    if (ThreadSafe)
+        counter.fetch_add(amount, std::memory_order_relaxed);
+    else
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
 }
 
+void* LinearArenaHeap::Alloc(size_t size)
+{
+    return AllocAligned(size, DefaultAlignment);
+}
 
-bool HeapIterationFilterRPN::Compile(const char* filter)
+void* LinearArenaHeap::AllocAligned(size_t size, size_t align)
 {
-    bool success = true; // To consider: We can report syntax errors and associated line numbers.
+    if (align < DefaultAlignment)
+        align = DefaultAlignment;
 
-    static_assert(std::is_standard_layout<Instruction>::value, "Instructions is presumed to be a POD here.");
-    memset(Instructions, 0, sizeof(Instructions));
+    // If there's no block then Capacity is 0 and everything goes to the overflow heap.
+    const uintptr_t base = reinterpret_cast<uintptr_t>(Base);
+    size_t top = Top.load(std::memory_order_relaxed);
 
-    for(size_t instructionCount = 0; success && (instructionCount < OVR_ARRAY_COUNT(Instructions)); ++instructionCount) // While reading each line until the end of the text...
+    for (;;)
     {
-        while(isspace(*filter)) // Move past whitespace. Currently we need this only because of our isOperandLine check below.
-            ++filter;
+        const size_t offset = AlignSizeUp(base + top + sizeof(BlockHeader), align) - base;
 
-        Instruction instruction{};
-        char        tempDataType[12], tempCompare[8], tempComparand[256], tempOperation[8], *nextChar;
-        size_t      i;
-        bool        isOperandLine = _strnicmp(filter, "and", 3) && _strnicmp(filter, "or", 2); // To consider: Find a cleaner way to discern which of the two kinds of lines this is (operand or operation).
+        if ((offset > Capacity) || (size > (Capacity - offset)))
+            return AllocOverflow(size, align);
 
-        if ((*filter == '\r') || (*filter == '\n') || (*filter == '/'))
+        if (MoveTop(top, offset + size))
         {
-            // Ignore lines that are empty or begin with / 
+            BlockHeader* header = reinterpret_cast<BlockHeader*>(Base + offset) - 1;
+            header->Begin = top;
+            header->Size  = size;
+
+            if (TrackingAllocator)
+                RecordBlockAlloc(Base + offset);
+
+            CountAlloc(AllocCount, 1);
+            return Base + offset;
         }
-        else if (isOperandLine && (sscanf_s(filter, "%11s %7s %255[^;]s", tempDataType,  (unsigned)sizeof(tempDataType),
-                                                                          tempCompare,   (unsigned)sizeof(tempCompare),
-                                                                          tempComparand, (unsigned)sizeof(tempComparand)) == 3)) // If this line looks like an operand (e.g. AllocSize > 100)...
-        {
-            static_assert(sizeof(tempComparand) == 256, "The format string here assumes 256. Fix the format string and this assert if tempComparand changes.");
- 
-            struct OperandTypePair{ const char* str; AllocMetadataFlags value; } 
-            operandTypeMap[] = { {"File", AMFFile}, {"Line", AMFLine}, {"Time", AMFTime}, {"Count", AMFCount}, {"Size", AMFAllocSize}, {"AllocSize", AMFAllocSize}, {"BlockSize", AMFBlockSize}, {"Tag", AMFTag}, {"ThreadId", AMFThreadId}, {"ThreadName", AMFThreadName} };
+    }
+}
 
-            // Read the operand (e.g. size)
-            for(i = 0; i < OVR_ARRAY_COUNT(operandTypeMap) && (instruction.operand.metadataType == AMFNone); ++i)
-            {
-                if(OVR_stricmp(tempDataType, operandTypeMap[i].str) == 0)
-                    instruction.operand.metadataType = operandTypeMap[i].value;
-            }
-            success = success && (instruction.operand.metadataType != AMFNone); // Successful if a match was found.
+void* LinearArenaHeap::AllocOverflow(size_t size, size_t align)
+{
+    const size_t memorySize = sizeof(OverflowHeader) + align + size;
 
-            // Read the compare type (e.g. >=)
-            struct CompareTypePair{ const char* str; Comparison value; } 
-            compareTypeMap[] = { {"==", CmpE}, {"<", CmpL}, {"<=", CmpLE}, {">", CmpG}, {">=", CmpGE}, {"has", CmpHas} };
+    if (memorySize < size) // If size is so large that the above wrapped around...
+        return nullptr;
 
-            for(i = 0; i < OVR_ARRAY_COUNT(compareTypeMap) && (instruction.operand.comparison == CmpNone); ++i)
-            {
-                if(OVR_stricmp(tempCompare, compareTypeMap[i].str) == 0)
-                    instruction.operand.comparison = compareTypeMap[i].value;
-            }
-            success = success && (instruction.operand.comparison != CmpNone); // Successful if a match was found.
+    void* memory = OverflowHeap->Alloc(memorySize);
 
-            // Read the comparand (e.g. 4096)
-            instruction.operand.numValue = strtoll(tempComparand, &nextChar, 10);    // Just read it as both types here; we'll
-            strcpy(instruction.operand.strValue, tempComparand);                     // decide at execution time which to use.
+    if (!memory)
+        return nullptr;
 
-            if (instruction.operand.metadataType == AMFTime)
-            {
-                if (*nextChar == 's')                                                                       // If the filter is specifying time in seconds instead of nanoseconds...
-                    instruction.operand.numValue *= 1000000000;                                             //     convert numValue from seconds to nanoseconds (which is what we internally use).
-                if (instruction.operand.numValue < 0)                                                       // Handle the case that a negative time was passed, which
-                    instruction.operand.numValue += CurrentHeapTimeNs;                                      //     means to refer to time relative to current time.
-            }
-            else if ((instruction.operand.metadataType == AMFCount) && (instruction.operand.numValue < 0))  // Handle the case that a negative count was passed, which
-                instruction.operand.numValue += AllocatorInstance->GetCounter();                            //     means to refer to the last N allocations.
-        }
-        else if (sscanf_s(filter, "%7[^;]s", tempOperation, (unsigned)sizeof(tempOperation)) == 1) // If this line looks like an operation (e.g. And or Or).
-        {
-            if (OVR_stricmp(tempOperation, "and") == 0)
-                instruction.operation = OpAnd;
-            else if(OVR_stricmp(tempOperation, "or") == 0)
-                instruction.operation = OpOr;
-            else
-                success = false;
-        }
-        else
-            success = false;
+    uint8_t* user = reinterpret_cast<uint8_t*>(AlignSizeUp(reinterpret_cast<uintptr_t>(memory) + sizeof(OverflowHeader), align));
+    OverflowHeader* header = reinterpret_cast<OverflowHeader*>(user) - 1;
 
-        if (success)
-        {
-            if (instructionCount < OVR_ARRAY_COUNT(Instructions))
-                Instructions[instructionCount] = instruction;
-            else
-                success = false; // Out of space.
-        }
+    header->Owner      = this;
+    header->Prev       = nullptr;
+    header->Memory     = memory;
+    header->MemorySize = memorySize;
+    header->Size       = size;
 
-        // Move to the start of the next statement (delimited by ; or \n)
-        filter = strpbrk(filter, ";\n");
-        if (filter)
-            filter++;
-        else
-            break;
+    {
+        Lock::Locker locker(&OverflowLock);
+
+        header->Next = OverflowList;
+        if (OverflowList)
+            OverflowList->Prev = header;
+        OverflowList = header;
+        OverflowListBytes += memorySize;
     }
 
-    return success;
+    CountAlloc(AllocCount, 1);
+    CountAlloc(OverflowCount, 1);
+    CountAlloc(OverflowBytes, size);
+
+    return user;
 }
 
-// Evaluates an individual operand, such as (AllocSize < 32).
-bool HeapIterationFilterRPN::EvaluateOperand(const Operand& operand, const AllocMetadata* amd) const
+void LinearArenaHeap::Free(void* p)
 {
-    switch ((int)operand.metadataType) // Cast to int in order to avoid compiler warnings about unhandled enumerants.
+    if (p)
     {
-        case AMFFile: case AMFTag: case AMFThreadName: // String-based operands
+        if (Owns(p))
         {
-            const char* p;
-
-            switch ((int)operand.metadataType)
-            {
-                default:
-                case AMFFile:       p = amd->File;       break;
-                case AMFTag:        p = amd->Tag;        break;
-                case AMFThreadName: p = amd->ThreadName; break;
-            }
+            // Only the most recent allocation gives its space back, which makes
+            // alloc/free pairs within a function cost nothing over the frame.
+            const BlockHeader* header = static_cast<const BlockHeader*>(p) - 1;
+            size_t end = (static_cast<uint8_t*>(p) - Base) + header->Size;
 
-            switch ((int)operand.comparison)
-            {
-                case CmpE:   return (OVR_stricmp(p, operand.strValue) == 0);
-                case CmpHas: return (OVR_stristr(p, operand.strValue) != nullptr);
-            }                
+            MoveTop(end, header->Begin);
         }
-    
-        case AMFLine: case AMFTime: case AMFCount: case AMFAllocSize: case AMFBlockSize: case AMFThreadId: // Integer-based operands
+        else
         {
-            int64_t n;
+            OverflowHeader* header = static_cast<OverflowHeader*>(p) - 1;
+            header->Owner->FreeOverflow(header); // Usually this, but may be the other arena of a FrameArena.
+        }
+    }
+}
 
-            switch ((int)operand.metadataType)
-            {
-                default:
-                case AMFLine:      n = amd->Line;      break;
-                case AMFTime:      n = amd->TimeNs;    break;
-                case AMFCount:     n = amd->Count;     break;
-                case AMFAllocSize: n = amd->AllocSize; break;
-                case AMFBlockSize: n = amd->BlockSize; break;
-                case AMFThreadId:  n = amd->ThreadId;  break;
-            }
+void LinearArenaHeap::FreeOverflow(OverflowHeader* header)
+{
+    {
+        Lock::Locker locker(&OverflowLock);
 
-            switch ((int)operand.comparison)
-            {
-                case CmpE:  return (n == operand.numValue);
-                case CmpL:  return (n <  operand.numValue);
-                case CmpLE: return (n <= operand.numValue);
-                case CmpG:  return (n >  operand.numValue);
-                case CmpGE: return (n >= operand.numValue);
-            }
-        }
+        if (header->Prev)
+            header->Prev->Next = header->Next;
+        else
+            OverflowList = header->Next;
+
+        if (header->Next)
+            header->Next->Prev = header->Prev;
+
+        OverflowListBytes -= header->MemorySize;
     }
 
-    return false;
+    OverflowHeap->Free(header->Memory);
 }
 
-bool HeapIterationFilterRPN::Evaluate(const AllocMetadata* amd)
+void LinearArenaHeap::ReleaseOverflow()
 {
-    // We execute an RPN (a.k.a. postfix) stack here. Because our language here involves 
-    // only logical operations, our stack need be only a stack of bool.
-    struct Stack
+    OverflowHeader* list;
+
     {
-        bool   data[32];
-        size_t size;
+        Lock::Locker locker(&OverflowLock);
 
-        void PopAndSet(bool value) { memmove(&data[1], &data[2], sizeof(data) - (2 * sizeof(bool))); data[0] = value; size -= 1; }
-        void Push(bool value)      { memmove(&data[1], &data[0], sizeof(data) - (1 * sizeof(bool))); data[0] = value; size += 1; }
-    } stack{ {true, 1} }; // By default the state is true. An empty instruction set evaluates as true.
+        list = OverflowList;
+        OverflowList = nullptr;
+        OverflowListBytes = 0;
+    }
 
-    for(size_t i = 0; (i < OVR_ARRAY_COUNT(Instructions)) && ((Instructions[i].operation != OpNone) || (Instructions[i].operand.comparison != CmpNone)); ++i)
+    // The detached list is ours alone, so untracking and freeing don't need the lock. Each block
+    // is untracked by its exact pointer, which touches one table shard instead of all of them.
+    while (list)
     {
-        if(Instructions[i].operation != OpNone) // if this is an operation...
-        {
-            if (Instructions[i].operation == OpAnd)
-                stack.PopAndSet(stack.data[0] && stack.data[1]);
-            else
-                stack.PopAndSet(stack.data[0] || stack.data[1]);
-        }
-        else // Else this is an operand push.
-            stack.Push(EvaluateOperand(Instructions[i].operand, amd));
-    }
+        OverflowHeader* header = list;
+        list = header->Next;
 
-    return stack.data[0];
-}
+        if (TrackingAllocator)
+            TrackingAllocator->UntrackPointer(header + 1);
 
+        OverflowHeap->Free(header->Memory);
+    }
+}
 
-void HeapIterationFilterRPN::TraceTrackedAllocations(Allocator* allocator, const char* filter, Allocator::AllocationTraceCallback callback, uintptr_t context)
+void LinearArenaHeap::RecordBlockAlloc(void* p)
 {
-    OVR::HeapIterationFilterRPN hifRPN;
+    size_t index;
 
-    hifRPN.SetFilter(allocator, filter);
-
-    for(const OVR::AllocMetadata* amd = hifRPN.IterateHeapBegin(); amd; amd = hifRPN.IterateHeapNext())
+    if (ThreadSafe)
+        index = RecordCount.fetch_add(1, std::memory_order_relaxed);
+    else
     {
-        char description[16384];
-        allocator->DescribeAllocation(amd, 0xffff, description, sizeof(description), 0);
-        callback(context, description);
+        index = RecordCount.load(std::memory_order_relaxed);
+        RecordCount.store(index + 1, std::memory_order_relaxed);
     }
 
-    hifRPN.IterateHeapEnd();
+    // Past the end the count still goes up, so that Reset knows the records are incomplete.
+    if (index < RecordCapacity)
+        Records[index] = p;
 }
 
+void LinearArenaHeap::UntrackBlock(size_t blockBytes)
+{
+    const size_t recordCount = RecordCount.load(std::memory_order_relaxed);
 
+    // Each allocation is untracked by its exact pointer, which touches one table shard.
+    // Allocations that were freed or reallocated since are already untracked, and
+    // untracking them again does nothing. Only if there were more allocations than
+    // records does it come to UntrackRange, which scans every shard.
+    if (recordCount <= RecordCapacity)
+    {
+        for (size_t i = 0; i < recordCount; i++)
+            TrackingAllocator->UntrackPointer(Records[i]);
+    }
+    else
+    {
+        if (blockBytes)
+            TrackingAllocator->UntrackRange(Base, Base + blockBytes);
 
-//------------------------------------------------------------------------
-// ***** DefaultHeap
-//
+        FreeRecords();
+        ReserveRecords(recordCount * 2);
+    }
 
-bool DefaultHeap::Init()
-{
-    // Nothing to do.
-    return true;
+    RecordCount.store(0, std::memory_order_relaxed);
 }
 
-void DefaultHeap::Shutdown()
+bool LinearArenaHeap::ReserveRecords(size_t capacity)
 {
-    // Nothing to do.
+    // SafeMMapAlloc, as Records are part of the tracking and shouldn't come from a tracked heap.
+    Records = static_cast<void**>(SafeMMapAlloc(capacity * sizeof(void*)));
+    RecordCapacity = (Records ? capacity : 0);
+    return (Records != nullptr);
 }
 
-
-void* DefaultHeap::Alloc(size_t size)
+void LinearArenaHeap::FreeRecords()
 {
-    void* p = malloc(size);
-
-    return p;
+    if (Records)
+        SafeMMapFree(Records, RecordCapacity * sizeof(void*));
+    Records = nullptr;
+    RecordCapacity = 0;
+    RecordCount.store(0, std::memory_order_relaxed);
 }
 
+void* LinearArenaHeap::Realloc(void* p, size_t newSize)
+{
+    return ReallocAligned(p, newSize, DefaultAlignment);
+}
 
-void* DefaultHeap::AllocAligned(size_t size, size_t align)
+void* LinearArenaHeap::ReallocAligned(void* p, size_t newSize, size_t newAlign)
 {
-    #if defined(_MSC_VER)
-        void* p = _aligned_malloc(size, align);
-    #else
-        void* p = memalign(align, size);
-    #endif
+    if (!p)
+        return AllocAligned(newSize, newAlign);
 
-    return p;
-}
+    if (Owns(p) && ((reinterpret_cast<uintptr_t>(p) & (newAlign - 1)) == 0))
+    {
+        BlockHeader* header = static_cast<BlockHeader*>(p) - 1;
+        const size_t offset = (static_cast<uint8_t*>(p) - Base);
+        size_t end = offset + header->Size;
 
+        if (newSize <= header->Size)
+        {
+            // Shrink in place, giving the space back if this is the most recent allocation.
+            MoveTop(end, offset + newSize);
+            header->Size = newSize;
+            return p;
+        }
 
-size_t DefaultHeap::GetAllocSize(const void* p) const
-{
-    #if defined(_MSC_VER)
-        return _msize(const_cast<void*>(p));
-    #else
-        return malloc_usable_size(p);
-    #endif
-}
+        // Grow in place if this is the most recent allocation and the block has room.
+        if ((newSize <= (Capacity - offset)) && MoveTop(end, offset + newSize))
+        {
+            header->Size = newSize;
+            return p;
+        }
+    }
 
+    void* newP = AllocAligned(newSize, newAlign);
 
-size_t DefaultHeap::GetAllocAlignedSize(const void* p, size_t align) const
-{
-    #if defined(_MSC_VER)
-        return _aligned_msize(const_cast<void*>(p), align, 0);
-    #else
-        OVR_UNUSED(align);
-        return malloc_usable_size(p);
-    #endif
-}
+    if (newP)
+    {
+        memcpy(newP, p, std::min(GetUserSize(p), newSize));
+        Free(p);
+    }
 
+    return newP;
+}
 
-void DefaultHeap::Free(void *p)
+size_t LinearArenaHeap::GetUserSize(const void* p)
 {
-    free(p);
+    // BlockHeader and OverflowHeader both end with the user size.
+    return static_cast<const size_t*>(p)[-1];
 }
 
-void DefaultHeap::FreeAligned(void* p)
+void LinearArenaHeap::Reset()
 {
-    #if defined(_MSC_VER)
-        _aligned_free(p);
-    #else
-        free(p); // No special function required.
-    #endif
-}
+    const size_t blockBytes = Top.load(std::memory_order_relaxed);
+    const uint64_t usedBytes = blockBytes + OverflowListBytes;
 
+    if (usedBytes > PeakBytes)
+        PeakBytes = usedBytes;
 
-void* DefaultHeap::Realloc(void* p, size_t newSize)
-{
-    void* newP = realloc(p, newSize);
+    if (GrowOnOverflow && OverflowListBytes && (usedBytes > NewCapacity))
+        NewCapacity = AlignSizeUp((size_t)usedBytes, 65536);
 
-    return newP;
+    if (TrackingAllocator)
+        UntrackBlock(blockBytes);
+
+    ReleaseOverflow();
+
+    if (NewCapacity != Capacity)
+    {
+        UnmapBlock();
+        MapBlock(NewCapacity); // If this fails then we run entirely from the overflow heap.
+    }
+
+    Top.store(0, std::memory_order_relaxed);
+    ResetCount++;
 }
 
-void* DefaultHeap::ReallocAligned(void* p, size_t newSize, size_t newAlign)
+void LinearArenaHeap::GetStats(Stats& stats) const
 {
-    #if defined(_MSC_VER)
-        void* pNew = _aligned_realloc(p, newSize, newAlign);
-    #else
-        void* pNew = realloc(p, newSize); // We expect the implementation to know its alignment. There is no standard posix_memalign_realloc.
-    #endif
-
-    return pNew;
+    const uint64_t usedBytes = Top.load(std::memory_order_relaxed);
+
+    stats.UsedBytes     = usedBytes;
+    stats.PeakBytes     = std::max(PeakBytes, usedBytes + OverflowListBytes);
+    stats.AllocCount    = AllocCount.load(std::memory_order_relaxed);
+    stats.OverflowCount = OverflowCount.load(std::memory_order_relaxed);
+    stats.OverflowBytes = OverflowBytes.load(std::memory_order_relaxed);
+    stats.ResetCount    = ResetCount;
 }
 
 
 
 //------------------------------------------------------------------------
-// ***** OSHeap
+// ***** FrameArena
 //
 
-OSHeap::OSHeap()
-  : Heap(nullptr)
+FrameArena::FrameArena(size_t capacityPerFrame, OVR::Heap* overflowHeap)
+  : Arenas()
+  , Current(&Arenas[0])
+  , Previous(&Arenas[1])
+  , FrameIndex(0)
 {
+    for (LinearArenaHeap& arena : Arenas)
+    {
+        arena.SetCapacity(capacityPerFrame);
+        arena.SetOverflowHeap(overflowHeap);
+    }
 }
 
-OSHeap::~OSHeap()
+bool FrameArena::Init()
 {
-    OSHeap::Shutdown();
+    return Arenas[0].Init() && Arenas[1].Init();
 }
 
-bool OSHeap::Init()
+void FrameArena::Shutdown()
 {
-    Heap = GetProcessHeap(); // This never fails.
-    return true;
+    Arenas[0].Shutdown();
+    Arenas[1].Shutdown();
 }
 
-void OSHeap::Shutdown()
+void FrameArena::Free(void* p)
 {
-    // Do not free this heap. Its lifetime is maintained by the OS.
-    Heap = nullptr;
+    // Current handles its own block as well as overflow allocations of either arena.
+    if (Previous->Owns(p))
+        Previous->Free(p);
+    else
+        Current->Free(p);
 }
 
-void* OSHeap::Alloc(size_t size)
+void* FrameArena::Realloc(void* p, size_t newSize)
 {
-    return HeapAlloc(Heap, 0, size);
+    return ReallocAligned(p, newSize, LinearArenaHeap::DefaultAlignment);
 }
 
-void* OSHeap::AllocAligned(size_t size, size_t /*align*/)
+void* FrameArena::ReallocAligned(void* p, size_t newSize, size_t newAlign)
 {
-    // We need to solve this if we are to support aligned memory. We'll need to allocate exta memory up front, return an internal pointer, and store info to find the base pointer.
-    OVR_FAIL_M("OSHeap::AllocAligned not yet supported.");
-    return HeapAlloc(Heap, 0, size);
-}
+    // Memory from the previous frame moves to the current one, as it would otherwise be 
+    // released a frame earlier than the caller would expect of something just reallocated.
+    if (p && Previous->Owns(p))
+    {
+        void* newP = Current->AllocAligned(newSize, newAlign);
 
-size_t OSHeap::GetAllocSize(const void* p) const
-{
-    return HeapSize(Heap, 0, p);
+        if (newP)
+        {
+            memcpy(newP, p, std::min(LinearArenaHeap::GetUserSize(p), newSize));
+            Previous->Free(p);
+        }
+
+        return newP;
+    }
+
+    return Current->ReallocAligned(p, newSize, newAlign);
 }
 
-size_t OSHeap::GetAllocAlignedSize(const void* p, size_t /*align*/) const
+void FrameArena::BeginFrame()
 {
-    // We need to solve this if we are to support aligned memory.
-    OVR_FAIL_M("OSHeap::AllocAligned not yet supported.");
-    return HeapSize(Heap, 0, p);
+    std::swap(Current, Previous);
+    Current->Reset();
+    FrameIndex++;
 }
 
-void OSHeap::Free(void* p)
+void FrameArena::EnableGrowOnOverflow(bool enable)
 {
-    BOOL result = HeapFree(Heap, 0, p);
-    OVR_ASSERT_AND_UNUSED(result, result);
+    Arenas[0].EnableGrowOnOverflow(enable);
+    Arenas[1].EnableGrowOnOverflow(enable);
 }
 
-void OSHeap::FreeAligned(void* p)
+void FrameArena::SetThreadSafe(bool threadSafe)
 {
-    OVR_FAIL_M("OSHeap::AllocAligned not yet supported.");
-    BOOL result = HeapFree(Heap, 0, p);
-    OVR_ASSERT_AND_UNUSED(result, result);
+    Arenas[0].SetThreadSafe(threadSafe);
+    Arenas[1].SetThreadSafe(threadSafe);
 }
 
-void* OSHeap::Realloc(void* p, size_t newSize)
+void FrameArena::SetAllocator(Allocator* allocator)
 {
-    return HeapReAlloc(Heap, 0, p, newSize);
+    Arenas[0].SetAllocator(allocator);
+    Arenas[1].SetAllocator(allocator);
 }
 
-void* OSHeap::ReallocAligned(void* p, size_t newSize, size_t /*newAlign*/)
+void FrameArena::GetStats(LinearArenaHeap::Stats& stats) const
 {
-    // We need to solve this if we are to support aligned memory.
-    return HeapReAlloc(Heap, 0, p, newSize);
-}
+    LinearArenaHeap::Stats other;
+
+    Arenas[0].GetStats(stats);
+    Arenas[1].GetStats(other);
 
+    stats.UsedBytes     += other.UsedBytes;
+    stats.PeakBytes      = std::max(stats.PeakBytes, other.PeakBytes);
+    stats.AllocCount    += other.AllocCount;
+    stats.OverflowCount += other.OverflowCount;
+    stats.OverflowBytes += other.OverflowBytes;
+    stats.ResetCount    += other.ResetCount;
+}
 
 
 //------------------------------------------------------------------------
-// ***** SafeMMapAlloc / SafeMMapFree
+// ***** PoolHeap
 //
 
-void* SafeMMapAlloc(size_t size)
+const uint16_t PoolHeap::SizeClassSizes[PoolHeap::SizeClassCount] =
 {
-    #if defined(_WIN32)
-        return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE); // size is rounded up to a page. // Returned memory is 0-filled.
+    16, 32, 48, 64, 80, 96, 112, 128,   // Steps of 16 up to 128, then four steps per doubling.
+    160, 192, 224, 256,
+    320, 384, 448, 512,
+    640, 768, 896, 1024
+};
 
-    #elif defined(OVR_OS_MAC) || defined(OVR_OS_UNIX)
-        #if !defined(MAP_FAILED)
-            #define MAP_FAILED ((void*)-1)
-        #endif
+// Source of PoolHeap::InstanceId values. 0 is never used, so a thread that has never
+// used a PoolHeap doesn't match any.
+static std::atomic<uint64_t> PoolHeapInstanceCounter(0);
 
-        void* result = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0); // Returned memory is 0-filled.
-        if(result == MAP_FAILED) // mmap returns MAP_FAILED (-1) upon failure.
-            result = nullptr;
-        return result;
-    #endif
-}
+// The calling thread's cache for the PoolHeap it most recently used. Other PoolHeaps
+// find theirs through their OS thread-local slot, which is slower.
+static OVR_THREAD_LOCAL uint64_t PoolHeapTlsInstanceId;
+static OVR_THREAD_LOCAL void*    PoolHeapTlsCache;
 
-void SafeMMapFree(const void* memory, size_t size)
+#if defined(_WIN32)
+    static void NTAPI PoolHeapFlsCallback(void* threadCache)
+    {
+        PoolHeap::OnThreadExit(threadCache);
+    }
+#endif
+
+static void* ReservePageMemory(size_t size)
 {
     #if defined(_WIN32)
-        OVR_UNUSED(size);
-        VirtualFree(const_cast<void*>(memory), 0, MEM_RELEASE);
-
-    #elif defined(OVR_OS_MAC) || defined(OVR_OS_UNIX)
-        size_t pageSize = getpagesize();
-        size = (((size + (pageSize - 1)) / pageSize) * pageSize);
-        munmap(const_cast<void*>(memory), size); // Must supply the size to munmap.
+        return VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
+    #else
+        void* result = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0);
+        return (result == MAP_FAILED) ? nullptr : result;
     #endif
 }
 
-
-
-
-//------------------------------------------------------------------------
-// ***** DebugPageHeap
-
-static size_t AlignSizeUp(size_t value, size_t alignment)
+static bool CommitPageMemory(void* p, size_t size)
 {
-    return ((value + (alignment - 1)) & ~(alignment - 1));
+    #if defined(_WIN32)
+        return (VirtualAlloc(p, size, MEM_COMMIT, PAGE_READWRITE) != nullptr);
+    #else
+        return (mprotect(p, size, PROT_READ | PROT_WRITE) == 0);
+    #endif
 }
 
-static size_t AlignSizeDown(size_t value, size_t alignment)
+static void ReleasePageMemory(void* p, size_t size)
 {
-    return (value & ~(alignment - 1));
+    #if defined(_WIN32)
+        OVR_UNUSED(size);
+        VirtualFree(p, 0, MEM_RELEASE);
+    #else
+        munmap(p, size);
+    #endif
 }
 
-template <typename Pointer>
-Pointer AlignPointerUp(Pointer p, size_t alignment)
-{
-    return reinterpret_cast<Pointer>(((reinterpret_cast<size_t>(p) + (alignment - 1)) & ~(alignment - 1)));
-}
 
-template <typename Pointer>
-Pointer AlignPointerDown(Pointer p, size_t alignment)
+PoolHeap::PoolHeap()
+  : RegionBase(nullptr)
+  , RegionSize(0)
+  , ReservedBase(nullptr)
+  , ReservedSize((size_t)((sizeof(void*) >= 8) ? (UINT64_C(4) << 30) : (UINT64_C(128) << 20)))
+  , SpanCapacity(0)
+  , SpanCount(0)
+  , SpanSizeClass(nullptr)
+  , SpanLock()
+  , Central()
+  , BatchSize()
+  , SizeClassLookup()
+  , InstanceId(0)
+  , TlsKey(0)
+  , TlsKeyValid(false)
+  , ThreadCacheList(nullptr)
+  , ThreadCacheCount(0)
+  , ThreadCacheLock()
+  , LargeHeap(&DefaultLargeHeap)
+  , DefaultLargeHeap()
+  , LargeAllocCount(0)
+  , LargeFreeCount(0)
 {
-    return reinterpret_cast<Pointer>(reinterpret_cast<size_t>(p) & ~(alignment-1));
-}
-
-
-const size_t kFreedBlockArrayMaxSizeDefault = 16384;
-
+    for (size_t size = 0, sizeClass = 0; size <= MaxSmallSize; size += 16)
+    {
+        while (SizeClassSizes[sizeClass] < size)
+            sizeClass++;
+        SizeClassLookup[size >> 4] = (uint8_t)sizeClass;
+    }
 
+    // About 8 KB per batch, within 4 to 64 blocks.
+    for (size_t i = 0; i < SizeClassCount; i++)
+        BatchSize[i] = (uint16_t)std::max<size_t>(4, std::min<size_t>(64, 8192 / SizeClassSizes[i]));
+}
 
-DebugPageHeap::DebugPageHeap()
-  : FreedBlockArray(nullptr)
-  , FreedBlockArrayMaxSize(0)
-  , FreedBlockArraySize(0)
-  , FreedBlockArrayOldest(0)
-  , AllocationCount(0)
-  , OverrunPageEnabled(true)
-  #if defined(OVR_BUILD_DEBUG)
-  , OverrunGuardBytesEnabled(true)
-  #else
-  , OverrunGuardBytesEnabled(false)
-  #endif
-  //PageSize(0)
-  , Lock()
+PoolHeap::~PoolHeap()
 {
-    #if OVR_HUNT_UNTRACKED_ALLOCS
-        _CrtSetAllocHook(HuntUntrackedAllocHook);
-    #endif
-
-    #if defined(_WIN32)
-        SYSTEM_INFO systemInfo;
-        GetSystemInfo(&systemInfo);
-        PageSize = (size_t)systemInfo.dwPageSize;
-    #else
-        PageSize = 4096;
-    #endif
-
-    SetMaxDelayedFreeCount(kFreedBlockArrayMaxSizeDefault);
+    PoolHeap::Shutdown();
 }
 
-
-DebugPageHeap::~DebugPageHeap()
+void PoolHeap::SetReservedSize(size_t reservedSize)
 {
-    Shutdown();
+    OVR_ASSERT(!RegionBase);
+    // Blocks are encoded as 32 bit multiples of 16 bytes, which covers 64 GB.
+    ReservedSize = (size_t)std::min<uint64_t>(AlignSizeUp(reservedSize, SpanSize), UINT64_C(64) << 30);
 }
 
-
-bool DebugPageHeap::Init()
+void PoolHeap::SetLargeObjectHeap(OVR::Heap* largeObjectHeap)
 {
-    // Nothing to do.
-    return true;
+    OVR_ASSERT(!RegionBase);
+    LargeHeap = (largeObjectHeap ? largeObjectHeap : &DefaultLargeHeap);
 }
 
-void DebugPageHeap::Shutdown()
+bool PoolHeap::Init()
 {
-    Lock::Locker autoLock(&Lock);
+    if (RegionBase) // If already initialized...
+        return true;
 
-    for(size_t i = 0; i < FreedBlockArraySize; i++)
+    if (LargeHeap == &DefaultLargeHeap)
+        DefaultLargeHeap.Init();
+
+    // Reserve an extra span so that the region can start on a span boundary.
+    ReservedBase = ReservePageMemory(ReservedSize + SpanSize);
+    if (!ReservedBase)
+        return false;
+
+    SpanCapacity  = ReservedSize / SpanSize;
+    SpanSizeClass = static_cast<uint8_t*>(SafeMMapAlloc(SpanCapacity));
+    if (!SpanSizeClass)
     {
-        if(FreedBlockArray[i].BlockPtr)
-        {
-            FreePageMemory(FreedBlockArray[i].BlockPtr, FreedBlockArray[i].BlockSize);
-            FreedBlockArray[i].Clear();
-        }
+        ReleasePageMemory(ReservedBase, ReservedSize + SpanSize);
+        ReservedBase = nullptr;
+        return false;
     }
 
-    SetMaxDelayedFreeCount(0);
-    FreedBlockArraySize = 0;
-    FreedBlockArrayOldest = 0;
-}
-
+    #if defined(_WIN32)
+        DWORD flsIndex = FlsAlloc(PoolHeapFlsCallback);
+        TlsKeyValid = (flsIndex != FLS_OUT_OF_INDEXES);
+        TlsKey = flsIndex;
+    #else
+        pthread_key_t key;
+        TlsKeyValid = (pthread_key_create(&key, OnThreadExit) == 0);
+        TlsKey = (uintptr_t)key;
+    #endif
 
-void DebugPageHeap::EnableOverrunDetection(bool enableOverrunDetection, bool enableOverrunGuardBytes)
-{
-    // Assert that no allocations have been made, which is a requirement for changing these properties. 
-    // Otherwise future deallocations of these allocations can fail to work properly because these 
-    // settings have changed behind their back.
-    OVR_ASSERT_M(AllocationCount == 0, "DebugPageHeap::EnableOverrunDetection called when DebugPageHeap is not in a newly initialized state.");
+    RegionBase = AlignPointerUp(static_cast<uint8_t*>(ReservedBase), SpanSize);
+    RegionSize = SpanCapacity * SpanSize;
+    SpanCount  = 0;
+    InstanceId = ++PoolHeapInstanceCounter;
 
-    OverrunPageEnabled       = enableOverrunDetection;
-    OverrunGuardBytesEnabled = (enableOverrunDetection && enableOverrunGuardBytes); // Set OverrunGuardBytesEnabled to false if enableOverrunDetection is false.
+    return true;
 }
 
-
-void DebugPageHeap::SetMaxDelayedFreeCount(size_t maxDelayedFreeCount)
+void PoolHeap::Shutdown()
 {
-    if(FreedBlockArray)
+    if (!RegionBase) // If not initialized...
+        return;
+
+    // Threads that exit from here on don't call us back. Freeing the slot may itself
+    // call back for threads that still have a cache, which releases those caches.
+    if (TlsKeyValid)
     {
-        SafeMMapFree(FreedBlockArray, FreedBlockArrayMaxSize * sizeof(Block));
-        FreedBlockArrayMaxSize = 0;
+        #if defined(_WIN32)
+            FlsFree((DWORD)TlsKey);
+        #else
+            pthread_key_delete((pthread_key_t)TlsKey);
+        #endif
+        TlsKeyValid = false;
     }
 
-    if(maxDelayedFreeCount)
+    // Any remaining caches belong to threads still running. Their blocks go away with the region.
     {
-        FreedBlockArray = (Block*)SafeMMapAlloc(maxDelayedFreeCount * sizeof(Block));
-        OVR_ASSERT(FreedBlockArray);
+        Lock::Locker locker(&ThreadCacheLock);
 
-        if(FreedBlockArray)
+        while (ThreadCacheList)
         {
-            FreedBlockArrayMaxSize = maxDelayedFreeCount;
-            #if defined(OVR_BUILD_DEBUG)
-                memset(FreedBlockArray, 0, maxDelayedFreeCount * sizeof(Block));
-            #endif
+            ThreadCache* cache = ThreadCacheList;
+            ThreadCacheList = cache->Next;
+            SysMemFree(cache, sizeof(ThreadCache));
         }
+
+        ThreadCacheCount = 0;
     }
-}
 
+    InstanceId = 0; // Invalidates the PoolHeapTlsCache values of all threads.
 
-size_t DebugPageHeap::GetMaxDelayedFreeCount() const
-{
-    return FreedBlockArrayMaxSize;
+    for (CentralList& central : Central)
+    {
+        central.Head = 0;
+        central.AllocCount = 0;
+        central.FreeCount = 0;
+        central.SpanCount = 0;
+        central.RefillCount = 0;
+        central.ReturnCount = 0;
+    }
+
+    SafeMMapFree(SpanSizeClass, SpanCapacity);
+    SpanSizeClass = nullptr;
+    ReleasePageMemory(ReservedBase, ReservedSize + SpanSize);
+    ReservedBase = nullptr;
+    RegionBase   = nullptr;
+    RegionSize   = 0;
+    SpanCapacity = 0;
+    SpanCount    = 0;
+    LargeAllocCount = 0;
+    LargeFreeCount  = 0;
 }
 
 
-void* DebugPageHeap::Alloc(size_t size)
+PoolHeap::ThreadCache* PoolHeap::GetThreadCache()
 {
+    if (PoolHeapTlsInstanceId == InstanceId)
+        return static_cast<ThreadCache*>(PoolHeapTlsCache);
+
+    if (!TlsKeyValid)
+        return nullptr;
+
     #if defined(_WIN32)
-        return AllocAligned(size, DefaultAlignment);
+        ThreadCache* cache = static_cast<ThreadCache*>(FlsGetValue((DWORD)TlsKey));
     #else
-        return malloc(size);
+        ThreadCache* cache = static_cast<ThreadCache*>(pthread_getspecific((pthread_key_t)TlsKey));
     #endif
-}
 
+    if (!cache)
+    {
+        cache = CreateThreadCache();
+        if (!cache)
+            return nullptr;
+    }
 
-void* DebugPageHeap::AllocAligned(size_t size, size_t align)
+    PoolHeapTlsInstanceId = InstanceId;
+    PoolHeapTlsCache = cache;
+
+    return cache;
+}
+
+PoolHeap::ThreadCache* PoolHeap::CreateThreadCache()
 {
-    #if defined(_WIN32)
-        OVR_ASSERT(align <= PageSize);
+    ThreadCache* cache = static_cast<ThreadCache*>(SysMemAlloc(sizeof(ThreadCache)));
 
-        Lock::Locker autoLock(&Lock);
+    if (cache)
+    {
+        memset(cache, 0, sizeof(ThreadCache));
+        cache->Heap = this;
 
-        if(align < DefaultAlignment)
-            align = DefaultAlignment;
+        #if defined(_WIN32)
+            FlsSetValue((DWORD)TlsKey, cache);
+        #else
+            pthread_setspecific((pthread_key_t)TlsKey, cache);
+        #endif
 
-        // The actual needed size may be a little less than this, but it's hard to tell how the size and alignments will play out.
-        size_t maxRequiredSize = AlignSizeUp(size, align) + SizeStorageSize;
+        Lock::Locker locker(&ThreadCacheLock);
 
-        if(align > SizeStorageSize)
-        {
-            // Must do: more sophisticated fitting, as maxRequiredSize is potentially too small.
-            OVR_ASSERT(SizeStorageSize <= align);
-        }
+        cache->Next = ThreadCacheList;
+        if (ThreadCacheList)
+            ThreadCacheList->Prev = cache;
+        ThreadCacheList = cache;
+        ThreadCacheCount++;
+    }
 
-        size_t blockSize = AlignSizeUp(maxRequiredSize, PageSize);
+    return cache;
+}
 
-        if(OverrunPageEnabled)
-            blockSize += PageSize; // We add another page which will be uncommitted, so any read or write with it will except.
+void PoolHeap::OnThreadExit(void* threadCache)
+{
+    ThreadCache* cache = static_cast<ThreadCache*>(threadCache);
 
-        void* pBlockPtr;
+    if (cache)
+        cache->Heap->ReleaseThreadCache(cache);
+}
 
-        if((FreedBlockArraySize == FreedBlockArrayMaxSize) && FreedBlockArrayMaxSize &&     // If there is an old block we can recycle...
-           (FreedBlockArray[FreedBlockArrayOldest].BlockSize == blockSize))                 // We require it to be the exact size, as there would be some headaches for us if it was over-sized.
-        {
-            pBlockPtr = EnablePageMemory(FreedBlockArray[FreedBlockArrayOldest].BlockPtr, blockSize);  // Convert this memory from PAGE_NOACCESS back to PAGE_READWRITE.
-            FreedBlockArray[FreedBlockArrayOldest].Clear();
-            
-            if(++FreedBlockArrayOldest == FreedBlockArrayMaxSize)
-                FreedBlockArrayOldest = 0;
-        }
-        else
-        {
-            pBlockPtr = AllocCommittedPageMemory(blockSize); // Allocate a new block of one or more pages (via VirtualAlloc).
-        }
+void PoolHeap::ReleaseThreadCache(ThreadCache* cache)
+{
+    // Anything this thread frees from here on (e.g. in other thread-exit callbacks) 
+    // gets a new cache, which the OS calls us back about again.
+    if (PoolHeapTlsCache == cache)
+    {
+        PoolHeapTlsInstanceId = 0;
+        PoolHeapTlsCache = nullptr;
+    }
 
-        if(pBlockPtr)
+    for (size_t sizeClass = 0; sizeClass < SizeClassCount; sizeClass++)
+    {
+        ClassCache& classCache = cache->Classes[sizeClass];
+
+        while (classCache.List)
         {
-            void*   pUserPtr = GetUserPosition(pBlockPtr, blockSize, size, align);
-            size_t* pSizePos = GetSizePosition(pUserPtr);
+            FreeBlock* batch = classCache.List;
+            FreeBlock* last  = batch;
+            uint32_t   count = 1;
 
-            pSizePos[UserSizeIndex] = size;
-            pSizePos[BlockSizeIndex] = blockSize;
-            AllocationCount++;
+            while (last->Next && (count < BatchSize[sizeClass]))
+            {
+                last = last->Next;
+                count++;
+            }
 
-            return pUserPtr;
+            classCache.List = last->Next;
+            last->Next = nullptr;
+            PushBatch(sizeClass, batch, count);
         }
 
-        return nullptr;
-    #else
-        OVR_ASSERT_AND_UNUSED(align <= DefaultAlignment, align);
-        return DebugPageHeap::Alloc(size);
-    #endif
-}
+        FlushStats(classCache, sizeClass);
+    }
 
+    {
+        Lock::Locker locker(&ThreadCacheLock);
 
-size_t DebugPageHeap::GetUserSize(const void* p)
-{
-    #if defined(_WIN32)
-        return GetSizePosition(p)[UserSizeIndex];
-    #elif defined(__APPLE__)
-        return malloc_size(p);
-    #else
-        return malloc_usable_size(const_cast<void*>(p));
-    #endif
+        if (cache->Prev)
+            cache->Prev->Next = cache->Next;
+        else
+            ThreadCacheList = cache->Next;
+
+        if (cache->Next)
+            cache->Next->Prev = cache->Prev;
+
+        ThreadCacheCount--;
+    }
+
+    SysMemFree(cache, sizeof(ThreadCache));
 }
 
 
-size_t DebugPageHeap::GetBlockSize(const void* p)
+uint32_t PoolHeap::EncodeBlock(const FreeBlock* block) const
 {
-    #if defined(_WIN32)
-        return GetSizePosition(p)[BlockSizeIndex];
-    #else
-        OVR_UNUSED(p);
-        return 0;
-    #endif
+    return block ? (uint32_t)(((const uint8_t*)block - RegionBase) >> 4) + 1 : 0;
 }
 
+PoolHeap::FreeBlock* PoolHeap::DecodeBlock(uint32_t value) const
+{
+    return value ? reinterpret_cast<FreeBlock*>(RegionBase + ((size_t)(value - 1) << 4)) : nullptr;
+}
 
-size_t* DebugPageHeap::GetSizePosition(const void* p)
+PoolHeap::FreeBlock* PoolHeap::PopBatch(size_t sizeClass)
 {
-    // No thread safety required as per our design, as we assume that anybody 
-    // who owns a pointer returned by Alloc cannot have another thread take it away.
+    std::atomic<uint64_t>& head = Central[sizeClass].Head;
+    uint64_t oldHead = head.load(std::memory_order_acquire);
 
-    // We assume the pointer is a valid pointer allocated by this allocator.
-    // We store some size values into the memory returned to the user, a few bytes before it.
-    size_t  value    = reinterpret_cast<size_t>(p);
-    size_t  valuePos = (value - SizeStorageSize);
-    size_t* pSize    = reinterpret_cast<size_t*>(valuePos);
+    for (;;)
+    {
+        FreeBlock* batch = DecodeBlock((uint32_t)oldHead);
 
-    return pSize;
-}
+        if (!batch)
+            return nullptr;
 
+        // The batch may be popped and reused by another thread meanwhile, in which case 
+        // this reads garbage, but from memory that's still ours, and the tag makes the CAS fail.
+        const uint64_t newHead = (oldHead & UINT64_C(0xffffffff00000000)) + UINT64_C(0x100000000) + batch->NextBatch;
 
-void* DebugPageHeap::Realloc(void* p, size_t newSize)
+        if (head.compare_exchange_weak(oldHead, newHead, std::memory_order_acquire, std::memory_order_acquire))
+            return batch;
+    }
+}
+
+void PoolHeap::PushBatch(size_t sizeClass, FreeBlock* batch, uint32_t count)
 {
-    #if defined(_WIN32)
-        return ReallocAligned(p, newSize, DefaultAlignment);
-    #else
-        void* newP = realloc(p, newSize);
+    std::atomic<uint64_t>& head = Central[sizeClass].Head;
+    uint64_t oldHead = head.load(std::memory_order_relaxed);
+    const uint32_t encoded = EncodeBlock(batch);
 
-        if(newP) // Need to check newP because realloc doesn't free p unless it returns a valid newP.
-        {
-            #if !defined(__clang_analyzer__) // The analyzer complains that we are using p after it was freed.
-                untrackAlloc(p);
-            #endif
-        }
-        trackAlloc(newP, newSize);
-        return newP;
-    #endif
-}
+    batch->BatchCount = count;
+
+    for (;;)
+    {
+        batch->NextBatch = (uint32_t)oldHead;
 
+        const uint64_t newHead = (oldHead & UINT64_C(0xffffffff00000000)) + UINT64_C(0x100000000) + encoded;
 
-void* DebugPageHeap::ReallocAligned(void* p, size_t newSize, size_t newAlign)
+        if (head.compare_exchange_weak(oldHead, newHead, std::memory_order_release, std::memory_order_relaxed))
+            return;
+    }
+}
+
+// Commits a new span for the size class, keeps one batch of it and pushes the rest to the central list.
+PoolHeap::FreeBlock* PoolHeap::CarveSpan(size_t sizeClass)
 {
-    #if defined(_WIN32)
-        // The ISO C99 standard states:
-        //     The realloc function deallocates the old object pointed to by ptr and 
-        //     returns a pointer to a new object that has the size specified by size. 
-        //     The contents of the new object shall be the same as that of the old 
-        //     object prior to deallocation, up to the lesser of the new and old sizes. 
-        //     Any bytes in the new object beyond the size of the old object have
-        //     indeterminate values.
-        //
-        //     If ptr is a null pointer, the realloc function behaves like the malloc 
-        //     function for the specified size. Otherwise, if ptr does not match a 
-        //     pointer earlier returned by the calloc, malloc, or realloc function, 
-        //     or if the space has been deallocated by a call to the free or realloc 
-        //     function, the behavior is undefined. If memory for the new object 
-        //     cannot be allocated, the old object is not deallocated and its value 
-        //     is unchanged.
-        //     
-        //     The realloc function returns a pointer to the new object (which may have 
-        //     the same value as a pointer to the old object), or a null pointer if 
-        //     the new object could not be allocated.
+    uint8_t* span;
 
-        // A mutex lock isn't required, as the functions below will handle it internally.
-        // But having it here is a little more efficient because it woudl otherwise be 
-        // locked and unlocked multiple times below, with possible context switches in between.
-        Lock::Locker autoLock(&Lock);
+    {
+        Lock::Locker locker(&SpanLock);
 
-        void* pReturn = nullptr;
+        if (SpanCount >= SpanCapacity)
+            return nullptr;
 
-        if(p)
-        {
-            if(newSize)
-            {
-                pReturn = AllocAligned(newSize, newAlign);
+        span = RegionBase + (SpanCount * SpanSize);
 
-                if(pReturn)
-                {
-                    size_t prevSize = GetUserSize(p);
+        if (!CommitPageMemory(span, SpanSize))
+            return nullptr;
 
-                    if(newSize > prevSize)
-                        newSize = prevSize;
+        SpanSizeClass[SpanCount++] = (uint8_t)sizeClass;
+    }
 
-                    memcpy(pReturn, p, newSize);
-                    Free(p);
-                } // Else fall through, leaving p's memory unmodified and returning nullptr.
-            }
-            else
-            {
-                Free(p);
-            }
+    Central[sizeClass].SpanCount.fetch_add(1, std::memory_order_relaxed);
+
+    const size_t   blockSize  = SizeClassSizes[sizeClass];
+    const size_t   blockCount = SpanSize / blockSize;
+    const uint32_t batchSize  = BatchSize[sizeClass];
+    FreeBlock*     firstBatch = nullptr;
+
+    for (size_t i = 0; i < blockCount; i += batchSize)
+    {
+        const uint32_t count = (uint32_t)std::min<size_t>(batchSize, blockCount - i);
+        FreeBlock*     batch = reinterpret_cast<FreeBlock*>(span + (i * blockSize));
+
+        for (uint32_t j = 0; j < count; j++)
+        {
+            FreeBlock* block = reinterpret_cast<FreeBlock*>(span + ((i + j) * blockSize));
+            block->Next = (j + 1 < count) ? reinterpret_cast<FreeBlock*>((uint8_t*)block + blockSize) : nullptr;
         }
-        else if(newSize)
+
+        if (!firstBatch)
         {
-            pReturn = AllocAligned(newSize, newAlign);
+            firstBatch = batch;
+            firstBatch->BatchCount = count;
         }
+        else
+            PushBatch(sizeClass, batch, count);
+    }
 
-        return pReturn;
-    #else
-        OVR_ASSERT_AND_UNUSED(newAlign <= DefaultAlignment, newAlign);
-        return DebugPageHeap::Realloc(p, newSize);
-    #endif
+    return firstBatch;
+}
+
+bool PoolHeap::Refill(ClassCache& classCache, size_t sizeClass)
+{
+    FreeBlock* batch = PopBatch(sizeClass);
+
+    if (!batch)
+        batch = CarveSpan(sizeClass);
+
+    if (!batch)
+        return false;
+
+    Central[sizeClass].RefillCount.fetch_add(1, std::memory_order_relaxed);
+    classCache.List  = batch;
+    classCache.Count = batch->BatchCount;
+    return true;
+}
+
+void PoolHeap::FlushStats(ClassCache& classCache, size_t sizeClass)
+{
+    Central[sizeClass].AllocCount.fetch_add(classCache.AllocCount, std::memory_order_relaxed);
+    Central[sizeClass].FreeCount.fetch_add(classCache.FreeCount, std::memory_order_relaxed);
+    classCache.AllocCount = 0;
+    classCache.FreeCount = 0;
 }
 
+static const uint32_t PoolHeapStatsFlushCount = 256;
 
-void DebugPageHeap::Free(void *p)
+void* PoolHeap::AllocSmall(size_t sizeClass)
 {
-    #if defined(_WIN32)
-        if(p)
+    ThreadCache* cache = GetThreadCache();
+
+    if (cache)
+    {
+        ClassCache& classCache = cache->Classes[sizeClass];
+
+        if (classCache.List || Refill(classCache, sizeClass))
         {
-            // Creating a scope for the lock
-            {
-                Lock::Locker autoLock(&Lock);
+            FreeBlock* block = classCache.List;
+            classCache.List = block->Next;
+            classCache.Count--;
 
-                if(FreedBlockArrayMaxSize)  // If we have a delayed free list...
-                {
-                    // We don't free the page(s) associated with this but rather put them in the FreedBlockArray in an inaccessible state for later freeing.
-                    // We do this because we don't want those pages to be available again in the near future, so we can detect use-after-free misakes.
-                    Block* pBlockNew;
+            if (++classCache.AllocCount >= PoolHeapStatsFlushCount)
+                FlushStats(classCache, sizeClass);
 
-                    if(FreedBlockArraySize == FreedBlockArrayMaxSize) // If we have reached freed block capacity... we can start purging old elements from it as a circular queue.
-                    {
-                        pBlockNew = &FreedBlockArray[FreedBlockArrayOldest];
+            return block;
+        }
+    }
 
-                        // The oldest element in the container is FreedBlockArrayOldest.
-                        if(pBlockNew->BlockPtr) // Currently this should always be true.
-                        {
-                            FreePageMemory(pBlockNew->BlockPtr, pBlockNew->BlockSize);
-                            pBlockNew->Clear();
-                        }
+    // Out of thread-local storage or out of reserved spans (or Init failed). The caller falls
+    // back to the large object heap, in the way that matches how the block will be freed.
+    return nullptr;
+}
 
-                        if(++FreedBlockArrayOldest == FreedBlockArrayMaxSize)
-                            FreedBlockArrayOldest = 0;
-                    }
-                    else // Else we are still building the container and not yet treating it a circular.
-                    {
-                        pBlockNew = &FreedBlockArray[FreedBlockArraySize++];
-                    }
+void PoolHeap::FreeSmall(void* p)
+{
+    const size_t sizeClass = GetSpanSizeClass(p);
+    ThreadCache* cache = GetThreadCache();
+    FreeBlock*   block = static_cast<FreeBlock*>(p);
 
-                    pBlockNew->BlockPtr  = GetBlockPtr(p);
-                    pBlockNew->BlockSize = GetBlockSize(p);
+    if (!cache) // If we can't have a cache then give the block back on its own.
+    {
+        block->Next = nullptr;
+        PushBatch(sizeClass, block, 1);
+        Central[sizeClass].FreeCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
 
-                    #if defined(OVR_BUILD_DEBUG)
-                        if(OverrunGuardBytesEnabled) // If we have extra bytes at the end of the user's allocation between it and an inaccessible guard page...
-                        {
-                            const size_t   userSize = GetUserSize(p);
-                            const uint8_t* pUserEnd = (static_cast<uint8_t*>(p) + userSize);
-                            const uint8_t* pPageEnd = AlignPointerUp(pUserEnd, PageSize);
+    ClassCache& classCache = cache->Classes[sizeClass];
+    const uint32_t batchSize = BatchSize[sizeClass];
 
-                            while(pUserEnd != pPageEnd)
-                            {
-                                if(*pUserEnd++ != GuardFillByte)
-                                {
-                                    OVR_FAIL();
-                                    break;
-                                }
-                            }
-                        }
-                    #endif
+    block->Next = classCache.List;
+    classCache.List = block;
 
-                    DisablePageMemory(pBlockNew->BlockPtr, pBlockNew->BlockSize); // Make it so that future attempts to use this memory result in an exception.
-                }
-                else
-                {
-                    FreePageMemory(GetBlockPtr(p), GetBlockSize(p));
-                }
+    if (++classCache.Count >= (2 * batchSize)) // If we have two batches, give one back.
+    {
+        FreeBlock* last = block;
+        for (uint32_t i = 1; i < batchSize; i++)
+            last = last->Next;
+
+        classCache.List = last->Next;
+        classCache.Count -= batchSize;
+        last->Next = nullptr;
+        PushBatch(sizeClass, block, batchSize);
+        Central[sizeClass].ReturnCount.fetch_add(1, std::memory_order_relaxed);
+    }
 
-                AllocationCount--;
-            }
-        }
-    #else
-        untrackAlloc(p);
-        return free(p);
-    #endif
+    if (++classCache.FreeCount >= PoolHeapStatsFlushCount)
+        FlushStats(classCache, sizeClass);
 }
 
 
-void DebugPageHeap::FreeAligned(void* p)
+void* PoolHeap::AllocLarge(size_t size)
 {
-    return Free(p);
+    LargeAllocCount.fetch_add(1, std::memory_order_relaxed);
+    return LargeHeap->Alloc(size);
 }
 
-
-// Converts a user pointer to the beginning of its page.
-void* DebugPageHeap::GetBlockPtr(void* p)
+// The large object heap may not support alignment (OSHeap doesn't), so we align within a
+// larger block and store the block pointer and user size right before the returned memory.
+void* PoolHeap::AllocLargeAligned(size_t size, size_t align)
 {
-    // We store size info before p in memory, and this will, by design, be always somewhere within 
-    // the first page of a block of pages. So just align down to the beginning of its page.
-    return AlignPointerDown(GetSizePosition(p), PageSize);
-}
+    if (align < sizeof(size_t) * 2)
+        align = sizeof(size_t) * 2;
 
+    const size_t blockSize = size + align + (sizeof(size_t) * 2);
 
-void* DebugPageHeap::GetUserPosition(void* pPageMemory, size_t blockSize, size_t userSize, size_t userAlignment)
-{
-    uint8_t* pUserPosition;
+    if (blockSize < size) // If it wrapped around...
+        return nullptr;
 
-    if(OverrunPageEnabled)
+    uint8_t* block = static_cast<uint8_t*>(AllocLarge(blockSize));
+
+    if (!block)
+        return nullptr;
+
+    uint8_t* p = AlignPointerUp(block + (sizeof(size_t) * 2), align);
+    reinterpret_cast<size_t*>(p)[-1] = (size_t)block;
+    reinterpret_cast<size_t*>(p)[-2] = size;
+
+    return p;
+}
+
+void* PoolHeap::Alloc(size_t size)
+{
+    if (size <= MaxSmallSize)
     {
-        // We need to return the highest position within the page memory that fits the user size while being aligned to userAlignment.
-        const size_t pageEnd      = reinterpret_cast<size_t>(pPageMemory) + (blockSize - PageSize); // pageEnd points to the beginning of the final guard page.
-        const size_t userPosition = AlignSizeDown(pageEnd - userSize, userAlignment);
-        pUserPosition = reinterpret_cast<uint8_t*>(userPosition);
-        OVR_ASSERT((userPosition + userSize) <= pageEnd);
+        if (void* p = AllocSmall(GetSizeClass(size)))
+            return p;
+    }
 
-        // If userSize is not a multiple of userAlignment then there will be (userAlignment - userSize) bytes
-        // of unused memory between the user allocated space and the end of the page. There is no way around having this.
-        // For example, a user allocation of 3 bytes with 8 byte alignment will leave 5 unused bytes at the end of the page.
-        // We optionally fill those unused bytes with a pattern and upon Free verify that the pattern is undisturbed.
-        // This won't detect reads or writes in that area immediately as with reads or writes beyond that, but it will
-        // at least detect them at some point (e.g. upon Free).
-        #if defined(OVR_BUILD_DEBUG)
-            if(OverrunGuardBytesEnabled)
+    return AllocLarge(size);
+}
+
+void* PoolHeap::AllocAligned(size_t size, size_t align)
+{
+    // Spans are SpanSize aligned, so blocks of a size class are aligned to any power of two its size is a multiple of.
+    if ((size <= MaxSmallSize) && (align <= MaxSmallSize))
+    {
+        for (size_t sizeClass = GetSizeClass(size); sizeClass < SizeClassCount; sizeClass++)
+        {
+            if ((SizeClassSizes[sizeClass] & (align - 1)) == 0)
             {
-                uint8_t* const pUserEnd = (pUserPosition + userSize);
-                const size_t remainingByteCount = (reinterpret_cast<uint8_t*>(pageEnd) - pUserEnd);
-                if(remainingByteCount) // If there are any left-over bytes...
-                    memset(pUserEnd, GuardFillByte, remainingByteCount);
+                if (void* p = AllocSmall(sizeClass))
+                    return p;
+                break;
             }
-        #endif
-    }
-    else
-    {
-        // We need to return the first position in the first page after SizeStorageSize bytes which is aligned to userAlignment.
-        const size_t lowestPossiblePos = reinterpret_cast<size_t>(pPageMemory) + SizeStorageSize;
-        const size_t userPosition = AlignSizeUp(lowestPossiblePos, userAlignment);
-        pUserPosition = reinterpret_cast<uint8_t*>(userPosition);
-        OVR_ASSERT((userPosition + userSize) <= (reinterpret_cast<size_t>(pPageMemory) + blockSize));
+        }
     }
 
-    // Assert that the returned user pointer (actually the size info before it) will be within the first page.
-    // This is important because it verifieds that we haven't wasted memory and because 
-    // our functionality for telling the start of the page block depends on it.
-    OVR_ASSERT(AlignPointerDown(GetSizePosition(pUserPosition), PageSize) == pPageMemory);
+    // FreeAligned and GetAllocAlignedSize expect the header AllocLargeAligned writes, so
+    // this must not go through AllocLarge even when a size class would have been used.
+    return AllocLargeAligned(size, align);
+}
 
-    return pUserPosition;
+size_t PoolHeap::GetAllocSize(const void* p) const
+{
+    if (IsSmallAlloc(p))
+        return SizeClassSizes[GetSpanSizeClass(p)];
+
+    return LargeHeap->GetAllocSize(p);
 }
 
+size_t PoolHeap::GetAllocAlignedSize(const void* p, size_t /*align*/) const
+{
+    if (IsSmallAlloc(p))
+        return SizeClassSizes[GetSpanSizeClass(p)];
 
-void* DebugPageHeap::AllocCommittedPageMemory(size_t blockSize)
+    return reinterpret_cast<const size_t*>(p)[-2];
+}
+
+void PoolHeap::Free(void* p)
 {
-    #if defined(_WIN32)
-        void* p;
-    
-        if(OverrunPageEnabled)
-        {
-            // We need to make it so that last page is MEM_RESERVE and the previous pages are MEM_COMMIT + PAGE_READWRITE.
-            OVR_ASSERT(blockSize > PageSize); // There should always be at least one extra page.
+    if (IsSmallAlloc(p))
+        FreeSmall(p);
+    else if (p)
+    {
+        LargeFreeCount.fetch_add(1, std::memory_order_relaxed);
+        LargeHeap->Free(p);
+    }
+}
 
-            // Reserve blockSize amount of pages.
-            // We could possibly use PAGE_GUARD here for the last page. This differs from simply leaving it reserved
-            // because the OS will generate a one-time-only gaurd page exception. We probabl don't want this, as it's
-            // more useful for maintaining your own stack than for catching unintended overruns.
-            p = VirtualAlloc(nullptr, blockSize, MEM_RESERVE, PAGE_READWRITE);
+void PoolHeap::FreeAligned(void* p)
+{
+    if (IsSmallAlloc(p))
+        FreeSmall(p);
+    else if (p)
+    {
+        LargeFreeCount.fetch_add(1, std::memory_order_relaxed);
+        LargeHeap->Free(reinterpret_cast<void*>(reinterpret_cast<size_t*>(p)[-1]));
+    }
+}
 
-            if(p)
-            {
-                // Commit all but the last page. Leave the last page as merely reserved so that reads from or writes
-                // to it result in an immediate exception.
-                p = VirtualAlloc(p, blockSize - PageSize, MEM_COMMIT, PAGE_READWRITE);
-            }
-        }
-        else
+void* PoolHeap::Realloc(void* p, size_t newSize)
+{
+    if (!p)
+        return Alloc(newSize);
+
+    if (IsSmallAlloc(p))
+    {
+        const size_t sizeClass = GetSpanSizeClass(p);
+        const size_t oldSize   = SizeClassSizes[sizeClass];
+
+        if ((newSize <= oldSize) && (GetSizeClass(newSize) == sizeClass)) // If it's still the same size class...
+            return p;
+
+        void* newP = Alloc(newSize);
+
+        if (newP)
         {
-            // We need to make it so that all pages are MEM_COMMIT + PAGE_READWRITE.
-            p = VirtualAlloc(nullptr, blockSize, MEM_COMMIT, PAGE_READWRITE);
+            memcpy(newP, p, std::min(oldSize, newSize));
+            FreeSmall(p);
         }
 
-        #if defined(OVR_BUILD_DEBUG)
-            if(!p)
-            {
-                // To consider: Make a generic OVRKernel function for formatting system errors. We could move 
-                // the OVRError GetSysErrorCodeString from LibOVR/OVRError.h to LibOVRKernel/OVR_DebugHelp.h
-                DWORD dwLastError = GetLastError();
-                WCHAR osError[256];
-                DWORD osErrorBufferCapacity = OVR_ARRAY_COUNT(osError);
-                CHAR  reportedError[384];
-                DWORD length = FormatMessageW(FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS, nullptr, (DWORD)dwLastError, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), osError, osErrorBufferCapacity, nullptr);
-        
-                if (length)
-                {
-                    std::string errorBuff = UCSStringToUTF8String(osError, length + 1);
-                    snprintf(reportedError, OVR_ARRAY_COUNT(reportedError), "DebugPageHeap: VirtualAlloc failed with error: %s", errorBuff.c_str());
-                }
-                else
-                {
-                    snprintf(reportedError, OVR_ARRAY_COUNT(reportedError), "DebugPageHeap: VirtualAlloc failed with error: %d.", dwLastError);
-                }
+        return newP;
+    }
 
-                //LogError("%s", reportedError); Disabled because this call turns around and allocates memory, yet we may be in a broken or exhausted memory situation.
-                OVR_FAIL_M(reportedError);
-            }
-        #endif
+    if (newSize > MaxSmallSize)
+        return LargeHeap->Realloc(p, newSize);
 
-        return p;
-    #else
-        OVR_UNUSED2(blockSize, OverrunPageEnabled);
-        return nullptr;
-    #endif
-}
+    // A large allocation shrinking into a size class.
+    void* newP = Alloc(newSize);
+
+    if (newP)
+    {
+        memcpy(newP, p, newSize);
+        Free(p);
+    }
 
+    return newP;
+}
 
-// We convert disabled page memory (see DisablePageMemory) to enabled page memory. The output is the same 
-// as with AllocPageMemory.
-void* DebugPageHeap::EnablePageMemory(void* pPageMemory, size_t blockSize)
+void* PoolHeap::ReallocAligned(void* p, size_t newSize, size_t newAlign)
 {
-    #if defined(_WIN32)
-        // Make sure the entire range of memory is of type PAGE_READWRITE.
-        DWORD dwPrevAccess = 0;
-        BOOL result = VirtualProtect(pPageMemory, OverrunPageEnabled ? (blockSize - PageSize) : blockSize, PAGE_READWRITE, &dwPrevAccess);
-        OVR_ASSERT_AND_UNUSED(result, result);
-    #else
-        OVR_UNUSED3(pPageMemory, blockSize, OverrunPageEnabled);
-    #endif
+    if (!p)
+        return AllocAligned(newSize, newAlign);
 
-    return pPageMemory;
+    const size_t oldSize = GetAllocAlignedSize(p, newAlign);
+
+    if (IsSmallAlloc(p) && (newSize <= oldSize) && (GetSizeClass(newSize) == GetSpanSizeClass(p)) && (((uintptr_t)p & (newAlign - 1)) == 0))
+        return p;
+
+    void* newP = AllocAligned(newSize, newAlign);
+
+    if (newP)
+    {
+        memcpy(newP, p, std::min(oldSize, newSize));
+        FreeAligned(p);
+    }
+
+    return newP;
 }
 
 
-void DebugPageHeap::DisablePageMemory(void* pPageMemory, size_t blockSize)
+size_t PoolHeap::GetSizeClassStats(SizeClassStats* stats, size_t capacity) const
 {
-    #if defined(_WIN32)
-        // Disable access to the page(s). It's faster for us to change the page access than it is to decommit or free the pages.
-        // However, this results in more committed physical memory usage than we would need if we instead decommitted the memory.
-        DWORD dwPrevAccesss = 0;
-        BOOL result = VirtualProtect(pPageMemory, OverrunPageEnabled ?  (blockSize - PageSize) : blockSize, PAGE_NOACCESS, &dwPrevAccesss);
-        OVR_ASSERT_AND_UNUSED(result, result);
-    #else
-        OVR_UNUSED2(pPageMemory, blockSize);
-    #endif
-}
+    for (size_t i = 0; (i < capacity) && (i < SizeClassCount); i++)
+    {
+        stats[i].BlockSize   = SizeClassSizes[i];
+        stats[i].AllocCount  = Central[i].AllocCount.load(std::memory_order_relaxed);
+        stats[i].FreeCount   = Central[i].FreeCount.load(std::memory_order_relaxed);
+        stats[i].SpanCount   = Central[i].SpanCount.load(std::memory_order_relaxed);
+        stats[i].RefillCount = Central[i].RefillCount.load(std::memory_order_relaxed);
+        stats[i].ReturnCount = Central[i].ReturnCount.load(std::memory_order_relaxed);
+    }
 
+    return SizeClassCount;
+}
 
-void DebugPageHeap::FreePageMemory(void* pPageMemory, size_t /*blockSize*/)
+void PoolHeap::GetStats(Stats& stats) const
 {
-    #if defined(_WIN32)    
-        BOOL result = VirtualFree(pPageMemory, 0, MEM_RELEASE);
-        OVR_ASSERT_AND_UNUSED(result, result);
-    #else
-        OVR_UNUSED(pPageMemory);
-    #endif
+    stats.LargeAllocCount  = LargeAllocCount.load(std::memory_order_relaxed);
+    stats.LargeFreeCount   = LargeFreeCount.load(std::memory_order_relaxed);
+    stats.ReservedBytes    = RegionSize;
+    stats.CommittedBytes   = SpanCount * SpanSize;
+    stats.ThreadCacheCount = ThreadCacheCount;
 }
 
 
@@ -3313,6 +6446,7 @@ int AllocatorReportStateDbgCmd(const std::vector<std::string>&, std::string* out
         bool     debugPageHeapEnabled   = allocator->IsDebugPageHeapEnabled();
         bool     osHeapEnabled          = allocator->IsOSHeapEnabled();
         bool     mallocRedirectEnabled  = allocator->IsMallocRedirectEnabled();
+        uint32_t trackingSampleRate     = allocator->GetTrackingSampleRate();
         bool     traceOnShutdownEnabled = allocator->IsAllocationTraceOnShutdownEnabled();
         uint64_t heapTimeNs             = allocator->GetCurrentHeapTimeNs();
         uint64_t heapCounter            = allocator->GetCounter();
@@ -3341,6 +6475,7 @@ int AllocatorReportStateDbgCmd(const std::vector<std::string>&, std::string* out
         std::stringstream strStream;
         
         strStream << "Memory tracking: " << (trackingEnabled ? "enabled." : "disabled.") << std::endl;
+        strStream << "Tracking sample rate: 1 in " << trackingSampleRate << std::endl;
         strStream << "Underlying heap: " << (debugPageHeapEnabled ? "debug page heap." : (osHeapEnabled ? "os heap." : "malloc-based heap.")) << std::endl;
         strStream << "malloc redirection: " << (mallocRedirectEnabled ? "" : "not ") << "enabled." << std::endl;
         strStream << "Shutdown trace: " << (traceOnShutdownEnabled ? "" : "not ") << "enabled." << std::endl;
@@ -3350,6 +6485,17 @@ int AllocatorReportStateDbgCmd(const std::vector<std::string>&, std::string* out
         strStream << "Heap allocated volume: " << heapTrackedVolume << std::endl;
         strStream << "CRT type: " << crtName << std::endl;
         strStream << "Build type: " << buildName << std::endl;
+        strStream << "Thread tag stacks:" << std::endl;
+
+        allocator->EnumerateTagStacks([](uintptr_t context, uint32_t threadId, const char* const* tags, size_t tagCount)
+            {
+                std::stringstream& stream = *reinterpret_cast<std::stringstream*>(context);
+
+                stream << "    tid " << threadId << ":";
+                for (size_t i = 0; i < tagCount; ++i)
+                    stream << (i ? " > " : " ") << tags[i];
+                stream << std::endl;
+            }, (uintptr_t)&strStream);
         
         std::string str = strStream.str();
         output->append(str.data(), str.length()); // We don't directly assign string objects because currently we are crossing a DLL boundary between these two strings.
@@ -413,6 +413,120 @@ public:
 };
 
 
+//-----------------------------------------------------------------------------------
+// ***** StdAllocatorHeap
+//
+// Like StdAllocatorSysMem, but allocates from a given Heap instance, such as a
+// LinearArenaHeap or FrameArena. The heap must outlive the container.
+//
+// Example usage:
+//     typedef std::vector<Layer, StdAllocatorHeap<Layer>> LayerArray;
+//     LayerArray layers((StdAllocatorHeap<Layer>(&frameArena)));
+//
+template <class T>
+class StdAllocatorHeap
+{
+public:
+    typedef StdAllocatorHeap<T>   this_type;
+    typedef T                     value_type;
+    typedef value_type*           pointer;
+    typedef const value_type*     const_pointer;
+    typedef void*                 void_pointer;
+    typedef const void*           const_void_pointer;
+    typedef value_type&           reference;
+    typedef const value_type&     const_reference;
+    typedef size_t                size_type;
+    typedef ptrdiff_t             difference_type;
+
+    // The heap travels with the memory, so containers take it along when they move or swap.
+    typedef std::false_type propagate_on_container_copy_assignment;
+    typedef std::true_type  propagate_on_container_move_assignment;
+    typedef std::true_type  propagate_on_container_swap;
+
+    this_type select_on_container_copy_construction() const
+    {
+        return *this;
+    }
+
+    template <class Other>
+    struct rebind
+    {
+        typedef StdAllocatorHeap<Other> other;
+    };
+
+    explicit StdAllocatorHeap(Heap* heap)
+      : HeapInstance(heap)
+    {
+    }
+
+    StdAllocatorHeap(const this_type& other)
+      : HeapInstance(other.HeapInstance)
+    {
+    }
+
+    template <class Other>
+    StdAllocatorHeap(const StdAllocatorHeap<Other>& other)
+      : HeapInstance(other.GetHeap())
+    {
+    }
+
+    bool operator==(const this_type& other) const
+    {
+        return (HeapInstance == other.HeapInstance);
+    }
+
+    bool operator!=(const this_type& other) const
+    {
+        return (HeapInstance != other.HeapInstance);
+    }
+
+    void deallocate(pointer p, size_type) const
+    {
+        if(p)
+            HeapInstance->FreeAligned(p);
+    }
+
+    pointer allocate(size_type n) const
+    {
+        void* pVoid = HeapInstance->AllocAligned(n * sizeof(T), alignof(T));
+        if(!pVoid)
+            throw ::std::bad_alloc();
+        return (pointer)pVoid;
+    }
+
+    pointer allocate(size_type n, const void*) const
+    {
+        return allocate(n);
+    }
+
+    template <class U, class... Types>
+    void construct(U* pU, Types&&... args) const
+    {
+        ::new ((void*)pU) U(std::forward<Types>(args)...);
+    }
+
+    template <class U>
+    void destroy(U* pU) const
+    {
+        pU->~U();
+        OVR_UNUSED(pU); // VC++ mistakenly claims it's unused unless we do this.
+    }
+
+    size_t max_size() const
+    {
+        return ((size_t)(-1) / sizeof(T));
+    }
+
+    Heap* GetHeap() const
+    {
+        return HeapInstance;
+    }
+
+protected:
+    Heap* HeapInstance;
+};
+
+
 class InterceptCRTMalloc;
 
 
@@ -474,6 +588,283 @@ enum AllocMetadataFlags
 };
 
 
+//-----------------------------------------------------------------------------------
+// ***** StackTraceTable
+//
+// Insert-only table of interned backtraces. Identical backtraces are stored once and
+// referred to by a small id, so a tracked allocation needs a uint32_t instead of its
+// own copy of the frames. Intern and GetFrames are lock-free and may be called from 
+// any thread between Init and Shutdown; before Init completes they see an empty table. 
+// When the table is 3/4 full or its frame storage is exhausted, Intern returns 0, which 
+// means "no backtrace", without using up a slot.
+//
+class StackTraceTable
+{
+public:
+    StackTraceTable();
+    ~StackTraceTable();
+
+    // slotCapacity is rounded up to a power of two. 
+    bool Init(size_t slotCapacity = 65536, size_t frameCapacity = 1048576);
+    void Shutdown();
+
+    bool IsInitialized() const
+        { return (Slots.load(std::memory_order_acquire) != nullptr); }
+
+    // Returns the id of the interned copy of frames, or 0 if frameCount is 0 or there's no room.
+    uint32_t Intern(void* const* frames, size_t frameCount);
+
+    // Returns the frame count of a stack returned by Intern, and sets frames to point to them.
+    // Returns 0 for a stackId of 0.
+    size_t GetFrames(uint32_t stackId, void* const*& frames) const;
+
+    // Returns the number of distinct stacks.
+    size_t GetCount() const
+        { return Count; }
+
+    // Returns the largest stack id Intern can return.
+    size_t GetCapacity() const
+        { return SlotCapacity; }
+
+protected:
+    struct Slot
+    {
+        std::atomic<uint64_t> Hash;         // 0 means the slot is unused.
+        std::atomic<uint32_t> FrameCount;   // Frame count + 1. 0 means the slot is still being written.
+        uint32_t              FrameOffset;  // Index of the first frame in Frames.
+    };
+
+    std::atomic<Slot*>  Slots;              // Published last by Init, so a reader that sees it sees the rest.
+    size_t              SlotCapacity;       // Power of two.
+    size_t              MaxCount;           // Load factor cap: 3/4 of SlotCapacity.
+    void**              Frames;
+    size_t              FrameCapacity;
+    std::atomic<size_t> FrameUsed;
+    std::atomic<size_t> Count;
+};
+
+
+//-----------------------------------------------------------------------------------
+// ***** TrackedAllocEntry
+//
+// Fixed-size record of a tracked allocation. This is the compact form of AllocMetadata
+// that the tracking table stores; the backtrace is an id into a StackTraceTable.
+//
+struct TrackedAllocEntry
+{
+    const void* Alloc;            // nullptr means the table slot is unused.
+    uint32_t    StackId;          // See StackTraceTable. 0 means no backtrace.
+    uint32_t    ThreadId;
+    const char* File;
+    int         Line;
+    const char* Tag;
+    uint64_t    TimeNs;
+    uint64_t    Count;
+    uint64_t    AllocSize;
+    uint64_t    BlockSize;
+    char        ThreadName[32];
+};
+
+typedef std::vector<TrackedAllocEntry, StdAllocatorSysMem<TrackedAllocEntry>> TrackedAllocEntryVector;
+
+
+//-----------------------------------------------------------------------------------
+// ***** TrackedAllocTable
+//
+// Hash table of TrackedAllocEntry, keyed by pointer. The table is split into shards by
+// pointer hash, each with its own lock and its own open-addressed array, so threads 
+// allocating and freeing concurrently rarely contend. Memory comes from SysMemAlloc.
+//
+class TrackedAllocTable
+{
+public:
+    static const size_t ShardCount = 64;  // Must be a power of two.
+
+    TrackedAllocTable();
+    ~TrackedAllocTable();
+
+    // Adds entry, replacing any existing entry for entry.Alloc.
+    // Returns false if the table couldn't grow to fit it.
+    bool Insert(const TrackedAllocEntry& entry);
+
+    // Returns true if p was found and removed, and copies its entry if removed is non-null.
+    bool Remove(const void* p, TrackedAllocEntry* removed = nullptr);
+
+    // Returns true if p was found, and copies its entry if entry is non-null.
+    bool Find(const void* p, TrackedAllocEntry* entry);
+
+    // Removes all entries with an address in [begin, end).
+    void RemoveRange(const void* begin, const void* end);
+
+    // Removes all entries and frees the table memory.
+    void Clear();
+
+    // Returns the number of entries. Not exact while other threads are modifying the table.
+    size_t GetCount() const;
+
+    // Iteration: LockAll, then call GetNext with shardIndex and slotIndex initialized 
+    // to 0 until it returns nullptr, then UnlockAll.
+    void LockAll();
+    void UnlockAll();
+    const TrackedAllocEntry* GetNext(size_t& shardIndex, size_t& slotIndex) const;
+
+    // Appends a copy of every entry to entries. Shards are locked one at a time, so this never
+    // blocks all allocating threads at once, though it isn't an atomic copy of the whole table.
+    void Snapshot(TrackedAllocEntryVector& entries);
+
+protected:
+    struct Shard
+    {
+        OVR::Lock          ShardLock;
+        TrackedAllocEntry* Entries;     // Linear probing. Entries[i].Alloc == nullptr means unused.
+        size_t             Capacity;    // 0 or a power of two.
+        size_t             Size;
+        char               Pad[64];     // Keeps each shard's lock and counters on their own cache line.
+
+        Shard() : ShardLock(), Entries(nullptr), Capacity(0), Size(0) {}
+    };
+
+    static uint64_t HashPointer(const void* p)
+        { return ((uint64_t)(uintptr_t)p * UINT64_C(0x9E3779B97F4A7C15)); }
+
+    Shard& GetShard(uint64_t hash)
+        { return Shards[hash >> (64 - 6)]; } // The top 6 bits pick one of the 64 shards. The slot is picked by lower bits.
+
+    static size_t GetHomeSlot(uint64_t hash, size_t capacity)
+        { return ((size_t)(hash >> 24) & (capacity - 1)); }
+
+    static size_t FindSlot(const Shard& shard, const void* p, uint64_t hash); // Returns shard.Capacity if not found.
+    static void   RemoveSlot(Shard& shard, size_t slot);
+    static bool   Grow(Shard& shard);
+
+    Shard Shards[ShardCount];
+};
+
+
+//-----------------------------------------------------------------------------------
+// ***** AllocationProfiler
+//
+// Low-overhead sampling heap profiler. See Allocator::EnableAllocationProfiler.
+// Each thread counts down a random number of bytes, drawn from an exponential distribution
+// whose mean is the sample interval, and samples the allocation in which the count runs out.
+// That samples allocated bytes as a Poisson process, and each sample is weighted by the bytes
+// it stands for, so the totals are unbiased estimates. Samples are aggregated by allocation tag
+// and by interned call stack, both cumulatively and as live (not yet freed) bytes.
+// Nothing here takes a lock that allocation takes, so the data can be read and exported 
+// while other threads keep allocating. Such reads are approximate snapshots.
+//
+class AllocationProfiler
+{
+public:
+    AllocationProfiler();
+    ~AllocationProfiler();
+
+    // Allocates the profiler's tables if needed and starts sampling.
+    bool Init(uint64_t sampleIntervalBytes);
+
+    // Frees the tables. No other thread may be allocating or freeing through the owner.
+    void Shutdown();
+
+    // Stops or resumes sampling. Frees of already sampled allocations are still accounted for.
+    void SetEnabled(bool enabled)
+        { Enabled.store(enabled && IsInitialized(), std::memory_order_release); }
+
+    bool IsEnabled() const
+        { return Enabled.load(std::memory_order_relaxed); }
+
+    bool IsInitialized() const
+        { return Initialized.load(std::memory_order_acquire); }
+
+    uint64_t GetSampleInterval() const
+        { return SampleInterval; }
+
+    struct TagStats
+    {
+        const char* Tag;
+        int64_t     LiveBytes;      // Estimated bytes allocated with this tag and not yet freed.
+        int64_t     LiveCount;      // Samples not yet freed.
+        uint64_t    TotalBytes;     // Estimated bytes allocated with this tag since profiling began.
+        uint64_t    TotalCount;     // Samples since profiling began.
+    };
+
+    // Writes up to capacity entries, one per tag seen so far, and returns the number of tags.
+    size_t GetTagStats(TagStats* stats, size_t capacity) const;
+
+    enum ProfileValue
+    {
+        PVLiveBytes,
+        PVLiveCount,
+        PVTotalBytes,
+        PVTotalCount
+    };
+
+    // Writes one line per call stack, in the folded format read by flame graph tools, e.g.:
+    //     main;App::Update;Mesh::Load 1048576
+    // Frames are outermost first. Stacks whose value is 0 are omitted. If symbolize is true then
+    // frames are written as function names where symbols are available, else as addresses.
+    // Returns the number of lines written.
+    typedef void (*ProfileTextCallback)(uintptr_t context, const char* text);
+    size_t ExportFoldedStacks(ProfileValue value, bool symbolize, ProfileTextCallback callback, uintptr_t context) const;
+
+    // Adds a point of per-tag live bytes to the time series. Call this periodically, such as once 
+    // per frame or once per second. The most recent TimeSeriesCapacity points are kept.
+    void RecordTimePoint();
+
+    // Writes the time series as CSV: a header line of time_ms and the tag names, then one line
+    // per point, oldest first. Returns the number of points written.
+    size_t ExportTimeSeries(ProfileTextCallback callback, uintptr_t context);
+
+    // Called by Allocator for every allocation and free while initialized.
+    // ShouldSample is cheap; RecordSample is called only when it returns true.
+    bool ShouldSample(size_t size);
+    void RecordSample(const void* p, size_t size, const char* tag);
+    void OnFree(const void* p);
+
+    static const size_t TagCapacity        = 256;   // Tags beyond this many are counted as "(other)".
+    static const size_t TimeSeriesCapacity = 512;
+    static const size_t MaxFrames          = 64;
+
+protected:
+    struct Counters
+    {
+        std::atomic<int64_t>  LiveBytes;
+        std::atomic<int64_t>  LiveCount;
+        std::atomic<uint64_t> TotalBytes;
+        std::atomic<uint64_t> TotalCount;
+    };
+
+    struct TagSlot
+    {
+        std::atomic<const char*> Tag;   // nullptr means unused.
+        Counters                 Stats;
+    };
+
+    static const size_t SampledFilterSize = 65536;
+
+    size_t GetTagSlot(const char* tag); // Returns TagCapacity (the "(other)" slot) if the table is full.
+    uint64_t NextSampleInterval();
+    static int64_t GetCounterValue(const Counters& counters, ProfileValue value);
+
+    static size_t GetFilterIndex(const void* p)
+        { return (size_t)(((uint64_t)(uintptr_t)p * UINT64_C(0x9E3779B97F4A7C15)) >> 48); }
+
+    std::atomic<bool>      Initialized;
+    std::atomic<bool>      Enabled;
+    uint64_t               SampleInterval;      // Mean bytes between samples.
+    StackTraceTable        Stacks;
+    Counters*              StackStats;          // Indexed by stack id. Index 0 is for samples without a stack.
+    size_t                 StackStatsCount;     // Stacks.GetCapacity() + 1
+    TagSlot*               Tags;                // TagCapacity + 1 slots. The last one is "(other)".
+    TrackedAllocTable      Samples;             // Live sampled allocations. StackId is the stack, BlockSize the weight.
+    std::atomic<uint32_t>* SampledFilter;       // Live samples per pointer hash, so frees of unsampled pointers skip Samples.
+    uint64_t*              TimeSeriesTimes;     // Ring buffer of TimeSeriesCapacity heap times.
+    int64_t*               TimeSeriesValues;    // Ring buffer of TimeSeriesCapacity rows of (TagCapacity + 1) live byte counts.
+    size_t                 TimeSeriesNext;
+    size_t                 TimeSeriesCount;
+    OVR::Lock              TimeSeriesLock;      // Guards the time series. Not used when allocating.
+};
+
+
 //-----------------------------------------------------------------------------------
 // ***** Allocator
 //
@@ -563,6 +954,20 @@ public:
     const Heap* GetHeap() const
         { return Heap; }
 
+    // Makes this Allocator use a heap owned by the caller instead of choosing one in Init,
+    // e.g. a FrameArena, so that AllocatorTagScope and tracking work with it as with any
+    // other Allocator. Must be called before Init. The heap must already be initialized 
+    // and must outlive this Allocator.
+    bool SetHeap(OVR::Heap* heap);
+
+    // Forgets tracked allocations within [begin, end) without freeing them. This is for
+    // heaps that release memory in bulk rather than via Free, such as LinearArenaHeap::Reset.
+    void UntrackRange(const void* begin, const void* end);
+
+    // Like UntrackRange, for one allocation whose exact pointer is known. This only looks in
+    // the table shard the pointer hashes to, where UntrackRange scans every shard.
+    void UntrackPointer(const void* p);
+
 public:
     // Names the Allocator. Useful for identifying one of multiple Allocators within a process.
     // The name is copied from the allocatorName argument.
@@ -577,6 +982,33 @@ public:
     bool IsTrackingEnabled() const
         { return TrackingEnabled; }
 
+    // If sampleRate is greater than 1 then tracking records only about one in sampleRate 
+    // allocations, which makes tracking cheap enough to leave on in production builds.
+    // Leak reports and heap iteration then see only the sampled allocations. Since an 
+    // unsampled pointer looks the same as a pointer that isn't ours, double-free detection 
+    // is lost, and sampling is ignored when malloc redirection or the debug page heap is used.
+    // Must be called before the Init function.
+    bool SetTrackingSampleRate(uint32_t sampleRate);
+
+    uint32_t GetTrackingSampleRate() const
+        { return TrackingSampleRate; }
+
+    // Starts the sampling allocation profiler with a mean of one sample per sampleIntervalBytes 
+    // allocated, or changes the interval if it's already running. Unlike tracking, the profiler 
+    // can be started and stopped at any time after Init. See AllocationProfiler.
+    bool EnableAllocationProfiler(uint64_t sampleIntervalBytes = 512 * 1024);
+
+    // Stops taking samples. Data gathered so far remains readable, and frees of sampled
+    // allocations keep being accounted for.
+    void DisableAllocationProfiler();
+
+    bool IsAllocationProfilerEnabled() const
+        { return Profiler.IsEnabled(); }
+
+    // The profiler's data can be read and exported from here until Shutdown.
+    AllocationProfiler& GetAllocationProfiler()
+        { return Profiler; }
+
     // If enabled then the debug page is used. 
     // Must be called before the Init function.
     bool EnableDebugPageHeap(bool enable);
@@ -584,6 +1016,13 @@ public:
     bool IsDebugPageHeapEnabled() const
         { return DebugPageHeapEnabled; }
 
+    // If enabled then the PoolHeap is used. The debug page heap takes precedence.
+    // Must be called before the Init function.
+    bool EnablePoolHeap(bool enable);
+
+    bool IsPoolHeapEnabled() const
+        { return PoolHeapEnabled; }
+
     bool IsOSHeapEnabled() const
         { return OSHeapEnabled; }
 
@@ -615,6 +1054,15 @@ public:
     const AllocMetadata* IterateHeapNext();
     void                 IterateHeapEnd();
 
+    // Copies the tracked allocation records into entries, replacing its contents. Unlike heap 
+    // iteration, this holds each tracking table lock only while copying that part of the table, 
+    // so the records can be examined at leisure afterward without stalling the application.
+    // Returns the number of entries copied, which is 0 if tracking is disabled.
+    size_t SnapshotTrackedAllocations(TrackedAllocEntryVector& entries);
+
+    // Expands a tracked allocation record into an AllocMetadata, including its backtrace.
+    void GetEntryMetadata(const TrackedAllocEntry& entry, AllocMetadata& amd) const;
+
     // Given an AllocationMetaData, this function writes it to a string description.
     // For amdFlags, see AllocMetadataFlags. 
     // Returns the required strlen of the description (like the strlcpy function, etc.)
@@ -624,7 +1072,9 @@ public:
     // purpose of reporting leaked memory on application or module shutdown.
     // This should be used instead of, for example, VC++ _CrtDumpMemoryLeaks 
     // because it allows us to dump additional information about our allocations.
-    // Returns the number of currently outstanding heap allocations.
+    // Allocations are reported once per unique backtrace, with their count and total size, 
+    // largest total first. Each distinct return address is symbolized only once per report.
+    // Returns the number of reported outstanding heap allocations.
     // If the callback is valid, this function iteratively calls the callback with 
     // output. If the callback is nullptr then this function debug-traces the output.
     // The callback context is an arbitrary user-supplied value.
@@ -653,7 +1103,7 @@ public:
         { return CurrentCounter++; } // Post-increment here is by design.
 
 protected:
-    void SetNewBlockMetadata(Allocator* allocator, AllocMetadata& amd, const void* alloc, uint64_t allocSize, uint64_t blockSize, 
+    void SetNewBlockMetadata(Allocator* allocator, TrackedAllocEntry& entry, const void* alloc, uint64_t allocSize, uint64_t blockSize, 
                                 const char* file, int line, const char* tag, void** backtraceArray, size_t backtraceArraySize);
 
     // Add the allocation & the callstack to the tracking database.
@@ -672,6 +1122,9 @@ protected:
     // Returns a copy of the AllocMetadata. 
     bool GetAllocMetadata(const void* p, AllocMetadata& metadata);
 
+    // Returns the tag p was allocated with, or nullptr if p isn't tracked.
+    const char* GetAllocTag(const void* p);
+
 public:
     // Tag push/pop API
 
@@ -685,47 +1138,62 @@ public:
     // Returns a default string if there is no current tag set for the current thread.
     const char* GetTag(const char* defaultTag = nullptr);
 
-protected:
-    // This is called periodically to purge the map of elements that correspond to threads that no longer exist.
-    void PurgeTagMap();
+    // Calls the callback once for each thread that has pushed a tag and not yet exited, with 
+    // its tags from the bottom of the stack up. This is a snapshot: other threads keep pushing 
+    // and popping while it runs, so a stack may be seen in the middle of a change.
+    typedef void (*TagStackCallback)(uintptr_t context, uint32_t threadId, const char* const* tags, size_t tagCount);
+    void EnumerateTagStacks(TagStackCallback callback, uintptr_t context);
+
+    // Called by the OS when a thread that has a tag stack exits.
+    static void OnTagThreadExit(void* tagStack);
+
+    // Tags pushed beyond this depth aren't recorded. GetTag then returns the deepest recorded tag.
+    static const size_t MaxTagDepth = 32;
 
 protected:
-    // Tracked allocations
-    #if defined(OVR_BUILD_DEBUG)
-        typedef std::map<const void*, AllocMetadata, std::less<const void*>, // map is slower but in debug builds we can read its sorted contents easier.
-                          StdAllocatorSysMem<std::pair<const void* const, AllocMetadata> > > TrackedAllocMap;
-    #else
-        typedef std::unordered_map<const void*, AllocMetadata, std::hash<const void*>, std::equal_to<const void*>, 
-                          StdAllocatorSysMem<std::pair<const void* const, AllocMetadata> > > TrackedAllocMap;
-    #endif
+    // Per-thread tag stack. Only its own thread writes it, so push, pop and get take no lock.
+    struct ThreadTagStack
+    {
+        Allocator*            Owner;
+        ThreadTagStack*       Prev;                 // Links of TagStackList.
+        ThreadTagStack*       Next;                 // 
+        uint32_t              ThreadId;
+        std::atomic<uint32_t> Depth;                // Pushes minus pops. May exceed MaxTagDepth.
+        const char*           Tags[MaxTagDepth];
+    };
 
-    // Per-thread tag stack
-    typedef std::vector<const char*, StdAllocatorSysMem<const char*>> ConstCharVector;
-    #if defined(OVR_BUILD_DEBUG)
-        typedef std::map<uint32_t, ConstCharVector, std::less<uint32_t>, 
-                          StdAllocatorSysMem<std::pair<const uint32_t,ConstCharVector>>> ThreadIdToTagVectorMap;
-    #else
-        typedef std::unordered_map<uint32_t, ConstCharVector, std::hash<uint32_t>, std::equal_to<uint32_t>, 
-                          StdAllocatorSysMem<std::pair<const uint32_t,ConstCharVector>>> ThreadIdToTagVectorMap;
-    #endif
+    ThreadTagStack* GetThreadTagStack(bool create);
+    void ReleaseThreadTagStack(ThreadTagStack* stack);
+    void ReleaseTagStacks();
 
     char                            AllocatorName[64];           // The name of this allocator. Useful because we could have multiple instances within a process.
     Heap*                           Heap;                        // The underlying heap we are using.
+    OVR::Heap*                      ExternalHeap;                // Heap supplied via SetHeap, which we don't own.
     bool                            DebugPageHeapEnabled;        // If enabled then we use our DebugPageHeap instead of DefaultHeap or OSheap.
     bool                            OSHeapEnabled;               // If enabled then we use our OSHeap instead of DebugPageHeap or DefaultHeap.
+    bool                            PoolHeapEnabled;             // If enabled then we use our PoolHeap instead of OSHeap or DefaultHeap.
     bool                            MallocRedirectEnabled;       // If enabled then we redirect CRT malloc to ourself (only if we are the default global allocator).
     InterceptCRTMalloc*             MallocRedirect;              // 
     bool                            TrackingEnabled;             // 
     bool                            TraceAllocationsOnShutdown;  // If true then we do a debug trace of allocations on our shutdown.
-    OVR::Lock                       TrackLock;                   // Thread-exclusive access to AllocationMap.
-    TrackedAllocMap::const_iterator TrackIterator;               // Valid only between IterateHeapBegin and IterateHeapEnd.
-    TrackedAllocMap                 AllocationMap;               // 
+    uint32_t                        TrackingSampleRate;          // Track one in this many allocations. 1 means track all.
+    OVR::Lock                       TrackLock;                   // Serializes heap iteration and tracking configuration changes. TrackAlloc and UntrackAlloc don't use it.
+    TrackedAllocTable               AllocationTable;             // Tracked allocations.
+    StackTraceTable                 BacktraceTable;              // Interned backtraces of tracked allocations.
+    size_t                          TrackIteratorShard;          // Valid only between IterateHeapBegin and IterateHeapEnd.
+    size_t                          TrackIteratorSlot;           // "
+    AllocMetadata                   TrackIteratorMetadata;       // " The entry most recently returned, expanded.
+    AllocationProfiler              Profiler;                    // Sampling profiler. Independent of tracking.
     SysAllocatedPointerVector       DelayedFreeList;             // Used when we are overriding CRT malloc and need to call CRT free on some pointers after we've restored it.
     SysAllocatedPointerVector       DelayedAlignedFreeList;      // "
     std::atomic_ullong              CurrentCounter;              // Ever-increasing count of allocation requests.
     bool                            SymbolLookupEnabled;         //
-    ThreadIdToTagVectorMap          TagMap;                      // 
-    OVR::Lock                       TagMapLock;                  // Thread-exclusive access to TagMap.
+    uint64_t                        TagInstanceId;               // Unique per Allocator, so thread-local tag stack pointers can't be mistaken for another Allocator's.
+    uintptr_t                       TagTlsKey;                   // OS thread-local slot whose destructor releases tag stacks.
+    bool                            TagTlsKeyValid;              // 
+    ThreadTagStack*                 TagStackList;                // All tag stacks, for enumeration and destruction.
+    size_t                          TagStackCount;               // 
+    OVR::Lock                       TagStackLock;                // Guards TagStackList and TagStackCount. Not used by PushTag, PopTag or GetTag.
     static Allocator*               DefaultAllocator;            // Default instance.
     static uint64_t                 ReferenceHeapTimeNs;         // The time that GetCurrentHeapTimeNs reports relative to. In practice this is the time of application startup.
 
@@ -804,18 +1272,30 @@ public:
 //      ThreadId                 ==,<,<=,>,>=    <integer>       <,<=,>,>= are usually useless but provided for consistency with other integer types.
 //      ThreadName               ==,has          <string>        case insensitive. has means substring check.
 //
+// Evaluation works on a snapshot of the allocator's tracking records rather than on the live 
+// heap: IterateHeapBegin copies the records out (see Allocator::SnapshotTrackedAllocations),
+// then runs the filter over the copy without holding any heap lock, splitting large snapshots 
+// across threads. Compile lowercases the string comparands up front, and the results of File 
+// and Tag comparisons are memoized by string address, since those are nearly always literals 
+// shared by many allocations.
+//
 struct HeapIterationFilterRPN
 {
     HeapIterationFilterRPN();
 
     bool SetFilter(Allocator* allocator, const char* filter);
 
-    // This is the same as Allocator::IterateHeapBegin, except it returns only 
-    // values that match the filter specification.
+    // This is the same as Allocator::IterateHeapBegin, except it returns only values that 
+    // match the filter specification, and the heap isn't locked during the iteration.
+    // Allocations made or freed after IterateHeapBegin aren't reflected in the results.
     const AllocMetadata* IterateHeapBegin();
     const AllocMetadata* IterateHeapNext();
     void                 IterateHeapEnd();
 
+    // Returns the number of allocations matched by the most recent IterateHeapBegin.
+    size_t GetMatchCount() const
+        { return MatchCount; }
+
     // This is a one-shot filtered tracing function. 
     // Example usage:
     //     auto printfCallback = [](uintptr_t, const char* text)->void{ printf("%s\n", text); };
@@ -831,9 +1311,10 @@ protected:
         AllocMetadataFlags metadataType;  // e.g. AMFAllocSize
         Comparison         comparison;    // e.g. CmpLE
         int64_t            numValue;      // Applies to numeric AllocMetadataFlags types.
-        char               strValue[256]; // Applies to string AllocMetadataFlags types.
+        char               strValue[256]; // Applies to string AllocMetadataFlags types. Lowercased by Compile.
+        size_t             strLength;
 
-        Operand() : metadataType(AMFNone), comparison(CmpNone), numValue(0), strValue{} {}
+        Operand() : metadataType(AMFNone), comparison(CmpNone), numValue(0), strValue{}, strLength(0) {}
     };
 
     // An instruction is either an operation or an operand. We could use a union to represent
@@ -846,15 +1327,34 @@ protected:
         Operand   operand; 
     };
 
-    bool Compile(const char* filter);           // Returns false upon syntax error.
-    bool Evaluate(const AllocMetadata* amd);    // Returns true if amd matches the filter.
-    bool EvaluateOperand(const Operand& operand, const AllocMetadata* amd) const;
+    // String operand results by string address, one cache per instruction. Direct-mapped; 
+    // a collision just means the string gets compared again.
+    struct StringMatchCache
+    {
+        const char* Key[64];
+        bool        Result[64];
+    };
+
+    bool Compile(const char* filter);                                            // Returns false upon syntax error.
+    bool Evaluate(const TrackedAllocEntry& entry, StringMatchCache* caches) const; // Returns true if entry matches the filter.
+    bool EvaluateOperand(const Operand& operand, const TrackedAllocEntry& entry, StringMatchCache& cache) const;
+    void EvaluateRange(size_t begin, size_t end);                                // Sets MatchFlags for Snapshot[begin, end).
+
+    static bool MatchString(const Operand& operand, const char* str);
+
+    typedef std::vector<uint8_t, StdAllocatorSysMem<uint8_t>> MatchFlagVector;
 
 protected:
-    Allocator*  AllocatorInstance;      // The Allocator we execute the filter against.
-    const char* Filter;                 // The string-based filter gets converted into the Instructions, which can be executed per alloc.
-    Instruction Instructions[32];       // Array of instructions to execute. 0-terminated.
-    uint64_t    CurrentHeapTimeNs;      // The time at the start of evaluation. Used for time comparisons.
+    Allocator*              AllocatorInstance;      // The Allocator we execute the filter against.
+    const char*             Filter;                 // The string-based filter gets converted into the Instructions, which can be executed per alloc.
+    Instruction             Instructions[32];       // Array of instructions to execute. 0-terminated.
+    size_t                  InstructionCount;       // Count of Instructions before the terminating one.
+    uint64_t                CurrentHeapTimeNs;      // The time at the start of evaluation. Used for time comparisons.
+    TrackedAllocEntryVector Snapshot;               // Taken by IterateHeapBegin.
+    MatchFlagVector         MatchFlags;             // Per Snapshot entry, nonzero if it matches.
+    size_t                  MatchCount;
+    size_t                  SnapshotIndex;          // The next Snapshot entry IterateHeapNext considers.
+    AllocMetadata           CurrentMetadata;        // The match most recently returned, expanded.
 };
 
 
@@ -890,12 +1390,45 @@ public:
 //
 // Delegates to OS heap functions instead of malloc/free/new/delete.
 //
+// Optionally, blocks at or above a size threshold bypass the OS heap and are mapped directly,
+// backed by huge pages and bound to a NUMA node (see SetLargeBlockOptions). That's for large 
+// buffers that are accessed all over, such as history and capture rings, whose working set 
+// otherwise spans many more 4 KB pages than the TLB covers. 
+//
 class OSHeap : public Heap
 {
 public:
     OSHeap();
    ~OSHeap();
 
+    enum PageMode
+    {
+        PageModeNormal,         // Large blocks use the default page size.
+        PageModeTransparent,    // Large blocks are huge page aligned and marked for transparent huge pages (Linux). Windows has no such thing and uses normal pages.
+        PageModeExplicit        // Large blocks use reserved huge pages (Linux MAP_HUGETLB, Windows MEM_LARGE_PAGES, which needs the "Lock pages in memory" privilege).
+                                // Falls back to PageModeTransparent when none are available, and on to normal pages where that isn't supported.
+    };
+
+    // Must be called before Init. A largeBlockThreshold of 0 (the default) disables large block 
+    // mapping. numaNode is the node large blocks are bound to, or -1 to leave placement to the OS.
+    void SetLargeBlockOptions(size_t largeBlockThreshold, PageMode pageMode, int numaNode = -1);
+
+    struct LargeBlockStats
+    {
+        uint64_t ExplicitCount;     // Large blocks mapped with explicit huge pages since Init.
+        uint64_t TransparentCount;  // Large blocks mapped for transparent huge pages since Init.
+        uint64_t NormalCount;       // Large blocks mapped with normal pages since Init.
+        uint64_t FallbackCount;     // Large blocks that didn't get the PageMode asked for.
+        uint64_t NumaFailureCount;  // Large blocks that couldn't be bound to the NUMA node.
+        uint64_t LiveCount;         // Currently mapped large blocks.
+        uint64_t LiveBytes;         // Their mapped size, including page rounding.
+    };
+
+    void GetLargeBlockStats(LargeBlockStats& stats) const;
+
+    // Returns true if p is a large block (as opposed to an OS heap block).
+    bool IsLargeBlock(const void* p) const;
+
     virtual bool  Init();
     virtual void  Shutdown();
 
@@ -909,9 +1442,38 @@ public:
     virtual void*  ReallocAligned(void* p, size_t newSize, size_t newAlign);
 
 protected:
+    // Stored at the start of a large block's mapping, right before the user's memory. 
+    struct LargeBlockHeader
+    {
+        uint64_t Magic;         // LargeBlockMagic ^ the header's address.
+        size_t   MappingSize;
+        size_t   UserSize;
+        PageMode Mode;          // The PageMode the block actually got.
+    };
+
+    static const size_t   LargeBlockHeaderSize = 64;    // Keeps the user memory 64 byte aligned. Less than the normal page size, which IsLargeBlock relies on.
+    static const uint64_t LargeBlockMagic = UINT64_C(0x4f53486561704c42);
+
+    void* AllocLarge(size_t size);
+    void  FreeLarge(void* p);
+    void* MapLargeBlock(size_t size, size_t& mappingSize, PageMode& mode);
+    void  UnmapLargeBlock(void* mapping, size_t mappingSize);
+
     #if defined(_WIN32)
         HANDLE Heap;    // Windows heap handle.
     #endif
+
+    size_t                LargeBlockThreshold;  // 0 if large blocks are disabled.
+    PageMode              LargePageMode;
+    int                   NumaNode;             // -1 for none.
+    size_t                PageSize;
+    size_t                HugePageSize;         // Explicit huge page size. 0 if the system doesn't support huge pages.
+    size_t                TransparentPageSize;  // Transparent huge page size (the PMD size on Linux). 0 if unsupported.
+    std::atomic<uint64_t> StatCount[3];         // Per PageMode.
+    std::atomic<uint64_t> FallbackCount;
+    std::atomic<uint64_t> NumaFailureCount;
+    std::atomic<uint64_t> LiveCount;
+    std::atomic<uint64_t> LiveBytes;
 };
 
 
@@ -1069,6 +1631,381 @@ protected:
 
 
 
+//------------------------------------------------------------------------
+// ***** LinearArenaHeap
+//
+// Implements a bump allocator for short-lived scratch memory, such as per-frame data
+// (layer descriptors, culling lists, temporary strings):
+//   Allocation moves a pointer through a single preallocated block. There is no per-
+//       allocation bookkeeping beyond a small header, and allocation is lock-free.
+//   Free does nothing except for the most recent allocation, whose space is given back.
+//       Everything is released at once by Reset.
+//   When the block is exhausted, allocations overflow to a backing heap (DefaultHeap
+//       unless one is supplied) and are counted. They are released by Reset as well, or
+//       earlier by Free. With EnableGrowOnOverflow, Reset enlarges the block to fit the
+//       peak usage it saw, so a steady workload stops overflowing after one frame.
+//   Reset must not race with other calls. Everything else may be called from any thread,
+//       unless thread safety is disabled via SetThreadSafe(false), which makes allocation
+//       cheaper for arenas that only one thread uses (e.g. render thread scratch memory).
+//
+// A LinearArenaHeap can serve as the heap of an Allocator (see Allocator::SetHeap), which
+// gives it tags via AllocatorTagScope and tracking. If that Allocator has tracking enabled,
+// pass it to SetAllocator so that Reset drops the records of the memory it releases.
+//
+// Example usage:
+//     LinearArenaHeap scratch(4 * 1024 * 1024);
+//     scratch.Init();
+//     while (running)
+//     {
+//         scratch.Reset();
+//         void* p = scratch.Alloc(size);
+//         ...
+//     }
+//
+class LinearArenaHeap : public Heap
+{
+public:
+    LinearArenaHeap(size_t capacity = DefaultCapacity, OVR::Heap* overflowHeap = nullptr);
+    virtual ~LinearArenaHeap();
+
+    virtual bool  Init();
+    virtual void  Shutdown();
+
+    virtual void*  Alloc(size_t size);
+    virtual void*  AllocAligned(size_t size, size_t align);
+    virtual size_t GetAllocSize(const void* p) const { return GetUserSize(p); }
+    virtual size_t GetAllocAlignedSize(const void* p, size_t /*align*/) const { return GetUserSize(p); }
+    virtual void   Free(void* p);
+    virtual void   FreeAligned(void* p) { Free(p); }
+    virtual void*  Realloc(void* p, size_t newSize);
+    virtual void*  ReallocAligned(void* p, size_t newSize, size_t newAlign);
+
+    // Releases all memory allocated since the last Reset, including overflow allocations.
+    void   Reset();
+
+    // Changes the block size. Takes effect at the next Reset.
+    void   SetCapacity(size_t capacity);
+    size_t GetCapacity() const { return Capacity; }
+
+    // Must be called before Init.
+    void   SetOverflowHeap(OVR::Heap* overflowHeap);
+
+    void   EnableGrowOnOverflow(bool enable) { GrowOnOverflow = enable; }
+    void   SetThreadSafe(bool threadSafe) { ThreadSafe = threadSafe; }
+
+    // Reset untracks what was allocated since the last Reset from allocator's tracking.
+    // Must be called before allocating, as only allocations made after it are untracked.
+    void   SetAllocator(Allocator* allocator);
+
+    // Returns true if p was allocated from the block (as opposed to the overflow heap).
+    bool   Owns(const void* p) const
+        { return ((uintptr_t)p - (uintptr_t)Base - 1) < Capacity; }
+
+    struct Stats
+    {
+        uint64_t UsedBytes;          // Block bytes in use now, including headers and alignment padding.
+        uint64_t PeakBytes;          // Highest block plus overflow usage seen by Reset so far.
+        uint64_t AllocCount;         // Allocations since Init, including overflow allocations.
+        uint64_t OverflowCount;      // Allocations since Init that went to the overflow heap.
+        uint64_t OverflowBytes;      // User bytes of those allocations.
+        uint64_t ResetCount;         // Resets since Init.
+    };
+
+    void GetStats(Stats& stats) const;
+
+    // Returns the size passed to Alloc for any allocation made by a LinearArenaHeap.
+    static size_t GetUserSize(const void* p);
+
+    static const size_t DefaultCapacity  = 1024 * 1024;
+    static const size_t DefaultAlignment = 16;
+
+protected:
+    // Precedes every allocation in the block. Size is last so that it's at the same place as in OverflowHeader.
+    struct BlockHeader
+    {
+        size_t Begin;                // Offset in the block at which this allocation's space (header and padding) starts.
+        size_t Size;                 // User size.
+    };
+
+    // Precedes every overflow allocation. Overflow allocations are kept in a list so that Reset can free them.
+    struct OverflowHeader
+    {
+        LinearArenaHeap* Owner;
+        OverflowHeader*  Prev;
+        OverflowHeader*  Next;
+        void*            Memory;     // What we got from OverflowHeap. The header and user memory are within it.
+        size_t           MemorySize; // Size of Memory.
+        size_t           Size;       // User size.
+    };
+
+    bool  MoveTop(size_t& expected, size_t desired);
+    void  CountAlloc(std::atomic_ullong& counter, uint64_t amount);
+    void* AllocOverflow(size_t size, size_t align);
+    void  FreeOverflow(OverflowHeader* header);
+    void  ReleaseOverflow();
+    void  RecordBlockAlloc(void* p);
+    void  UntrackBlock(size_t blockBytes);
+    bool  ReserveRecords(size_t capacity);
+    void  FreeRecords();
+    bool  MapBlock(size_t capacity);
+    void  UnmapBlock();
+
+    uint8_t*            Base;                   // The block.
+    size_t              Capacity;               // Size of the block.
+    size_t              NewCapacity;            // Capacity to switch to at the next Reset.
+    std::atomic<size_t> Top;                    // Offset of the first free byte in the block.
+    OVR::Heap*          OverflowHeap;           // Where allocations go when the block is full.
+    DefaultHeap         DefaultOverflowHeap;    // Used if no overflow heap was supplied.
+    OverflowHeader*     OverflowList;           // Overflow allocations not yet freed.
+    size_t              OverflowListBytes;      // Bytes taken from OverflowHeap by OverflowList.
+    OVR::Lock           OverflowLock;           // Guards OverflowList and OverflowListBytes.
+    bool                GrowOnOverflow;         // If true, Reset grows the block to fit the peak usage.
+    bool                ThreadSafe;             // If false, Top and the counters are updated without atomic read-modify-write.
+    Allocator*          TrackingAllocator;      // If set, Reset removes the released memory from its tracking.
+    void**              Records;                // Block allocations since the last Reset, kept while TrackingAllocator is set.
+    size_t              RecordCapacity;         // Size of Records.
+    std::atomic<size_t> RecordCount;            // Block allocations since the last Reset. May exceed RecordCapacity.
+    uint64_t            PeakBytes;              // See Stats. Updated at Reset.
+    std::atomic_ullong  AllocCount;             // "
+    std::atomic_ullong  OverflowCount;          // "
+    std::atomic_ullong  OverflowBytes;          // "
+    uint64_t            ResetCount;             // "
+};
+
+
+
+//------------------------------------------------------------------------
+// ***** FrameArena
+//
+// A pair of LinearArenaHeaps used alternately by consecutive frames, so that memory
+// allocated during frame N stays valid through frame N+1 and is released when frame
+// N+2 begins. This suits data produced one frame and consumed the next, such as layer
+// lists submitted while the following frame is being built.
+//
+// Alloc always allocates from the current frame's arena. Free, GetAllocSize and Realloc
+// accept memory from either frame. BeginFrame must not race with other calls.
+//
+// Example usage:
+//     FrameArena frameArena(2 * 1024 * 1024);
+//     frameArena.Init();
+//     while (running)
+//     {
+//         frameArena.BeginFrame();
+//         std::vector<ovrLayerHeader*, StdAllocatorHeap<ovrLayerHeader*>> layers(StdAllocatorHeap<ovrLayerHeader*>(&frameArena));
+//         ...
+//     }
+//
+class FrameArena : public Heap
+{
+public:
+    FrameArena(size_t capacityPerFrame = LinearArenaHeap::DefaultCapacity, OVR::Heap* overflowHeap = nullptr);
+
+    virtual bool  Init();
+    virtual void  Shutdown();
+
+    virtual void*  Alloc(size_t size) { return Current->Alloc(size); }
+    virtual void*  AllocAligned(size_t size, size_t align) { return Current->AllocAligned(size, align); }
+    virtual size_t GetAllocSize(const void* p) const { return LinearArenaHeap::GetUserSize(p); }
+    virtual size_t GetAllocAlignedSize(const void* p, size_t /*align*/) const { return LinearArenaHeap::GetUserSize(p); }
+    virtual void   Free(void* p);
+    virtual void   FreeAligned(void* p) { Free(p); }
+    virtual void*  Realloc(void* p, size_t newSize);
+    virtual void*  ReallocAligned(void* p, size_t newSize, size_t newAlign);
+
+    // Releases the memory of the frame before the previous one and makes its arena current.
+    void BeginFrame();
+
+    uint64_t GetFrameIndex() const { return FrameIndex; }
+
+    LinearArenaHeap& GetCurrentArena()  { return *Current; }
+    LinearArenaHeap& GetPreviousArena() { return *Previous; }
+
+    void EnableGrowOnOverflow(bool enable);
+    void SetThreadSafe(bool threadSafe);
+    void SetAllocator(Allocator* allocator);
+
+    // Sums the stats of both arenas.
+    void GetStats(LinearArenaHeap::Stats& stats) const;
+
+protected:
+    LinearArenaHeap  Arenas[2];
+    LinearArenaHeap* Current;
+    LinearArenaHeap* Previous;
+    uint64_t         FrameIndex;
+};
+
+
+
+//------------------------------------------------------------------------
+// ***** PoolHeap
+//
+// Implements a size-class pool heap for the many small allocations made through
+// OVR_ALLOC and NewOverrideBase (JSON nodes, String data, Hash entries, log messages):
+//   Sizes up to MaxSmallSize are rounded up to one of SizeClassCount block sizes. Blocks
+//       of a size class are carved from spans of SpanSize bytes. All spans come from one
+//       reserved address range, so the size class of any pointer is found from its span
+//       index without a per-block header, and Free can tell our blocks from large ones.
+//   Each thread has a cache of free blocks per size class, so most Alloc and Free calls
+//       touch only thread-local memory and take no lock. A cache that runs empty refills
+//       a batch of blocks from the size class's central free list, and a cache that holds 
+//       two batches returns one. The central lists are lock-free stacks of batches.
+//   Larger sizes, alignments the size classes can't provide and allocations made after the
+//       reserved range is used up go to the large object heap (OSHeap on Windows).
+//   Spans are never returned to the OS until Shutdown; memory freed by one size class
+//       isn't available to another. This is the usual trade of a pool for speed.
+//   When a thread exits, its cache goes back to the central lists.
+//   Per size class statistics are kept. Counts made in thread caches reach them in
+//       batches, so they may be behind by a few hundred operations per thread.
+//
+// This heap is used by an Allocator if EnablePoolHeap(true) is called before Init.
+//
+class PoolHeap : public Heap
+{
+public:
+    PoolHeap();
+    virtual ~PoolHeap();
+
+    // Must be called before Init. The default is 4 GB of address space on 64 bit
+    // platforms and 128 MB on 32 bit platforms. Only the used part is committed.
+    void   SetReservedSize(size_t reservedSize);
+
+    // Must be called before Init. By default an internal OSHeap (DefaultHeap on non-Windows platforms) is used.
+    void   SetLargeObjectHeap(OVR::Heap* largeObjectHeap);
+
+    virtual bool   Init();
+    virtual void   Shutdown();
+
+    virtual void*  Alloc(size_t size);
+    virtual void*  AllocAligned(size_t size, size_t align);
+    virtual size_t GetAllocSize(const void* p) const;
+    virtual size_t GetAllocAlignedSize(const void* p, size_t align) const;
+    virtual void   Free(void* p);
+    virtual void   FreeAligned(void* p);
+    virtual void*  Realloc(void* p, size_t newSize);
+    virtual void*  ReallocAligned(void* p, size_t newSize, size_t newAlign);
+
+    // Returns true if p is a block of one of our size classes (as opposed to a large allocation).
+    bool   IsSmallAlloc(const void* p) const
+        { return ((uintptr_t)p - (uintptr_t)RegionBase) < RegionSize; }
+
+    struct SizeClassStats
+    {
+        size_t   BlockSize;
+        uint64_t AllocCount;     // Allocations since Init.
+        uint64_t FreeCount;      // Frees since Init.
+        uint64_t SpanCount;      // Spans committed for this size class.
+        uint64_t RefillCount;    // Batches thread caches took from the central list.
+        uint64_t ReturnCount;    // Batches thread caches gave back to the central list.
+    };
+
+    struct Stats
+    {
+        uint64_t LargeAllocCount;  // Allocations that went to the large object heap since Init.
+        uint64_t LargeFreeCount;   // Frees of such allocations since Init.
+        size_t   ReservedBytes;    // Address space reserved for spans.
+        size_t   CommittedBytes;   // Span memory committed so far.
+        size_t   ThreadCacheCount; // Threads that currently have a cache.
+    };
+
+    // Writes up to capacity entries, one per size class, and returns SizeClassCount.
+    size_t GetSizeClassStats(SizeClassStats* stats, size_t capacity) const;
+    void   GetStats(Stats& stats) const;
+
+    // Called by the OS when a thread that has a cache exits.
+    static void OnThreadExit(void* threadCache);
+
+    static const size_t MaxSmallSize   = 1024;
+    static const size_t SizeClassCount = 20;
+    static const size_t SpanSize       = 65536;
+
+protected:
+    // A free block. A batch is a list of free blocks whose first block also links the 
+    // next batch of the central list and holds the count.
+    struct FreeBlock
+    {
+        FreeBlock* Next;            // Next block of the thread cache list or of the batch.
+        uint32_t   NextBatch;       // Encoded (see EncodeBlock) first block of the next batch in the central list.
+        uint32_t   BatchCount;      // Number of blocks in this batch.
+    };
+
+    struct ClassCache
+    {
+        FreeBlock* List;
+        uint32_t   Count;
+        uint32_t   AllocCount;      // Not yet added to the central stats.
+        uint32_t   FreeCount;       // "
+    };
+
+    struct ThreadCache
+    {
+        PoolHeap*    Heap;
+        ThreadCache* Prev;
+        ThreadCache* Next;
+        ClassCache   Classes[SizeClassCount];
+    };
+
+    // Padded to a cache line, as each is modified by all threads.
+    struct CentralList
+    {
+        std::atomic<uint64_t> Head; // Encoded first block of the first batch in the low 32 bits, ABA tag in the high 32 bits.
+        std::atomic_ullong    AllocCount;
+        std::atomic_ullong    FreeCount;
+        std::atomic_ullong    SpanCount;
+        std::atomic_ullong    RefillCount;
+        std::atomic_ullong    ReturnCount;
+        uint8_t               Pad[16];
+    };
+
+    ThreadCache* GetThreadCache();
+    ThreadCache* CreateThreadCache();
+    void         ReleaseThreadCache(ThreadCache* cache);
+
+    size_t       GetSizeClass(size_t size) const { return SizeClassLookup[(size + 15) >> 4]; }
+    size_t       GetSpanSizeClass(const void* p) const { return SpanSizeClass[((uintptr_t)p - (uintptr_t)RegionBase) / SpanSize]; }
+    void*        AllocSmall(size_t sizeClass); // nullptr if no block is available; callers fall back to the large heap.
+    void         FreeSmall(void* p);
+    bool         Refill(ClassCache& classCache, size_t sizeClass);
+    void         FlushStats(ClassCache& classCache, size_t sizeClass);
+    FreeBlock*   CarveSpan(size_t sizeClass);
+    FreeBlock*   PopBatch(size_t sizeClass);
+    void         PushBatch(size_t sizeClass, FreeBlock* batch, uint32_t count);
+    uint32_t     EncodeBlock(const FreeBlock* block) const;
+    FreeBlock*   DecodeBlock(uint32_t value) const;
+
+    void*        AllocLarge(size_t size);
+    void*        AllocLargeAligned(size_t size, size_t align);
+
+    uint8_t*            RegionBase;                     // Span-aligned start of the reserved range.
+    size_t              RegionSize;                     // Usable size of the reserved range. 0 until Init.
+    void*               ReservedBase;                   // What the OS returned for the reservation.
+    size_t              ReservedSize;                   // Requested reservation size, plus a span for alignment once reserved.
+    size_t              SpanCapacity;                   // RegionSize / SpanSize.
+    size_t              SpanCount;                      // Spans committed so far.
+    uint8_t*            SpanSizeClass;                  // Size class per span.
+    OVR::Lock           SpanLock;                       // Guards SpanCount and the committing of spans.
+    CentralList         Central[SizeClassCount];
+    uint16_t            BatchSize[SizeClassCount];      // Blocks per batch, by size class.
+    uint8_t             SizeClassLookup[(MaxSmallSize >> 4) + 1]; // Size class by (size + 15) / 16.
+    uint64_t            InstanceId;                     // Unique per Init, so thread-local cache pointers can't outlive it.
+    uintptr_t           TlsKey;                         // OS thread-local slot whose destructor releases thread caches.
+    bool                TlsKeyValid;
+    ThreadCache*        ThreadCacheList;                // All thread caches, for Shutdown and stats.
+    size_t              ThreadCacheCount;
+    OVR::Lock           ThreadCacheLock;                // Guards ThreadCacheList and ThreadCacheCount.
+    OVR::Heap*          LargeHeap;                      // Where allocations the size classes don't serve go.
+  #if defined(_WIN32)
+    OSHeap              DefaultLargeHeap;
+  #else
+    DefaultHeap         DefaultLargeHeap;
+  #endif
+    std::atomic_ullong  LargeAllocCount;
+    std::atomic_ullong  LargeFreeCount;
+
+    static const uint16_t SizeClassSizes[SizeClassCount];
+};
+
+
+
 ///------------------------------------------------------------------------
 /// ***** AllocatorTagScope
 ///
@@ -1118,6 +2055,94 @@ protected:
 
 
 
+///------------------------------------------------------------------------
+/// ***** AllocationBudgetScope
+///
+/// Counts the allocations the current thread makes through the Allocator while the scope
+/// exists, and reports each allocation that takes the scope over its count or byte budget,
+/// with the allocation's tag and backtrace. This is for code that's expected not to allocate
+/// in steady state, such as the per-frame work of a render loop. Scopes nest, and an allocation
+/// counts against every enclosing scope of its thread. Allocations that go through the
+/// Allocator are always seen. With the debug CRT, malloc and operator new are seen as well,
+/// through a CRT allocation hook that's installed the first time a scope is enabled. With the
+/// release CRT they're seen only if malloc redirection is enabled, so code that allocates
+/// directly from the CRT isn't checked in release builds.
+///
+/// Example usage:
+///    void Renderer::SubmitFrame()
+///    {
+///        AllocationBudgetScope budget("SubmitFrame"); // Default budget: no allocations at all.
+///
+///        Layers.push_back(layer);         // Reported if this has to grow Layers.
+///    }
+///
+class AllocationBudgetScope
+{
+public:
+    // If enabled is false the scope does nothing, so the declaration can stay unconditional.
+    AllocationBudgetScope(const char* name, uint64_t maxAllocCount = 0, uint64_t maxAllocBytes = 0, bool enabled = true);
+    ~AllocationBudgetScope(); // Must run on the creating thread, in reverse order of creation, as block scoping does.
+
+    const char* GetName() const
+        { return Name; }
+
+    uint64_t GetAllocCount() const
+        { return AllocCount; }
+
+    uint64_t GetAllocBytes() const
+        { return AllocBytes; }
+
+    // Returns the count of allocations that were over the budget.
+    uint64_t GetViolationCount() const
+        { return ViolationCount; }
+
+    // An allocation that went over a scope's budget.
+    struct Violation
+    {
+        const AllocationBudgetScope* Scope;
+        const void*                  Alloc;     // nullptr for CRT allocations seen through the hook, which runs before the allocation.
+        uint64_t                     Size;
+        const char*                  Tag;       // "CRT" for CRT allocations seen through the hook.
+        const char*                  File;      // nullptr if the allocation site didn't supply it.
+        int                          Line;
+        void*                        Backtrace[32];
+        size_t                       BacktraceCount;
+    };
+
+    // Called on the allocating thread, from within the allocation. The callback may allocate;
+    // its own allocations aren't counted against any budget.
+    typedef void (*ViolationCallback)(uintptr_t context, const Violation& violation);
+
+    // Sets the process-wide violation handler. Without one (the default) violations are 
+    // debug-traced with a symbolized backtrace. Only the first MaxReportedViolations of each 
+    // scope are reported, though all are counted. Set this before any scope is active.
+    static void SetViolationCallback(ViolationCallback callback, uintptr_t context);
+    static const uint64_t MaxReportedViolations = 8;
+
+    // Returns the count of over-budget allocations in all scopes since startup.
+    static uint64_t GetTotalViolationCount();
+
+    // Returns the calling thread's innermost scope, or nullptr if it has none.
+    static AllocationBudgetScope* GetCurrent();
+
+    // Called by the Allocator for each allocation made by a thread that has a scope.
+    static void OnAlloc(const void* p, size_t size, const char* tag, const char* file, int line);
+
+protected:
+    void ReportViolation(const void* p, size_t size, const char* tag, const char* file, int line);
+
+    const char*            Name;
+    uint64_t               MaxAllocCount;
+    uint64_t               MaxAllocBytes;
+    uint64_t               AllocCount;
+    uint64_t               AllocBytes;
+    uint64_t               ViolationCount;
+    AllocationBudgetScope* Parent;          // The thread's enclosing scope.
+    bool                   Enabled;
+};
+
+
+
 
 
 // AllocatorTraceDbgCmd
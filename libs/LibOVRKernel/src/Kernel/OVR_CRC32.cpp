@@ -26,6 +26,28 @@ limitations under the License.
 
 #include "OVR_CRC32.h"
 
+#include <string.h>
+#include <thread>
+#include <vector>
+
+// The x86 hardware paths are compiled in with per-function target attributes and only
+// used when cpuid reports support, so the file still builds for any baseline.
+#if (defined(OVR_CPU_X86_64) || defined(OVR_CPU_X86)) && !defined(OVR_CRC32_NO_HARDWARE)
+    #define OVR_CRC32_X86 1
+
+    #if defined(OVR_CC_MSVC)
+        #include <intrin.h>
+        #define OVR_CRC32_TARGET(features)
+    #else
+        #include <cpuid.h>
+        #define OVR_CRC32_TARGET(features) __attribute__((target(features)))
+    #endif
+
+    #include <nmmintrin.h>  // SSE4.2 crc32
+    #include <smmintrin.h>  // SSE4.1 extract
+    #include <wmmintrin.h>  // PCLMULQDQ
+#endif
+
 namespace OVR {
 
 
@@ -67,11 +89,11 @@ static const uint32_t CRC_Table[256] = {
     0xafb010b1, 0xab710d06, 0xa6322bdf, 0xa2f33668, 0xbcb4666d, 0xb8757bda, 0xb5365d03, 0xb1f740b4
 };
 
-uint32_t OculusCamera_CRC32(const void* data, int bytes, uint32_t accumulator)
+uint32_t OculusCamera_CRC32(const void* data, size_t bytes, uint32_t accumulator)
 {
     const uint8_t* inputBytes = reinterpret_cast<const uint8_t*>( data );
 
-    for (int j = 0; j < bytes; ++j)
+    for (size_t j = 0; j < bytes; ++j)
     {
         int i = ((uint32_t)(accumulator >> 24) ^ *inputBytes++) & 0xFF;
 
@@ -167,37 +189,539 @@ const uint32_t CRC32_Table_CRC32_C[256] = {
     0x4c4623a6, 0x5f16d052, 0xad7d5351
 };
 
-// CRC32 core algorithm, slightly unrolled, no hardware acceleration
-uint32_t CalculateCRC32(const uint32_t* OVR_RESTRICT table, const void* OVR_RESTRICT message, int messageBytes, uint32_t crc)
-{
-    crc = ~crc;
+//-----------------------------------------------------------------------------------
+// ***** Portable implementation
 
+// CRC32 core algorithm, slightly unrolled, no hardware acceleration. Used for tables
+// other than the two standard ones.
+static uint32_t CalculateCRC32_Bytewise(const uint32_t* OVR_RESTRICT table, const uint8_t* OVR_RESTRICT bytes, size_t messageBytes, uint32_t crc)
+{
     // Handle 4 bytes at a time.
-    const uint32_t* words = (const uint32_t*)message;
     while (messageBytes >= 4)
     {
-        crc = crc ^ *words++;
+        uint32_t word;
+        memcpy(&word, bytes, 4);
+        crc = crc ^ word;
         crc = (crc >> 8) ^ table[crc & 0xFF];
         crc = (crc >> 8) ^ table[crc & 0xFF];
         crc = (crc >> 8) ^ table[crc & 0xFF];
         crc = (crc >> 8) ^ table[crc & 0xFF];
+        bytes += 4;
         messageBytes -= 4;
     }
 
     // Handle last 0..3 bytes
-    const unsigned char* bytes = (const unsigned char*)words;
-    switch (messageBytes)
+    while (messageBytes--)
+        crc = (crc >> 8) ^ table[(crc ^ *bytes++) & 0xFF];
+
+    return crc;
+}
+
+// Slicing-by-8 (Kounavis and Berry, "A Systematic Approach to Building High Performance
+// Software-based CRC Generators"): Slice[k][n] is the CRC of byte n followed by k zero
+// bytes, so eight table lookups retire eight input bytes.
+struct CRC32SliceTables
+{
+    uint32_t Slice[8][256];
+
+    explicit CRC32SliceTables(const uint32_t* table)
+    {
+        for (int n = 0; n < 256; ++n)
+            Slice[0][n] = table[n];
+        for (int k = 1; k < 8; ++k)
+            for (int n = 0; n < 256; ++n)
+                Slice[k][n] = (Slice[k - 1][n] >> 8) ^ table[Slice[k - 1][n] & 0xFF];
+    }
+};
+
+static uint32_t CalculateCRC32_Slice8(const CRC32SliceTables& tables, const uint8_t* OVR_RESTRICT bytes, size_t messageBytes, uint32_t crc)
+{
+    const uint32_t (*t)[256] = tables.Slice;
+
+    while (messageBytes >= 8)
+    {
+        uint32_t lo, hi;
+        memcpy(&lo, bytes, 4);
+        memcpy(&hi, bytes + 4, 4);
+        lo ^= crc;
+        crc = t[7][ lo        & 0xFF] ^ t[6][(lo >>  8) & 0xFF] ^
+              t[5][(lo >> 16) & 0xFF] ^ t[4][ lo >> 24        ] ^
+              t[3][ hi        & 0xFF] ^ t[2][(hi >>  8) & 0xFF] ^
+              t[1][(hi >> 16) & 0xFF] ^ t[0][ hi >> 24        ];
+        bytes += 8;
+        messageBytes -= 8;
+    }
+
+    while (messageBytes--)
+        crc = (crc >> 8) ^ t[0][(crc ^ *bytes++) & 0xFF];
+
+    return crc;
+}
+
+
+//-----------------------------------------------------------------------------------
+// ***** CRC shift operators
+//
+// Appending n zero bytes to a message is a linear map on the CRC register, which can
+// be built once as a 32x32 GF(2) matrix (Mark Adler's crc32_combine approach) and
+// then applied with four table lookups. The hardware CRC32-C path uses this to merge
+// the three streams it computes in parallel.
+
+// Reflected polynomials
+static const uint32_t CRC32_Poly   = 0xEDB88320;
+static const uint32_t CRC32_C_Poly = 0x82F63B78;
+
+static uint32_t GF2MatrixTimes(const uint32_t* mat, uint32_t vec)
+{
+    uint32_t sum = 0;
+    while (vec)
     {
-    case 3: crc = (crc >> 8) ^ table[(crc ^ *bytes++) & 0xFF];
-    case 2: crc = (crc >> 8) ^ table[(crc ^ *bytes++) & 0xFF];
-    case 1: crc = (crc >> 8) ^ table[(crc ^ *bytes++) & 0xFF];
-        break;
-    default:
-        break;
+        if (vec & 1)
+            sum ^= *mat;
+        vec >>= 1;
+        mat++;
+    }
+    return sum;
+}
+
+static void GF2MatrixSquare(uint32_t* square, const uint32_t* mat)
+{
+    for (int n = 0; n < 32; n++)
+        square[n] = GF2MatrixTimes(mat, mat[n]);
+}
+
+// Operator for appending one zero bit.
+static void CRC32ZeroBitOperator(uint32_t poly, uint32_t* op)
+{
+    op[0] = poly;
+    for (int n = 1; n < 32; n++)
+        op[n] = 1u << (n - 1);
+}
+
+// Operator for appending 'bytes' zero bytes, bytes a power of two.
+static void CRC32ZerosOperator(uint32_t poly, size_t bytes, uint32_t* op)
+{
+    uint32_t odd[32], even[32];
+
+    CRC32ZeroBitOperator(poly, odd);
+
+    // Two, four, then eight zero bits = one zero byte
+    GF2MatrixSquare(even, odd);
+    GF2MatrixSquare(odd, even);
+    GF2MatrixSquare(even, odd);
+
+    for (size_t len = 1; len < bytes; len <<= 1)
+    {
+        GF2MatrixSquare(odd, even);
+        memcpy(even, odd, sizeof(even));
+    }
+
+    memcpy(op, even, sizeof(even));
+}
+
+struct CRC32ShiftTable
+{
+    uint32_t Table[4][256];
+
+    CRC32ShiftTable(uint32_t poly, size_t bytes)
+    {
+        uint32_t op[32];
+        CRC32ZerosOperator(poly, bytes, op);
+        for (uint32_t n = 0; n < 256; n++)
+        {
+            Table[0][n] = GF2MatrixTimes(op, n);
+            Table[1][n] = GF2MatrixTimes(op, n << 8);
+            Table[2][n] = GF2MatrixTimes(op, n << 16);
+            Table[3][n] = GF2MatrixTimes(op, n << 24);
+        }
+    }
+
+    uint32_t Shift(uint32_t crc) const
+    {
+        return Table[0][crc & 0xFF] ^ Table[1][(crc >> 8) & 0xFF] ^ Table[2][(crc >> 16) & 0xFF] ^ Table[3][crc >> 24];
+    }
+};
+
+
+//-----------------------------------------------------------------------------------
+// ***** x86 hardware implementations
+
+#if defined(OVR_CRC32_X86)
+
+// Block sizes for the three-way interleaved CRC32-C. The crc32 instruction has a
+// latency of three cycles and a throughput of one, so three independent streams keep
+// it busy; the long blocks amortize the cost of merging the streams.
+static const size_t CRC32_C_LongBlock  = 8192;
+static const size_t CRC32_C_ShortBlock = 256;
+
+struct CRC32_C_HardwareTables
+{
+    CRC32ShiftTable Long;
+    CRC32ShiftTable Short;
+
+    CRC32_C_HardwareTables()
+        : Long(CRC32_C_Poly, CRC32_C_LongBlock)
+        , Short(CRC32_C_Poly, CRC32_C_ShortBlock)
+    {
+    }
+};
+
+#if defined(OVR_CPU_X86_64)
+    #define OVR_CRC32_C_WORD(crc, p) ((uint32_t)_mm_crc32_u64((crc), Load64(p)))
+#else
+    #define OVR_CRC32_C_WORD(crc, p) _mm_crc32_u32(_mm_crc32_u32((crc), Load32(p)), Load32((p) + 4))
+#endif
+
+static inline uint64_t Load64(const uint8_t* p) { uint64_t v; memcpy(&v, p, 8); return v; }
+static inline uint32_t Load32(const uint8_t* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+
+OVR_CRC32_TARGET("sse4.2")
+static uint32_t CalculateCRC32_C_SSE42(const CRC32_C_HardwareTables& tables, const uint8_t* OVR_RESTRICT next, size_t messageBytes, uint32_t crc0)
+{
+    // Align to eight bytes
+    while (messageBytes && ((uintptr_t)next & 7) != 0)
+    {
+        crc0 = _mm_crc32_u8(crc0, *next++);
+        messageBytes--;
+    }
+
+    while (messageBytes >= CRC32_C_LongBlock * 3)
+    {
+        uint32_t crc1 = 0, crc2 = 0;
+        const uint8_t* end = next + CRC32_C_LongBlock;
+        do
+        {
+            crc0 = OVR_CRC32_C_WORD(crc0, next);
+            crc1 = OVR_CRC32_C_WORD(crc1, next + CRC32_C_LongBlock);
+            crc2 = OVR_CRC32_C_WORD(crc2, next + CRC32_C_LongBlock * 2);
+            next += 8;
+        } while (next < end);
+        crc0 = tables.Long.Shift(crc0) ^ crc1;
+        crc0 = tables.Long.Shift(crc0) ^ crc2;
+        next += CRC32_C_LongBlock * 2;
+        messageBytes -= CRC32_C_LongBlock * 3;
+    }
+
+    while (messageBytes >= CRC32_C_ShortBlock * 3)
+    {
+        uint32_t crc1 = 0, crc2 = 0;
+        const uint8_t* end = next + CRC32_C_ShortBlock;
+        do
+        {
+            crc0 = OVR_CRC32_C_WORD(crc0, next);
+            crc1 = OVR_CRC32_C_WORD(crc1, next + CRC32_C_ShortBlock);
+            crc2 = OVR_CRC32_C_WORD(crc2, next + CRC32_C_ShortBlock * 2);
+            next += 8;
+        } while (next < end);
+        crc0 = tables.Short.Shift(crc0) ^ crc1;
+        crc0 = tables.Short.Shift(crc0) ^ crc2;
+        next += CRC32_C_ShortBlock * 2;
+        messageBytes -= CRC32_C_ShortBlock * 3;
+    }
+
+    while (messageBytes >= 8)
+    {
+        crc0 = OVR_CRC32_C_WORD(crc0, next);
+        next += 8;
+        messageBytes -= 8;
+    }
+
+    while (messageBytes--)
+        crc0 = _mm_crc32_u8(crc0, *next++);
+
+    return crc0;
+}
+
+#undef OVR_CRC32_C_WORD
+
+// Folding constants for the standard (reflected 0x04C11DB7) polynomial, from Gopal et
+// al., "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction".
+// x^(4*128+32), x^(4*128-32), x^(128+32), x^(128-32), x^64 mod P, then P and mu for the
+// final Barrett reduction.
+OVR_ALIGNAS(16) static const uint64_t CRC32_FoldBy4[2]  = { 0x0154442bd4ULL, 0x01c6e41596ULL };
+OVR_ALIGNAS(16) static const uint64_t CRC32_FoldBy1[2]  = { 0x01751997d0ULL, 0x00ccaa009eULL };
+OVR_ALIGNAS(16) static const uint64_t CRC32_Fold64[2]   = { 0x0163cd6124ULL, 0x0000000000ULL };
+OVR_ALIGNAS(16) static const uint64_t CRC32_Barrett[2]  = { 0x01db710641ULL, 0x01f7011641ULL };
+
+// Processes the largest multiple of 16 bytes, at least 64. Returns the register and
+// leaves the unprocessed tail to the caller.
+OVR_CRC32_TARGET("pclmul,sse4.1")
+static uint32_t CalculateCRC32_PCLMUL(const uint8_t* OVR_RESTRICT buf, size_t& messageBytes, uint32_t crc)
+{
+    size_t len = messageBytes;
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = _mm_load_si128((const __m128i*)CRC32_FoldBy4);
+    buf += 64;
+    len -= 64;
+
+    // Fold four 128-bit lanes in parallel
+    while (len >= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        y5 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+        y6 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+        y7 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+        y8 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        buf += 64;
+        len -= 64;
+    }
+
+    // Fold the four lanes into one
+    x0 = _mm_load_si128((const __m128i*)CRC32_FoldBy1);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // Remaining whole 16 byte blocks
+    while (len >= 16)
+    {
+        x2 = _mm_loadu_si128((const __m128i*)buf);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        buf += 16;
+        len -= 16;
+    }
+
+    // 128 bits down to 64
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64((const __m128i*)CRC32_Fold64);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x0 = _mm_load_si128((const __m128i*)CRC32_Barrett);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    messageBytes = len;
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+struct CPUFeatures
+{
+    bool SSE42;
+    bool PCLMUL;
+
+    CPUFeatures() : SSE42(false), PCLMUL(false)
+    {
+        unsigned int ecx = 0;
+    #if defined(OVR_CC_MSVC)
+        int info[4];
+        __cpuid(info, 1);
+        ecx = (unsigned int)info[2];
+    #else
+        unsigned int eax, ebx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+            ecx = 0;
+    #endif
+        const bool sse41 = (ecx & (1u << 19)) != 0;
+        SSE42  = (ecx & (1u << 20)) != 0;
+        PCLMUL = sse41 && (ecx & (1u << 1)) != 0;
+    }
+};
+
+#endif // OVR_CRC32_X86
+
+
+//-----------------------------------------------------------------------------------
+// ***** Dispatch
+
+// Built on first use: everything here is immutable afterwards, so concurrent callers
+// only rely on the thread-safe initialization of function statics.
+struct CRC32Implementations
+{
+    CRC32SliceTables Standard;
+    CRC32SliceTables Castagnoli;
+#if defined(OVR_CRC32_X86)
+    CPUFeatures Features;
+    CRC32_C_HardwareTables CastagnoliHardware;
+#endif
+
+    CRC32Implementations()
+        : Standard(CRC32_Table_CRC32)
+        , Castagnoli(CRC32_Table_CRC32_C)
+    {
+    }
+
+    static const CRC32Implementations& Get()
+    {
+        static const CRC32Implementations implementations;
+        return implementations;
+    }
+};
+
+// The register is kept inverted while a buffer is processed, as usual.
+uint32_t CalculateCRC32(const uint32_t* OVR_RESTRICT table, const void* OVR_RESTRICT message, size_t messageBytes, uint32_t crc)
+{
+    const uint8_t* bytes = (const uint8_t*)message;
+    crc = ~crc;
+
+    if (table == CRC32_Table_CRC32)
+    {
+        const CRC32Implementations& impl = CRC32Implementations::Get();
+
+    #if defined(OVR_CRC32_X86)
+        if (impl.Features.PCLMUL && messageBytes >= 64)
+        {
+            const size_t before = messageBytes;
+            crc = CalculateCRC32_PCLMUL(bytes, messageBytes, crc);
+            bytes += before - messageBytes;
+        }
+    #endif
+
+        crc = CalculateCRC32_Slice8(impl.Standard, bytes, messageBytes, crc);
+    }
+    else if (table == CRC32_Table_CRC32_C)
+    {
+        const CRC32Implementations& impl = CRC32Implementations::Get();
+
+    #if defined(OVR_CRC32_X86)
+        if (impl.Features.SSE42)
+            crc = CalculateCRC32_C_SSE42(impl.CastagnoliHardware, bytes, messageBytes, crc);
+        else
+    #endif
+            crc = CalculateCRC32_Slice8(impl.Castagnoli, bytes, messageBytes, crc);
+    }
+    else
+    {
+        crc = CalculateCRC32_Bytewise(table, bytes, messageBytes, crc);
     }
 
     return ~crc;
 }
 
+const char* GetCRC32Implementation(const uint32_t* table)
+{
+#if defined(OVR_CRC32_X86)
+    const CRC32Implementations& impl = CRC32Implementations::Get();
+    if (table == CRC32_Table_CRC32 && impl.Features.PCLMUL)
+        return "pclmul";
+    if (table == CRC32_Table_CRC32_C && impl.Features.SSE42)
+        return "sse4.2";
+#endif
+    if (table == CRC32_Table_CRC32 || table == CRC32_Table_CRC32_C)
+        return "slice8";
+    return "bytewise";
+}
+
+
+
+//-----------------------------------------------------------------------------------
+// ***** Combining and parallel CRC
+
+// For a reflected table entry 128 is the polynomial itself.
+// As in zlib's crc32_combine: crcA is shifted over bytesB zero bytes by applying
+// the operators for the set bits of bytesB, squaring up from one byte. The ~crc
+// pre/post conditioning cancels out in the XOR with crcB.
+uint32_t CombineCRC32(const uint32_t* table, uint32_t crcA, uint32_t crcB, uint64_t bytesB)
+{
+    if (bytesB == 0)
+        return crcA;
+
+    uint32_t odd[32], even[32];
+
+    CRC32ZeroBitOperator(table[128], odd);
+    GF2MatrixSquare(even, odd);     // 2 bits
+    GF2MatrixSquare(odd, even);     // 4 bits
+
+    for (;;)
+    {
+        GF2MatrixSquare(even, odd); // 1, 4, 16.. bytes
+        if (bytesB & 1)
+            crcA = GF2MatrixTimes(even, crcA);
+        bytesB >>= 1;
+        if (bytesB == 0)
+            break;
+
+        GF2MatrixSquare(odd, even); // 2, 8, 32.. bytes
+        if (bytesB & 1)
+            crcA = GF2MatrixTimes(odd, crcA);
+        bytesB >>= 1;
+        if (bytesB == 0)
+            break;
+    }
+
+    return crcA ^ crcB;
+}
+
+uint32_t CalculateCRC32Parallel(const uint32_t* table, const void* data, size_t bytes, uint32_t crc,
+                                unsigned threadCount, size_t minBytesPerThread)
+{
+    if (threadCount == 0)
+        threadCount = std::thread::hardware_concurrency();
+    if (minBytesPerThread == 0)
+        minBytesPerThread = 1;
+    if (threadCount > bytes / minBytesPerThread)
+        threadCount = (unsigned)(bytes / minBytesPerThread);
+
+    if (threadCount <= 1)
+        return CalculateCRC32(table, data, bytes, crc);
+
+    // Chunks are 64 byte multiples so every chunk but the last runs the wide loops
+    // without a ragged tail; the last one takes the remainder.
+    const uint8_t* bytePtr = (const uint8_t*)data;
+    const size_t chunkBytes = (bytes / threadCount) & ~(size_t)63;
+
+    std::vector<uint32_t> chunkCRC(threadCount);
+    std::vector<std::thread> workers;
+    workers.reserve(threadCount - 1);
+
+    for (unsigned i = 1; i < threadCount; i++)
+    {
+        const size_t offset = chunkBytes * i;
+        const size_t length = (i + 1 < threadCount) ? chunkBytes : (bytes - offset);
+        uint32_t* result = &chunkCRC[i];
+
+        workers.emplace_back([=]() { *result = CalculateCRC32(table, bytePtr + offset, length, 0); });
+    }
+
+    // The calling thread does the first chunk, continuing from the caller's crc.
+    chunkCRC[0] = CalculateCRC32(table, bytePtr, chunkBytes, crc);
+
+    for (std::thread& worker : workers)
+        worker.join();
+
+    crc = chunkCRC[0];
+    for (unsigned i = 1; i < threadCount; i++)
+    {
+        const size_t length = (i + 1 < threadCount) ? chunkBytes : (bytes - chunkBytes * i);
+        crc = CombineCRC32(table, crc, chunkCRC[i], length);
+    }
+
+    return crc;
+}
+
 
 } // namespace OVR
@@ -38,7 +38,7 @@ namespace OVR {
 // ***** Oculus Camera CRC-32
 
 // This is a proprietary CRC we have been using for camera EEPROM data.
-uint32_t OculusCamera_CRC32(const void* data, int bytes, uint32_t prevCRC = 0);
+uint32_t OculusCamera_CRC32(const void* data, size_t bytes, uint32_t prevCRC = 0);
 
 
 //-----------------------------------------------------------------------------------
@@ -52,27 +52,105 @@ extern const uint32_t CRC32_Table_CRC32[256];
 // polynomial 0x1EDC6F41 - CRC32-C (Castagnoli): SSE4.2 [newer]
 extern const uint32_t CRC32_Table_CRC32_C[256];
 
-// CRC32 core algorithm
-uint32_t CalculateCRC32(const uint32_t* OVR_RESTRICT table, const void* OVR_RESTRICT data, int bytes, uint32_t crc);
+// CRC32 core algorithm. Pass the previous result as crc to continue a checksum over
+// several buffers (0 to start). The two tables above get the fastest implementation
+// the CPU supports: PCLMULQDQ folding for CRC32, the SSE4.2 crc32 instruction for
+// CRC32-C, slicing-by-8 otherwise. Any other table uses a plain table loop.
+// Define OVR_CRC32_NO_HARDWARE to build without the x86 instruction paths.
+uint32_t CalculateCRC32(const uint32_t* OVR_RESTRICT table, const void* OVR_RESTRICT data, size_t bytes, uint32_t crc);
+
+// Name of the implementation CalculateCRC32 uses for the table on this CPU:
+// "pclmul", "sse4.2", "slice8" or "bytewise". For logging and benchmarks.
+const char* GetCRC32Implementation(const uint32_t* table);
+
+// Returns the CRC of A followed by B given crcA, crcB and the length of B, for either
+// table above or any other reflected table. Costs O(log bytesB) and touches no data,
+// so pieces checksummed separately (in parallel, or as they arrive out of order) can
+// be merged into the CRC of the whole.
+uint32_t CombineCRC32(const uint32_t* table, uint32_t crcA, uint32_t crcB, uint64_t bytesB);
+
+// Same result as CalculateCRC32, with the buffer split into one chunk per thread and
+// the chunk CRCs merged with CombineCRC32. The calling thread does one of the chunks.
+// threadCount 0 uses std::thread::hardware_concurrency(); fewer threads are used if
+// a chunk would come out smaller than minBytesPerThread, so small buffers stay on
+// the calling thread. For a file, map it and pass the mapping as the buffer.
+uint32_t CalculateCRC32Parallel(const uint32_t* table, const void* data, size_t bytes, uint32_t crc = 0,
+                                unsigned threadCount = 0, size_t minBytesPerThread = 1024 * 1024);
 
 
 //-----------------------------------------------------------------------------------
 // ***** CRC-32 Standards
 
 // This is the version you probably want to call.  It's the same one used in PKZIP.
-inline uint32_t Standard_CRC32(const void* data, int bytes)
+inline uint32_t Standard_CRC32(const void* data, size_t bytes)
 {
     return CalculateCRC32(CRC32_Table_CRC32, data, bytes, 0);
 }
 
-// This is a version that can be hardware accelerated with SSE4.2 and may be suitable
-// for large data in the future.
-inline uint32_t Castagnoli_CRC32(const void* data, int bytes)
+// This is a version that is hardware accelerated with SSE4.2, and the fastest choice
+// for large data on such CPUs.
+inline uint32_t Castagnoli_CRC32(const void* data, size_t bytes)
 {
     return CalculateCRC32(CRC32_Table_CRC32_C, data, bytes, 0);
 }
 
 
+//-----------------------------------------------------------------------------------
+// ***** CRC32Stream
+//
+// Incremental CRC over data that arrives in pieces, e.g. a file read in chunks:
+//
+//     CRC32Stream crc(CRC32_Table_CRC32_C);
+//     while (size_t n = file.Read(buffer, sizeof(buffer)))
+//         crc.Update(buffer, n);
+//     uint32_t result = crc.GetCRC();
+//
+// The result is the same as one call over the concatenated data.
+
+class CRC32Stream
+{
+public:
+    explicit CRC32Stream(const uint32_t* table = CRC32_Table_CRC32)
+      : Table(table), CRC(0), Bytes(0)
+    {
+    }
+
+    void Update(const void* data, size_t bytes)
+    {
+        CRC = CalculateCRC32(Table, data, bytes, CRC);
+        Bytes += bytes;
+    }
+
+    // Appends a piece checksummed by another stream with the same table, e.g. one
+    // filled on another thread: the result is as if its data had gone through Update.
+    void Append(const CRC32Stream& next)
+    {
+        Append(next.CRC, next.Bytes);
+    }
+
+    void Append(uint32_t nextCRC, uint64_t nextBytes)
+    {
+        CRC = CombineCRC32(Table, CRC, nextCRC, nextBytes);
+        Bytes += nextBytes;
+    }
+
+    void Reset()
+    {
+        CRC = 0;
+        Bytes = 0;
+    }
+
+    uint32_t        GetCRC() const   { return CRC; }
+    uint64_t        GetBytes() const { return Bytes; }
+    const uint32_t* GetTable() const { return Table; }
+
+protected:
+    const uint32_t* Table;
+    uint32_t        CRC;
+    uint64_t        Bytes;
+};
+
+
 } // namespace OVR
 
 #endif
@@ -29,6 +29,7 @@ limitations under the License.
 
 #include <cstring>
 using std::memcpy;
+#include <type_traits>
 
 #include "OVR_Atomic.h"
 
@@ -47,6 +48,9 @@ namespace OVR {
 //
 // The SlotType can be the same as T, but should probably be a larger fixed size.
 // This allows for forward compatibility when the updater is shared between processes.
+//
+// GetState retries until it gets a clean copy. See LocklessHistoryUpdater for reads that
+// give up after a few attempts, and for access to earlier updates.
 
 template<class T, class SlotType = T>
 class LocklessUpdater
@@ -139,6 +143,487 @@ OVR_RESTORE_MSVC_WARNING()
 #pragma pack(pop)
 
 
+// ***** Lockless queues
+
+// Bounded FIFO queues for handing work between threads without a Lock.
+//
+//   LocklessSPSCQueue   - one producer thread and one consumer thread.
+//   LocklessMPSCQueue   - any number of producer threads, one consumer thread.
+//   LocklessMPMCQueue   - any number of producer and consumer threads.
+//   LocklessSharedQueue - LocklessMPMCQueue with fixed-size slots, for use between processes.
+//
+// Capacity must be a power of two. Enqueue fails instead of waiting when the queue is full, 
+// and Dequeue fails when it's empty, so the caller decides whether to spin, sleep or drop.
+// The batch versions move as many of the given values as fit or are available, up to count, 
+// and return how many they moved; a batch costs one index update instead of one per value.
+//
+// Example usage:
+//     LocklessMPSCQueue<Message, 1024> queue;
+//
+//     // Any thread
+//     if (!queue.Enqueue(message))
+//         ++droppedCount;
+//
+//     // Worker thread
+//     Message messages[32];
+//     uint32_t count = queue.DequeueBatch(messages, 32);
+//
+// The producer and consumer indices are kept on separate cache lines. Indices are 32 bits and 
+// wrap, so a queue has the same layout in 32 and 64 bit processes.
+
+const size_t LocklessCacheLineSize = 64;
+
+
+template<class T, uint32_t Capacity>
+class LocklessSPSCQueue
+{
+public:
+    static_assert((Capacity != 0) && ((Capacity & (Capacity - 1)) == 0) && (Capacity <= 0x80000000u), "Capacity must be a power of two");
+
+    LocklessSPSCQueue()
+      : Tail(0), ProducerHead(0), Head(0), ConsumerTail(0)
+    {
+    }
+
+    // Producer thread only.
+    bool Enqueue(const T& value)
+    {
+        return (EnqueueBatch(&value, 1) == 1);
+    }
+
+    uint32_t EnqueueBatch(const T* values, uint32_t count)
+    {
+        const uint32_t tail = Tail.load(std::memory_order_relaxed);
+
+        // Only look at the consumer's index when our last view of it says there isn't room.
+        if (count > (Capacity - (tail - ProducerHead)))
+            ProducerHead = Head.load(std::memory_order_acquire);
+
+        const uint32_t freeCount = (Capacity - (tail - ProducerHead));
+        if (count > freeCount)
+            count = freeCount;
+
+        for (uint32_t i = 0; i < count; ++i)
+            Slots[(tail + i) & (Capacity - 1)] = values[i];
+
+        Tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer thread only.
+    bool Dequeue(T& value)
+    {
+        return (DequeueBatch(&value, 1) == 1);
+    }
+
+    uint32_t DequeueBatch(T* values, uint32_t count)
+    {
+        const uint32_t head = Head.load(std::memory_order_relaxed);
+
+        if (count > (ConsumerTail - head))
+            ConsumerTail = Tail.load(std::memory_order_acquire);
+
+        const uint32_t usedCount = (ConsumerTail - head);
+        if (count > usedCount)
+            count = usedCount;
+
+        for (uint32_t i = 0; i < count; ++i)
+            values[i] = Slots[(head + i) & (Capacity - 1)];
+
+        Head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    // Approximate while the other thread is active.
+    uint32_t GetCount() const
+    {
+        return (Tail.load(std::memory_order_acquire) - Head.load(std::memory_order_acquire));
+    }
+
+protected:
+    std::atomic<uint32_t> Tail;             // Written by the producer.
+    uint32_t              ProducerHead;     // The producer's last view of Head.
+    uint8_t               TailPad[LocklessCacheLineSize - sizeof(std::atomic<uint32_t>) - sizeof(uint32_t)];
+    std::atomic<uint32_t> Head;             // Written by the consumer.
+    uint32_t              ConsumerTail;     // The consumer's last view of Tail.
+    uint8_t               HeadPad[LocklessCacheLineSize - sizeof(std::atomic<uint32_t>) - sizeof(uint32_t)];
+    T                     Slots[Capacity];
+};
+
+
+// Bounded queue of slots with sequence numbers (D. Vyukov's design), used by LocklessMPSCQueue,
+// LocklessMPMCQueue and LocklessSharedQueue. A slot's sequence number says whether it is free 
+// for, or holds the value of, a given position. Producers claim positions by advancing Tail and 
+// consumers by advancing Head, so threads only contend on those indices, never on a lock, and a 
+// stalled thread blocks only the slots it has claimed.
+//
+// Sequence numbers are stored relative to the slot index, which makes all zero bytes the empty 
+// state: a slot is free for position p when its Sequence is (p & ~(Capacity - 1)) and holds 
+// the value for p when it is one more than that. With a Capacity of 1 that would also be the 
+// free state for position p + 1, so the smallest Capacity is 2.
+//
+template<class T, uint32_t Capacity, bool MultiConsumer>
+class LocklessSequenceQueue
+{
+public:
+    static_assert((Capacity >= 2) && ((Capacity & (Capacity - 1)) == 0) && (Capacity <= 0x80000000u), "Capacity must be a power of two, at least 2");
+
+    // Empties the queue. Not thread-safe.
+    void Reset()
+    {
+        Tail.store(0, std::memory_order_relaxed);
+        Head.store(0, std::memory_order_relaxed);
+
+        for (uint32_t i = 0; i < Capacity; ++i)
+            Slots[i].Sequence.store(0, std::memory_order_relaxed);
+    }
+
+    // Any thread. U is T or anything T can be assigned from.
+    template<class U>
+    bool Enqueue(const U& value)
+    {
+        return (EnqueueBatch(&value, 1) == 1);
+    }
+
+    template<class U>
+    uint32_t EnqueueBatch(const U* values, uint32_t count)
+    {
+        uint32_t tail = Tail.load(std::memory_order_relaxed);
+        uint32_t claimCount;
+
+        for (;;)
+        {
+            // Count the free slots from tail on. No other producer can fill them before we claim 
+            // them, because that needs Tail to move past them first.
+            for (claimCount = 0; claimCount < count; ++claimCount)
+            {
+                const uint32_t position = (tail + claimCount);
+
+                if (GetSlot(position).Sequence.load(std::memory_order_acquire) != GetLap(position))
+                    break;
+            }
+
+            if (claimCount == 0)
+            {
+                const int32_t difference = (int32_t)(GetSlot(tail).Sequence.load(std::memory_order_acquire) - GetLap(tail));
+
+                if (difference < 0) // If the slot still holds the value from the last lap...
+                    return 0;       // the queue is full.
+
+                tail = Tail.load(std::memory_order_relaxed); // Another producer claimed it.
+            }
+            else if (Tail.compare_exchange_weak(tail, tail + claimCount, std::memory_order_relaxed)) // Updates tail on failure.
+                break;
+        }
+
+        for (uint32_t i = 0; i < claimCount; ++i)
+        {
+            Slot& slot = GetSlot(tail + i);
+            slot.Value = values[i];
+            slot.Sequence.store(GetLap(tail + i) + 1, std::memory_order_release);
+        }
+
+        return claimCount;
+    }
+
+    // Any thread for LocklessMPMCQueue. Only the consumer thread for LocklessMPSCQueue.
+    // U is T or anything T converts to.
+    template<class U>
+    bool Dequeue(U& value)
+    {
+        return (DequeueBatch(&value, 1) == 1);
+    }
+
+    template<class U>
+    uint32_t DequeueBatch(U* values, uint32_t count)
+    {
+        uint32_t head = Head.load(std::memory_order_relaxed);
+        uint32_t claimCount;
+
+        for (;;)
+        {
+            for (claimCount = 0; claimCount < count; ++claimCount)
+            {
+                const uint32_t position = (head + claimCount);
+
+                if (GetSlot(position).Sequence.load(std::memory_order_acquire) != (GetLap(position) + 1))
+                    break;
+            }
+
+            if (claimCount == 0)
+            {
+                const int32_t difference = (int32_t)(GetSlot(head).Sequence.load(std::memory_order_acquire) - (GetLap(head) + 1));
+
+                if (difference < 0) // If the slot hasn't been written for this lap...
+                    return 0;       // the queue is empty.
+
+                head = Head.load(std::memory_order_relaxed); // Another consumer claimed it.
+            }
+            else if (!MultiConsumer)
+            {
+                Head.store(head + claimCount, std::memory_order_relaxed);
+                break;
+            }
+            else if (Head.compare_exchange_weak(head, head + claimCount, std::memory_order_relaxed))
+                break;
+        }
+
+        for (uint32_t i = 0; i < claimCount; ++i)
+        {
+            Slot& slot = GetSlot(head + i);
+            values[i] = slot.Value;
+            slot.Sequence.store(GetLap(head + i) + Capacity, std::memory_order_release); // Free for the next lap.
+        }
+
+        return claimCount;
+    }
+
+    // Approximate while other threads are active.
+    uint32_t GetCount() const
+    {
+        const int32_t count = (int32_t)(Tail.load(std::memory_order_acquire) - Head.load(std::memory_order_acquire));
+        return ((count > 0) ? (uint32_t)count : 0);
+    }
+
+protected:
+    struct Slot
+    {
+        std::atomic<uint32_t> Sequence;
+        T                     Value;
+    };
+
+    static uint32_t GetLap(uint32_t position)
+        { return (position & ~(Capacity - 1)); }
+
+    Slot& GetSlot(uint32_t position)
+        { return Slots[position & (Capacity - 1)]; }
+
+    std::atomic<uint32_t> Tail;             // Next position to enqueue.
+    uint8_t               TailPad[LocklessCacheLineSize - sizeof(std::atomic<uint32_t>)];
+    std::atomic<uint32_t> Head;             // Next position to dequeue.
+    uint8_t               HeadPad[LocklessCacheLineSize - sizeof(std::atomic<uint32_t>)];
+    Slot                  Slots[Capacity];
+};
+
+
+template<class T, uint32_t Capacity>
+class LocklessMPSCQueue : public LocklessSequenceQueue<T, Capacity, false>
+{
+public:
+    LocklessMPSCQueue()
+        { this->Reset(); }
+};
+
+
+template<class T, uint32_t Capacity>
+class LocklessMPMCQueue : public LocklessSequenceQueue<T, Capacity, true>
+{
+public:
+    LocklessMPMCQueue()
+        { this->Reset(); }
+};
+
+
+// For queues in SharedMemory. Payload values are copied in and out of LocklessPadding slots,
+// so Payload can grow up to PaddingSize without changing the layout, as with LocklessUpdater.
+// Construct it only in the process that creates the shared memory (e.g. SharedObjectWriter);
+// other processes must map it without constructing it. Zero-filled memory is also a valid
+// empty queue.
+template<class Payload, int PaddingSize, uint32_t Capacity>
+class LocklessSharedQueue : public LocklessSequenceQueue<LocklessPadding<Payload, PaddingSize>, Capacity, true>
+{
+public:
+    static_assert(ATOMIC_INT_LOCK_FREE == 2, "Shared queues need address-free atomics");
+
+    LocklessSharedQueue()
+        { this->Reset(); }
+};
+
+
+// ***** LocklessHistoryUpdater
+
+// Like LocklessUpdater, for a single producer, but keeps the last SlotCount updates instead of
+// only the latest, so a reader can also look back (e.g. for the sample closest to a time), 
+// and reads never wait on the producer.
+//
+// Each slot is a seqlock: its Sequence is odd while the producer writes it, and a read of a 
+// slot is valid if Sequence was even and unchanged across the copy. A read of one update is a 
+// single attempt, so it is wait-free. It fails only if the update isn't written yet, or has been 
+// overwritten because the producer made SlotCount more updates in the meantime. Reading the 
+// latest K updates therefore succeeds as long as the producer makes fewer than (SlotCount - K) 
+// updates while the reader copies them, so size SlotCount for the history readers want plus 
+// the updates that can happen during a read. GetLatest and GetHistory retry with the newest 
+// update up to maxAttempts times and then return false, instead of spinning like 
+// LocklessUpdater::GetState when SlotType is large and the producer is fast.
+//
+// Update indices start at 1 and wrap at 32 bits. The layout is the same in 32 and 64 bit 
+// processes, and zero-filled memory is an updater with no updates, so it can be placed in 
+// SharedMemory like LocklessUpdater. As there, SlotType can be larger than T to leave room 
+// for T to grow.
+//
+// Example usage:
+//     LocklessHistoryUpdater<PoseSample, 64> poses;
+//
+//     // Producer
+//     poses.SetState(sample);
+//
+//     // Any reader
+//     PoseSample history[16];
+//     uint32_t   historyCount;
+//     if (poses.GetHistory(history, 16, historyCount))
+//         { ... history[0] is the newest ... }
+
+template<class T, uint32_t SlotCount, class SlotType = T>
+class LocklessHistoryUpdater
+{
+public:
+    static_assert((SlotCount >= 2) && ((SlotCount & (SlotCount - 1)) == 0), "SlotCount must be a power of two");
+    static_assert(sizeof(T) <= sizeof(SlotType), "SlotType is too small");
+    static_assert(std::is_trivially_copyable<T>::value, "T is copied as raw memory");
+    static_assert(ATOMIC_INT_LOCK_FREE == 2, "Needs address-free atomics to be usable in SharedMemory");
+
+    static const unsigned DefaultMaxAttempts = 4;
+
+    LocklessHistoryUpdater()
+      : UpdateCount(0)
+    {
+        for (uint32_t i = 0; i < SlotCount; ++i)
+        {
+            Slots[i].Sequence.store(0, std::memory_order_relaxed);
+            Slots[i].Index.store(0, std::memory_order_relaxed);
+
+            for (uint32_t j = 0; j < WordCount; ++j)
+                Slots[i].Words[j].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Producer thread only. 
+    void SetState(const T& state)
+    {
+        const uint32_t index    = (UpdateCount.load(std::memory_order_relaxed) + 1);
+        Slot&          slot     = Slots[index & (SlotCount - 1)];
+        const uint32_t sequence = slot.Sequence.load(std::memory_order_relaxed);
+
+        slot.Sequence.store(sequence + 1, std::memory_order_relaxed); // Odd: readers of this slot fail until we're done.
+
+        // The release stores keep the odd Sequence ahead of the new contents. A reader that sees 
+        // any of the new contents is then guaranteed to see Sequence changed when it checks again.
+        slot.Index.store(index, std::memory_order_release);
+
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&state);
+
+        for (uint32_t j = 0; j < ValueWordCount; ++j)
+        {
+            uint32_t word = 0;
+            memcpy(&word, bytes + (j * sizeof(uint32_t)), GetWordSize(j));
+            slot.Words[j].store(word, std::memory_order_release);
+        }
+
+        slot.Sequence.store(sequence + 2, std::memory_order_release);
+        UpdateCount.store(index, std::memory_order_release);
+    }
+
+    // Returns the index of the latest update, which is 0 before the first.
+    uint32_t GetUpdateCount() const
+    {
+        return UpdateCount.load(std::memory_order_acquire);
+    }
+
+    // Copies the given update. Wait-free. Returns false if it isn't written yet or was 
+    // overwritten, in which case state may have been modified.
+    bool GetUpdate(uint32_t index, T& state) const
+    {
+        const Slot&    slot     = Slots[index & (SlotCount - 1)];
+        const uint32_t sequence = slot.Sequence.load(std::memory_order_acquire);
+
+        if ((sequence == 0) || (sequence & 1) || (slot.Index.load(std::memory_order_acquire) != index))
+            return false;
+
+        uint8_t* bytes = reinterpret_cast<uint8_t*>(&state);
+
+        for (uint32_t j = 0; j < ValueWordCount; ++j)
+        {
+            const uint32_t word = slot.Words[j].load(std::memory_order_acquire);
+            memcpy(bytes + (j * sizeof(uint32_t)), &word, GetWordSize(j));
+        }
+
+        return (slot.Sequence.load(std::memory_order_relaxed) == sequence);
+    }
+
+    // Copies the latest update. Returns false if there were no updates yet, or if the producer 
+    // overwrote the latest update maxAttempts times in a row while it was being copied.
+    bool GetLatest(T& state, uint32_t* index = nullptr, unsigned maxAttempts = DefaultMaxAttempts) const
+    {
+        for (unsigned attempt = 0; attempt < maxAttempts; ++attempt)
+        {
+            const uint32_t latest = GetUpdateCount();
+
+            if (latest == 0)
+                return false;
+
+            if (GetUpdate(latest, state))
+            {
+                if (index)
+                    *index = latest;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Copies up to count of the latest updates, newest first, into states. historyCount is set 
+    // to the number copied, which is less than count if there haven't been enough updates yet. 
+    // Returns false if the producer overwrote part of the history maxAttempts times in a row
+    // while it was being copied.
+    bool GetHistory(T* states, uint32_t count, uint32_t& historyCount, unsigned maxAttempts = DefaultMaxAttempts) const
+    {
+        historyCount = 0;
+
+        if (count > SlotCount)
+            count = SlotCount;
+
+        for (unsigned attempt = 0; attempt < maxAttempts; ++attempt)
+        {
+            const uint32_t latest = GetUpdateCount();
+            uint32_t       i = 0;
+
+            while ((i < count) && (i < latest) && GetUpdate(latest - i, states[i])) // Right after the index wraps, this stops early.
+                ++i;
+
+            if ((i == count) || (i == latest))
+            {
+                historyCount = i;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+protected:
+    static const uint32_t WordCount      = (uint32_t)((sizeof(SlotType) + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+    static const uint32_t ValueWordCount = (uint32_t)((sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t)); // The rest stay 0.
+
+    // The number of bytes of T in word j.
+    static size_t GetWordSize(uint32_t j)
+        { return ((((j + 1) * sizeof(uint32_t)) <= sizeof(T)) ? sizeof(uint32_t) : (sizeof(T) - (j * sizeof(uint32_t)))); }
+
+    // The contents are copied as atomic words so that a copy racing with the producer is 
+    // well-defined; it's detected and thrown away by the Sequence check.
+    struct Slot
+    {
+        std::atomic<uint32_t> Sequence;     // Odd while being written. 0 if never written.
+        std::atomic<uint32_t> Index;        // Update index of the contents.
+        std::atomic<uint32_t> Words[WordCount];
+    };
+
+    std::atomic<uint32_t> UpdateCount;      // Index of the latest update.
+    uint8_t               UpdateCountPad[LocklessCacheLineSize - sizeof(std::atomic<uint32_t>)];
+    Slot                  Slots[SlotCount];
+};
+
+
 } // namespace OVR
 
 #endif // OVR_Lockless_h
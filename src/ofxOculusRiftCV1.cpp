@@ -1,8 +1,12 @@
 
 #include "ofxOculusRiftCV1.h"
+#include "Kernel/OVR_Allocator.h"
 
 #define STRINGIFY(x) #x
 
+// How often update() retries ovr_Create after the display was lost
+#define RECOVERY_RETRY_INTERVAL_US 500000
+
 ofQuaternion toOf(const Quatf& q) {
 	return ofQuaternion(q.x, q.y, q.z, q.w);
 }
@@ -43,14 +47,53 @@ using namespace OVR;
 ofxOculusRiftCV1::ofxOculusRiftCV1() {
 
 	bOVRInitialized = false;
+	bRuntimeInitialized = false;
+	initPhase = INIT_NONE;
+	memset(&initTimings, 0, sizeof(initTimings));
+	memset(&connectTimings, 0, sizeof(connectTimings));
+	initStartTime = 0;
+
+	memset(&hmdDesc, 0, sizeof(hmdDesc));
+	memset(&connectHmdDesc, 0, sizeof(connectHmdDesc));
+	windowSize = { 0, 0 };
 
+	session = nullptr;
 	eyeRenderTexture[0] = nullptr;
 	eyeRenderTexture[1] = nullptr;
 	eyeDepthBuffer[0] = nullptr;
 	eyeDepthBuffer[1] = nullptr;
 	mirrorTexture = nullptr;
+	mirrorTextureID = 0;
 	mirrorFBO = 0;
+	mirrorTextureLocation = -1;
 	frameIndex = 0;
+
+	bEyeBegun[0] = false;
+	bEyeBegun[1] = false;
+
+	recoveryState = RECOVERY_NONE;
+	displayLostTime = 0;
+	lastRecoveryAttempt = 0;
+	lastRecoveryTime = 0;
+	recoveryCount = 0;
+
+	memset(&sessionStatus, 0, sizeof(sessionStatus));
+	visibilityState = VISIBILITY_NO_HMD;
+	idlePolicy = IDLE_RENDER;
+	idleFrameInterval = 6;
+	idleResolutionScale = 0.5f;
+	idleFrameCount = 0;
+	memset(timeInState, 0, sizeof(timeInState));
+	lastVisibilityUpdate = 0;
+	bRenderThisFrame = false;
+	renderScale = 1.0f;
+
+	floatingOrigin = nullptr;
+
+	bAllocationBudget = false;
+	allocationBudgetCount = 0;
+	allocationBudgetBytes = 0;
+	allocationBudgetBaseViolations = 0;
 }
 
 ofxOculusRiftCV1::~ofxOculusRiftCV1() {
@@ -58,9 +101,39 @@ ofxOculusRiftCV1::~ofxOculusRiftCV1() {
 	close();
 }
 
-bool ofxOculusRiftCV1::init() {
+bool ofxOculusRiftCV1::init(bool bDeferred) {
+
+	ofLogNotice("ofxOculusRiftCV1") << "init()";
+
+	if (initPhase != INIT_NONE && initPhase != INIT_FAILED) {
+		ofLogWarning("ofxOculusRiftCV1") << "init() called twice";
+		return true;
+	}
+
+	memset(&initTimings, 0, sizeof(initTimings));
+	memset(&connectTimings, 0, sizeof(connectTimings));
+	initStartTime = ofGetElapsedTimeMicros();
+	initPhase = INIT_CONNECTING;
+
+	// Connecting to the runtime doesn't touch GL, so run it in the background
+	connectFuture = std::async(std::launch::async, &ofxOculusRiftCV1::connectRuntime, this);
 
-	ofLogError("ofxOculusRiftCV1") << "init()";
+	// ...and compile the mirror shader on this (the GL) thread meanwhile
+	setupMirrorShader();
+
+	if (bDeferred) {
+		// finishInit() will be called from update() once the session is up
+		return true;
+	}
+
+	return finishInit();
+}
+
+bool ofxOculusRiftCV1::connectRuntime() {
+
+	// This runs off the GL thread: it only writes connectHmdDesc and
+	// connectTimings, which finishInit() copies once the thread is done
+	uint64_t start = ofGetElapsedTimeMicros();
 
 	// Initializes LibOVR, and the Rift
 	ovrInitParams initParams = { ovrInit_RequestVersion, OVR_MINOR_VERSION, NULL, 0, 0 };
@@ -74,6 +147,11 @@ bool ofxOculusRiftCV1::init() {
 		return false;
 	}
 
+	bRuntimeInitialized = true;
+
+	uint64_t connected = ofGetElapsedTimeMicros();
+	connectTimings.connect = connected - start;
+
 	result = ovr_Create(&session, &luid);
 
 	if (!OVR_SUCCESS(result)){
@@ -84,17 +162,75 @@ bool ofxOculusRiftCV1::init() {
 		return false;
 	}
 
+	// This runs off the main thread, so report the failure and let finishInit() clean up
 	if (Compare(luid, GetDefaultAdapterLuid())) // If luid that the Rift is on is not the default adapter LUID...
 	{
-		VALIDATE(false, "OpenGL supports only the default graphics adapter.");
+		ofLogError("ofxOculusRiftCV1") << "OpenGL supports only the default graphics adapter.";
+		return false;
 	}
 
-	hmdDesc = ovr_GetHmdDesc(session);
+	connectHmdDesc = ovr_GetHmdDesc(session);
+
+	connectTimings.createSession = ofGetElapsedTimeMicros() - connected;
+	initPhase = INIT_SESSION_READY;
+
+	return true;
+}
+
+bool ofxOculusRiftCV1::finishInit() {
+
+	// Blocks only if the background connection hasn't finished yet
+	bool bConnected = connectFuture.valid() && connectFuture.get();
+
+	// The connection thread is done, take over what it wrote
+	initTimings.connect = connectTimings.connect;
+	initTimings.createSession = connectTimings.createSession;
+
+	if (!bConnected) {
+		initPhase = INIT_FAILED;
+		close();
+		return false;
+	}
+
+	hmdDesc = connectHmdDesc;
 
 	// Setup Window and Graphics
 	// Note: the mirror window can be any size, for this sample we use 1/2 the HMD resolution
 	windowSize = { hmdDesc.Resolution.w /2 , hmdDesc.Resolution.h /2 };
 
+	uint64_t start = ofGetElapsedTimeMicros();
+
+	if (!createRenderTargets()) {
+		initPhase = INIT_FAILED;
+		close();
+		return false;
+	}
+
+	// Turn off vsync to let the compositor do its magic
+	wglSwapIntervalEXT(0);
+
+	// FloorLevel will give tracking poses where the floor height is 0
+	ovr_SetTrackingOriginType(session, ovrTrackingOrigin_FloorLevel);
+
+	uint64_t end = ofGetElapsedTimeMicros();
+	initTimings.createTargets = end - start;
+	initTimings.total = end - initStartTime;
+
+	ofLogNotice("ofxOculusRiftCV1") << "init timings (ms):"
+		<< " connect " << initTimings.connect / 1000.0
+		<< ", session " << initTimings.createSession / 1000.0
+		<< ", shader " << initTimings.compileShader / 1000.0
+		<< ", targets " << initTimings.createTargets / 1000.0
+		<< ", total " << initTimings.total / 1000.0;
+
+	bOVRInitialized = true;
+	initPhase = INIT_READY;
+
+	return bOVRInitialized;
+}
+
+bool ofxOculusRiftCV1::createRenderTargets() {
+
 	/*
 	if (!Platform.InitDevice(windowSize.w, windowSize.h, reinterpret_cast<LUID*>(&luid)))
 		close();
@@ -109,8 +245,8 @@ bool ofxOculusRiftCV1::init() {
 
 		if (!eyeRenderTexture[eye]->TextureChain)
 		{
-			close();
-			VALIDATE(false, "Failed to create texture.");
+			ofLogError("ofxOculusRiftCV1") << "Failed to create texture.";
+			return false;
 		}
 	}
 
@@ -126,11 +262,12 @@ bool ofxOculusRiftCV1::init() {
 	desc.Format = OVR_FORMAT_R8G8B8A8_UNORM_SRGB;
 
 	// Create mirror texture and an FBO used to copy mirror texture to back buffer
-	result = ovr_CreateMirrorTextureGL(session, &desc, &mirrorTexture);
+	ovrResult result = ovr_CreateMirrorTextureGL(session, &desc, &mirrorTexture);
 	if (!OVR_SUCCESS(result))
 	{
-		close();
-		VALIDATE(false, "Failed to create mirror texture.");
+		ofLogError("ofxOculusRiftCV1") << "Failed to create mirror texture.";
+		logError();
+		return false;
 	}
 
 	// Configure the mirror read buffer
@@ -142,12 +279,102 @@ bool ofxOculusRiftCV1::init() {
 	glFramebufferRenderbuffer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, 0);
 	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 
-	// Turn off vsync to let the compositor do its magic
-	wglSwapIntervalEXT(0);
+	return true;
+}
+
+void ofxOculusRiftCV1::destroyRenderTargets() {
+
+	if (mirrorFBO) {
+		glDeleteFramebuffers(1, &mirrorFBO);
+		mirrorFBO = 0;
+	}
+
+	if (mirrorTexture) {
+		ovr_DestroyMirrorTexture(session, mirrorTexture);
+		mirrorTexture = nullptr;
+		mirrorTextureID = 0;
+	}
+
+	for (int eye = 0; eye < 2; ++eye)
+	{
+		delete eyeRenderTexture[eye];
+		delete eyeDepthBuffer[eye];
+		eyeRenderTexture[eye] = nullptr;
+		eyeDepthBuffer[eye] = nullptr;
+	}
+}
+
+void ofxOculusRiftCV1::onDisplayLost() {
+
+	if (recoveryState != RECOVERY_NONE) return;
+
+	ofLogWarning("ofxOculusRiftCV1") << "display lost, recreating session";
+
+	// The session is unusable from here on: drop everything that belongs to
+	// it, but keep the runtime and our GL programs
+	destroyRenderTargets();
+
+	if (session) {
+		ovr_Destroy(session);
+		session = nullptr;
+	}
+
+	bOVRInitialized = false;
+	recoveryState = RECOVERY_PENDING;
+	displayLostTime = ofGetElapsedTimeMicros();
+	lastRecoveryAttempt = 0;
+}
+
+bool ofxOculusRiftCV1::tryRecover() {
+
+	uint64_t now = ofGetElapsedTimeMicros();
+	if (lastRecoveryAttempt && now - lastRecoveryAttempt < RECOVERY_RETRY_INTERVAL_US) return false;
+	lastRecoveryAttempt = now;
+
+	ovrGraphicsLuid newLuid;
+	ovrResult result = ovr_Create(&session, &newLuid);
+
+	if (!OVR_SUCCESS(result)) {
+		// Most likely the headset is still unplugged, keep waiting
+		session = nullptr;
+		return false;
+	}
+
+	// Our GL context lives on the old adapter, it can't render to a new one
+	if (Compare(newLuid, luid)) {
+		ofLogError("ofxOculusRiftCV1") << "HMD came back on a different graphics adapter, restart required";
+		ovr_Destroy(session);
+		session = nullptr;
+		return false;
+	}
+
+	hmdDesc = ovr_GetHmdDesc(session);
+	windowSize = { hmdDesc.Resolution.w / 2, hmdDesc.Resolution.h / 2 };
+
+	if (!createRenderTargets()) {
+		destroyRenderTargets();
+		ovr_Destroy(session);
+		session = nullptr;
+		return false;
+	}
 
-	// FloorLevel will give tracking poses where the floor height is 0
 	ovr_SetTrackingOriginType(session, ovrTrackingOrigin_FloorLevel);
 
+	frameIndex = 0;
+	lastRecoveryTime = ofGetElapsedTimeMicros() - displayLostTime;
+	recoveryCount++;
+	recoveryState = RECOVERY_NONE;
+	bOVRInitialized = true;
+
+	ofLogNotice("ofxOculusRiftCV1") << "recovered from display lost in " << lastRecoveryTime / 1000.0 << " ms";
+
+	return true;
+}
+
+void ofxOculusRiftCV1::setupMirrorShader() {
+
+	uint64_t start = ofGetElapsedTimeMicros();
+
 	const string version = "#version 150\n";
 	const string vertexShader = version+STRINGIFY(
 
@@ -194,37 +421,63 @@ bool ofxOculusRiftCV1::init() {
 	mirrorShader.setupShaderFromSource(GL_FRAGMENT_SHADER, fragmentShader);
 	mirrorShader.bindDefaults();
 	mirrorShader.linkProgram();
+	mirrorTextureLocation = glGetUniformLocation(mirrorShader.getProgram(), "src_tex_unit0");
 
-	bOVRInitialized = true;
+	// draw() fills in the corners
+	ofVec3f vertices[4];
+	ofVec2f texCoords[4] = { ofVec2f(0, 0), ofVec2f(1.0, 0), ofVec2f(0, 1.0), ofVec2f(1.0, 1.0) };
+	mirrorQuad.setVertexData(vertices, 4, GL_DYNAMIC_DRAW);
+	mirrorQuad.setTexCoordData(texCoords, 4, GL_STATIC_DRAW);
+	mirrorQuadRect = ofRectangle();
 
-	return bOVRInitialized;
+	initTimings.compileShader = ofGetElapsedTimeMicros() - start;
 }
 
 void ofxOculusRiftCV1::close() {
 
 	ofLogNotice("ofxOculusRiftCV1") << "close()";
 
-	if( bOVRInitialized ){
+	// Never tear down underneath the background connection
+	if (connectFuture.valid()) connectFuture.wait();
 
-		if (mirrorFBO) glDeleteFramebuffers(1, &mirrorFBO);
-		if (mirrorTexture) ovr_DestroyMirrorTexture(session, mirrorTexture);
+	destroyRenderTargets();
 
-		for (int eye = 0; eye < 2; ++eye)
-		{
-			delete eyeRenderTexture[eye];
-			delete eyeDepthBuffer[eye];
-		}
-		
+	if (session) {
 		ovr_Destroy(session);
-		ovr_Shutdown();
+		session = nullptr;
+	}
 
-		bOVRInitialized = false;
+	if (bRuntimeInitialized) {
+		ovr_Shutdown();
+		bRuntimeInitialized = false;
 	}
+
+	bOVRInitialized = false;
+	recoveryState = RECOVERY_NONE;
+	if (initPhase != INIT_FAILED) initPhase = INIT_NONE;
 }
 
 void ofxOculusRiftCV1::update() {
 
-	if (!bOVRInitialized) return;
+	AllocationBudgetScope budget("ofxOculusRiftCV1::update", allocationBudgetCount, allocationBudgetBytes, bAllocationBudget);
+
+	// Once the session is back, carry on with the normal update so this
+	// frame's begin()/end() don't submit the poses from before the loss
+	if (recoveryState != RECOVERY_NONE && !tryRecover()) return;
+
+	if (!bOVRInitialized) {
+
+		// Deferred init: pick up the session once the background thread is done
+		if (initPhase == INIT_SESSION_READY) finishInit();
+		else if (initPhase == INIT_CONNECTING && connectFuture.valid() &&
+			connectFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready) finishInit();
+
+		return;
+	}
+
+	updateVisibility();
+
+	if (!bOVRInitialized || !bRenderThisFrame) return;
 
 	// Call ovr_GetRenderDesc each frame to get the ovrEyeRenderDesc, as the returned values (e.g. HmdToEyeOffset) may change at runtime.
 	eyeRenderDesc[0] = ovr_GetRenderDesc(session, ovrEye_Left, hmdDesc.DefaultEyeFov[0]);
@@ -235,39 +488,109 @@ void ofxOculusRiftCV1::update() {
 
 	// sensorSampleTime is fed into the layer later
 	ovr_GetEyePoses(session, frameIndex, ovrTrue, HmdToEyeOffset, eyeRenderPose, &sensorSampleTime);
+
+	if (floatingOrigin) {
+		// Head sits halfway between the eyes
+		Posef headPose(eyeRenderPose[0].Orientation,
+			(Vector3f(eyeRenderPose[0].Position) + Vector3f(eyeRenderPose[1].Position)) * 0.5f);
+		floatingOrigin->update(headPose);
+	}
 }
 
-void ofxOculusRiftCV1::begin(ovrEyeType whichEye) {
+void ofxOculusRiftCV1::updateVisibility() {
 
-	if (!bOVRInitialized) return;
-
-	ovrSessionStatus sessionStatus;
 	ovr_GetSessionStatus(session, &sessionStatus);
 
-	if (sessionStatus.ShouldQuit) {
-		// Because the application is requested to quit, should not request retry
+	if (sessionStatus.DisplayLost) {
+		onDisplayLost();
+		bRenderThisFrame = false;
 		return;
 	}
 
 	if (sessionStatus.ShouldRecenter)
 		ovr_RecenterTrackingOrigin(session);
 
-	if (true) //sessionStatus.IsVisible)
+	VisibilityState state;
+	if (!sessionStatus.HmdPresent) state = VISIBILITY_NO_HMD;
+	else if (!sessionStatus.IsVisible) state = VISIBILITY_HIDDEN;
+	else if (!sessionStatus.HmdMounted) state = VISIBILITY_UNMOUNTED;
+	else state = VISIBILITY_ACTIVE;
+
+	// Charge the time since the last frame to the state we were in
+	uint64_t now = ofGetElapsedTimeMicros();
+	if (lastVisibilityUpdate) timeInState[visibilityState] += now - lastVisibilityUpdate;
+	lastVisibilityUpdate = now;
+
+	if (state != visibilityState) {
+		ofLogVerbose("ofxOculusRiftCV1") << "visibility state " << visibilityState << " -> " << state;
+		visibilityState = state;
+		idleFrameCount = 0;
+	}
+
+	renderScale = 1.0f;
+
+	if (sessionStatus.ShouldQuit) {
+		// Because the application is requested to quit, should not request retry
+		bRenderThisFrame = false;
+	}
+	else if (visibilityState == VISIBILITY_ACTIVE || idlePolicy == IDLE_RENDER) {
+		bRenderThisFrame = true;
+	}
+	else if (idlePolicy == IDLE_THROTTLE) {
+		bRenderThisFrame = (idleFrameCount++ % idleFrameInterval) == 0;
+		renderScale = idleResolutionScale;
+	}
+	else {
+		bRenderThisFrame = false;
+	}
+}
+
+Sizei ofxOculusRiftCV1::getEyeRenderSize(int eye) {
+
+	Sizei size = eyeRenderTexture[eye]->GetSize();
+	if (renderScale < 1.0f) {
+		size.w = std::max(1, (int)(size.w * renderScale));
+		size.h = std::max(1, (int)(size.h * renderScale));
+	}
+	return size;
+}
+
+bool ofxOculusRiftCV1::begin(ovrEyeType whichEye) {
+
+	AllocationBudgetScope budget("ofxOculusRiftCV1::begin", allocationBudgetCount, allocationBudgetBytes, bAllocationBudget);
+
+	int eye = (whichEye == ovrEye_Left) ? 0 : 1;
+	bEyeBegun[eye] = false;
+
+	if (!bOVRInitialized) return false;
+
+	// Session status, recentering and the idle policy are handled once per frame in update()
+	if (bRenderThisFrame)
 	{
-		int eye = (whichEye == ovrEye_Left) ? 0 : 1;
+		bEyeBegun[eye] = true;
 
 		ofPushView();
 
 		// Switch to eye render target
 		eyeRenderTexture[eye]->SetAndClearRenderSurface(eyeDepthBuffer[eye]);
 
+		// Idle frames only fill the lower-left corner, the compositor scales it up
+		if (renderScale < 1.0f) {
+			Sizei size = getEyeRenderSize(eye);
+			glViewport(0, 0, size.w, size.h);
+		}
+
 		Matrix4f proj = ovrMatrix4f_Projection(hmdDesc.DefaultEyeFov[eye], 0.2f, 1000.0f, ovrProjection_None);
 		ofMatrix4x4 projectionMatrix = toOf(proj);
 
-		Matrix4f eyeMatrix = Matrix4f(eyeRenderPose[eye].Orientation);
+		// The layer keeps the tracking-space pose, only the camera is rebased
+		Posef eyePose = eyeRenderPose[eye];
+		if (floatingOrigin) eyePose = floatingOrigin->trackingToRender(eyePose);
+
+		Matrix4f eyeMatrix = Matrix4f(eyePose.Rotation);
 		Vector3f finalUp = eyeMatrix.Transform(Vector3f(0, 1, 0));
 		Vector3f finalForward = eyeMatrix.Transform(Vector3f(0, 0, -1));
-		Vector3f shiftedEyePos = (eyeRenderPose[eye].Position);
+		Vector3f shiftedEyePos = eyePose.Translation;
 
 		ofVec3f eyePos = ofVec3f(shiftedEyePos.x, shiftedEyePos.y, shiftedEyePos.z);
 		ofVec3f lookAtPos = eyePos + ofVec3f(finalForward.x, finalForward.y, finalForward.z);
@@ -286,15 +609,29 @@ void ofxOculusRiftCV1::begin(ovrEyeType whichEye) {
 		ofSetMatrixMode(OF_MATRIX_MODELVIEW);
 		ofLoadIdentityMatrix();
 		ofLoadMatrix(modelViewMatrix);
-	}	
+	}
+
+	return bEyeBegun[eye];
 }
 
 void ofxOculusRiftCV1::end(ovrEyeType whichEye) {
 
-	if (!bOVRInitialized) return;
+	AllocationBudgetScope budget("ofxOculusRiftCV1::end", allocationBudgetCount, allocationBudgetBytes, bAllocationBudget);
 
 	int eye = (whichEye == ovrEye_Left) ? 0 : 1;
 
+	// Nothing was pushed or bound if begin() bailed out
+	if (!bEyeBegun[eye]) return;
+	bEyeBegun[eye] = false;
+
+	if (!bOVRInitialized) {
+		// The session went away between begin() and end(), just restore state
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		ofPopMatrix();
+		ofPopView();
+		return;
+	}
+
 	// Avoids an error when calling SetAndClearRenderSurface during next iteration.
 	// Without this, during the next while loop iteration SetAndClearRenderSurface
 	// would bind a framebuffer with an invalid COLOR_ATTACHMENT0 because the texture ID
@@ -319,7 +656,7 @@ void ofxOculusRiftCV1::end(ovrEyeType whichEye) {
 		for (int eye = 0; eye < 2; ++eye)
 		{
 			ld.ColorTexture[eye] = eyeRenderTexture[eye]->TextureChain;
-			ld.Viewport[eye] = Recti(eyeRenderTexture[eye]->GetSize());
+			ld.Viewport[eye] = Recti(getEyeRenderSize(eye));
 			ld.Fov[eye] = hmdDesc.DefaultEyeFov[eye];
 			ld.RenderPose[eye] = eyeRenderPose[eye];
 			ld.SensorSampleTime = sensorSampleTime;
@@ -328,8 +665,12 @@ void ofxOculusRiftCV1::end(ovrEyeType whichEye) {
 		ovrLayerHeader* layers = &ld.Header;
 		ovrResult result = ovr_SubmitFrame(session, frameIndex, nullptr, &layers, 1);
 
-		// exit the rendering loop if submit returns an error, will retry on ovrError_DisplayLost
-		if (!OVR_SUCCESS(result)) {
+		// recreate the session from update() on ovrError_DisplayLost
+		if (result == ovrError_DisplayLost) {
+			onDisplayLost();
+			return;
+		}
+		else if (!OVR_SUCCESS(result)) {
 			logError();
 		}
 
@@ -344,20 +685,18 @@ void ofxOculusRiftCV1::draw(float x, float y) {
 
 void ofxOculusRiftCV1::draw(float x, float y, float w, float h) {
 
+	AllocationBudgetScope budget("ofxOculusRiftCV1::draw", allocationBudgetCount, allocationBudgetBytes, bAllocationBudget);
+
 	if (!bOVRInitialized) return;
 
-	
-	ovrSessionStatus sessionStatus;
-	ovr_GetSessionStatus(session, &sessionStatus);
+	// sessionStatus is read (and recentering done) once per frame in update()
 	if (sessionStatus.ShouldQuit){
 		// Because the application is requested to quit, should not request retry
 		return;
 	}
-	if (sessionStatus.ShouldRecenter)
-		ovr_RecenterTrackingOrigin(session);
 
 
-#ifndef BLIT_TEXTURE
+#if BLIT_TEXTURE
 
 		GLint offsetY = ofGetHeight() - windowSize.h;
 
@@ -373,26 +712,23 @@ void ofxOculusRiftCV1::draw(float x, float y, float w, float h) {
 #else
 
 		glClear(GL_DEPTH_BUFFER_BIT);
-		
-		ofMesh m;
-		m.setMode(OF_PRIMITIVE_TRIANGLE_STRIP);
-		m.addVertex(ofVec3f(x, y));
-		m.addVertex(ofVec3f(x+w, y));
-		m.addVertex(ofVec3f(x, y+h));
-		m.addVertex(ofVec3f(x+w, y+h));
-		m.addTexCoord(ofVec3f(0, 0));
-		m.addTexCoord(ofVec3f(1.0, 0));
-		m.addTexCoord(ofVec3f(0, 1.0));
-		m.addTexCoord(ofVec3f(1.0, 1.0));
+
+		// The quad and the sampler location come from setupMirrorShader(), so
+		// drawing doesn't allocate; the corners are only rewritten when they move
+		ofRectangle rect(x, y, w, h);
+		if (rect != mirrorQuadRect) {
+			ofVec3f vertices[4] = { ofVec3f(x, y), ofVec3f(x+w, y), ofVec3f(x, y+h), ofVec3f(x+w, y+h) };
+			mirrorQuad.updateVertexData(vertices, 4);
+			mirrorQuadRect = rect;
+		}
 
 		mirrorShader.begin();
 		
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D, mirrorTextureID);
-		glUniform1i(glGetUniformLocation(mirrorShader.getProgram(), "src_tex_unit0"), 0);
-		glActiveTexture(GL_TEXTURE0);
+		glUniform1i(mirrorTextureLocation, 0);
 		
-		m.draw();
+		mirrorQuad.draw(GL_TRIANGLE_STRIP, 0, 4);
 
 		mirrorShader.end();
 #endif
@@ -402,14 +738,11 @@ void ofxOculusRiftCV1::drawScene() {
 
 	if (!bOVRInitialized) return;
 
-	ovrSessionStatus sessionStatus;
-	ovr_GetSessionStatus(session, &sessionStatus);
+	// sessionStatus is read (and recentering done) once per frame in update()
 	if (sessionStatus.ShouldQuit) {
 		// Because the application is requested to quit, should not request retry
 		return;
 	}
-	if (sessionStatus.ShouldRecenter)
-		ovr_RecenterTrackingOrigin(session);
 
 	if (sessionStatus.IsVisible)
 	{
@@ -494,8 +827,12 @@ void ofxOculusRiftCV1::drawScene() {
 		ovrLayerHeader* layers = &ld.Header;
 		ovrResult result = ovr_SubmitFrame(session, frameIndex, nullptr, &layers, 1);
 
-		// exit the rendering loop if submit returns an error, will retry on ovrError_DisplayLost
-		if (!OVR_SUCCESS(result)) {
+		// recreate the session from update() on ovrError_DisplayLost, as end() does
+		if (result == ovrError_DisplayLost) {
+			onDisplayLost();
+			return;
+		}
+		else if (!OVR_SUCCESS(result)) {
 			logError();
 		}
 
@@ -529,6 +866,104 @@ bool ofxOculusRiftCV1::getIsInitialized() {
 	return bOVRInitialized;
 }
 
+bool ofxOculusRiftCV1::isReady() {
+
+	return initPhase == INIT_READY && recoveryState == RECOVERY_NONE;
+}
+
+float ofxOculusRiftCV1::getInitProgress() {
+
+	switch (initPhase) {
+	case INIT_CONNECTING:		return bRuntimeInitialized ? 0.5f : 0.1f;
+	case INIT_SESSION_READY:	return 0.75f;
+	case INIT_READY:			return 1.0f;
+	default:					return 0.0f;
+	}
+}
+
+ofxOculusRiftCV1::InitPhase ofxOculusRiftCV1::getInitPhase() {
+
+	return (InitPhase)initPhase.load();
+}
+
+const ofxOculusRiftCV1::InitTimings & ofxOculusRiftCV1::getInitTimings() {
+
+	return initTimings;
+}
+
+ofxOculusRiftCV1::RecoveryState ofxOculusRiftCV1::getRecoveryState() {
+
+	return recoveryState;
+}
+
+int ofxOculusRiftCV1::getRecoveryCount() {
+
+	return recoveryCount;
+}
+
+uint64_t ofxOculusRiftCV1::getLastRecoveryTime() {
+
+	return lastRecoveryTime;
+}
+
+void ofxOculusRiftCV1::setIdlePolicy(IdlePolicy policy, int frameInterval, float resolutionScale) {
+
+	idlePolicy = policy;
+	idleFrameInterval = std::max(1, frameInterval);
+	idleResolutionScale = ofClamp(resolutionScale, 0.1f, 1.0f);
+}
+
+ofxOculusRiftCV1::IdlePolicy ofxOculusRiftCV1::getIdlePolicy() {
+
+	return idlePolicy;
+}
+
+ofxOculusRiftCV1::VisibilityState ofxOculusRiftCV1::getVisibilityState() {
+
+	return visibilityState;
+}
+
+uint64_t ofxOculusRiftCV1::getTimeInState(VisibilityState state) {
+
+	if (state < 0 || state >= VISIBILITY_NUM_STATES) return 0;
+	return timeInState[state];
+}
+
+bool ofxOculusRiftCV1::isRenderingFrame() {
+
+	return bOVRInitialized && bRenderThisFrame;
+}
+
+void ofxOculusRiftCV1::setFloatingOrigin(ofxOculusRiftCV1FloatingOrigin * origin) {
+
+	floatingOrigin = origin;
+}
+
+ofxOculusRiftCV1FloatingOrigin * ofxOculusRiftCV1::getFloatingOrigin() {
+
+	return floatingOrigin;
+}
+
+void ofxOculusRiftCV1::setAllocationBudget(bool enabled, uint64_t maxAllocs, uint64_t maxBytes) {
+
+	if (enabled && !bAllocationBudget) allocationBudgetBaseViolations = AllocationBudgetScope::GetTotalViolationCount();
+
+	bAllocationBudget = enabled;
+	allocationBudgetCount = maxAllocs;
+	allocationBudgetBytes = maxBytes;
+}
+
+bool ofxOculusRiftCV1::getAllocationBudgetEnabled() {
+
+	return bAllocationBudget;
+}
+
+uint64_t ofxOculusRiftCV1::getAllocationBudgetViolations() {
+
+	if (!bAllocationBudget) return 0;
+	return AllocationBudgetScope::GetTotalViolationCount() - allocationBudgetBaseViolations;
+}
+
 ofRectangle ofxOculusRiftCV1::getHMDSize() {
 
 	ofRectangle bounds;
@@ -537,6 +972,11 @@ ofRectangle ofxOculusRiftCV1::getHMDSize() {
 	return bounds;
 }
 
+GLuint ofxOculusRiftCV1::getMirrorTextureID() {
+
+	return bOVRInitialized ? mirrorTextureID : 0;
+}
+
 ovrHmdDesc & ofxOculusRiftCV1::getHMD() {
 
 	return hmdDesc;
@@ -544,7 +984,7 @@ ovrHmdDesc & ofxOculusRiftCV1::getHMD() {
 
 void ofxOculusRiftCV1::getHMDTrackingState(ofVec3f & position, ofQuaternion & orientation) {
 
-	ovrTrackingState state = ovr_GetTrackingState(session, sensorSampleTime, ovrFalse);
+	ovrTrackingState state = getHMDTrackingState();
 	
 	position = toOf(state.HeadPose.ThePose.Position);
 	orientation = toOf(state.HeadPose.ThePose.Orientation);
@@ -552,6 +992,13 @@ void ofxOculusRiftCV1::getHMDTrackingState(ofVec3f & position, ofQuaternion & or
 
 ovrTrackingState ofxOculusRiftCV1::getHMDTrackingState() {
 
+	// In deferred mode the connection thread may still be creating the session
+	if (!bOVRInitialized) {
+		ovrTrackingState state;
+		memset(&state, 0, sizeof(state));
+		return state;
+	}
+
 	ovrTrackingState state = ovr_GetTrackingState(session, sensorSampleTime, ovrFalse );
 	return state;
 }
@@ -561,7 +1008,7 @@ ofMatrix4x4 ofxOculusRiftCV1::getHMDOrientationMatrix() {
 	// @NOTE: todo
 	//return toOf(Matrix4f(pFusionResult->GetPredictedOrientation()));
 
-	ovrTrackingState ts = ovr_GetTrackingState(session, sensorSampleTime, ovrFalse);
+	ovrTrackingState ts = getHMDTrackingState();
 	if (ts.StatusFlags & (ovrStatus_OrientationTracked | ovrStatus_PositionTracked)) {
 		return toOf(Matrix4f(ts.HeadPose.ThePose.Orientation));
 	}
@@ -13,19 +13,72 @@
 #pragma comment(lib, "dxgi.lib")
 #endif
 
+#include "ofxOculusRiftCV1FloatingOrigin.h"
+
+#include <atomic>
+#include <future>
+
 #define BLIT_TEXTURE 0
 
 class ofxOculusRiftCV1 {
 
 public:
 
+	// Startup phases, in order. init() runs the runtime connection on a
+	// background thread while the mirror shader compiles on the GL thread.
+	enum InitPhase {
+		INIT_NONE,
+		INIT_CONNECTING,
+		INIT_SESSION_READY,
+		INIT_READY,
+		INIT_FAILED
+	};
+
+	// Wall-clock duration of each startup phase, in microseconds.
+	struct InitTimings {
+		uint64_t connect;		// ovr_Initialize (background)
+		uint64_t createSession;	// ovr_Create + ovr_GetHmdDesc (background)
+		uint64_t compileShader;	// mirror shader (GL thread, overlaps the above)
+		uint64_t createTargets;	// eye swap chains, mirror texture and FBO (GL thread)
+		uint64_t total;			// init() call to INIT_READY
+	};
+
+	// Display-lost recovery. Only the session, swap chains and mirror texture
+	// are recreated; the runtime, shaders and app resources stay alive.
+	enum RecoveryState {
+		RECOVERY_NONE,
+		RECOVERY_PENDING	// display lost, retrying from update()
+	};
+
+	// What the headset is doing, from ovrSessionStatus
+	enum VisibilityState {
+		VISIBILITY_ACTIVE,		// visible and on someone's head
+		VISIBILITY_UNMOUNTED,	// visible but the proximity sensor says nobody is wearing it
+		VISIBILITY_HIDDEN,		// another app has VR focus
+		VISIBILITY_NO_HMD,		// HMD not present
+		VISIBILITY_NUM_STATES
+	};
+
+	// What to do with the eye buffers in any state other than VISIBILITY_ACTIVE.
+	// IDLE_RENDER unless setIdlePolicy() says otherwise.
+	enum IdlePolicy {
+		IDLE_RENDER,	// render as usual
+		IDLE_THROTTLE,	// render every idleFrameInterval frames at idleResolutionScale
+		IDLE_SKIP		// don't render or submit at all
+	};
+
 	ofxOculusRiftCV1();
 	~ofxOculusRiftCV1();
 
-	bool init();
+	// Pass bDeferred = true to return as soon as the background connection is
+	// started; the GL objects are then created from update() once the session
+	// is up. Poll isReady() / getInitProgress() to know when rendering starts.
+	bool init(bool bDeferred = false);
 	void close();
 	void update();
-	void begin(ovrEyeType whichEye);
+	// Returns false if the eye shouldn't be drawn this frame (not ready,
+	// display lost or idle); end() is still safe to call either way.
+	bool begin(ovrEyeType whichEye);
 	void end(ovrEyeType whichEye);
 
 	void draw(float x, float y );
@@ -33,10 +86,47 @@ public:
 	void drawScene(); 
 
 	bool getIsInitialized();
-
+	bool isReady();
+	float getInitProgress();
+	InitPhase getInitPhase();
+	const InitTimings & getInitTimings();	// zero until the background connection is done
+
+	RecoveryState getRecoveryState();
+	int getRecoveryCount();
+	uint64_t getLastRecoveryTime();	// microseconds from display lost to rendering again
+
+	void setIdlePolicy(IdlePolicy policy, int frameInterval = 6, float resolutionScale = 0.5f);
+	IdlePolicy getIdlePolicy();
+	VisibilityState getVisibilityState();
+	uint64_t getTimeInState(VisibilityState state);	// microseconds since init
+	bool isRenderingFrame();
+
+	// With a floating origin attached, begin() sets up the eye cameras in its
+	// render space and update() rebases it from the head pose. Pass nullptr
+	// to go back to plain tracking space. The origin isn't owned.
+	void setFloatingOrigin(ofxOculusRiftCV1FloatingOrigin * origin);
+	ofxOculusRiftCV1FloatingOrigin * getFloatingOrigin();
+
+	// Steady-state frames shouldn't touch the heap. With the budget enabled,
+	// each update(), begin(), end() and draw() call that makes more than
+	// maxAllocs allocations or maxBytes bytes reports the offending
+	// allocations with their tag and backtrace (see OVR::AllocationBudgetScope).
+	// Enable it after the first few frames, once everything created lazily
+	// exists. Debug builds see every allocation, including malloc and new in
+	// the addon and openFrameworks. Release builds only see allocations made
+	// through OVR::Allocator, which the addon doesn't use, so there the
+	// budget checks nothing and getAllocationBudgetViolations() stays 0.
+	void setAllocationBudget(bool enabled, uint64_t maxAllocs = 0, uint64_t maxBytes = 0);
+	bool getAllocationBudgetEnabled();
+	uint64_t getAllocationBudgetViolations();	// over-budget allocations since enabled, in any budget scope
+
+	// Empty until init() (or update(), when deferred) has finished
 	ofRectangle getHMDSize();
+	GLuint getMirrorTextureID();	// 0 while not initialized or recovering
 	ovrHmdDesc & getHMD();
 
+	// Zeroed state while not initialized or recovering
+
 	void getHMDTrackingState(ofVec3f & position, ofQuaternion & orientation);
 	ovrTrackingState getHMDTrackingState();
 	ofMatrix4x4 getHMDOrientationMatrix();
@@ -45,6 +135,16 @@ protected:
 
 	void logError();
 
+	bool connectRuntime();
+	bool finishInit();
+	bool createRenderTargets();
+	void destroyRenderTargets();
+	void onDisplayLost();
+	bool tryRecover();
+	void updateVisibility();
+	Sizei getEyeRenderSize(int eye);
+	void setupMirrorShader();	// and the quad draw() puts the mirror texture on
+
 	static ovrGraphicsLuid GetDefaultAdapterLuid();
 	static int Compare(const ovrGraphicsLuid& lhs, const ovrGraphicsLuid& rhs);
 
@@ -65,7 +165,47 @@ protected:
 	GLuint				mirrorFBO;
 	long long			frameIndex;
 	ofShader			mirrorShader;
+	GLint				mirrorTextureLocation;
+	ofVbo				mirrorQuad;
+	ofRectangle			mirrorQuadRect;
 
 	bool bOVRInitialized;
+	std::atomic<bool> bRuntimeInitialized;
+
+	std::atomic<int>	initPhase;
+	std::future<bool>	connectFuture;
+	InitTimings			initTimings;
+	uint64_t			initStartTime;
+
+	// Written only by the connection thread, copied by finishInit() once
+	// connectFuture is done so the getters never race it
+	ovrHmdDesc			connectHmdDesc;
+	InitTimings			connectTimings;
+
+	bool				bEyeBegun[2];
+
+	RecoveryState		recoveryState;
+	uint64_t			displayLostTime;
+	uint64_t			lastRecoveryAttempt;
+	uint64_t			lastRecoveryTime;
+	int					recoveryCount;
+
+	ovrSessionStatus	sessionStatus;
+	VisibilityState		visibilityState;
+	IdlePolicy			idlePolicy;
+	int					idleFrameInterval;
+	float				idleResolutionScale;
+	long long			idleFrameCount;
+	uint64_t			timeInState[VISIBILITY_NUM_STATES];
+	uint64_t			lastVisibilityUpdate;
+	bool				bRenderThisFrame;
+	float				renderScale;
+
+	ofxOculusRiftCV1FloatingOrigin *	floatingOrigin;
+
+	bool				bAllocationBudget;
+	uint64_t			allocationBudgetCount;
+	uint64_t			allocationBudgetBytes;
+	uint64_t			allocationBudgetBaseViolations;
 };
 
@@ -0,0 +1,137 @@
+#include "ofxOculusRiftCV1FloatingOrigin.h"
+
+using namespace OVR;
+
+ofxOculusRiftCV1FloatingOrigin::ofxOculusRiftCV1FloatingOrigin() {
+
+	trackingOrigin = Posed::Identity();
+	renderOrigin = Vector3d(0, 0, 0);
+	rebaseDistance = 100.0;
+	rebaseCount = 0;
+	bRebased = false;
+}
+
+void ofxOculusRiftCV1FloatingOrigin::setTrackingOrigin(const Posed & pose) {
+
+	trackingOrigin = Posed(pose.Rotation.Normalized(), pose.Translation);
+}
+
+const Posed & ofxOculusRiftCV1FloatingOrigin::getTrackingOrigin() {
+
+	return trackingOrigin;
+}
+
+void ofxOculusRiftCV1FloatingOrigin::setRebaseDistance(double meters) {
+
+	rebaseDistance = std::max(0.0, meters);
+}
+
+double ofxOculusRiftCV1FloatingOrigin::getRebaseDistance() {
+
+	return rebaseDistance;
+}
+
+void ofxOculusRiftCV1FloatingOrigin::update(const Posef & headPose) {
+
+	Vector3d headPosition = trackingToWorld(headPose).Translation;
+
+	bRebased = false;
+	if ((headPosition - renderOrigin).LengthSq() > rebaseDistance * rebaseDistance) {
+		rebase(headPosition);
+	}
+}
+
+void ofxOculusRiftCV1FloatingOrigin::rebase(const Vector3d & worldPosition) {
+
+	renderOrigin = worldPosition;
+	rebaseCount++;
+	bRebased = true;
+}
+
+const Vector3d & ofxOculusRiftCV1FloatingOrigin::getRenderOrigin() {
+
+	return renderOrigin;
+}
+
+int ofxOculusRiftCV1FloatingOrigin::getRebaseCount() {
+
+	return rebaseCount;
+}
+
+bool ofxOculusRiftCV1FloatingOrigin::didRebase() {
+
+	return bRebased;
+}
+
+Posed ofxOculusRiftCV1FloatingOrigin::trackingToWorld(const Posef & trackingPose) {
+
+	return trackingOrigin * Posed(trackingPose);
+}
+
+Posef ofxOculusRiftCV1FloatingOrigin::trackingToRender(const Posef & trackingPose) {
+
+	return toRender(trackingToWorld(trackingPose));
+}
+
+Posef ofxOculusRiftCV1FloatingOrigin::toRender(const Posed & worldPose) {
+
+	// Subtract in double first, only the small difference is rounded to float
+	return Posef(Quatf(worldPose.Rotation), Vector3f(worldPose.Translation - renderOrigin));
+}
+
+Vector3f ofxOculusRiftCV1FloatingOrigin::toRender(const Vector3d & worldPosition) {
+
+	return Vector3f(worldPosition - renderOrigin);
+}
+
+Posed ofxOculusRiftCV1FloatingOrigin::toWorld(const Posef & renderPose) {
+
+	return Posed(Quatd(renderPose.Rotation).Normalized(), Vector3d(renderPose.Translation) + renderOrigin);
+}
+
+Vector3d ofxOculusRiftCV1FloatingOrigin::toWorld(const Vector3f & renderPosition) {
+
+	return Vector3d(renderPosition) + renderOrigin;
+}
+
+void ofxOculusRiftCV1FloatingOrigin::toRender(const Posed * worldPoses, Posef * renderPoses, size_t count) {
+
+	const double ox = renderOrigin.x;
+	const double oy = renderOrigin.y;
+	const double oz = renderOrigin.z;
+
+	for (size_t i = 0; i < count; i++) {
+		const Posed & src = worldPoses[i];
+		Posef & dst = renderPoses[i];
+		dst.Rotation.x = (float)src.Rotation.x;
+		dst.Rotation.y = (float)src.Rotation.y;
+		dst.Rotation.z = (float)src.Rotation.z;
+		dst.Rotation.w = (float)src.Rotation.w;
+		dst.Translation.x = (float)(src.Translation.x - ox);
+		dst.Translation.y = (float)(src.Translation.y - oy);
+		dst.Translation.z = (float)(src.Translation.z - oz);
+	}
+}
+
+void ofxOculusRiftCV1FloatingOrigin::toRender(const Vector3d * worldPositions, Vector3f * renderPositions, size_t count) {
+
+	const double ox = renderOrigin.x;
+	const double oy = renderOrigin.y;
+	const double oz = renderOrigin.z;
+
+	for (size_t i = 0; i < count; i++) {
+		renderPositions[i].x = (float)(worldPositions[i].x - ox);
+		renderPositions[i].y = (float)(worldPositions[i].y - oy);
+		renderPositions[i].z = (float)(worldPositions[i].z - oz);
+	}
+}
+
+ofMatrix4x4 ofxOculusRiftCV1FloatingOrigin::getRenderMatrix(const Posed & worldPose) {
+
+	Posef pose = toRender(worldPose);
+
+	ofMatrix4x4 m;
+	m.makeRotationMatrix(ofQuaternion(pose.Rotation.x, pose.Rotation.y, pose.Rotation.z, pose.Rotation.w));
+	m.setTranslation(pose.Translation.x, pose.Translation.y, pose.Translation.z);
+	return m;
+}
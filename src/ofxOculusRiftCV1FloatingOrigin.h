@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Extras/OVR_Math.h"
+
+// Large-world coordinates for content far from the origin.
+//
+// World positions are kept in double precision. Rendering happens in a float
+// "render space": the world translated so that a render origin near the
+// viewer sits at 0,0,0, which keeps everything close to the camera small
+// enough for float. The render origin follows the head and is moved
+// (rebased) whenever the head gets further than the rebase distance from it.
+//
+// The tracking origin places the runtime's tracking space in the world, so
+// moving or turning it moves the player through the world.
+class ofxOculusRiftCV1FloatingOrigin {
+
+public:
+
+	ofxOculusRiftCV1FloatingOrigin();
+
+	void setTrackingOrigin(const OVR::Posed & pose);
+	const OVR::Posed & getTrackingOrigin();
+
+	// 0 rebases every frame, i.e. rendering is fully camera-relative
+	void setRebaseDistance(double meters);
+	double getRebaseDistance();
+
+	// Call once per frame with the head pose in tracking space.
+	// ofxOculusRiftCV1 does this itself when the origin is attached to it.
+	void update(const OVR::Posef & headPose);
+	void rebase(const OVR::Vector3d & worldPosition);
+
+	const OVR::Vector3d & getRenderOrigin();
+	int getRebaseCount();
+	bool didRebase();	// the render origin moved during the last update()
+
+	OVR::Posed trackingToWorld(const OVR::Posef & trackingPose);
+	OVR::Posef trackingToRender(const OVR::Posef & trackingPose);
+
+	OVR::Posef toRender(const OVR::Posed & worldPose);
+	OVR::Vector3f toRender(const OVR::Vector3d & worldPosition);
+	OVR::Posed toWorld(const OVR::Posef & renderPose);
+	OVR::Vector3d toWorld(const OVR::Vector3f & renderPosition);
+
+	// Batched versions of toRender() for object transforms
+	void toRender(const OVR::Posed * worldPoses, OVR::Posef * renderPoses, size_t count);
+	void toRender(const OVR::Vector3d * worldPositions, OVR::Vector3f * renderPositions, size_t count);
+
+	// Model matrix to draw something placed at worldPose
+	ofMatrix4x4 getRenderMatrix(const OVR::Posed & worldPose);
+
+protected:
+
+	OVR::Posed trackingOrigin;
+	OVR::Vector3d renderOrigin;
+	double rebaseDistance;
+	int rebaseCount;
+	bool bRebased;
+};
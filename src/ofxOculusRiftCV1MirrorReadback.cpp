@@ -0,0 +1,278 @@
+#include "ofxOculusRiftCV1MirrorReadback.h"
+
+ofxOculusRiftCV1MirrorReadback::ofxOculusRiftCV1MirrorReadback() {
+
+	srcWidth = srcHeight = 0;
+	width = height = 0;
+	frameInterval = 1;
+	readFBO = 0;
+	scaledFBO = 0;
+	scaledRBO = 0;
+	nextSlot = 0;
+	frameNumber = 0;
+	bRunning = false;
+
+	framesCaptured = 0;
+	framesDelivered = 0;
+	framesDropped = 0;
+	framesLate = 0;
+}
+
+ofxOculusRiftCV1MirrorReadback::~ofxOculusRiftCV1MirrorReadback() {
+
+	close();
+}
+
+bool ofxOculusRiftCV1MirrorReadback::setup(int w, int h, Callback cb, int numBuffers, int downscale, int interval) {
+
+	close();
+
+	if (w <= 0 || h <= 0 || !cb) {
+		ofLogError("ofxOculusRiftCV1MirrorReadback") << "setup(): invalid size or callback";
+		return false;
+	}
+
+	srcWidth = w;
+	srcHeight = h;
+	downscale = std::max(1, downscale);
+	width = std::max(1, w / downscale);
+	height = std::max(1, h / downscale);
+	frameInterval = std::max(1, interval);
+	callback = cb;
+
+	glGenFramebuffers(1, &readFBO);
+
+	// Only needed when downscaling, otherwise we read straight from the source
+	if (width != srcWidth || height != srcHeight) {
+		glGenRenderbuffers(1, &scaledRBO);
+		glBindRenderbuffer(GL_RENDERBUFFER, scaledRBO);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glGenFramebuffers(1, &scaledFBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, scaledFBO);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, scaledRBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	slots.resize(std::max(3, numBuffers));
+	for (auto & slot : slots) {
+		glGenBuffers(1, &slot.pbo);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+		glBufferData(GL_PIXEL_PACK_BUFFER, width * height * 4, NULL, GL_STREAM_READ);
+		slot.fence = 0;
+		slot.frameNumber = 0;
+		slot.captureTime = 0;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	nextSlot = 0;
+	frameNumber = 0;
+	framesCaptured = 0;
+	framesDelivered = 0;
+	framesDropped = 0;
+	framesLate = 0;
+
+	bRunning = true;
+	worker = std::thread(&ofxOculusRiftCV1MirrorReadback::threadedFunction, this);
+
+	return true;
+}
+
+void ofxOculusRiftCV1MirrorReadback::close() {
+
+	if (worker.joinable()) {
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			bRunning = false;
+		}
+		queueCondition.notify_all();
+		worker.join();
+	}
+
+	queue.clear();
+	freeBuffers.clear();
+
+	for (auto & slot : slots) {
+		if (slot.fence) glDeleteSync(slot.fence);
+		glDeleteBuffers(1, &slot.pbo);
+	}
+	slots.clear();
+
+	if (readFBO) glDeleteFramebuffers(1, &readFBO);
+	if (scaledFBO) glDeleteFramebuffers(1, &scaledFBO);
+	if (scaledRBO) glDeleteRenderbuffers(1, &scaledRBO);
+	readFBO = scaledFBO = scaledRBO = 0;
+}
+
+void ofxOculusRiftCV1MirrorReadback::update(GLuint texture) {
+
+	if (slots.empty() || !texture) return;
+
+	frameNumber++;
+
+	// Pick up whatever the GPU has finished since last frame
+	collect();
+
+	if ((frameNumber - 1) % frameInterval) return;
+
+	Slot & slot = slots[nextSlot];
+	if (slot.fence) {
+		// Every buffer is still in flight, the GPU is behind
+		framesDropped++;
+		return;
+	}
+
+	GLint prevReadFBO, prevDrawFBO;
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prevReadFBO);
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevDrawFBO);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, readFBO);
+	glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+
+	if (scaledFBO) {
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, scaledFBO);
+		glBlitFramebuffer(0, 0, srcWidth, srcHeight, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, scaledFBO);
+	}
+
+	// The mirror texture is stored top row first, so rows come back in image order
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.frameNumber = frameNumber;
+	slot.captureTime = ofGetElapsedTimeMicros();
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, prevReadFBO);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, prevDrawFBO);
+
+	nextSlot = (nextSlot + 1) % slots.size();
+	framesCaptured++;
+}
+
+void ofxOculusRiftCV1MirrorReadback::collect() {
+
+	size_t numBytes = width * height * 4;
+
+	// Slots are issued round-robin, so nextSlot is the oldest one in flight.
+	// The GPU retires fences in order: stop at the first unfinished one.
+	for (size_t i = 0; i < slots.size(); ++i) {
+
+		Slot & slot = slots[(nextSlot + i) % slots.size()];
+		if (!slot.fence) continue;
+
+		GLenum status = glClientWaitSync(slot.fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+
+		// With frameInterval > 1 a slot is only reused every slots.size() * frameInterval frames
+		if (frameNumber - slot.frameNumber > slots.size() * frameInterval) framesLate++;
+
+		Pending pending;
+		pending.frameNumber = slot.frameNumber;
+		pending.captureTime = slot.captureTime;
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			if (!freeBuffers.empty()) {
+				pending.pixels.swap(freeBuffers.back());
+				freeBuffers.pop_back();
+			}
+		}
+		pending.pixels.resize(numBytes);
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+		void * src = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, numBytes, GL_MAP_READ_BIT);
+		if (src) {
+			memcpy(pending.pixels.data(), src, numBytes);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		if (!src) {
+			framesDropped++;
+			continue;
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queue.push_back(std::move(pending));
+
+			// Don't let a slow consumer build up latency, drop the oldest frame
+			if (queue.size() > slots.size()) {
+				freeBuffers.push_back(std::move(queue.front().pixels));
+				queue.pop_front();
+				framesDropped++;
+			}
+		}
+		queueCondition.notify_one();
+	}
+}
+
+void ofxOculusRiftCV1MirrorReadback::threadedFunction() {
+
+	std::unique_lock<std::mutex> lock(queueMutex);
+
+	while (bRunning) {
+
+		queueCondition.wait(lock, [this] { return !queue.empty() || !bRunning; });
+		if (!bRunning) break;
+
+		Pending pending = std::move(queue.front());
+		queue.pop_front();
+
+		lock.unlock();
+
+		Frame frame;
+		frame.pixels = pending.pixels.data();
+		frame.width = width;
+		frame.height = height;
+		frame.frameNumber = pending.frameNumber;
+		frame.captureTime = pending.captureTime;
+		callback(frame);
+
+		lock.lock();
+
+		freeBuffers.push_back(std::move(pending.pixels));
+		framesDelivered++;
+	}
+}
+
+bool ofxOculusRiftCV1MirrorReadback::isSetup() {
+
+	return !slots.empty();
+}
+
+int ofxOculusRiftCV1MirrorReadback::getWidth() {
+
+	return width;
+}
+
+int ofxOculusRiftCV1MirrorReadback::getHeight() {
+
+	return height;
+}
+
+uint64_t ofxOculusRiftCV1MirrorReadback::getFramesCaptured() {
+
+	return framesCaptured;
+}
+
+uint64_t ofxOculusRiftCV1MirrorReadback::getFramesDelivered() {
+
+	return framesDelivered;
+}
+
+uint64_t ofxOculusRiftCV1MirrorReadback::getFramesDropped() {
+
+	return framesDropped;
+}
+
+uint64_t ofxOculusRiftCV1MirrorReadback::getFramesLate() {
+
+	return framesLate;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Reads the mirror texture back to the CPU without stalling the frame.
+//
+// Each captured frame is blitted into a smaller FBO if downscaling, read into
+// one of a ring of pixel-pack buffers and fenced. Later frames poll the fences,
+// copy completed buffers out and hand them to a callback on a worker thread.
+// Only core GL 3.2 is used, so it also runs on a software GL.
+class ofxOculusRiftCV1MirrorReadback {
+
+public:
+
+	struct Frame {
+		const unsigned char * pixels;	// RGBA8, top row first
+		int width;
+		int height;
+		uint64_t frameNumber;			// count of update() calls when captured
+		uint64_t captureTime;			// ofGetElapsedTimeMicros() when captured
+	};
+
+	typedef std::function<void(const Frame &)> Callback;
+
+	ofxOculusRiftCV1MirrorReadback();
+	~ofxOculusRiftCV1MirrorReadback();
+
+	// width/height are the source texture size. downscale divides both,
+	// frameInterval captures one frame out of every frameInterval.
+	bool setup(int width, int height, Callback callback, int numBuffers = 3, int downscale = 1, int frameInterval = 1);
+	void close();
+
+	// Call once per frame on the GL thread, after the mirror texture was updated.
+	void update(GLuint texture);
+
+	bool isSetup();
+	int getWidth();
+	int getHeight();
+
+	uint64_t getFramesCaptured();	// readbacks issued
+	uint64_t getFramesDelivered();	// frames handed to the callback
+	uint64_t getFramesDropped();	// no free buffer, or the callback fell behind
+	uint64_t getFramesLate();		// fence took longer than the ring length (numBuffers * frameInterval frames)
+
+protected:
+
+	struct Slot {
+		GLuint pbo;
+		GLsync fence;
+		uint64_t frameNumber;
+		uint64_t captureTime;
+	};
+
+	struct Pending {
+		std::vector<unsigned char> pixels;
+		uint64_t frameNumber;
+		uint64_t captureTime;
+	};
+
+	void collect();
+	void threadedFunction();
+
+	int srcWidth, srcHeight;
+	int width, height;
+	int frameInterval;
+	Callback callback;
+
+	std::vector<Slot> slots;
+	GLuint readFBO;
+	GLuint scaledFBO;
+	GLuint scaledRBO;
+	size_t nextSlot;
+	uint64_t frameNumber;
+
+	std::thread worker;
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	std::deque<Pending> queue;
+	std::vector<std::vector<unsigned char>> freeBuffers;
+	bool bRunning;
+
+	std::atomic<uint64_t> framesCaptured;
+	std::atomic<uint64_t> framesDelivered;
+	std::atomic<uint64_t> framesDropped;
+	std::atomic<uint64_t> framesLate;
+};
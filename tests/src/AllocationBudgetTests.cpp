@@ -0,0 +1,105 @@
+#include "TestSuite.h"
+#include "ovrStubRuntime.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+using namespace OVR;
+
+// OVR::AllocationBudgetScope as the addon uses it: steady-state frames against
+// the stub runtime must not allocate. CRT allocations (malloc, new) are only
+// visible with the debug CRT, so in release builds only OVR::Allocator is seen.
+
+#if defined(_DEBUG)
+static const bool bCRTVisible = true;
+#else
+static const bool bCRTVisible = false;
+#endif
+
+// Keeps the first violation for the failure message
+struct BudgetViolations {
+
+	BudgetViolations() : count(0) {
+		first[0] = '\0';
+		AllocationBudgetScope::SetViolationCallback(record, (uintptr_t)this);
+	}
+
+	~BudgetViolations() {
+		AllocationBudgetScope::SetViolationCallback(nullptr, 0);
+	}
+
+	static void record(uintptr_t context, const AllocationBudgetScope::Violation & violation) {
+		BudgetViolations * violations = (BudgetViolations*)context;
+		if (violations->count++ == 0) {
+			snprintf(violations->first, sizeof(violations->first), "%s: %llu bytes, tag %s, %s(%d)",
+				violation.Scope->GetName(), (unsigned long long)violation.Size, violation.Tag ? violation.Tag : "none",
+				violation.File ? violation.File : "unknown", violation.Line);
+		}
+	}
+
+	int		count;
+	char	first[512];
+};
+
+TEST_CASE(allocationBudget_seesAllocations) {
+
+	BudgetViolations violations;
+	Allocator * allocator = Allocator::GetInstance();
+	uint64_t allocCount;
+
+	{
+		AllocationBudgetScope budget("allocationBudget_seesAllocations");
+
+		int * volatile newed = new int[4];
+		delete[] newed;
+		void * volatile malloced = malloc(64);
+		free(malloced);
+
+		// Counted once, though DefaultHeap gets it from malloc
+		void * p = allocator->Alloc(32, "budget");
+		allocator->Free(p);
+
+		allocCount = budget.GetAllocCount();
+		CHECK(budget.GetViolationCount() == allocCount);
+	}
+
+	CHECK(allocCount == (bCRTVisible ? 3 : 1));
+	CHECK(violations.count == (int)allocCount);
+
+	// Nothing is counted outside a scope, or in a disabled one
+	{
+		AllocationBudgetScope budget("disabled", 0, 0, false);
+		void * volatile malloced = malloc(64);
+		free(malloced);
+		CHECK(budget.GetAllocCount() == 0);
+	}
+	CHECK(violations.count == (int)allocCount);
+}
+
+TEST_CASE(allocationBudget_stubFrames) {
+
+	const int warmUpFrames = 60;
+	const int frames = 600;
+
+	ofxOculusRiftCV1 cv1;
+	stubRuntime.reset();
+	CHECK(cv1.init());
+
+	// Everything created lazily exists after the first frames
+	for (int i = 0; i < warmUpFrames; i++) renderStubFrame(cv1);
+
+	BudgetViolations violations;
+	int submits = stubRuntime.submitCount;
+	cv1.setAllocationBudget(true);
+	for (int i = 0; i < frames; i++) renderStubFrame(cv1);
+
+	CHECK(stubRuntime.submitCount == submits + frames);
+	CHECK(cv1.getAllocationBudgetViolations() == 0);
+	if (violations.count) reportFailure(__FILE__, __LINE__, violations.first);
+
+	reportResult("  %d frames, %llu allocations over budget%s\n", frames,
+		(unsigned long long)cv1.getAllocationBudgetViolations(), bCRTVisible ? "" : " (release CRT: only OVR::Allocator is seen)");
+
+	cv1.setAllocationBudget(false);
+	cv1.close();
+}
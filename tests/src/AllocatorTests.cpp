@@ -0,0 +1,896 @@
+#include "TestSuite.h"
+#include "Kernel/OVR_Allocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace OVR;
+
+// OVR::Allocator and its heaps. The kernel allocator only builds on Windows,
+// so these are part of the test app rather than the console runner.
+
+static size_t countTrackedAllocations(Allocator & allocator) {
+
+	size_t count = 0;
+	for (const AllocMetadata * amd = allocator.IterateHeapBegin(); amd; amd = allocator.IterateHeapNext()) count++;
+	allocator.IterateHeapEnd();
+	return count;
+}
+
+// A tracking Allocator on top of a LinearArenaHeap, the way a frame arena is
+// normally set up
+struct TrackedArena {
+
+	TrackedArena(size_t capacity) : arena(capacity), allocator("TrackedArena") {
+		arena.Init();
+		arena.SetAllocator(&allocator);
+		allocator.SetHeap(&arena);
+		allocator.EnableTracking(true);
+		allocator.Init();
+	}
+
+	~TrackedArena() {
+		arena.Reset();
+		allocator.Shutdown();
+		arena.Shutdown();
+	}
+
+	// Fills the block, so everything allocated after this overflows
+	size_t fillBlock(size_t size) {
+		size_t count = 0;
+		while (arena.Owns(allocator.Alloc(size, "block"))) count++;
+		return count + 1;
+	}
+
+	LinearArenaHeap	arena;
+	Allocator		allocator;
+};
+
+TEST_CASE(allocator_arenaResetUntracksOverflow) {
+
+	TrackedArena tracked(4096);
+
+	size_t blockCount = tracked.fillBlock(64);
+	std::vector<void*> overflow;
+	for (int i = 0; i < 20; i++) overflow.push_back(tracked.allocator.Alloc(10000, "overflow"));
+
+	for (void * p : overflow) CHECK(p && !tracked.arena.Owns(p));
+	CHECK(countTrackedAllocations(tracked.allocator) == blockCount + overflow.size());
+
+	// Freeing one overflow block by hand leaves the rest to Reset
+	tracked.allocator.Free(overflow.back());
+	CHECK(countTrackedAllocations(tracked.allocator) == blockCount + overflow.size() - 1);
+
+	tracked.arena.Reset();
+	CHECK(countTrackedAllocations(tracked.allocator) == 0);
+
+	LinearArenaHeap::Stats stats;
+	tracked.arena.GetStats(stats);
+	CHECK(stats.UsedBytes == 0);
+}
+
+BENCHMARK_CASE(allocator_arenaResetOverflow) {
+
+	const int overflowCount = 2000;
+	const int rounds = 10;
+	uint64_t byPointer = 0, byRange = 0;
+	size_t tracked = 0;
+
+	for (int r = 0; r < rounds; r++) {
+
+		// Reset as it is: overflow blocks untracked by exact pointer
+		{
+			TrackedArena arena(1024 * 1024);
+			arena.fillBlock(48);
+			for (int i = 0; i < overflowCount; i++) arena.allocator.Alloc(48, "overflow");
+			tracked = countTrackedAllocations(arena.allocator);
+
+			uint64_t start = getTestTimeMicros();
+			arena.arena.Reset();
+			byPointer += getTestTimeMicros() - start;
+			CHECK(countTrackedAllocations(arena.allocator) == 0);
+		}
+
+		// What it used to cost: one UntrackRange, i.e. a scan of every table
+		// shard, per overflow block
+		{
+			TrackedArena arena(1024 * 1024);
+			arena.fillBlock(48);
+			std::vector<uint8_t*> overflow;
+			for (int i = 0; i < overflowCount; i++) overflow.push_back((uint8_t*)arena.allocator.Alloc(48, "overflow"));
+
+			uint64_t start = getTestTimeMicros();
+			for (uint8_t * p : overflow) arena.allocator.UntrackRange(p, p + 1);
+			arena.arena.Reset();
+			byRange += getTestTimeMicros() - start;
+		}
+	}
+
+	reportResult("  Reset() with %d overflow blocks, %u tracked allocations:\n", overflowCount, (unsigned)tracked);
+	reportResult("    untracked by pointer: %8.1f us\n", (double)byPointer / rounds);
+	reportResult("    untracked by range:   %8.1f us\n", (double)byRange / rounds);
+}
+
+TEST_CASE(allocator_arenaResetUntracksBlock) {
+
+	TrackedArena tracked(64 * 1024);
+
+	// A freed top allocation whose space is handed out again, and one shrunk
+	// then grown back in place
+	void * freed = tracked.allocator.Alloc(64, "block");
+	tracked.allocator.Free(freed);
+	CHECK(tracked.allocator.Alloc(32, "block") == freed);
+	void * resized = tracked.allocator.Alloc(256, "block");
+	CHECK(tracked.allocator.Realloc(resized, 16) == resized);
+	CHECK(tracked.allocator.Realloc(resized, 128) == resized);
+	for (int i = 0; i < 100; i++) tracked.allocator.Alloc(100, "block");
+	CHECK(countTrackedAllocations(tracked.allocator) == 102);
+
+	tracked.arena.Reset();
+	CHECK(countTrackedAllocations(tracked.allocator) == 0);
+
+	// More allocations than Reset keeps records of, the first time round
+	for (int r = 0; r < 2; r++) {
+		for (int i = 0; i < 2000; i++) tracked.allocator.Alloc(16, "block");
+		CHECK(countTrackedAllocations(tracked.allocator) == 2000);
+		tracked.arena.Reset();
+		CHECK(countTrackedAllocations(tracked.allocator) == 0);
+	}
+}
+
+BENCHMARK_CASE(allocator_arenaResetBlock) {
+
+	const int blockCounts[] = { 10, 100, 1000, 10000 };
+	const int rounds = 20;
+
+	// One big frame grows the tracking table, which never shrinks, so every
+	// UntrackRange after it scans room for 100000 allocations
+	TrackedArena arena(4 * 1024 * 1024);
+	Allocator & allocator = arena.allocator;
+	for (int i = 0; i < 100000; i++) allocator.Alloc(16, "big frame");
+	arena.arena.Reset();
+
+	reportResult("  Reset() of a frame's block allocations, after a frame of 100000:\n");
+
+	for (int blockCount : blockCounts) {
+
+		uint64_t byPointer = 0, byRange = 0;
+
+		for (int r = 0; r < rounds; r++) {
+
+			// Reset as it is: each block allocation untracked by exact pointer
+			for (int i = 0; i < blockCount; i++) allocator.Alloc(32, "block");
+			uint64_t start = getTestTimeMicros();
+			arena.arena.Reset();
+			byPointer += getTestTimeMicros() - start;
+			CHECK(countTrackedAllocations(allocator) == 0);
+
+			// What it used to cost: one UntrackRange over the used part of the block
+			uint8_t * begin = (uint8_t*)allocator.Alloc(32, "block");
+			uint8_t * end = begin;
+			for (int i = 1; i < blockCount; i++) end = (uint8_t*)allocator.Alloc(32, "block");
+			start = getTestTimeMicros();
+			allocator.UntrackRange(begin, end + 32);
+			byRange += getTestTimeMicros() - start;
+			arena.arena.Reset();
+		}
+
+		reportResult("    %5d allocations: by pointer %8.1f us, by range %8.1f us\n", blockCount,
+			(double)byPointer / rounds, (double)byRange / rounds);
+	}
+}
+
+// Collects what TraceTrackedAllocations reports
+static void collectTrace(uintptr_t context, const char * text) {
+
+	((std::vector<std::string>*)context)->push_back(text);
+}
+
+TEST_CASE(allocator_traceGroupsLeaks) {
+
+	TrackedArena tracked(1024 * 1024);
+
+	for (int i = 0; i < 50; i++) tracked.allocator.Alloc(64, "first");
+	for (int i = 0; i < 10; i++) tracked.allocator.Alloc(256, "second");
+
+	// One entry per call site, largest total first, then the summary. The
+	// symbols are resolved on this thread, as they must be when this runs
+	// from Shutdown under the loader lock.
+	std::vector<std::string> trace;
+	CHECK(tracked.allocator.TraceTrackedAllocations(collectTrace, (uintptr_t)&trace) == 60);
+	CHECK(trace.size() == 3);
+	CHECK(trace.size() == 3 && trace[0].find("count: 50, total size: 3200, tag: first") != std::string::npos);
+	CHECK(trace.size() == 3 && trace[1].find("count: 10, total size: 2560, tag: second") != std::string::npos);
+	CHECK(trace.size() == 3 && trace[2].find("Reported backtrace count: 2") != std::string::npos);
+}
+
+// An aligned request that can't get a size class block must still come back
+// with the header FreeAligned and GetAllocAlignedSize read
+static void checkAlignedFallback(PoolHeap & pool) {
+
+	void * p = pool.AllocAligned(100, 64);
+	CHECK(p && !pool.IsSmallAlloc(p));
+	CHECK(((uintptr_t)p & 63) == 0);
+	CHECK(pool.GetAllocAlignedSize(p, 64) == 100);
+	memset(p, 0x5a, 100);
+
+	p = pool.ReallocAligned(p, 200, 64);
+	CHECK(((uintptr_t)p & 63) == 0);
+	CHECK(((uint8_t*)p)[99] == 0x5a);
+	pool.FreeAligned(p);
+
+	void * q = pool.Alloc(100);
+	CHECK(q && !pool.IsSmallAlloc(q));
+	CHECK(pool.GetAllocSize(q) >= 100);
+	pool.Free(q);
+}
+
+TEST_CASE(allocator_poolAlignedFallbackSpansExhausted) {
+
+	// One span, which the 16 byte size class takes
+	PoolHeap pool;
+	pool.SetReservedSize(65536);
+	CHECK(pool.Init());
+
+	void * small = pool.Alloc(16);
+	CHECK(pool.IsSmallAlloc(small));
+
+	checkAlignedFallback(pool);
+
+	pool.Free(small);
+	pool.Shutdown();
+}
+
+TEST_CASE(allocator_poolAlignedFallbackWithoutInit) {
+
+	// The state Init leaves the pool in when it can't reserve its address
+	// space: no spans and no thread caches, so everything goes to the large heap
+	DefaultHeap largeHeap;
+	largeHeap.Init();
+
+	PoolHeap pool;
+	pool.SetLargeObjectHeap(&largeHeap);
+
+	checkAlignedFallback(pool);
+
+	void * p = pool.Alloc(16);
+	CHECK(p && !pool.IsSmallAlloc(p));
+	pool.Free(p);
+
+	PoolHeap::Stats stats;
+	pool.GetStats(stats);
+	CHECK(stats.LargeAllocCount == stats.LargeFreeCount);
+}
+
+// A stack of frameCount made-up return addresses, distinct for each seed
+static std::vector<void*> fakeStack(size_t seed, size_t frameCount) {
+
+	std::vector<void*> frames(frameCount);
+	for (size_t i = 0; i < frameCount; i++) frames[i] = (void*)(0x10000 + seed * 0x1000 + i * 8);
+	return frames;
+}
+
+TEST_CASE(allocator_stackTraceTableFull) {
+
+	// 64 slots, of which 48 can be used, and frames for 40 stacks of 4
+	StackTraceTable table;
+	CHECK(table.Init(64, 160));
+
+	std::vector<void*> first = fakeStack(0, 4);
+	uint32_t firstId = table.Intern(first.data(), first.size());
+	CHECK(firstId != 0);
+
+	// Running out of frames gives 0 without using up a slot
+	size_t seed = 1;
+	while (table.Intern(fakeStack(seed, 4).data(), 4)) seed++;
+	CHECK(seed == 40);
+	CHECK(table.GetCount() == 40);
+	CHECK(table.Intern(fakeStack(seed, 4).data(), 4) == 0);
+	CHECK(table.GetCount() == 40);
+
+	// Stacks already in the table are still found, with their frames
+	void * const * frames = nullptr;
+	CHECK(table.Intern(first.data(), first.size()) == firstId);
+	CHECK(table.GetFrames(firstId, frames) == 4);
+	CHECK(frames && memcmp(frames, first.data(), 4 * sizeof(void*)) == 0);
+	table.Shutdown();
+
+	// With frames to spare, the load factor caps the table at 3/4 full
+	CHECK(table.Init(64, 4096));
+	for (seed = 0; table.Intern(fakeStack(seed, 4).data(), 4); seed++) {}
+	CHECK(seed == 48);
+	CHECK(table.GetCount() == 48);
+	CHECK(table.Intern(fakeStack(0, 4).data(), 4) != 0);
+	table.Shutdown();
+	CHECK(!table.IsInitialized());
+}
+
+static const char * pageModeName(OSHeap::PageMode mode) {
+
+	return (mode == OSHeap::PageModeExplicit) ? "explicit" : (mode == OSHeap::PageModeTransparent) ? "transparent" : "normal";
+}
+
+static OSHeap::PageMode pageModeGot(const OSHeap::LargeBlockStats & stats) {
+
+	return stats.ExplicitCount ? OSHeap::PageModeExplicit : stats.TransparentCount ? OSHeap::PageModeTransparent : OSHeap::PageModeNormal;
+}
+
+TEST_CASE(allocator_osHeapLargeBlocks) {
+
+	OSHeap heap;
+	heap.SetLargeBlockOptions(1 << 20, OSHeap::PageModeTransparent);
+	CHECK(heap.Init());
+
+	void * small = heap.Alloc(100);
+	void * large = heap.Alloc(3 << 20);
+	CHECK(!heap.IsLargeBlock(small));
+	CHECK(heap.IsLargeBlock(large));
+	CHECK(heap.GetAllocSize(large) == (3 << 20));
+	memset(large, 0xab, 3 << 20);
+
+	OSHeap::LargeBlockStats stats;
+	heap.GetLargeBlockStats(stats);
+	CHECK(stats.LiveCount == 1);
+	CHECK(stats.LiveBytes >= (3 << 20));
+	CHECK(stats.TransparentCount + stats.NormalCount == 1);
+
+	// Transparent huge pages are aligned to their own size, which is 2 MB
+	// wherever they exist
+	if (stats.TransparentCount) CHECK((((uintptr_t)large - 64) & ((2 << 20) - 1)) == 0);
+
+	large = heap.Realloc(large, 8 << 20);
+	CHECK(heap.IsLargeBlock(large) && ((uint8_t*)large)[(3 << 20) - 1] == 0xab);
+
+	heap.Free(small);
+	heap.Free(large);
+	heap.GetLargeBlockStats(stats);
+	CHECK(stats.LiveCount == 0 && stats.LiveBytes == 0);
+	heap.Shutdown();
+}
+
+// Random pointer chasing through a buffer far larger than the TLB covers, one
+// access per 64 byte line, with each page mode. The mode a block gets depends
+// on the system: explicit huge pages need them reserved (Linux) or the "Lock
+// pages in memory" privilege (Windows), and Windows has no transparent ones.
+BENCHMARK_CASE(allocator_osHeapTLBMisses) {
+
+	const size_t bytes = 256 << 20;
+	const size_t lineCount = bytes / 64;
+	const size_t steps = 20000000;
+
+	std::vector<uint32_t> order(lineCount);
+	for (size_t i = 0; i < lineCount; i++) order[i] = (uint32_t)i;
+	std::shuffle(order.begin(), order.end(), std::mt19937(42));
+
+	for (int m = OSHeap::PageModeNormal; m <= OSHeap::PageModeExplicit; m++) {
+
+		OSHeap heap;
+		heap.SetLargeBlockOptions(1 << 20, (OSHeap::PageMode)m);
+		heap.Init();
+
+		uint64_t * lines = (uint64_t*)heap.Alloc(bytes);
+		if (!lines) {
+			reportResult("  %-11s  allocation failed\n", pageModeName((OSHeap::PageMode)m));
+			continue;
+		}
+
+		// A single cycle through every line, in random order
+		for (size_t i = 0; i < lineCount; i++) lines[(size_t)order[i] * 8] = order[(i + 1) % lineCount];
+
+		OSHeap::LargeBlockStats stats;
+		heap.GetLargeBlockStats(stats);
+
+		uint64_t index = 0;
+		uint64_t start = getTestTimeMicros();
+		for (size_t i = 0; i < steps; i++) index = lines[index * 8];
+		double ns = (getTestTimeMicros() - start) * 1000.0 / steps;
+
+		reportResult("  %-11s (got %-11s) %6.1f ns per access\n", pageModeName((OSHeap::PageMode)m), pageModeName(pageModeGot(stats)), ns);
+		CHECK(index < lineCount);
+
+		heap.Free(lines);
+		heap.Shutdown();
+	}
+}
+
+// Collects what EnumerateTagStacks reports, one string of the tags joined by
+// '/' per thread
+static void collectTagStack(uintptr_t context, uint32_t /*threadId*/, const char * const * tags, size_t tagCount) {
+
+	std::string stack;
+	for (size_t i = 0; i < tagCount; i++) stack += (i ? "/" : "") + std::string(tags[i]);
+	((std::vector<std::string>*)context)->push_back(stack);
+}
+
+static std::vector<std::string> getTagStacks(Allocator & allocator) {
+
+	std::vector<std::string> stacks;
+	allocator.EnumerateTagStacks(collectTagStack, (uintptr_t)&stacks);
+	std::sort(stacks.begin(), stacks.end());
+	return stacks;
+}
+
+TEST_CASE(allocator_tagStacksPerThread) {
+
+	Allocator allocator("tags");
+	allocator.EnableTracking(true);
+	allocator.Init();
+
+	CHECK(strcmp(allocator.GetTag(), "none") == 0 && strcmp(allocator.GetTag("default"), "default") == 0);
+	allocator.PopTag();	// unmatched, does nothing
+	allocator.PushTag("main");
+
+	// Each thread sees only its own tags, and allocations pick them up
+	static const char * const threadTags[] = { "t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7" };
+	const int threadCount = 8;
+	std::atomic<int> ready(0), errors(0);
+	std::atomic<bool> bRelease(false);
+	std::vector<void*> allocations(threadCount);
+	std::vector<std::thread> threads;
+
+	for (int t = 0; t < threadCount; t++) {
+		threads.emplace_back([&, t]() {
+			AllocatorTagScope outer(threadTags[t], &allocator);
+			for (int i = 0; i < 1000; i++) {
+				AllocatorTagScope inner("inner", &allocator);
+				if (strcmp(allocator.GetTag(), "inner") != 0) errors++;
+			}
+			if (allocator.GetTag() != threadTags[t]) errors++;
+
+			allocations[t] = allocator.Alloc(64, nullptr);
+
+			AllocatorTagScope held("held", &allocator);
+			ready++;
+			while (!bRelease) std::this_thread::yield();
+			allocator.Free(allocations[t]);
+		});
+	}
+	while (ready < threadCount) std::this_thread::yield();
+
+	std::vector<std::string> stacks = getTagStacks(allocator);
+	CHECK(stacks.size() == (size_t)threadCount + 1);
+	for (int t = 0; t < threadCount; t++)
+		CHECK(std::count(stacks.begin(), stacks.end(), std::string(threadTags[t]) + "/held") == 1);
+	CHECK(std::count(stacks.begin(), stacks.end(), "main") == 1);
+	CHECK(strcmp(allocator.GetTag(), "main") == 0);
+
+	TrackedAllocEntryVector entries;
+	allocator.SnapshotTrackedAllocations(entries);
+	for (int t = 0; t < threadCount; t++) {
+		auto entry = std::find_if(entries.begin(), entries.end(), [&](const TrackedAllocEntry & e) { return e.Alloc == allocations[t]; });
+		CHECK(entry != entries.end() && entry->Tag == threadTags[t]);
+	}
+
+	// Exiting threads give their stacks back
+	bRelease = true;
+	for (std::thread & thread : threads) thread.join();
+	CHECK(errors == 0);
+	stacks = getTagStacks(allocator);
+	CHECK(stacks.size() == 1 && stacks[0] == "main");
+
+	// Past MaxTagDepth the deepest recorded tag stands in, and the pops still match
+	for (size_t i = 0; i < Allocator::MaxTagDepth + 8; i++) allocator.PushTag(i == Allocator::MaxTagDepth - 1 ? "deepest" : "deep");
+	CHECK(strcmp(allocator.GetTag(), "deepest") == 0);
+	for (size_t i = 0; i < Allocator::MaxTagDepth + 8; i++) allocator.PopTag();
+	CHECK(strcmp(allocator.GetTag(), "main") == 0);
+
+	// Another Allocator has its own stacks, even on the same thread
+	{
+		Allocator other("other tags");
+		CHECK(strcmp(other.GetTag(), "none") == 0);
+		other.PushTag("other");
+		CHECK(strcmp(other.GetTag(), "other") == 0 && strcmp(allocator.GetTag(), "main") == 0);
+	}
+	CHECK(strcmp(allocator.GetTag(), "main") == 0);
+
+	allocator.PopTag();
+	CHECK(strcmp(allocator.GetTag(), "none") == 0);
+	allocator.Shutdown();
+}
+
+// What tags used to be kept in: one map of stacks by thread id behind one lock
+struct LockedTagMap {
+
+	void push(const char * tag) {
+		std::lock_guard<std::mutex> lock(mutex);
+		stacks[std::this_thread::get_id()].push_back(tag);
+	}
+
+	void pop() {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::vector<const char*> & stack = stacks[std::this_thread::get_id()];
+		if (!stack.empty()) stack.pop_back();
+	}
+
+	const char * get() {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::vector<const char*> & stack = stacks[std::this_thread::get_id()];
+		return stack.empty() ? "none" : stack.back();
+	}
+
+	std::mutex mutex;
+	std::unordered_map<std::thread::id, std::vector<const char*>> stacks;
+};
+
+// Nanoseconds per push, get and pop, with every thread doing nothing else,
+// which is the worst case for the lock
+BENCHMARK_CASE(allocator_tagContention) {
+
+	const int threadCounts[] = { 1, 4, 16 };
+	const int opsPerThread = 500000;
+
+	for (int threadCount : threadCounts) {
+
+		auto run = [&](const std::function<void()> & op) {
+			std::atomic<bool> bGo(false);
+			std::vector<std::thread> threads;
+			for (int t = 0; t < threadCount; t++) {
+				threads.emplace_back([&]() {
+					while (!bGo) std::this_thread::yield();
+					for (int i = 0; i < opsPerThread; i++) op();
+				});
+			}
+			uint64_t start = getTestTimeMicros();
+			bGo = true;
+			for (std::thread & thread : threads) thread.join();
+			return (getTestTimeMicros() - start) * 1000.0 / ((double)opsPerThread * threadCount);
+		};
+
+		Allocator allocator("tag contention");
+		std::atomic<int> errors(0);
+		double perThread = run([&]() {
+			allocator.PushTag("bench");
+			if (allocator.GetTag()[0] != 'b') errors++;
+			allocator.PopTag();
+		});
+
+		LockedTagMap map;
+		double locked = run([&]() {
+			map.push("bench");
+			if (map.get()[0] != 'b') errors++;
+			map.pop();
+		});
+
+		CHECK(errors == 0);
+		reportResult("  %2d threads: per-thread stacks %7.1f ns   locked map %7.1f ns\n", threadCount, perThread, locked);
+	}
+}
+
+static void collectLines(uintptr_t context, const char * text) {
+
+	((std::vector<std::string>*)context)->push_back(text);
+}
+
+static AllocationProfiler::TagStats getProfilerTag(AllocationProfiler & profiler, const char * tag) {
+
+	AllocationProfiler::TagStats stats[AllocationProfiler::TagCapacity + 1];
+	size_t count = std::min(profiler.GetTagStats(stats, AllocationProfiler::TagCapacity + 1), AllocationProfiler::TagCapacity + 1);
+	for (size_t i = 0; i < count; i++)
+		if (strcmp(stats[i].Tag, tag) == 0) return stats[i];
+	AllocationProfiler::TagStats none = {};
+	return none;
+}
+
+// Sums the values of folded stack lines ("frame;frame;frame value\n"), or
+// returns -1 if a line doesn't parse
+static int64_t sumFoldedStacks(const std::vector<std::string> & lines) {
+
+	int64_t sum = 0;
+	for (const std::string & line : lines) {
+		size_t space = line.rfind(' ');
+		if (space == std::string::npos || space == 0 || line.back() != '\n') return -1;
+		char * end;
+		long long value = strtoll(line.c_str() + space + 1, &end, 10);
+		if (value <= 0 || *end != '\n') return -1;
+		if (line.find(";;") != std::string::npos || line[0] == ';') return -1;
+		sum += value;
+	}
+	return sum;
+}
+
+// Three tags with known sizes, one of them with allocations bigger than the
+// sample interval, interleaved the way a frame would make them
+TEST_CASE(allocator_profilerSampledWeights) {
+
+	const uint64_t interval = 4096;
+	struct Mix { const char * tag; size_t size; int count; };
+	const Mix mix[] = { { "small", 64, 200000 }, { "medium", 1000, 20000 }, { "large", 100000, 200 } };
+
+	Allocator allocator("profiler");
+	allocator.Init();
+	CHECK(allocator.EnableAllocationProfiler(interval));
+	AllocationProfiler & profiler = allocator.GetAllocationProfiler();
+
+	std::vector<void*> allocations[3];
+	for (int i = 0; i < mix[0].count; i++) {
+		for (int m = 0; m < 3; m++)
+			if (i % (mix[0].count / mix[m].count) == 0) allocations[m].push_back(allocator.Alloc(mix[m].size, mix[m].tag));
+	}
+
+	// The weights make each tag's estimate unbiased. There are a few thousand
+	// samples per tag, so 10% is several standard deviations.
+	uint64_t totalBytes = 0, totalCount = 0;
+	for (int m = 0; m < 3; m++) {
+		AllocationProfiler::TagStats stats = getProfilerTag(profiler, mix[m].tag);
+		double actual = (double)mix[m].size * mix[m].count;
+		CHECK(stats.TotalCount > 0);
+		CHECK_CLOSE(stats.TotalBytes / actual, 1.0, 0.1);
+		CHECK(stats.LiveBytes == (int64_t)stats.TotalBytes && stats.LiveCount == (int64_t)stats.TotalCount);
+		reportResult("  %-6s %9.0f bytes, estimated %9llu from %5llu samples\n", mix[m].tag, actual,
+			(unsigned long long)stats.TotalBytes, (unsigned long long)stats.TotalCount);
+		totalBytes += stats.TotalBytes;
+		totalCount += stats.TotalCount;
+	}
+
+	// Each folded stack line parses, and the stacks add up to the tags
+	std::vector<std::string> lines;
+	CHECK(profiler.ExportFoldedStacks(AllocationProfiler::PVTotalBytes, false, collectLines, (uintptr_t)&lines) == lines.size());
+	CHECK(!lines.empty());
+	CHECK(sumFoldedStacks(lines) == (int64_t)totalBytes);
+	lines.clear();
+	profiler.ExportFoldedStacks(AllocationProfiler::PVLiveCount, true, collectLines, (uintptr_t)&lines);
+	CHECK(sumFoldedStacks(lines) == (int64_t)totalCount);
+
+	// Freeing half of one tag leaves about half of it live. Live bytes are
+	// exact once everything is freed, as each free takes back its sample's weight.
+	for (size_t i = 0; i < allocations[1].size(); i += 2) allocator.Free(allocations[1][i]);
+	AllocationProfiler::TagStats medium = getProfilerTag(profiler, "medium");
+	CHECK_CLOSE((double)medium.LiveBytes / medium.TotalBytes, 0.5, 0.1);
+
+	for (int m = 0; m < 3; m++)
+		for (size_t i = (m == 1 ? 1 : 0); i < allocations[m].size(); i += (m == 1 ? 2 : 1)) allocator.Free(allocations[m][i]);
+	for (int m = 0; m < 3; m++) {
+		AllocationProfiler::TagStats stats = getProfilerTag(profiler, mix[m].tag);
+		CHECK(stats.LiveBytes == 0 && stats.LiveCount == 0 && stats.TotalCount > 0);
+	}
+	lines.clear();
+	CHECK(profiler.ExportFoldedStacks(AllocationProfiler::PVLiveBytes, false, collectLines, (uintptr_t)&lines) == 0);
+	CHECK(lines.empty());
+
+	allocator.Shutdown();
+}
+
+// Splits a CSV line, dropping the quotes around tag names
+static std::vector<std::string> splitCSV(const std::string & line) {
+
+	std::vector<std::string> fields(1);
+	for (char c : line) {
+		if (c == ',') fields.push_back("");
+		else if (c != '"' && c != '\n') fields.back() += c;
+	}
+	return fields;
+}
+
+TEST_CASE(allocator_profilerTimeSeries) {
+
+	Allocator allocator("profiler time series");
+	allocator.Init();
+	CHECK(allocator.EnableAllocationProfiler(1024));
+	AllocationProfiler & profiler = allocator.GetAllocationProfiler();
+
+	// One point per phase: "a" grows, "b" grows, then "a" is freed
+	std::vector<void*> a, b;
+	std::vector<int64_t> expectedA, expectedB;
+	auto recordPoint = [&]() {
+		profiler.RecordTimePoint();
+		expectedA.push_back(getProfilerTag(profiler, "a").LiveBytes);
+		expectedB.push_back(getProfilerTag(profiler, "b").LiveBytes);
+	};
+	for (int i = 0; i < 10000; i++) a.push_back(allocator.Alloc(100, "a"));
+	recordPoint();
+	for (int i = 0; i < 10000; i++) b.push_back(allocator.Alloc(200, "b"));
+	recordPoint();
+	for (void * p : a) allocator.Free(p);
+	recordPoint();
+
+	std::vector<std::string> lines;
+	CHECK(profiler.ExportTimeSeries(collectLines, (uintptr_t)&lines) == 3);
+	CHECK(lines.size() == 4);
+	if (lines.size() == 4) {
+		std::vector<std::string> header = splitCSV(lines[0]);
+		size_t columnA = std::find(header.begin(), header.end(), "a") - header.begin();
+		size_t columnB = std::find(header.begin(), header.end(), "b") - header.begin();
+		CHECK(header[0] == "time_ms" && columnA < header.size() && columnB < header.size());
+
+		double lastTime = 0;
+		for (size_t p = 0; p < 3 && columnA < header.size() && columnB < header.size(); p++) {
+			std::vector<std::string> row = splitCSV(lines[p + 1]);
+			CHECK(row.size() == header.size());
+			if (row.size() != header.size()) break;
+			double time = atof(row[0].c_str());
+			CHECK(time >= lastTime);
+			lastTime = time;
+			CHECK(strtoll(row[columnA].c_str(), nullptr, 10) == expectedA[p]);
+			CHECK(strtoll(row[columnB].c_str(), nullptr, 10) == expectedB[p]);
+		}
+		CHECK(expectedA[0] > 0 && expectedB[0] == 0 && expectedB[1] > 0 && expectedA[2] == 0);
+	}
+
+	// Only the most recent points are kept, oldest first
+	for (size_t i = 0; i < AllocationProfiler::TimeSeriesCapacity + 10; i++) profiler.RecordTimePoint();
+	lines.clear();
+	CHECK(profiler.ExportTimeSeries(collectLines, (uintptr_t)&lines) == AllocationProfiler::TimeSeriesCapacity);
+	CHECK(lines.size() == AllocationProfiler::TimeSeriesCapacity + 1);
+	CHECK(lines.size() > 2 && atof(lines[1].c_str()) <= atof(lines.back().c_str()));
+
+	for (void * p : b) allocator.Free(p);
+	allocator.Shutdown();
+}
+
+// Runs a compiled filter over a snapshot built by hand, in threadCount
+// contiguous ranges the way IterateHeapBegin splits large snapshots
+struct SnapshotFilter : public HeapIterationFilterRPN {
+
+	bool compile(const char * filter) {
+		return Compile(filter);
+	}
+
+	size_t evaluate(const TrackedAllocEntryVector & entries, size_t threadCount) {
+		Snapshot.assign(entries.begin(), entries.end());
+		MatchFlags.assign(entries.size(), 0);
+		size_t chunkSize = entries.size() / threadCount;
+		std::vector<std::thread> threads;
+		for (size_t t = 1; t < threadCount; t++)
+			threads.emplace_back([=]() { EvaluateRange(chunkSize * t, (t + 1 < threadCount) ? chunkSize * (t + 1) : Snapshot.size()); });
+		EvaluateRange(0, (threadCount > 1) ? chunkSize : Snapshot.size());
+		for (std::thread & thread : threads) thread.join();
+		return std::count(MatchFlags.begin(), MatchFlags.end(), 1);
+	}
+
+	bool matched(size_t i) const {
+		return MatchFlags[i] != 0;
+	}
+};
+
+static std::string lowercase(const char * str) {
+
+	std::string lower(str ? str : "");
+	for (char & c : lower) c = (char)tolower((unsigned char)c);
+	return lower;
+}
+
+// The same strings at different addresses and in different case, so neither
+// the case folding nor the string results cached by address can fake a match
+static char mixedCaseMeshFile[] = "SRC/Mesh.CPP";
+static char tagCopy[] = "geometry";
+
+static TrackedAllocEntryVector buildSnapshot(size_t count) {
+
+	static const char * const files[] = { "src/mesh.cpp", "src/texture.cpp", "LibOVR/Kernel/OVR_String.cpp", mixedCaseMeshFile, nullptr };
+	static const char * const tags[] = { "geometry", "Textures", "audio", tagCopy, nullptr };
+	static const char * const threadNames[] = { "render", "Render Worker", "audio", "" };
+
+	TrackedAllocEntryVector entries(count);
+	std::mt19937 random(7);
+	for (size_t i = 0; i < count; i++) {
+		TrackedAllocEntry & entry = entries[i];
+		memset(&entry, 0, sizeof(entry));
+		entry.Alloc = (void*)(uintptr_t)(0x10000 + i * 16);
+		entry.File = files[random() % 5];
+		entry.Line = (int)(random() % 400);
+		entry.Tag = tags[random() % 5];
+		entry.ThreadId = random() % 16;
+		strcpy(entry.ThreadName, threadNames[random() % 4]);
+		entry.TimeNs = (uint64_t)(random() % 4000) * 1000000;
+		entry.Count = i;
+		entry.AllocSize = 1 + random() % 2000;
+		entry.BlockSize = entry.AllocSize + 16;
+	}
+	return entries;
+}
+
+TEST_CASE(allocator_filterSnapshot) {
+
+	struct Case { const char * filter; std::function<bool(const TrackedAllocEntry &)> expected; };
+	const Case cases[] = {
+		{ "Size > 1000", [](const TrackedAllocEntry & e) { return e.AllocSize > 1000; } },
+		{ "AllocSize >= 64\nAllocSize < 256\nand", [](const TrackedAllocEntry & e) { return e.AllocSize >= 64 && e.AllocSize < 256; } },
+		{ "BlockSize == 100", [](const TrackedAllocEntry & e) { return e.BlockSize == 100; } },
+		{ "Tag has TEX;File == src/mesh.cpp;or", [](const TrackedAllocEntry & e) {
+			return lowercase(e.Tag).find("tex") != std::string::npos || lowercase(e.File) == "src/mesh.cpp"; } },
+		{ "Tag == GEOMETRY\nLine <= 100\nand\nThreadName has render\nor", [](const TrackedAllocEntry & e) {
+			return (lowercase(e.Tag) == "geometry" && e.Line <= 100) || lowercase(e.ThreadName).find("render") != std::string::npos; } },
+		{ "ThreadName == audio\nThreadId > 7\nand\nFile has string\nor\nCount < 5000\nand", [](const TrackedAllocEntry & e) {
+			return ((lowercase(e.ThreadName) == "audio" && e.ThreadId > 7) || lowercase(e.File).find("string") != std::string::npos) && e.Count < 5000; } },
+		{ "Time >= 2s\nTime < 3000000000\nand", [](const TrackedAllocEntry & e) { return e.TimeNs >= 2000000000 && e.TimeNs < 3000000000ull; } },
+		{ "File has MESH\nTag has geo\nor", [](const TrackedAllocEntry & e) {
+			return lowercase(e.File).find("mesh") != std::string::npos || lowercase(e.Tag).find("geo") != std::string::npos; } },
+	};
+
+	TrackedAllocEntryVector entries = buildSnapshot(100000);
+
+	for (const Case & c : cases) {
+		SnapshotFilter filter;
+		CHECK(filter.compile(c.filter));
+
+		size_t expectedCount = 0, errors = 0;
+		size_t serialCount = filter.evaluate(entries, 1);
+		for (size_t i = 0; i < entries.size(); i++) {
+			bool expected = c.expected(entries[i]);
+			expectedCount += expected;
+			errors += (filter.matched(i) != expected);
+		}
+		CHECK(errors == 0 && serialCount == expectedCount);
+
+		// The same matches split across threads
+		for (size_t threadCount : { 3, 8 }) {
+			CHECK(filter.evaluate(entries, threadCount) == expectedCount);
+			errors = 0;
+			for (size_t i = 0; i < entries.size(); i++) errors += (filter.matched(i) != c.expected(entries[i]));
+			CHECK(errors == 0);
+		}
+		if (errors || serialCount != expectedCount) reportResult("  filter \"%s\": %u mismatches\n", c.filter, (unsigned)errors);
+	}
+
+	SnapshotFilter filter;
+	CHECK(!filter.compile("Size ~ 10"));
+	CHECK(!filter.compile("Colour == red"));
+	CHECK(!filter.compile("Size > 10\nxor"));
+}
+
+// A tracked heap big enough for IterateHeapBegin to split it across threads
+// where there are cores for it
+TEST_CASE(allocator_filterTrackedHeap) {
+
+	TrackedArena tracked(16 * 1024 * 1024);
+	for (int i = 0; i < 100000; i++) tracked.allocator.Alloc(16 + (i % 7) * 16, (i % 10 == 0) ? "keep" : "skip");
+
+	HeapIterationFilterRPN filter;
+	CHECK(filter.SetFilter(&tracked.allocator, "Tag == keep\nSize > 32\nand"));
+
+	// Tags 0, 10, 20... with sizes over 32, i.e. i % 7 >= 2
+	size_t expected = 0;
+	for (int i = 0; i < 100000; i += 10) expected += ((i % 7) >= 2);
+
+	size_t count = 0, errors = 0;
+	for (const AllocMetadata * amd = filter.IterateHeapBegin(); amd; amd = filter.IterateHeapNext()) {
+		count++;
+		errors += (strcmp(amd->Tag, "keep") != 0 || amd->AllocSize <= 32);
+	}
+	filter.IterateHeapEnd();
+	CHECK(count == expected && filter.GetMatchCount() == expected && errors == 0);
+
+	std::vector<std::string> trace;
+	HeapIterationFilterRPN::TraceTrackedAllocations(&tracked.allocator, "Tag == keep\nSize == 16\nand", collectTrace, (uintptr_t)&trace);
+	CHECK(trace.size() == 100000 / 70 + 1);
+}
+
+// Millions of snapshot entries a second per filter, on one thread and on
+// every core
+BENCHMARK_CASE(allocator_filterThroughput) {
+
+	const char * const filters[] = {
+		"Size > 1000",
+		"Tag has TEX;File == src/mesh.cpp;or",
+		"Tag == GEOMETRY\nLine <= 100\nand\nThreadName has render\nor",
+	};
+	const size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	TrackedAllocEntryVector entries = buildSnapshot(1000000);
+
+	for (const char * text : filters) {
+		SnapshotFilter filter;
+		filter.compile(text);
+
+		uint64_t start = getTestTimeMicros();
+		size_t serial = filter.evaluate(entries, 1);
+		double serialSeconds = (getTestTimeMicros() - start) / 1.0e6;
+		start = getTestTimeMicros();
+		size_t parallel = filter.evaluate(entries, threadCount);
+		double parallelSeconds = (getTestTimeMicros() - start) / 1.0e6;
+		CHECK(serial == parallel);
+
+		std::string name(text);
+		std::replace(name.begin(), name.end(), '\n', ' ');
+		reportResult("  %-58s 1 thread %7.1f M/s   %2u threads %7.1f M/s\n", name.c_str(),
+			entries.size() / serialSeconds / 1.0e6, (unsigned)threadCount, entries.size() / parallelSeconds / 1.0e6);
+	}
+}
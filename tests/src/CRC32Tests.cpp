@@ -0,0 +1,263 @@
+#include "TestSuite.h"
+#include "Kernel/OVR_CRC32.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// CalculateCRC32's dispatch (PCLMULQDQ, SSE4.2, slicing-by-8) against a plain
+// bit-at-a-time CRC and the bytewise table loop, at every length and
+// alignment the wide loops and their tails care about.
+
+using namespace OVR;
+
+// Keeps the benchmark loops from being optimized away
+static volatile uint32_t crcSink;
+
+// Deterministic, so a failure reproduces
+static std::vector<uint8_t> randomBytes(size_t count, uint32_t seed) {
+
+	std::vector<uint8_t> bytes(count);
+	for (uint8_t & b : bytes) {
+		seed = seed * 1664525u + 1013904223u;
+		b = (uint8_t)(seed >> 24);
+	}
+	return bytes;
+}
+
+// Reflected CRC one bit at a time from the polynomial, continuing from crc
+// like CalculateCRC32
+static uint32_t bitwiseCRC32(uint32_t poly, const uint8_t * data, size_t bytes, uint32_t crc) {
+
+	crc = ~crc;
+	for (size_t i = 0; i < bytes; i++) {
+		crc ^= data[i];
+		for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ ((crc & 1) ? poly : 0);
+	}
+	return ~crc;
+}
+
+static const uint32_t standardPoly = 0xEDB88320, castagnoliPoly = 0x82F63B78;
+
+// Copies of the two tables: CalculateCRC32 only dispatches on the table's
+// address, so these take the bytewise loop with the same results
+static uint32_t bytewiseStandard[256], bytewiseCastagnoli[256];
+
+static void copyTables() {
+
+	memcpy(bytewiseStandard, CRC32_Table_CRC32, sizeof(bytewiseStandard));
+	memcpy(bytewiseCastagnoli, CRC32_Table_CRC32_C, sizeof(bytewiseCastagnoli));
+}
+
+TEST_CASE(crc32_knownValues) {
+
+	const char * check = "123456789";
+	CHECK(Standard_CRC32(check, 9) == 0xCBF43926);
+	CHECK(Castagnoli_CRC32(check, 9) == 0xE3069283);
+	CHECK(Standard_CRC32(check, 0) == 0 && Castagnoli_CRC32(NULL, 0) == 0);
+
+	// 32 zero bytes and 32 0xFF bytes, from the iSCSI test vectors (RFC 3720)
+	std::vector<uint8_t> zeros(32, 0), ones(32, 0xFF);
+	CHECK(Castagnoli_CRC32(zeros.data(), 32) == 0x8A9136AA);
+	CHECK(Castagnoli_CRC32(ones.data(), 32) == 0x62A8AB43);
+
+	copyTables();
+	CHECK(CalculateCRC32(bytewiseStandard, check, 9, 0) == 0xCBF43926);
+	CHECK(CalculateCRC32(bytewiseCastagnoli, check, 9, 0) == 0xE3069283);
+	CHECK(strcmp(GetCRC32Implementation(bytewiseStandard), "bytewise") == 0);
+
+	reportResult("  CRC32 uses %s, CRC32-C uses %s\n", GetCRC32Implementation(CRC32_Table_CRC32), GetCRC32Implementation(CRC32_Table_CRC32_C));
+}
+
+// Every length up to past the PCLMUL and slice-by-8 tails, at every offset
+// within 16 bytes, and lengths around the SSE4.2 3-way block sizes
+TEST_CASE(crc32_matchesReference) {
+
+	copyTables();
+	std::vector<uint8_t> data = randomBytes(3 * 8192 * 2 + 4096, 1);
+
+	std::vector<size_t> lengths;
+	for (size_t n = 0; n <= 300; n++) lengths.push_back(n);
+	for (size_t n : { 3 * 256 - 1, 3 * 256, 3 * 256 + 7, 3 * 8192 - 1, 3 * 8192, 3 * 8192 + 13, 2 * 3 * 8192 + 777 }) lengths.push_back(n);
+
+	int mismatches = 0;
+	for (size_t length : lengths) {
+		for (size_t offset = 0; offset < 16; offset++) {
+			const uint8_t * p = data.data() + offset;
+			uint32_t start = (uint32_t)(length * 2654435761u);	// a continued checksum as well as a fresh one
+			for (uint32_t crc : { 0u, start }) {
+				uint32_t standard = CalculateCRC32(CRC32_Table_CRC32, p, length, crc);
+				uint32_t castagnoli = CalculateCRC32(CRC32_Table_CRC32_C, p, length, crc);
+				if (standard != CalculateCRC32(bytewiseStandard, p, length, crc)) mismatches++;
+				if (castagnoli != CalculateCRC32(bytewiseCastagnoli, p, length, crc)) mismatches++;
+				if (length < 1024 && standard != bitwiseCRC32(standardPoly, p, length, crc)) mismatches++;
+				if (length < 1024 && castagnoli != bitwiseCRC32(castagnoliPoly, p, length, crc)) mismatches++;
+			}
+		}
+	}
+	CHECK(mismatches == 0);
+}
+
+// Feeding the data in pieces gives the one-shot result
+TEST_CASE(crc32_streaming) {
+
+	std::vector<uint8_t> data = randomBytes(1 << 20, 2);
+	uint32_t split = 3;
+
+	for (const uint32_t * table : { CRC32_Table_CRC32, CRC32_Table_CRC32_C }) {
+
+		uint32_t whole = CalculateCRC32(table, data.data(), data.size(), 0);
+
+		CRC32Stream stream(table);
+		size_t position = 0;
+		while (position < data.size()) {
+			split = split * 1664525u + 1013904223u;
+			size_t n = std::min((size_t)(split >> 16) % 20000, data.size() - position);
+			stream.Update(data.data() + position, n);
+			position += n;
+		}
+		CHECK(stream.GetCRC() == whole && stream.GetBytes() == data.size());
+		CHECK(stream.GetTable() == table);
+
+		stream.Reset();
+		CHECK(stream.GetCRC() == 0 && stream.GetBytes() == 0);
+		stream.Update(data.data(), 100);
+		CHECK(stream.GetCRC() == CalculateCRC32(table, data.data(), 100, 0));
+	}
+}
+
+// Any reflected table works with CombineCRC32, not just the two built in
+static void makeReflectedTable(uint32_t poly, uint32_t * table) {
+
+	for (uint32_t n = 0; n < 256; n++) {
+		uint32_t crc = n;
+		for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ ((crc & 1) ? poly : 0);
+		table[n] = crc;
+	}
+}
+
+// The CRC of A then B from the CRCs of the two pieces, at every split of a
+// buffer that matters and with a continued checksum for A
+TEST_CASE(crc32_combine) {
+
+	static uint32_t koopman[256];
+	makeReflectedTable(0xEB31D82E, koopman);
+	std::vector<uint8_t> data = randomBytes(100000, 4);
+
+	int mismatches = 0;
+	for (const uint32_t * table : { CRC32_Table_CRC32, CRC32_Table_CRC32_C, (const uint32_t *)koopman }) {
+		for (size_t total : { (size_t)0, (size_t)1, (size_t)64, (size_t)1000, data.size() }) {
+			for (size_t split : { (size_t)0, std::min(total, (size_t)1), total / 3, total / 2, total - std::min(total, (size_t)1), total }) {
+				for (uint32_t start : { 0u, 0x12345678u }) {
+					uint32_t whole = CalculateCRC32(table, data.data(), total, start);
+					uint32_t crcA = CalculateCRC32(table, data.data(), split, start);
+					uint32_t crcB = CalculateCRC32(table, data.data() + split, total - split, 0);
+					if (CombineCRC32(table, crcA, crcB, total - split) != whole) mismatches++;
+				}
+			}
+		}
+	}
+	CHECK(mismatches == 0);
+
+	// Zeros past 4 GB: shifting over 2^32 + n zero bytes is the same as
+	// shifting over 2^32 and then over n
+	uint64_t big = (1ull << 32) + 1000;
+	std::vector<uint8_t> zeros(1000, 0);
+	uint32_t crcA = Standard_CRC32(data.data(), 100);
+	uint32_t viaBig = CombineCRC32(CRC32_Table_CRC32, crcA, 0, big);
+	uint32_t viaSteps = CombineCRC32(CRC32_Table_CRC32, CombineCRC32(CRC32_Table_CRC32, crcA, 0, 1ull << 32), 0, 1000);
+	CHECK(viaBig == viaSteps);
+
+	// Streams filled separately, e.g. on other threads, then appended
+	CRC32Stream first(CRC32_Table_CRC32_C), second(CRC32_Table_CRC32_C), third(CRC32_Table_CRC32_C);
+	first.Update(data.data(), 30000);
+	second.Update(data.data() + 30000, 50000);
+	third.Update(data.data() + 80000, 20000);
+	first.Append(second);
+	first.Append(third.GetCRC(), third.GetBytes());
+	CHECK(first.GetCRC() == Castagnoli_CRC32(data.data(), data.size()) && first.GetBytes() == data.size());
+}
+
+// The parallel checksum matches the serial one for any thread count, chunk
+// size and starting crc, including uneven last chunks
+TEST_CASE(crc32_parallel) {
+
+	std::vector<uint8_t> data = randomBytes((3 << 20) + 777, 5);
+
+	int mismatches = 0;
+	for (const uint32_t * table : { CRC32_Table_CRC32, CRC32_Table_CRC32_C }) {
+		for (size_t bytes : { (size_t)0, (size_t)100, (size_t)4096 + 3, (size_t)65536, data.size() }) {
+			for (uint32_t start : { 0u, 0xDEADBEEFu }) {
+				uint32_t serial = CalculateCRC32(table, data.data(), bytes, start);
+				for (unsigned threads : { 0u, 1u, 2u, 3u, 4u, 7u, 16u }) {
+					if (CalculateCRC32Parallel(table, data.data(), bytes, start, threads, 64) != serial) mismatches++;
+					if (CalculateCRC32Parallel(table, data.data(), bytes, start, threads) != serial) mismatches++;
+				}
+			}
+		}
+	}
+	CHECK(mismatches == 0);
+
+	// More threads than 64-byte pieces
+	CHECK(CalculateCRC32Parallel(CRC32_Table_CRC32, data.data(), 200, 0, 16, 1) == Standard_CRC32(data.data(), 200));
+}
+
+// GB/s for each table through its dispatched path and through the bytewise
+// loop, from cache-sized buffers to one that streams from memory
+BENCHMARK_CASE(crc32_throughput) {
+
+	copyTables();
+	const size_t largest = 64 << 20;
+	std::vector<uint8_t> data = randomBytes(largest + 8, 3);	// each round starts up to 7 bytes in
+	uint32_t sink = 0;
+
+	struct { const char * name; const uint32_t * table; } paths[] = {
+		{ "CRC32", CRC32_Table_CRC32 }, { "CRC32-C", CRC32_Table_CRC32_C },
+		{ "CRC32", bytewiseStandard }, { "CRC32-C", bytewiseCastagnoli } };
+
+	for (const auto & path : paths) {
+		for (size_t size : { (size_t)64, (size_t)4096, (size_t)(1 << 20), largest }) {
+
+			// About 256 MB per measurement, a quarter of that for the bytewise loop
+			size_t total = (path.table == bytewiseStandard || path.table == bytewiseCastagnoli) ? (64 << 20) : (256 << 20);
+			size_t rounds = std::max(total / size, (size_t)1);
+
+			uint64_t start = getTestTimeMicros();
+			for (size_t r = 0; r < rounds; r++) sink += CalculateCRC32(path.table, data.data() + (r & 7), size, sink);
+			double seconds = (getTestTimeMicros() - start) * 1e-6;
+
+			reportResult("  %-7s %-8s %9zu bytes: %6.2f GB/s\n", path.name, GetCRC32Implementation(path.table), size,
+				(double)rounds * size / seconds * 1e-9);
+		}
+	}
+	crcSink = sink;
+}
+
+// GB/s of the parallel checksum on a 256 MB buffer by thread count, next to
+// the serial call
+BENCHMARK_CASE(crc32_threadScaling) {
+
+	std::vector<uint8_t> data = randomBytes(256 << 20, 6);
+	const int rounds = 4;
+	uint32_t sink = 0;
+
+	reportResult("  %u hardware threads\n", std::thread::hardware_concurrency());
+
+	for (const uint32_t * table : { CRC32_Table_CRC32, CRC32_Table_CRC32_C }) {
+
+		uint64_t start = getTestTimeMicros();
+		for (int r = 0; r < rounds; r++) sink += CalculateCRC32(table, data.data(), data.size(), sink);
+		double serial = (double)rounds * data.size() / ((getTestTimeMicros() - start) * 1e-6) * 1e-9;
+		reportResult("  %-7s serial:     %6.2f GB/s\n", table == CRC32_Table_CRC32 ? "CRC32" : "CRC32-C", serial);
+
+		for (unsigned threads : { 1u, 2u, 4u, 8u, 16u }) {
+			start = getTestTimeMicros();
+			for (int r = 0; r < rounds; r++) sink += CalculateCRC32Parallel(table, data.data(), data.size(), sink, threads);
+			double parallel = (double)rounds * data.size() / ((getTestTimeMicros() - start) * 1e-6) * 1e-9;
+			reportResult("  %-7s %2u threads: %6.2f GB/s (%.2fx)\n", table == CRC32_Table_CRC32 ? "CRC32" : "CRC32-C",
+				threads, parallel, parallel / serial);
+		}
+	}
+	crcSink = sink;
+}
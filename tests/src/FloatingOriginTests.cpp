@@ -0,0 +1,169 @@
+#include "TestSuite.h"
+#include "ovrStubRuntime.h"
+
+using namespace OVR;
+
+// ofxOculusRiftCV1FloatingOrigin: precision thousands of kilometers from the
+// world origin, and how fast poses are converted to render space.
+
+// Roughly a point on the Earth's surface in an Earth-centered frame, where
+// float steps are 0.25 to 0.5 m
+static const Vector3d FAR_ORIGIN(4.0e6, 12.0, -3.5e6);
+
+// Consecutive head positions a tenth of a millimeter apart: the motion a
+// tracked headset reports between frames when the viewer holds still
+static const int STEP_COUNT = 100;
+static const float STEP = 1.0e-4f;
+
+TEST_CASE(floatingOrigin_jitterFarFromOrigin) {
+
+	ofxOculusRiftCV1FloatingOrigin origin;
+	origin.setTrackingOrigin(Posed(Quatd(Vector3d(0, 1, 0), 0.3), FAR_ORIGIN));
+	origin.setRebaseDistance(50);
+
+	Posef head(Quatf(), Vector3f(0.1234567f, 1.7f, 0.3f));
+	origin.update(head);
+
+	Vector3f firstRender = origin.trackingToRender(head).Translation;
+	Vector3d firstWorld = origin.trackingToWorld(head).Translation;
+	double worstRender = 0;
+	double worstNaive = 0;
+
+	for (int i = 1; i <= STEP_COUNT; i++) {
+
+		Posef moved(head.Rotation, head.Translation + Vector3f(STEP * i, 0, 0));
+		origin.update(moved);
+
+		// Render space moves with the head, to well under a micrometer
+		Vector3f render = origin.trackingToRender(moved).Translation;
+		worstRender = std::max(worstRender, std::fabs((double)(render - firstRender).Length() - STEP * i));
+
+		// Without the floating origin, the world position itself is rounded to float
+		Vector3f naive = Vector3f(origin.trackingToWorld(moved).Translation);
+		Vector3f naiveFirst = Vector3f(firstWorld);
+		worstNaive = std::max(worstNaive, std::fabs((double)(naive - naiveFirst).Length() - STEP * i));
+	}
+
+	CHECK(origin.getRebaseCount() == 1);
+	CHECK(worstRender < 1.0e-6);
+	CHECK(worstNaive > STEP * STEP_COUNT / 2);
+	reportResult("  worst error over %d steps of %g m: %g m render space, %g m world space in float\n",
+		STEP_COUNT, STEP, worstRender, worstNaive);
+}
+
+TEST_CASE(floatingOrigin_rebaseKeepsRenderSpaceSmall) {
+
+	ofxOculusRiftCV1FloatingOrigin origin;
+	origin.setTrackingOrigin(Posed(Quatd(), FAR_ORIGIN));
+	origin.setRebaseDistance(50);
+
+	// Walk 200 m in 1 cm steps
+	for (int i = 0; i <= 20000; i++) {
+
+		Posef head(Quatf(), Vector3f(0, 1.7f, -0.01f * i));
+		origin.update(head);
+
+		Posef render = origin.trackingToRender(head);
+		CHECK(render.Translation.Length() <= 50.0f + 0.01f);
+
+		// ...and converting back loses no more than float precision at 50 m
+		Vector3d world = origin.trackingToWorld(head).Translation;
+		CHECK((origin.toWorld(render).Translation - world).Length() < 1.0e-5);
+	}
+
+	CHECK(origin.getRebaseCount() == 4);
+}
+
+TEST_CASE(floatingOrigin_batchedMatchesSingle) {
+
+	ofxOculusRiftCV1FloatingOrigin origin;
+	origin.setTrackingOrigin(Posed(Quatd(), FAR_ORIGIN));
+	origin.update(Posef(Quatf(), Vector3f(0, 1.7f, 0)));
+
+	const size_t count = 1000;
+	vector<Posed> worldPoses(count);
+	vector<Vector3d> worldPositions(count);
+	for (size_t i = 0; i < count; i++) {
+		worldPoses[i] = Posed(Quatd(Vector3d(0, 1, 0), 0.001 * i), FAR_ORIGIN + Vector3d(0.37 * i, 0.5, -0.11 * i));
+		worldPositions[i] = worldPoses[i].Translation;
+	}
+
+	vector<Posef> renderPoses(count);
+	vector<Vector3f> renderPositions(count);
+	origin.toRender(worldPoses.data(), renderPoses.data(), count);
+	origin.toRender(worldPositions.data(), renderPositions.data(), count);
+
+	for (size_t i = 0; i < count; i++) {
+		Posef single = origin.toRender(worldPoses[i]);
+		CHECK(renderPoses[i].Translation == single.Translation);
+		CHECK(renderPoses[i].Rotation == single.Rotation);
+		CHECK(renderPositions[i] == origin.toRender(worldPositions[i]));
+	}
+}
+
+TEST_CASE(floatingOrigin_attached) {
+
+	ofxOculusRiftCV1 cv1;
+	ofxOculusRiftCV1FloatingOrigin origin;
+	origin.setTrackingOrigin(Posed(Quatd(), FAR_ORIGIN));
+	origin.setRebaseDistance(0);
+	cv1.setFloatingOrigin(&origin);
+
+	stubRuntime.reset();
+	CHECK(cv1.init());
+	renderStubFrame(cv1);
+
+	// update() moves the render origin to the head, while the layer keeps the
+	// runtime's tracking-space poses
+	CHECK(origin.didRebase());
+	CHECK_CLOSE(origin.getRenderOrigin().x, FAR_ORIGIN.x, 1.0e-6);
+	CHECK_CLOSE(origin.getRenderOrigin().y, FAR_ORIGIN.y + stubRuntime.headPosition.y, 1.0e-6);
+	CHECK_CLOSE(origin.getRenderOrigin().z, FAR_ORIGIN.z, 1.0e-6);
+	CHECK_CLOSE(stubRuntime.lastSubmitPose[0].Position.y, stubRuntime.headPosition.y, 1.0e-6);
+
+	cv1.close();
+}
+
+BENCHMARK_CASE(floatingOrigin_throughput) {
+
+	ofxOculusRiftCV1FloatingOrigin origin;
+	origin.setTrackingOrigin(Posed(Quatd(), FAR_ORIGIN));
+	origin.update(Posef(Quatf(), Vector3f(0, 1.7f, 0)));
+
+	const size_t count = 100000;
+	const int rounds = 20;
+	vector<Posed> worldPoses(count);
+	vector<Vector3d> worldPositions(count);
+	for (size_t i = 0; i < count; i++) {
+		worldPoses[i] = Posed(Quatd(Vector3d(0, 1, 0), 1.0e-5 * i), FAR_ORIGIN + Vector3d(0.01 * i, 0, 0));
+		worldPositions[i] = worldPoses[i].Translation;
+	}
+
+	vector<Posef> renderPoses(count);
+	vector<Vector3f> renderPositions(count);
+
+	uint64_t start = getTestTimeMicros();
+	for (int r = 0; r < rounds; r++)
+		for (size_t i = 0; i < count; i++) renderPoses[i] = origin.toRender(worldPoses[i]);
+	double single = (getTestTimeMicros() - start) * 1000.0 / ((double)rounds * count);
+
+	start = getTestTimeMicros();
+	for (int r = 0; r < rounds; r++) origin.toRender(worldPoses.data(), renderPoses.data(), count);
+	double batched = (getTestTimeMicros() - start) * 1000.0 / ((double)rounds * count);
+
+	start = getTestTimeMicros();
+	for (int r = 0; r < rounds; r++) origin.toRender(worldPositions.data(), renderPositions.data(), count);
+	double positions = (getTestTimeMicros() - start) * 1000.0 / ((double)rounds * count);
+
+	start = getTestTimeMicros();
+	ofMatrix4x4 sum;
+	for (size_t i = 0; i < count; i++) sum = origin.getRenderMatrix(worldPoses[i]);
+	double matrices = (getTestTimeMicros() - start) * 1000.0 / count;
+
+	reportResult("  toRender(Posed):        %6.2f ns each\n", single);
+	reportResult("  toRender(Posed[]):      %6.2f ns each\n", batched);
+	reportResult("  toRender(Vector3d[]):   %6.2f ns each\n", positions);
+	reportResult("  getRenderMatrix(Posed): %6.2f ns each\n", matrices);
+	CHECK(renderPoses[count - 1].Translation.x == renderPositions[count - 1].x);
+	CHECK(sum.getTranslation().x == renderPositions[count - 1].x);
+}
@@ -0,0 +1,126 @@
+#include "TestSuite.h"
+#include "ovrStubRuntime.h"
+
+// GLEContext start-up cost, eager against lazy loading. The addon builds with
+// GLE_LAZY_LOAD_ENABLED, so Init() only reads the version and everything else
+// is looked up on first use.
+
+// Installs a fresh GLEContext as the current one for the lifetime of a test
+struct ScopedGLEContext {
+
+	ScopedGLEContext() : previous(OVR::GLEContext::GetCurrentContext()) {
+		OVR::GLEContext::SetCurrentContext(&context);
+	}
+
+	~ScopedGLEContext() {
+		context.Shutdown();
+		OVR::GLEContext::SetCurrentContext(previous);
+	}
+
+	OVR::GLEContext		context;
+	OVR::GLEContext *	previous;
+};
+
+// What the eager build's Init() does
+static void initEager(OVR::GLEContext & context) {
+
+	context.PlatformInit();
+	context.InitVersion();
+	context.InitExtensionLoad();
+	context.InitExtensionSupport();
+}
+
+// The framebuffer functions the eye and mirror passes need
+static void resolveFrameFunctions(OVR::GLEContext & context) {
+
+	context.GetLazyFunction(&OVR::GLEContext::glGenFramebuffers_Impl, "glGenFramebuffers");
+	context.GetLazyFunction(&OVR::GLEContext::glBindFramebuffer_Impl, "glBindFramebuffer");
+	context.GetLazyFunction(&OVR::GLEContext::glFramebufferTexture2D_Impl, "glFramebufferTexture2D");
+	context.GetLazyFunction(&OVR::GLEContext::glCheckFramebufferStatus_Impl, "glCheckFramebufferStatus");
+	context.GetLazyFunction(&OVR::GLEContext::glBlitFramebuffer_Impl, "glBlitFramebuffer");
+	context.GetLazyFunction(&OVR::GLEContext::glDeleteFramebuffers_Impl, "glDeleteFramebuffers");
+}
+
+TEST_CASE(gle_lazyInit) {
+
+#if !defined(GLE_LAZY_LOAD_ENABLED)
+	reportFailure(__FILE__, __LINE__, "built without GLE_LAZY_LOAD_ENABLED");
+#endif
+
+	ScopedGLEContext scope;
+	OVR::GLEContext & context = scope.context;
+
+	context.Init();
+	CHECK(context.IsInitialized());
+	CHECK(context.WholeVersion >= 302);
+	CHECK(!context.ExtensionSupportInitialized);
+	CHECK(context.glBindFramebuffer_Impl == nullptr);
+
+	unsigned initCount = context.ResolvedFunctionCount;
+
+	// Each function is resolved once, on first use
+	resolveFrameFunctions(context);
+	CHECK(context.glBindFramebuffer_Impl != nullptr);
+	CHECK(context.glBlitFramebuffer_Impl != nullptr);
+	CHECK(context.ResolvedFunctionCount == initCount + 6);
+
+	resolveFrameFunctions(context);
+	CHECK(context.ResolvedFunctionCount == initCount + 6);
+
+	// The first extension query computes the support booleans
+	OVR::GLEContext::GetExtensionContext();
+	CHECK(context.ExtensionSupportInitialized);
+}
+
+TEST_CASE(gle_lazyFallback) {
+
+	ScopedGLEContext scope;
+	OVR::GLEContext & context = scope.context;
+	context.Init();
+
+	// Names only InitExtensionLoad's fallback table knows resolve to nothing,
+	// everything else resolves to the same address either way
+	CHECK(context.ResolveLazyFunction("glNotAFunctionEXT") == nullptr);
+	CHECK(context.ResolveLazyFunction("glBindFramebuffer") == context.ResolveFunction("glBindFramebuffer"));
+}
+
+BENCHMARK_CASE(gle_initEagerVsLazy) {
+
+	const int runs = 20;
+	uint64_t eagerMicros = 0, lazyMicros = 0, firstFrameMicros = 0;
+	unsigned eagerCount = 0, lazyCount = 0;
+
+	for (int i = 0; i < runs; i++) {
+
+		ScopedGLEContext scope;
+		uint64_t start = getTestTimeMicros();
+		initEager(scope.context);
+		eagerMicros += getTestTimeMicros() - start;
+		eagerCount = scope.context.ResolvedFunctionCount;
+	}
+
+	for (int i = 0; i < runs; i++) {
+
+		ScopedGLEContext scope;
+		uint64_t start = getTestTimeMicros();
+		scope.context.Init();
+		lazyMicros += getTestTimeMicros() - start;
+		resolveFrameFunctions(scope.context);
+		firstFrameMicros += getTestTimeMicros() - start;
+		lazyCount = scope.context.ResolvedFunctionCount;
+	}
+
+	reportResult("  eager init: %7.1f us, %u functions resolved\n", (double)eagerMicros / runs, eagerCount);
+	reportResult("  lazy init:  %7.1f us, %7.1f us to first frame, %u functions resolved\n",
+		(double)lazyMicros / runs, (double)firstFrameMicros / runs, lazyCount);
+
+	// Start-up as the app sees it, with the stub runtime in place of the service
+	ofxOculusRiftCV1 cv1;
+	stubRuntime.reset();
+
+	uint64_t start = getTestTimeMicros();
+	CHECK(cv1.init());
+	renderStubFrame(cv1);
+	glFinish();
+	reportResult("  init() to first submitted frame: %.1f ms\n", (getTestTimeMicros() - start) / 1000.0);
+}
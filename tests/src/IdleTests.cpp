@@ -0,0 +1,85 @@
+#include "TestSuite.h"
+#include "ovrStubRuntime.h"
+
+// Session status handling and the idle policy.
+
+static void initStub(ofxOculusRiftCV1 & cv1) {
+
+	stubRuntime.reset();
+	CHECK(cv1.init());
+	renderStubFrame(cv1);
+}
+
+TEST_CASE(idle_defaultPolicyRenders) {
+
+	ofxOculusRiftCV1 cv1;
+	CHECK(cv1.getIdlePolicy() == ofxOculusRiftCV1::IDLE_RENDER);
+
+	initStub(cv1);
+
+	stubRuntime.status.HmdMounted = ovrFalse;
+	int submits = stubRuntime.submitCount;
+	for (int i = 0; i < 12; i++) renderStubFrame(cv1);
+
+	CHECK(cv1.getVisibilityState() == ofxOculusRiftCV1::VISIBILITY_UNMOUNTED);
+	CHECK(stubRuntime.submitCount == submits + 12);
+}
+
+TEST_CASE(idle_throttleAndSkip) {
+
+	ofxOculusRiftCV1 cv1;
+	initStub(cv1);
+
+	cv1.setIdlePolicy(ofxOculusRiftCV1::IDLE_THROTTLE, 6, 0.5f);
+	stubRuntime.status.IsVisible = ovrFalse;
+
+	int submits = stubRuntime.submitCount;
+	for (int i = 0; i < 12; i++) renderStubFrame(cv1);
+	CHECK(cv1.getVisibilityState() == ofxOculusRiftCV1::VISIBILITY_HIDDEN);
+	CHECK(stubRuntime.submitCount == submits + 2);
+
+	cv1.setIdlePolicy(ofxOculusRiftCV1::IDLE_SKIP);
+	submits = stubRuntime.submitCount;
+	for (int i = 0; i < 12; i++) renderStubFrame(cv1);
+	CHECK(stubRuntime.submitCount == submits);
+
+	// Back to full rate on the first active frame
+	stubRuntime.status.IsVisible = ovrTrue;
+	renderStubFrame(cv1);
+	CHECK(cv1.getVisibilityState() == ofxOculusRiftCV1::VISIBILITY_ACTIVE);
+	CHECK(stubRuntime.submitCount == submits + 1);
+}
+
+TEST_CASE(idle_sessionStatusOncePerFrame) {
+
+	ofxOculusRiftCV1 cv1;
+	initStub(cv1);
+
+	// update() is the only place the status is read and recentering done;
+	// draw() and drawScene() use what it read
+	int statusReads = stubRuntime.sessionStatusCount;
+	stubRuntime.status.ShouldRecenter = ovrTrue;
+
+	renderStubFrame(cv1);
+	cv1.drawScene();
+
+	CHECK(stubRuntime.sessionStatusCount == statusReads + 1);
+	CHECK(stubRuntime.recenterCount == 1);
+
+	for (int i = 0; i < 5; i++) renderStubFrame(cv1);
+	CHECK(stubRuntime.sessionStatusCount == statusReads + 6);
+	CHECK(stubRuntime.recenterCount == 1);
+}
+
+TEST_CASE(idle_shouldQuit) {
+
+	ofxOculusRiftCV1 cv1;
+	initStub(cv1);
+
+	stubRuntime.status.ShouldQuit = ovrTrue;
+	int submits = stubRuntime.submitCount;
+	for (int i = 0; i < 3; i++) renderStubFrame(cv1);
+
+	CHECK(!cv1.isRenderingFrame());
+	CHECK(stubRuntime.submitCount == submits);
+}
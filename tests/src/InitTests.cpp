@@ -0,0 +1,57 @@
+#include "TestSuite.h"
+#include "ovrStubRuntime.h"
+
+// Deferred init: the runtime connection runs in the background and update()
+// picks up the session once it's there.
+
+TEST_CASE(init_deferred) {
+
+	ofxOculusRiftCV1 cv1;
+	stubRuntime.reset();
+	CHECK(cv1.init(true));
+
+	// Nothing the connection thread writes is visible before update() takes it over
+	CHECK(!cv1.isReady());
+	CHECK(cv1.getHMDSize().width == 0 && cv1.getHMDSize().height == 0);
+	CHECK(cv1.getHMD().Resolution.w == 0);
+	CHECK(cv1.getInitTimings().connect == 0 && cv1.getInitTimings().createSession == 0);
+	CHECK(cv1.getHMDTrackingState().StatusFlags == 0);
+
+	uint64_t start = ofGetElapsedTimeMicros();
+	while (!cv1.isReady() && cv1.getInitPhase() != ofxOculusRiftCV1::INIT_FAILED &&
+		ofGetElapsedTimeMicros() - start < 5000000) {
+		renderStubFrame(cv1);
+		ofSleepMillis(1);
+	}
+
+	CHECK(cv1.isReady());
+	CHECK(cv1.getHMDSize().width == stubRuntime.resolution.w / 2);
+	CHECK(cv1.getHMD().Resolution.h == stubRuntime.resolution.h);
+	CHECK(cv1.getInitTimings().total >= cv1.getInitTimings().createTargets);
+	CHECK(cv1.getHMDTrackingState().StatusFlags != 0);
+
+	renderStubFrame(cv1);
+	CHECK(stubRuntime.submitCount >= 1);
+
+	cv1.close();
+	CHECK(stubRuntime.sessionsAlive == 0);
+}
+
+TEST_CASE(init_deferredCreateFails) {
+
+	ofxOculusRiftCV1 cv1;
+	stubRuntime.reset();
+	stubRuntime.createFailures = 1;
+	CHECK(cv1.init(true));
+
+	uint64_t start = ofGetElapsedTimeMicros();
+	while (cv1.getInitPhase() == ofxOculusRiftCV1::INIT_CONNECTING && ofGetElapsedTimeMicros() - start < 5000000) {
+		cv1.update();
+		ofSleepMillis(1);
+	}
+
+	CHECK(cv1.getInitPhase() == ofxOculusRiftCV1::INIT_FAILED);
+	CHECK(!cv1.isReady());
+	CHECK(cv1.getHMDSize().width == 0);
+	CHECK(stubRuntime.sessionsAlive == 0);
+}
@@ -0,0 +1,175 @@
+#include "TestSuite.h"
+#include "Kernel/OVR_Lockless.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// LocklessHistoryUpdater with readers racing a producer: a read either fails or
+// returns an update exactly as it was written, never a mix of two. Like the
+// queue tests, these are meant to run under ThreadSanitizer too
+// (OFXOCULUSRIFTCV1_TSAN), and the threads count their errors for the test
+// thread to check.
+
+using namespace OVR;
+
+// Every word is derived from index, so a torn copy shows. The odd-sized tail
+// covers the partial last word.
+template<int WordCount>
+struct HistorySample {
+
+	void set(uint32_t i) {
+		index = i;
+		for (int j = 0; j < WordCount; j++) words[j] = i * 2654435761u + j;
+		tail[0] = tail[1] = tail[2] = (uint8_t)i;
+	}
+
+	bool isIntact() const {
+		for (int j = 0; j < WordCount; j++)
+			if (words[j] != index * 2654435761u + j) return false;
+		return tail[0] == (uint8_t)index && tail[1] == (uint8_t)index && tail[2] == (uint8_t)index;
+	}
+
+	uint32_t	index;
+	uint32_t	words[WordCount];
+	uint8_t		tail[3];
+};
+
+struct HistoryReaderResult {
+	uint64_t	latestRead;
+	uint64_t	latestFailed;
+	uint64_t	historyRead;
+	uint64_t	historyFailed;
+	uint64_t	overlapped;	// reads, either kind, that an update landed in the middle of
+	uint64_t	errors;		// torn copies, updates out of order, or a short history
+};
+
+// One producer makes updateCount updates while readerCount threads read the
+// latest update and the latest historyLength updates, two attempts each
+template<int WordCount, uint32_t SlotCount>
+static void stressHistory(const char * name, uint32_t updateCount, int readerCount, uint32_t historyLength) {
+
+	typedef HistorySample<WordCount> Sample;
+	typedef LocklessHistoryUpdater<Sample, SlotCount, LocklessPadding<Sample, sizeof(Sample) + 64>> Updater;
+
+	Updater * updater = new Updater;
+	std::atomic<bool> bDone(false);
+	std::atomic<int> readersStarted(0);
+	std::vector<HistoryReaderResult> results(readerCount, HistoryReaderResult());
+	std::vector<std::thread> readers;
+
+	for (int r = 0; r < readerCount; r++) {
+		readers.emplace_back([&, r]() {
+			HistoryReaderResult & result = results[r];
+			std::vector<Sample> history(historyLength);
+			uint32_t lastIndex = 0;	// 0 until the first update has been read
+			readersStarted++;
+
+			while (!bDone) {
+
+				// Nothing is counted before the first update, when there's
+				// nothing to read or to tear
+				Sample sample;
+				uint32_t index;
+				uint32_t before = updater->GetUpdateCount();
+				if (updater->GetLatest(sample, &index, 2)) {
+					if (!sample.isIntact() || sample.index != index || index < lastIndex) result.errors++;
+					lastIndex = index;
+					result.latestRead++;
+				}
+				else if (lastIndex) result.latestFailed++;
+				if (lastIndex && updater->GetUpdateCount() != before) result.overlapped++;
+
+				// Once historyLength updates have been made, a read that succeeds
+				// returns all of them
+				uint32_t count;
+				before = updater->GetUpdateCount();
+				if (updater->GetHistory(history.data(), historyLength, count, 2)) {
+					for (uint32_t i = 0; i < count; i++)
+						if (!history[i].isIntact() || (i && history[i].index != history[i - 1].index - 1)) result.errors++;
+					if (lastIndex >= historyLength && count != historyLength) result.errors++;
+					if (count) result.historyRead++;
+				}
+				else if (lastIndex) result.historyFailed++;
+				if (lastIndex && updater->GetUpdateCount() != before) result.overlapped++;
+			}
+		});
+	}
+
+	// The yields let the readers in between updates when there are fewer
+	// cores than threads
+	while (readersStarted < readerCount) std::this_thread::yield();
+
+	Sample * sample = new Sample;
+	for (uint32_t i = 1; i <= updateCount; i++) {
+		sample->set(i);
+		updater->SetState(*sample);
+		if ((i & 63) == 0) std::this_thread::yield();
+	}
+	bDone = true;
+
+	for (std::thread & reader : readers) reader.join();
+
+	HistoryReaderResult total = HistoryReaderResult();
+	for (const HistoryReaderResult & result : results) {
+		total.latestRead += result.latestRead;
+		total.latestFailed += result.latestFailed;
+		total.historyRead += result.historyRead;
+		total.historyFailed += result.historyFailed;
+		total.overlapped += result.overlapped;
+		total.errors += result.errors;
+	}
+	CHECK(total.errors == 0);
+	CHECK(total.latestRead > 0 && total.historyRead > 0);
+
+	// Once the producer is done, the whole history reads back
+	std::vector<Sample> history(SlotCount);
+	uint32_t count;
+	CHECK(updater->GetLatest(*sample) && sample->index == updateCount);
+	CHECK(updater->GetHistory(history.data(), SlotCount, count) && count == SlotCount);
+	CHECK(history[SlotCount - 1].index == updateCount - SlotCount + 1 && history[SlotCount - 1].isIntact());
+	CHECK(!updater->GetUpdate(updateCount - SlotCount, *sample));
+	CHECK(!updater->GetUpdate(updateCount + 1, *sample));
+
+	reportResult("  %s: latest %llu read, %llu failed; history of %u %llu read, %llu failed; %llu overlapped an update\n", name,
+		(unsigned long long)total.latestRead, (unsigned long long)total.latestFailed, historyLength,
+		(unsigned long long)total.historyRead, (unsigned long long)total.historyFailed, (unsigned long long)total.overlapped);
+
+	delete sample;
+	delete updater;
+}
+
+TEST_CASE(lockless_historyEmpty) {
+
+	LocklessHistoryUpdater<int, 4> updater;
+	int value, history[4];
+	uint32_t count;
+	CHECK(!updater.GetLatest(value));
+	CHECK(updater.GetHistory(history, 4, count) && count == 0);
+	CHECK(!updater.GetUpdate(0, value));
+
+	updater.SetState(5);
+	updater.SetState(6);
+	CHECK(updater.GetHistory(history, 4, count) && count == 2 && history[0] == 6 && history[1] == 5);
+
+	// Zero-filled memory is an updater with no updates, as when it's in shared memory
+	typedef LocklessHistoryUpdater<int, 4> ZeroUpdater;
+	ZeroUpdater * zeroed = (ZeroUpdater*)calloc(1, sizeof(ZeroUpdater));
+	CHECK(!zeroed->GetLatest(value));
+	CHECK(!zeroed->GetUpdate(0, value));
+	zeroed->SetState(3);
+	CHECK(zeroed->GetLatest(value) && value == 3);
+	free(zeroed);
+}
+
+TEST_CASE(lockless_historyTornReads) {
+
+	stressHistory<4, 8>("small slots", 100000, 2, 4);
+	stressHistory<1000, 4>("4 KB slots, 4 of them", 10000, 2, 2);
+	stressHistory<1000, 64>("4 KB slots, 64 of them", 10000, 2, 16);
+
+	// Slots big enough that the producer laps readers mid-copy
+	stressHistory<8192, 2>("32 KB slots, 2 of them", 1000, 3, 2);
+	stressHistory<8192, 4>("32 KB slots, 4 of them", 1000, 3, 2);
+}
@@ -0,0 +1,317 @@
+#include "TestSuite.h"
+#include "Kernel/OVR_Lockless.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// OVR_Lockless.h queues under contention: every item arrives exactly once and
+// each producer's items arrive in order. Build with OFXOCULUSRIFTCV1_TSAN to
+// run these under ThreadSanitizer. CHECK isn't thread-safe, so the threads
+// count their errors and the test thread checks the counts.
+
+using namespace OVR;
+
+struct QueueItem {
+	uint32_t producer;
+	uint32_t sequence;		// 1, 2, ... per producer
+};
+
+// What the lockless queues replace: a deque behind a mutex, bounded the same way
+struct MutexQueue {
+
+	MutexQueue() : capacity(1024) {}
+
+	bool Enqueue(const QueueItem & item) {
+		return EnqueueBatch(&item, 1) == 1;
+	}
+
+	bool Dequeue(QueueItem & item) {
+		return DequeueBatch(&item, 1) == 1;
+	}
+
+	uint32_t EnqueueBatch(const QueueItem * items, uint32_t count) {
+		std::lock_guard<std::mutex> lock(mutex);
+		uint32_t i = 0;
+		for (; i < count && queue.size() < capacity; i++) queue.push_back(items[i]);
+		return i;
+	}
+
+	uint32_t DequeueBatch(QueueItem * items, uint32_t count) {
+		std::lock_guard<std::mutex> lock(mutex);
+		uint32_t i = 0;
+		for (; i < count && !queue.empty(); i++) {
+			items[i] = queue.front();
+			queue.pop_front();
+		}
+		return i;
+	}
+
+	std::mutex				mutex;
+	std::deque<QueueItem>	queue;
+	size_t					capacity;
+};
+
+struct QueueStressResult {
+	uint64_t	received;
+	uint64_t	sequenceSum;
+	uint64_t	orderErrors;
+	double		seconds;
+};
+
+// producerCount threads each enqueue 1..itemCount, consumerCount threads
+// dequeue until the producers are done and the queue is empty. Batches are
+// of varying size, up to 16.
+template<class Queue>
+static QueueStressResult stressQueue(Queue & queue, int producerCount, int consumerCount, uint32_t itemCount, bool bBatch) {
+
+	std::atomic<int> producersDone(0);
+	std::vector<uint64_t> received(consumerCount, 0), sequenceSum(consumerCount, 0), orderErrors(consumerCount, 0);
+	std::vector<std::thread> threads;
+
+	uint64_t start = getTestTimeMicros();
+
+	for (int p = 0; p < producerCount; p++) {
+		threads.emplace_back([&, p]() {
+			QueueItem items[16];
+			for (uint32_t sequence = 1; sequence <= itemCount; ) {
+				uint32_t count = bBatch ? std::min<uint32_t>(1 + sequence % 16, itemCount - sequence + 1) : 1;
+				for (uint32_t i = 0; i < count; i++) items[i] = { (uint32_t)p, sequence + i };
+				uint32_t enqueued = bBatch ? queue.EnqueueBatch(items, count) : (queue.Enqueue(items[0]) ? 1 : 0);
+				sequence += enqueued;
+				if (!enqueued) std::this_thread::yield();
+			}
+			producersDone++;
+		});
+	}
+
+	for (int c = 0; c < consumerCount; c++) {
+		threads.emplace_back([&, c]() {
+			std::vector<uint32_t> lastSequence(producerCount, 0);
+			QueueItem items[16];
+			for (;;) {
+				bool bDone = (producersDone.load() == producerCount);
+				uint32_t count = bBatch ? queue.DequeueBatch(items, 16) : (queue.Dequeue(items[0]) ? 1 : 0);
+				for (uint32_t i = 0; i < count; i++) {
+					if (items[i].sequence <= lastSequence[items[i].producer]) orderErrors[c]++;
+					lastSequence[items[i].producer] = items[i].sequence;
+					received[c]++;
+					sequenceSum[c] += items[i].sequence;
+				}
+				if (!count) {
+					if (bDone) break;
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+
+	for (std::thread & thread : threads) thread.join();
+
+	QueueStressResult result = { 0, 0, 0, (getTestTimeMicros() - start) / 1.0e6 };
+	for (int c = 0; c < consumerCount; c++) {
+		result.received += received[c];
+		result.sequenceSum += sequenceSum[c];
+		result.orderErrors += orderErrors[c];
+	}
+	return result;
+}
+
+template<class Queue>
+static void checkStress(Queue & queue, int producerCount, int consumerCount, uint32_t itemCount, bool bBatch) {
+
+	QueueStressResult result = stressQueue(queue, producerCount, consumerCount, itemCount, bBatch);
+	CHECK(result.orderErrors == 0);
+	CHECK(result.received == (uint64_t)producerCount * itemCount);
+	CHECK(result.sequenceSum == (uint64_t)producerCount * itemCount * (itemCount + 1) / 2);
+}
+
+// Small enough to finish in a few seconds under ThreadSanitizer
+static const uint32_t STRESS_ITEMS = 50000;
+
+TEST_CASE(lockless_spscOrder) {
+
+	LocklessSPSCQueue<QueueItem, 64> * queue = new LocklessSPSCQueue<QueueItem, 64>;
+	checkStress(*queue, 1, 1, STRESS_ITEMS, false);
+	checkStress(*queue, 1, 1, STRESS_ITEMS, true);
+	delete queue;
+}
+
+TEST_CASE(lockless_mpscOrder) {
+
+	LocklessMPSCQueue<QueueItem, 64> * queue = new LocklessMPSCQueue<QueueItem, 64>;
+	checkStress(*queue, 4, 1, STRESS_ITEMS, false);
+	checkStress(*queue, 4, 1, STRESS_ITEMS, true);
+	delete queue;
+}
+
+TEST_CASE(lockless_mpmcOrder) {
+
+	LocklessMPMCQueue<QueueItem, 64> * queue = new LocklessMPMCQueue<QueueItem, 64>;
+	checkStress(*queue, 4, 4, STRESS_ITEMS, false);
+	checkStress(*queue, 4, 4, STRESS_ITEMS, true);
+	delete queue;
+
+	// The smallest queue, where every batch laps it
+	LocklessMPMCQueue<QueueItem, 2> * tiny = new LocklessMPMCQueue<QueueItem, 2>;
+	checkStress(*tiny, 3, 3, STRESS_ITEMS / 10, true);
+	delete tiny;
+}
+
+TEST_CASE(lockless_sharedQueue) {
+
+	LocklessSharedQueue<QueueItem, 64, 32> * queue = new LocklessSharedQueue<QueueItem, 64, 32>;
+	checkStress(*queue, 2, 2, STRESS_ITEMS, true);
+
+	QueueItem in = { 7, 9 }, out;
+	CHECK(queue->Enqueue(in));
+	CHECK(queue->Dequeue(out) && out.sequence == 9);
+	CHECK(!queue->Dequeue(out));
+	delete queue;
+}
+
+TEST_CASE(lockless_queueFullAndEmpty) {
+
+	LocklessMPMCQueue<int, 4> queue;
+	int value = 0, values[8];
+	for (int i = 0; i < 4; i++) CHECK(queue.Enqueue(i));
+	CHECK(!queue.Enqueue(value));
+	CHECK(queue.GetCount() == 4);
+	CHECK(queue.DequeueBatch(values, 8) == 4 && values[3] == 3);
+	CHECK(!queue.Dequeue(value));
+
+	// Zero-filled memory is an empty queue, as when it's in shared memory
+	typedef LocklessSequenceQueue<int, 8, true> ZeroQueue;
+	ZeroQueue * zeroed = (ZeroQueue*)calloc(1, sizeof(ZeroQueue));
+	int in[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+	CHECK(zeroed->EnqueueBatch(in, 10) == 8);
+	CHECK(zeroed->DequeueBatch(values, 3) == 3 && values[2] == 2);
+	CHECK(zeroed->EnqueueBatch(in, 10) == 3);
+	free(zeroed);
+}
+
+// The queues with their 32 bit indices preset just short of 2^32, as if
+// billions of items had gone through, so a test can cross the wrap
+template<class T, uint32_t Capacity>
+struct WrappingSPSCQueue : public LocklessSPSCQueue<T, Capacity> {
+
+	explicit WrappingSPSCQueue(uint32_t position) {
+		this->Tail.store(position);
+		this->Head.store(position);
+		this->ProducerHead = position;
+		this->ConsumerTail = position;
+	}
+};
+
+template<class T, uint32_t Capacity, bool MultiConsumer>
+struct WrappingSequenceQueue : public LocklessSequenceQueue<T, Capacity, MultiConsumer> {
+
+	explicit WrappingSequenceQueue(uint32_t position) {
+		this->Tail.store(position);
+		this->Head.store(position);
+
+		// Each slot is free for the first position from here on that maps to it
+		for (uint32_t i = 0; i < Capacity; i++)
+			this->Slots[i].Sequence.store(this->GetLap(position + ((i - position) & (Capacity - 1))));
+	}
+};
+
+// Fills and drains a queue whose indices start offset positions short of
+// 2^32, for every offset up to a little over twice the capacity, so the wrap
+// falls on each position of a fill, of the refill after one dequeue and of
+// the drain
+template<class Queue>
+static void checkWrap(uint32_t capacity) {
+
+	for (uint32_t offset = 1; offset <= 2 * capacity + 2; offset++) {
+
+		const uint32_t start = 0u - offset;
+		Queue * queue = new Queue(start);
+		int in[17], out[17], value = 0;
+		int next = 0, expected = 0;
+		uint32_t position = start;
+
+		for (int round = 0; round < 3; round++) {
+
+			for (uint32_t i = 0; i <= capacity; i++) in[i] = next + i;
+			CHECK(queue->EnqueueBatch(in, capacity + 1) == capacity);
+			next += capacity;
+			CHECK(!queue->Enqueue(next));
+			CHECK(queue->GetCount() == capacity);
+
+			CHECK(queue->Dequeue(value) && value == expected++);
+			CHECK(queue->Enqueue(next++));	// refills the slot just freed
+			CHECK(!queue->Enqueue(next));
+
+			uint32_t count = queue->DequeueBatch(out, 17);
+			CHECK(count == capacity);
+			for (uint32_t i = 0; i < count; i++) CHECK(out[i] == expected++);
+			CHECK(!queue->Dequeue(value));
+			CHECK(queue->GetCount() == 0);
+			position += capacity + 1;
+		}
+
+		// The indices really did go past 2^32
+		CHECK(position < start);
+		delete queue;
+	}
+}
+
+TEST_CASE(lockless_queueIndexWrap) {
+
+	checkWrap<WrappingSPSCQueue<int, 4>>(4);
+	checkWrap<WrappingSPSCQueue<int, 16>>(16);
+	checkWrap<WrappingSequenceQueue<int, 4, false>>(4);
+	checkWrap<WrappingSequenceQueue<int, 8, true>>(8);
+	checkWrap<WrappingSequenceQueue<int, 2, true>>(2);
+}
+
+// Millions of items per second through each queue against MutexQueue, one
+// at a time and in batches
+BENCHMARK_CASE(lockless_queueVsMutex) {
+
+	const uint32_t itemCount = 2000000;
+
+	for (int batch = 0; batch < 2; batch++) {
+
+		reportResult("  %s\n", batch ? "batches of up to 16" : "one at a time");
+
+		struct Shape { const char * name; int producers, consumers; };
+		const Shape shapes[] = { { "1P1C spsc", 1, 1 }, { "4P1C mpsc", 4, 1 }, { "4P4C mpmc", 4, 4 } };
+
+		for (int s = 0; s < 3; s++) {
+
+			const Shape & shape = shapes[s];
+			uint32_t perProducer = itemCount / shape.producers;
+			QueueStressResult lockless, locked;
+
+			if (s == 0) {
+				LocklessSPSCQueue<QueueItem, 1024> * queue = new LocklessSPSCQueue<QueueItem, 1024>;
+				lockless = stressQueue(*queue, 1, 1, perProducer, batch != 0);
+				delete queue;
+			}
+			else if (s == 1) {
+				LocklessMPSCQueue<QueueItem, 1024> * queue = new LocklessMPSCQueue<QueueItem, 1024>;
+				lockless = stressQueue(*queue, 4, 1, perProducer, batch != 0);
+				delete queue;
+			}
+			else {
+				LocklessMPMCQueue<QueueItem, 1024> * queue = new LocklessMPMCQueue<QueueItem, 1024>;
+				lockless = stressQueue(*queue, 4, 4, perProducer, batch != 0);
+				delete queue;
+			}
+
+			MutexQueue * mutexQueue = new MutexQueue;
+			locked = stressQueue(*mutexQueue, shape.producers, shape.consumers, perProducer, batch != 0);
+			delete mutexQueue;
+
+			CHECK(lockless.received == locked.received && lockless.orderErrors == 0);
+			reportResult("    %s %6.1f M/s   mutex %6.1f M/s\n", shape.name,
+				lockless.received / lockless.seconds / 1.0e6, locked.received / locked.seconds / 1.0e6);
+		}
+	}
+}
@@ -0,0 +1,264 @@
+#include "TestSuite.h"
+#include "OVR_MathApprox.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+
+// The approximate kernels (OVR_MathApprox.h) swept against double-precision
+// libm for each tier, through both the float and the Vec4f overloads. The
+// bounds are the documented ones: relative error below 1e-6 (MathFast) or
+// 1e-3 (MathVeryFast) for RSqrt and Sqrt, absolute error below the same for
+// Atan2, Sin and Cos.
+
+using namespace OVR;
+
+// Keeps the benchmark loops from being optimized away
+static volatile float approxSink;
+
+// Runs one tier's kernels over arrays, four at a time through Vec4f when
+// bSimd is set and the backend has it, one at a time through float otherwise
+template<class Tier>
+struct ApproxKernels {
+
+	static void rsqrt(const float * x, float * out, size_t count, bool bSimd) {
+		size_t i = 0;
+#if OVR_MATH_SIMD
+		if (bSimd) for (; i + 4 <= count; i += 4) MathSimd::Store(out + i, MathApprox::RSqrt<Tier>(MathSimd::Load(x + i)));
+#endif
+		for (; i < count; i++) out[i] = MathApprox::RSqrt<Tier>(x[i]);
+	}
+
+	static void sqrt(const float * x, float * out, size_t count, bool bSimd) {
+		size_t i = 0;
+#if OVR_MATH_SIMD
+		if (bSimd) for (; i + 4 <= count; i += 4) MathSimd::Store(out + i, MathApprox::Sqrt<Tier>(MathSimd::Load(x + i)));
+#endif
+		for (; i < count; i++) out[i] = MathApprox::Sqrt<Tier>(x[i]);
+	}
+
+	static void atan2(const float * y, const float * x, float * out, size_t count, bool bSimd) {
+		size_t i = 0;
+#if OVR_MATH_SIMD
+		if (bSimd) for (; i + 4 <= count; i += 4) MathSimd::Store(out + i, MathApprox::Atan2<Tier>(MathSimd::Load(y + i), MathSimd::Load(x + i)));
+#endif
+		for (; i < count; i++) out[i] = MathApprox::Atan2<Tier>(y[i], x[i]);
+	}
+
+	static void sinCos(const float * angle, float * s, float * c, size_t count, bool bSimd) {
+		size_t i = 0;
+#if OVR_MATH_SIMD
+		if (bSimd) {
+			for (; i + 4 <= count; i += 4) {
+				MathSimd::Vec4f vs, vc;
+				MathApprox::SinCos<Tier>(MathSimd::Load(angle + i), &vs, &vc);
+				MathSimd::Store(s + i, vs);
+				MathSimd::Store(c + i, vc);
+			}
+		}
+#endif
+		for (; i < count; i++) MathApprox::SinCos<Tier>(angle[i], &s[i], &c[i]);
+	}
+};
+
+// Worst errors of one tier over the sweeps below
+struct ApproxErrors {
+	double rsqrt, sqrt, atan2, sinCos;
+};
+
+// Every float in [1, 4), which covers every mantissa at both exponent
+// parities, then a spread of exponents
+static std::vector<float> rsqrtInputs() {
+
+	std::vector<float> x;
+	for (float v = 1.0f; v < 4.0f; v = nextafterf(v, 5.0f)) x.push_back(v);
+	for (float v = 1e-30f; v < 1e30f; v *= 1.37f) x.push_back(v);
+	return x;
+}
+
+// Points on circles from 1e-3 to 1e3 in radius, so every octant and both
+// sides of each fold, plus the axes
+static void atan2Inputs(std::vector<float> & ys, std::vector<float> & xs) {
+
+	for (float radius : { 1e-3f, 1.0f, 7.5f, 1e3f }) {
+		for (int i = 0; i < 200000; i++) {
+			double angle = -MATH_DOUBLE_PI + i * (MATH_DOUBLE_TWOPI / 200000);
+			ys.push_back(radius * (float)sin(angle));
+			xs.push_back(radius * (float)cos(angle));
+		}
+	}
+	const float axes[][2] = { { 0, 1 }, { 1, 0 }, { 0, -1 }, { -1, 0 }, { 1, 1 }, { -1, -1 } };
+	for (const auto & p : axes) {
+		ys.push_back(p[0]);
+		xs.push_back(p[1]);
+	}
+}
+
+// Dense over a few turns, then sparser out to the documented 8000 radians
+static std::vector<float> sinCosInputs() {
+
+	std::vector<float> angles;
+	for (int i = -400000; i <= 400000; i++) angles.push_back(i * (4 * MATH_FLOAT_PI / 400000));
+	for (float a = 13.0f; a < 8000.0f; a *= 1.0001f) {
+		angles.push_back(a);
+		angles.push_back(-a);
+	}
+	return angles;
+}
+
+template<class Tier>
+static ApproxErrors measureErrors(bool bSimd) {
+
+	ApproxErrors errors = ApproxErrors();
+
+	std::vector<float> x = rsqrtInputs(), out(x.size());
+	ApproxKernels<Tier>::rsqrt(x.data(), out.data(), x.size(), bSimd);
+	for (size_t i = 0; i < x.size(); i++) {
+		double reference = 1.0 / std::sqrt((double)x[i]);
+		errors.rsqrt = std::max(errors.rsqrt, std::fabs(out[i] - reference) / reference);
+	}
+	ApproxKernels<Tier>::sqrt(x.data(), out.data(), x.size(), bSimd);
+	for (size_t i = 0; i < x.size(); i++) {
+		double reference = std::sqrt((double)x[i]);
+		errors.sqrt = std::max(errors.sqrt, std::fabs(out[i] - reference) / reference);
+	}
+
+	std::vector<float> ys, xs;
+	atan2Inputs(ys, xs);
+	out.resize(ys.size());
+	ApproxKernels<Tier>::atan2(ys.data(), xs.data(), out.data(), ys.size(), bSimd);
+	for (size_t i = 0; i < ys.size(); i++)
+		errors.atan2 = std::max(errors.atan2, std::fabs(out[i] - std::atan2((double)ys[i], (double)xs[i])));
+
+	std::vector<float> angles = sinCosInputs(), s(angles.size()), c(angles.size());
+	ApproxKernels<Tier>::sinCos(angles.data(), s.data(), c.data(), angles.size(), bSimd);
+	for (size_t i = 0; i < angles.size(); i++) {
+		errors.sinCos = std::max(errors.sinCos, std::fabs(s[i] - std::sin((double)angles[i])));
+		errors.sinCos = std::max(errors.sinCos, std::fabs(c[i] - std::cos((double)angles[i])));
+	}
+	return errors;
+}
+
+TEST_CASE(mathApprox_fastBounds) {
+
+	for (bool bSimd : { false, true }) {
+		ApproxErrors errors = measureErrors<MathFast>(bSimd);
+		CHECK(errors.rsqrt < 1e-6);
+		CHECK(errors.sqrt < 1e-6);
+		CHECK(errors.atan2 < 1e-6);
+		CHECK(errors.sinCos < 1e-6);
+	}
+}
+
+TEST_CASE(mathApprox_veryFastBounds) {
+
+	for (bool bSimd : { false, true }) {
+		ApproxErrors errors = measureErrors<MathVeryFast>(bSimd);
+		CHECK(errors.rsqrt < 1e-3);
+		CHECK(errors.sqrt < 1e-3);
+		CHECK(errors.atan2 < 1e-3);
+		CHECK(errors.sinCos < 1e-3);
+	}
+}
+
+// MathPrecise is libm, and double always is
+TEST_CASE(mathApprox_precise) {
+
+	for (float x : { 1e-20f, 0.3f, 2.0f, 1234.5f }) {
+		CHECK(MathApprox::RSqrt<MathPrecise>(x) == 1.0f / sqrtf(x));
+		CHECK(MathApprox::Sqrt<MathPrecise>(x) == sqrtf(x));
+		CHECK(MathApprox::Atan2<MathPrecise>(x, 1.0f - x) == atan2f(x, 1.0f - x));
+		CHECK(MathApprox::Sin<MathPrecise>(x) == sinf(x) && MathApprox::Cos<MathPrecise>(x) == cosf(x));
+		CHECK(MathApprox::Sqrt<MathVeryFast>((double)x) == std::sqrt((double)x));
+		CHECK(MathApprox::Sin<MathVeryFast>((double)x) == std::sin((double)x));
+	}
+}
+
+// Zero, signs and the special points of each kernel
+TEST_CASE(mathApprox_edges) {
+
+	CHECK(MathApprox::Sqrt<MathFast>(0.0f) == 0.0f);
+	CHECK(MathApprox::Sqrt<MathVeryFast>(0.0f) == 0.0f);
+
+	CHECK(MathApprox::Atan2<MathFast>(0.0f, 1.0f) == 0.0f);
+	CHECK(MathApprox::Atan2<MathFast>(0.0f, 0.0f) == 0.0f);
+	CHECK_CLOSE(MathApprox::Atan2<MathFast>(1.0f, 0.0f), MATH_DOUBLE_PIOVER2, 1e-6);
+	CHECK_CLOSE(MathApprox::Atan2<MathFast>(-1.0f, 0.0f), -MATH_DOUBLE_PIOVER2, 1e-6);
+	CHECK_CLOSE(MathApprox::Atan2<MathFast>(0.0f, -1.0f), MATH_DOUBLE_PI, 1e-6);
+	CHECK_CLOSE(MathApprox::Atan2<MathFast>(-0.0f, -1.0f), -MATH_DOUBLE_PI, 1e-6);
+
+	CHECK(MathApprox::Sin<MathFast>(0.0f) == 0.0f && MathApprox::Cos<MathFast>(0.0f) == 1.0f);
+	CHECK_CLOSE(MathApprox::Sin<MathFast>(MATH_FLOAT_PIOVER2), 1.0, 1e-6);
+	CHECK_CLOSE(MathApprox::Cos<MathFast>(MATH_FLOAT_PI), -1.0, 1e-6);
+
+	// Tiered Length and Normalized, and zero-length vectors left alone
+	Vector3f v(3, 4, 12);
+	CHECK_CLOSE(MathApprox::Length<MathFast>(v), 13.0, 13e-6);
+	CHECK_CLOSE(MathApprox::Normalized<MathFast>(v).Length(), 1.0, 2e-6);
+	CHECK_CLOSE(MathApprox::Normalized<MathVeryFast>(Quatf(1, 2, 3, 4)).Length(), 1.0, 2e-3);
+	CHECK(MathApprox::Normalized<MathFast>(Vector3f()) == Vector3f());
+
+	float xs[7] = { 3, 0, 1, 1e-3f, 0, -5, 2 }, ys[7] = { 4, 0, 1, 0, 0, 0, 2 }, zs[7] = { 12, 0, 1, 0, 2, 0, 1 };
+	MathApprox::NormalizeMany<MathFast>(xs, ys, zs, 7);
+	CHECK(xs[1] == 0 && ys[1] == 0 && zs[1] == 0);
+	for (int i = 0; i < 7; i++)
+		if (i != 1) CHECK_CLOSE(xs[i] * xs[i] + ys[i] * ys[i] + zs[i] * zs[i], 1.0, 4e-6);
+	CHECK_CLOSE(xs[0], 3.0 / 13, 1e-6);
+}
+
+// Time per value and worst error of each kernel and tier, float and Vec4f,
+// next to libm
+BENCHMARK_CASE(mathApprox_tiers) {
+
+	const size_t count = 4096;
+	const int rounds = 2000;
+	const double operations = (double)rounds * count;
+	std::vector<float> x(count), y(count), angles(count), out(count), out2(count);
+	for (size_t i = 0; i < count; i++) {
+		x[i] = 0.01f + i * 0.37f;
+		y[i] = std::sin(i * 0.1f) * 50.0f;
+		angles[i] = (i * 0.013f) - 25.0f;
+	}
+	float sink = 0;
+
+	struct Row { const char * name; double rsqrt, atan2, sinCos; ApproxErrors errors; };
+	Row rows[5];
+
+	auto timeTier = [&](Row & row, void (*rsqrt)(const float *, float *, size_t, bool),
+			void (*atan2)(const float *, const float *, float *, size_t, bool),
+			void (*sinCos)(const float *, float *, float *, size_t, bool), bool bSimd) {
+
+		uint64_t start = getTestTimeMicros();
+		for (int r = 0; r < rounds; r++) { rsqrt(x.data(), out.data(), count, bSimd); sink += out[r]; }
+		row.rsqrt = (getTestTimeMicros() - start) * 1000.0 / operations;
+
+		start = getTestTimeMicros();
+		for (int r = 0; r < rounds; r++) { atan2(y.data(), x.data(), out.data(), count, bSimd); sink += out[r]; }
+		row.atan2 = (getTestTimeMicros() - start) * 1000.0 / operations;
+
+		start = getTestTimeMicros();
+		for (int r = 0; r < rounds; r++) { sinCos(angles.data(), out.data(), out2.data(), count, bSimd); sink += out[r] + out2[r]; }
+		row.sinCos = (getTestTimeMicros() - start) * 1000.0 / operations;
+	};
+
+	rows[0].name = "precise (libm)";
+	timeTier(rows[0], ApproxKernels<MathPrecise>::rsqrt, ApproxKernels<MathPrecise>::atan2, ApproxKernels<MathPrecise>::sinCos, false);
+	rows[0].errors = measureErrors<MathPrecise>(false);
+	rows[1].name = "fast, float";
+	timeTier(rows[1], ApproxKernels<MathFast>::rsqrt, ApproxKernels<MathFast>::atan2, ApproxKernels<MathFast>::sinCos, false);
+	rows[1].errors = measureErrors<MathFast>(false);
+	rows[2].name = "fast, Vec4f";
+	timeTier(rows[2], ApproxKernels<MathFast>::rsqrt, ApproxKernels<MathFast>::atan2, ApproxKernels<MathFast>::sinCos, true);
+	rows[2].errors = measureErrors<MathFast>(true);
+	rows[3].name = "very fast, float";
+	timeTier(rows[3], ApproxKernels<MathVeryFast>::rsqrt, ApproxKernels<MathVeryFast>::atan2, ApproxKernels<MathVeryFast>::sinCos, false);
+	rows[3].errors = measureErrors<MathVeryFast>(false);
+	rows[4].name = "very fast, Vec4f";
+	timeTier(rows[4], ApproxKernels<MathVeryFast>::rsqrt, ApproxKernels<MathVeryFast>::atan2, ApproxKernels<MathVeryFast>::sinCos, true);
+	rows[4].errors = measureErrors<MathVeryFast>(true);
+
+	for (const Row & row : rows)
+		reportResult("  %-17s rsqrt %5.2f ns (%.1e), atan2 %5.2f ns (%.1e), sincos %5.2f ns (%.1e)\n", row.name,
+			row.rsqrt, row.errors.rsqrt, row.atan2, row.errors.atan2, row.sinCos, row.errors.sinCos);
+	approxSink = sink;
+}
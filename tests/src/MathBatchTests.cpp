@@ -0,0 +1,349 @@
+#include "TestSuite.h"
+#include "OVR_MathBatch.h"
+
+#include <algorithm>
+#include <vector>
+
+// The batch point transforms (OVR_MathBatch.h) against the single-point
+// functions they promise to match exactly, float and double, at counts that
+// leave every possible remainder after the groups of four.
+
+using namespace OVR;
+
+// Keeps the benchmark loops from being optimized away
+static volatile float batchSink;
+
+// Deterministic, so a failure reproduces; uniform in [-1, 1]
+static float batchRandom(uint32_t & state) {
+
+	state = state * 1664525u + 1013904223u;
+	return (float)(state >> 8) / (float)(1 << 23) - 1.0f;
+}
+
+template<class T>
+static Pose<T> randomPose(uint32_t & state) {
+
+	Vector3<T> axis(batchRandom(state), batchRandom(state), batchRandom(state));
+	if (axis.LengthSq() < T(1e-4)) axis = Vector3<T>(0, 1, 0);
+	return Pose<T>(Quat<T>(axis.Normalized(), batchRandom(state) * T(MATH_DOUBLE_PI)),
+		Vector3<T>(batchRandom(state), batchRandom(state), batchRandom(state)) * T(300));
+}
+
+// Points in separate x, y and z arrays, with one sentinel past count in each
+// output array to catch a store past the end
+template<class T>
+struct PointArrays {
+
+	PointArrays(size_t count, uint32_t & state) : count(count), xs(count + 1), ys(count + 1), zs(count + 1) {
+		for (size_t i = 0; i < count; i++) {
+			xs[i] = batchRandom(state) * T(50);
+			ys[i] = batchRandom(state) * T(50);
+			zs[i] = batchRandom(state) * T(50);
+		}
+		xs[count] = ys[count] = zs[count] = T(-12345);
+	}
+
+	Vector3<T> point(size_t i) const { return Vector3<T>(xs[i], ys[i], zs[i]); }
+
+	bool sentinelsIntact() const { return xs[count] == T(-12345) && ys[count] == T(-12345) && zs[count] == T(-12345); }
+
+	size_t			count;
+	std::vector<T>	xs, ys, zs;
+};
+
+// Runs the four batch functions on count random points, out of place and in
+// place, and checks every point against the single-point version
+template<class T>
+static void checkBatchTransforms(size_t count, uint32_t & state) {
+
+	Pose<T> pose = randomPose<T>(state);
+	PointArrays<T> in(count, state);
+	PointArrays<T> out(count, state);
+
+	for (int kind = 0; kind < 4; kind++) {
+
+		switch (kind) {
+		case 0: RotateMany(pose.Rotation, in.xs.data(), in.ys.data(), in.zs.data(), out.xs.data(), out.ys.data(), out.zs.data(), count); break;
+		case 1: InverseRotateMany(pose.Rotation, in.xs.data(), in.ys.data(), in.zs.data(), out.xs.data(), out.ys.data(), out.zs.data(), count); break;
+		case 2: TransformPoints(pose, in.xs.data(), in.ys.data(), in.zs.data(), out.xs.data(), out.ys.data(), out.zs.data(), count); break;
+		case 3: InverseTransformPoints(pose, in.xs.data(), in.ys.data(), in.zs.data(), out.xs.data(), out.ys.data(), out.zs.data(), count); break;
+		}
+
+		int mismatches = 0;
+		for (size_t i = 0; i < count; i++) {
+			Vector3<T> expected;
+			switch (kind) {
+			case 0: expected = pose.Rotation.Rotate(in.point(i)); break;
+			case 1: expected = pose.Rotation.InverseRotate(in.point(i)); break;
+			case 2: expected = pose.Transform(in.point(i)); break;
+			case 3: expected = pose.InverseTransform(in.point(i)); break;
+			}
+			if (out.point(i) != expected) mismatches++;
+		}
+		CHECK(mismatches == 0);
+		CHECK(out.sentinelsIntact());
+	}
+
+	// In place gives the same as out of place
+	PointArrays<T> inPlace = in;
+	TransformPoints(pose, in.xs.data(), in.ys.data(), in.zs.data(), out.xs.data(), out.ys.data(), out.zs.data(), count);
+	TransformPoints(pose, inPlace.xs.data(), inPlace.ys.data(), inPlace.zs.data(), count);
+	CHECK(inPlace.xs == out.xs && inPlace.ys == out.ys && inPlace.zs == out.zs);
+
+	inPlace = in;
+	InverseTransformPoints(pose, in.xs.data(), in.ys.data(), in.zs.data(), out.xs.data(), out.ys.data(), out.zs.data(), count);
+	InverseTransformPoints(pose, inPlace.xs.data(), inPlace.ys.data(), inPlace.zs.data(), count);
+	CHECK(inPlace.xs == out.xs && inPlace.ys == out.ys && inPlace.zs == out.zs);
+}
+
+static const size_t batchCounts[] = { 0, 1, 3, 4, 5, 7, 8, 1027 };
+
+TEST_CASE(mathBatch_transformsMatchScalar) {
+
+	uint32_t state = 12345;
+	for (size_t count : batchCounts) {
+		checkBatchTransforms<float>(count, state);
+		checkBatchTransforms<double>(count, state);
+	}
+}
+
+// Unaligned arrays: the batch functions promise no alignment requirement
+TEST_CASE(mathBatch_unaligned) {
+
+	uint32_t state = 777;
+	Posef pose = randomPose<float>(state);
+	PointArrays<float> in(1031, state);
+	std::vector<float> outX(1032), outY(1032), outZ(1032);
+
+	TransformPoints(pose, in.xs.data() + 1, in.ys.data() + 1, in.zs.data() + 1, outX.data() + 1, outY.data() + 1, outZ.data() + 1, 1029);
+	int mismatches = 0;
+	for (size_t i = 1; i < 1030; i++)
+		if (Vector3f(outX[i], outY[i], outZ[i]) != pose.Transform(in.point(i))) mismatches++;
+	CHECK(mismatches == 0);
+}
+
+TEST_CASE(mathBatch_soaRoundTrip) {
+
+	uint32_t state = 99;
+	std::vector<Vector3f> points(1027), back(1027);
+	for (Vector3f & p : points) p = Vector3f(batchRandom(state), batchRandom(state), batchRandom(state));
+
+	std::vector<float> xs(1027), ys(1027), zs(1027);
+	Vector3ToSoA(points.data(), xs.data(), ys.data(), zs.data(), points.size());
+	CHECK(xs[5] == points[5].x && ys[5] == points[5].y && zs[1026] == points[1026].z);
+
+	Vector3FromSoA(xs.data(), ys.data(), zs.data(), back.data(), back.size());
+	CHECK(back == points);
+}
+
+// Batch against a per-point Pose::Transform loop over the same SoA arrays,
+// from sizes that fit in L1 to ones that stream from memory
+BENCHMARK_CASE(mathBatch_transformThroughput) {
+
+	uint32_t state = 12345;
+	Posef pose = randomPose<float>(state);
+	const size_t sizes[] = { 1000, 10000, 100000, 1000000 };
+	float sink = 0;
+
+	for (size_t count : sizes) {
+
+		PointArrays<float> in(count, state);
+		PointArrays<float> out(count, state);
+		const int rounds = (int)(20000000 / count);
+
+		uint64_t start = getTestTimeMicros();
+		for (int r = 0; r < rounds; r++) {
+			TransformPoints(pose, in.xs.data(), in.ys.data(), in.zs.data(), out.xs.data(), out.ys.data(), out.zs.data(), count);
+			sink += out.xs[r % count];
+		}
+		double batch = (getTestTimeMicros() - start) * 1000.0 / ((double)rounds * count);
+
+		start = getTestTimeMicros();
+		for (int r = 0; r < rounds; r++) {
+			for (size_t i = 0; i < count; i++) {
+				Vector3f p = pose.Transform(in.point(i));
+				out.xs[i] = p.x;
+				out.ys[i] = p.y;
+				out.zs[i] = p.z;
+			}
+			sink += out.xs[r % count];
+		}
+		double scalar = (getTestTimeMicros() - start) * 1000.0 / ((double)rounds * count);
+
+		reportResult("  %7zu points: %6.3f ns/point batch, %6.3f ns/point Pose::Transform (%.2fx)\n",
+			count, batch, scalar, scalar / batch);
+	}
+	batchSink = sink;
+}
+
+// SlerpMany against a double-precision slerp. Pairs are a random rotation a
+// and b = a turned by rotationAngle about a random axis, with b negated half
+// the time so the shortest-arc flip is exercised.
+struct SlerpPairs {
+
+	SlerpPairs(size_t count, float rotationAngle, uint32_t & state) : a(count), b(count), s(count) {
+		for (size_t i = 0; i < count; i++) {
+			Vector3f axis(batchRandom(state), batchRandom(state), batchRandom(state));
+			if (axis.LengthSq() < 1e-4f) axis = Vector3f(0, 1, 0);
+			a[i] = randomPose<float>(state).Rotation;
+			b[i] = (Quatf(axis.Normalized(), rotationAngle * (0.5f + 0.5f * std::fabs(batchRandom(state)))) * a[i]).Normalized();
+			if (batchRandom(state) < 0) b[i] = -b[i];
+			s[i] = 0.5f + 0.5f * batchRandom(state);
+		}
+	}
+
+	std::vector<Quatf>	a, b;
+	std::vector<float>	s;
+};
+
+// Largest component difference to the double slerp of the same pair. Both
+// flip b towards a, so the results are in the same hemisphere.
+static double slerpError(const SlerpPairs & pairs, const std::vector<Quatf> & out) {
+
+	double worst = 0;
+	for (size_t i = 0; i < out.size(); i++) {
+		Quatd reference = MathBatch::AccurateSlerp(Quatd(pairs.a[i]), Quatd(pairs.b[i]), (double)pairs.s[i]);
+		Quatd difference = Quatd(out[i]) - reference;
+		worst = std::max(worst, std::max(std::max(std::fabs(difference.x), std::fabs(difference.y)),
+			std::max(std::fabs(difference.z), std::fabs(difference.w))));
+	}
+	return worst;
+}
+
+// Largest component difference once r is in q's hemisphere, as Quat::Slerp
+// may return the other sign for the same rotation
+static double slerpDistance(const Quatf & q, const Quatf & r) {
+
+	Quatd difference = Quatd(q) - ((Quatd(q).Dot(Quatd(r)) < 0) ? -Quatd(r) : Quatd(r));
+	return std::max(std::max(std::fabs(difference.x), std::fabs(difference.y)),
+		std::max(std::fabs(difference.z), std::fabs(difference.w)));
+}
+
+TEST_CASE(mathBatch_slerpAccurate) {
+
+	uint32_t state = 4242;
+	for (float degrees : { 1.0f, 30.0f, 120.0f, 179.0f }) {
+
+		SlerpPairs pairs(1027, DegreeToRad(degrees), state);
+		std::vector<Quatf> out(1027);
+		SlerpMany(pairs.a.data(), pairs.b.data(), pairs.s.data(), out.data(), out.size(), Slerp_Accurate);
+
+		double worstDistance = 0;
+		for (size_t i = 0; i < out.size(); i++)
+			worstDistance = std::max(worstDistance, slerpDistance(out[i], pairs.a[i].Slerp(pairs.b[i], pairs.s[i])));
+		CHECK(worstDistance < 1e-6);
+		CHECK(slerpError(pairs, out) < 1e-6);
+	}
+}
+
+TEST_CASE(mathBatch_slerpFastError) {
+
+	uint32_t state = 4242;
+
+	// The documented weight error, plus float rounding of the blend
+	struct { float degrees; double bound; } sweeps[] = {
+		{ 1.0f, 2e-6 }, { 30.0f, 2e-6 }, { 90.0f, 2e-6 }, { 120.0f, 2e-6 }, { 150.0f, 1e-4 }, { 180.0f, 1e-4 } };
+
+	for (const auto & sweep : sweeps) {
+		SlerpPairs pairs(4099, DegreeToRad(sweep.degrees), state);
+		std::vector<Quatf> out(4099);
+		SlerpMany(pairs.a.data(), pairs.b.data(), pairs.s.data(), out.data(), out.size(), Slerp_Fast);
+		CHECK(slerpError(pairs, out) < sweep.bound);
+	}
+}
+
+// Flipping b, one s for all against an array of it, aliasing and the tails
+// after the groups of four
+TEST_CASE(mathBatch_slerpArguments) {
+
+	uint32_t state = 31337;
+
+	for (SlerpMode mode : { Slerp_Accurate, Slerp_Fast }) {
+		for (size_t count : batchCounts) {
+
+			SlerpPairs pairs(count, DegreeToRad(150.0f), state);
+			std::vector<Quatf> out(count + 1), flipped(count), perElement(count), single(count + 1);
+			out[count] = single[count] = Quatf(-2, -2, -2, -2);
+
+			SlerpMany(pairs.a.data(), pairs.b.data(), pairs.s.data(), out.data(), count, mode);
+
+			// The shortest arc doesn't depend on b's sign
+			std::vector<Quatf> negatedB(count);
+			for (size_t i = 0; i < count; i++) negatedB[i] = -pairs.b[i];
+			SlerpMany(pairs.a.data(), negatedB.data(), pairs.s.data(), flipped.data(), count, mode);
+			CHECK(std::equal(flipped.begin(), flipped.end(), out.begin()));
+
+			// Each element on its own gives what it gave in the batch
+			int mismatches = 0;
+			for (size_t i = 0; i < count; i++) {
+				Quatf one;
+				SlerpMany(&pairs.a[i], &pairs.b[i], pairs.s[i], &one, 1, mode);
+				if (mode == Slerp_Accurate ? !(one == out[i]) : slerpDistance(one, out[i]) > 1e-6) mismatches++;
+			}
+			CHECK(mismatches == 0);
+
+			// One s for every element matches an array of that s
+			std::vector<float> sameS(count, 0.3f);
+			SlerpMany(pairs.a.data(), pairs.b.data(), 0.3f, single.data(), count, mode);
+			SlerpMany(pairs.a.data(), pairs.b.data(), sameS.data(), perElement.data(), count, mode);
+			CHECK(std::equal(perElement.begin(), perElement.end(), single.begin()));
+
+			// out may be a or b
+			std::vector<Quatf> inA = pairs.a, inB = pairs.b;
+			SlerpMany(inA.data(), pairs.b.data(), pairs.s.data(), inA.data(), count, mode);
+			SlerpMany(pairs.a.data(), inB.data(), pairs.s.data(), inB.data(), count, mode);
+			CHECK(std::equal(inA.begin(), inA.end(), out.begin()));
+			CHECK(std::equal(inB.begin(), inB.end(), out.begin()));
+
+			CHECK(out[count] == Quatf(-2, -2, -2, -2) && single[count] == Quatf(-2, -2, -2, -2));
+		}
+	}
+
+	// The end points
+	Quatf a(Vector3f(0, 1, 0), 0.5f), b(Vector3f(1, 0, 0), 2.0f), out;
+	SlerpMany(&a, &b, 0.0f, &out, 1, Slerp_Fast);
+	CHECK(slerpDistance(out, a) < 1e-6);
+	SlerpMany(&a, &b, 1.0f, &out, 1, Slerp_Fast);
+	CHECK(slerpDistance(out, b) < 1e-6);
+}
+
+// Error against speed for the two modes and a Quat::Slerp loop, by how far
+// apart the rotations are
+BENCHMARK_CASE(mathBatch_slerpErrorAndSpeed) {
+
+	uint32_t state = 4242;
+	const size_t count = 4096;
+	const int rounds = 500;
+	float sink = 0;
+
+	for (float degrees : { 10.0f, 60.0f, 120.0f, 180.0f }) {
+
+		SlerpPairs pairs(count, DegreeToRad(degrees), state);
+		std::vector<Quatf> accurate(count), fast(count), quatSlerp(count);
+
+		uint64_t start = getTestTimeMicros();
+		for (int r = 0; r < rounds; r++) {
+			SlerpMany(pairs.a.data(), pairs.b.data(), pairs.s.data(), accurate.data(), count, Slerp_Accurate);
+			sink += accurate[r].w;
+		}
+		double accurateTime = (getTestTimeMicros() - start) * 1000.0 / ((double)rounds * count);
+
+		start = getTestTimeMicros();
+		for (int r = 0; r < rounds; r++) {
+			SlerpMany(pairs.a.data(), pairs.b.data(), pairs.s.data(), fast.data(), count, Slerp_Fast);
+			sink += fast[r].w;
+		}
+		double fastTime = (getTestTimeMicros() - start) * 1000.0 / ((double)rounds * count);
+
+		start = getTestTimeMicros();
+		for (int r = 0; r < rounds; r++) {
+			for (size_t i = 0; i < count; i++) quatSlerp[i] = pairs.a[i].Slerp(pairs.b[i], pairs.s[i]);
+			sink += quatSlerp[r].w;
+		}
+		double quatSlerpTime = (getTestTimeMicros() - start) * 1000.0 / ((double)rounds * count);
+
+		reportResult("  up to %3.0f degrees: accurate %5.2f ns (error %.1e), fast %5.2f ns (error %.1e), Quat::Slerp %5.2f ns\n",
+			degrees, accurateTime, slerpError(pairs, accurate), fastTime, slerpError(pairs, fast), quatSlerpTime);
+	}
+	batchSink = sink;
+}
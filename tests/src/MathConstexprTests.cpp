@@ -0,0 +1,163 @@
+#include "TestSuite.h"
+#include "OVR_Math.h"
+
+#include <algorithm>
+
+// The constexpr parts of OVR_Math.h: the static_asserts fail the build if
+// something stops being a constant expression, and the tests check the
+// MathConstexpr builders against the runtime functions they stand in for.
+
+using namespace OVR;
+
+#if OVR_MATH_CONSTEXPR_ENABLED
+
+static constexpr bool constexprClose(double a, double b, double tolerance) {
+
+	return (a - b <= tolerance) && (b - a <= tolerance);
+}
+
+// Vectors and quaternions
+static_assert(Vector3f(1, 2, 3) + Vector3f(4, 5, 6) == Vector3f(5, 7, 9), "Vector3 +");
+static_assert(-Vector3f(1, 2, 3) * 2.0f == Vector3f(-2, -4, -6), "Vector3 negate and scale");
+static_assert(Vector3f(1, 0, 0).Cross(Vector3f(0, 1, 0)) == Vector3f(0, 0, 1), "Vector3::Cross");
+static_assert(Vector3f(1, 2, 3).Dot(Vector3f(4, 5, 6)) == 32.0f, "Vector3::Dot");
+static_assert(Vector3d(1, 2, 2).LengthSq() == 9.0, "Vector3::LengthSq");
+static_assert(Vector3f::Min(Vector3f(1, 5, 3), Vector3f(4, 2, 6)) == Vector3f(1, 2, 3), "Vector3::Min");
+static_assert(Vector4f(Vector3f(1, 2, 3)).w == 1.0f, "Vector4 from Vector3");
+static_assert(Quatf() == Quatf::Identity(), "Quat identity");
+static_assert(Quatf(1, 2, 3, 4).Conj() == Quatf(-1, -2, -3, 4), "Quat::Conj");
+static_assert(Quatf(0, 0, 1, 0) * Quatf(0, 0, 1, 0) == Quatf(0, 0, 0, -1), "Quat * Quat");
+static_assert(Quatf(1, 2, 3, 4).Imag() == Vector3f(1, 2, 3), "Quat::Imag");
+static_assert(Quatd(Quatf(0.5f, 0, 0, 0.5f)).x == 0.5, "Quat conversion");
+
+// Matrices
+static_assert(Matrix4f::Identity().M[2][2] == 1.0f && Matrix4f::Identity().M[2][3] == 0.0f, "Matrix4 identity");
+static_assert(Matrix4f::Translation(1, 2, 3).GetTranslation() == Vector3f(1, 2, 3), "Matrix4::Translation");
+static_assert(Matrix4f::Scaling(2.0f).M[1][1] == 2.0f && Matrix4f::Scaling(2.0f).M[3][3] == 1.0f, "Matrix4::Scaling");
+static_assert(Matrix4f(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16).Transposed().M[0][3] == 13.0f, "Matrix4::Transposed");
+static_assert(MathConstexpr::Transform(MathConstexpr::Multiply(Matrix4f::Translation(1, 2, 3), Matrix4f::Scaling(2.0f)),
+	Vector3f(1, 1, 1)) == Vector3f(3, 4, 5), "MathConstexpr::Multiply and Transform");
+
+// Trig and square roots, to double precision over the whole period
+static_assert(constexprClose(MathConstexpr::Sin(MATH_DOUBLE_PI / 6), 0.5, 1e-15), "MathConstexpr::Sin");
+static_assert(constexprClose(MathConstexpr::Cos(MATH_DOUBLE_PI / 3), 0.5, 1e-15), "MathConstexpr::Cos");
+static_assert(constexprClose(MathConstexpr::Sin(-7 * MATH_DOUBLE_PI / 2), 1.0, 1e-14), "MathConstexpr::Sin wraps");
+static_assert(constexprClose(MathConstexpr::Tan(MATH_DOUBLE_PI / 4), 1.0, 1e-15), "MathConstexpr::Tan");
+static_assert(constexprClose(MathConstexpr::Sqrt(2.0), 1.4142135623730951, 1e-15), "MathConstexpr::Sqrt");
+static_assert(MathConstexpr::Sqrt(0.0) == 0.0 && MathConstexpr::Sqrt(-1.0) == 0.0, "MathConstexpr::Sqrt at and below 0");
+
+// Rotations: a quarter turn about z takes x to y, whichever way it's built
+static_assert(constexprClose(MathConstexpr::Transform(MathConstexpr::RotationZ(MATH_DOUBLE_PIOVER2), Vector3d(1, 0, 0)).y, 1.0, 1e-15),
+	"MathConstexpr::RotationZ");
+static_assert(constexprClose(MathConstexpr::Rotate(MathConstexpr::QuatFromAxisAngle(Vector3d(0, 0, 1), MATH_DOUBLE_PIOVER2), Vector3d(1, 0, 0)).y, 1.0, 1e-15),
+	"MathConstexpr::QuatFromAxisAngle and Rotate");
+static_assert(constexprClose(MathConstexpr::RotationMatrix(MathConstexpr::QuatFromAxisAngle(Vector3d(1, 0, 0), 0.3)).M[2][1],
+	MathConstexpr::RotationX(0.3).M[2][1], 1e-15), "MathConstexpr::RotationMatrix");
+
+// Projections: a symmetric 90 degree field of view has unit scale and no
+// offset, and w is -z for right-handed coordinates
+static_assert(constexprClose(MathConstexpr::FovFromDegrees(90.0f, 90.0f).LeftTan, 1.0, 1e-6), "MathConstexpr::FovFromDegrees");
+static_assert(MathConstexpr::NDCScaleAndOffsetFromFov(FovPort(1.0f)).Scale.x == 1.0f &&
+	MathConstexpr::NDCScaleAndOffsetFromFov(FovPort(1.0f)).Offset.y == 0.0f, "MathConstexpr::NDCScaleAndOffsetFromFov");
+static_assert(MathConstexpr::Projection(false, true, FovPort(1.0f)).M[3][2] == -1.0f &&
+	MathConstexpr::Projection(true, true, FovPort(1.0f)).M[3][2] == 1.0f, "MathConstexpr::Projection handedness");
+
+// A table built at compile time, as an app would use one
+static constexpr Matrix4f constexprRotationTable[] = {
+	MathConstexpr::RotationY(0.0f), MathConstexpr::RotationY(0.25f), MathConstexpr::RotationY(0.5f), MathConstexpr::RotationY(0.75f),
+	MathConstexpr::RotationY(1.0f), MathConstexpr::RotationY(1.25f), MathConstexpr::RotationY(1.5f), MathConstexpr::RotationY(1.75f),
+	MathConstexpr::RotationY(2.0f), MathConstexpr::RotationY(2.25f), MathConstexpr::RotationY(2.5f), MathConstexpr::RotationY(2.75f),
+	MathConstexpr::RotationY(3.0f), MathConstexpr::RotationY(-3.0f), MathConstexpr::RotationY(-1.5f), MathConstexpr::RotationY(-0.5f)
+};
+static constexpr float constexprTableAngles[] = {
+	0.0f, 0.25f, 0.5f, 0.75f, 1.0f, 1.25f, 1.5f, 1.75f, 2.0f, 2.25f, 2.5f, 2.75f, 3.0f, -3.0f, -1.5f, -0.5f
+};
+static const int constexprTableSize = sizeof(constexprTableAngles) / sizeof(constexprTableAngles[0]);
+
+// Keeps the benchmark loops from being optimized away
+static volatile float constexprSink;
+
+static float maxDifference(const Matrix4f & a, const Matrix4f & b) {
+
+	float result = 0;
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			result = std::max(result, std::fabs(a.M[i][j] - b.M[i][j]));
+	return result;
+}
+
+// The compile-time builders against the runtime ones, over a sweep of angles.
+// In double, the range reduction costs a few ULP; in float, both round the
+// same value, give or take libm's last bit. Rotate goes through q * v * q'
+// rather than Quat::Rotate's cross products, so it gets a few ULP of |v|.
+TEST_CASE(mathConstexpr_matchesRuntime) {
+
+	for (int n = -64; n <= 64; n++) {
+
+		double angle = n * (MATH_DOUBLE_PI / 32);
+		CHECK_CLOSE(MathConstexpr::Sin(angle), sin(angle), 1e-15);
+		CHECK_CLOSE(MathConstexpr::Cos(angle), cos(angle), 1e-15);
+		if (std::fabs(cos(angle)) > 0.1) CHECK_CLOSE(MathConstexpr::Tan(angle), tan(angle), 1e-15 * (1 + tan(angle) * tan(angle)));
+
+		float angleF = (float)angle;
+		CHECK(maxDifference(MathConstexpr::RotationX(angleF), Matrix4f::RotationX(angleF)) <= FLT_EPSILON);
+		CHECK(maxDifference(MathConstexpr::RotationY(angleF), Matrix4f::RotationY(angleF)) <= FLT_EPSILON);
+		CHECK(maxDifference(MathConstexpr::RotationZ(angleF), Matrix4f::RotationZ(angleF)) <= FLT_EPSILON);
+
+		Vector3f axis = Vector3f(1, 2, 3).Normalized();
+		Quatf q = MathConstexpr::QuatFromAxisAngle(axis, angleF), runtime(axis, angleF);
+		CHECK_CLOSE(q.x, runtime.x, 2 * FLT_EPSILON);
+		CHECK_CLOSE(q.w, runtime.w, 2 * FLT_EPSILON);
+		CHECK(maxDifference(MathConstexpr::RotationMatrix(q), Matrix4f(runtime)) <= 4 * FLT_EPSILON);
+
+		Vector3f v(0.5f, -2.0f, 3.0f);
+		CHECK((MathConstexpr::Rotate(q, v) - runtime.Rotate(v)).Length() <= 8 * FLT_EPSILON * v.Length());
+	}
+
+	for (double x : { 1e-12, 0.25, 2.0, 12345.678, 1e12 })
+		CHECK_CLOSE(MathConstexpr::Sqrt(x), sqrt(x), 4e-16 * sqrt(x));
+
+	Matrix4f a = Matrix4f::RotationZ(0.7f) * Matrix4f::Translation(1, 2, 3), b = Matrix4f::RotationX(-0.4f) * Matrix4f::Scaling(2.0f);
+	CHECK(maxDifference(MathConstexpr::Multiply(a, b), a * b) <= 8 * FLT_EPSILON);
+	Vector3f p(4, -5, 6);
+	CHECK((MathConstexpr::Transform(a, p) - a.Transform(p)).Length() <= 16 * FLT_EPSILON);
+
+	for (int i = 0; i < constexprTableSize; i++)
+		CHECK(maxDifference(constexprRotationTable[i], Matrix4f::RotationY(constexprTableAngles[i])) <= FLT_EPSILON);
+}
+
+// What the compile-time table saves: reading it against building the same
+// matrices with Matrix4f::RotationY and MathConstexpr::RotationY at run time
+BENCHMARK_CASE(mathConstexpr_tableVsRuntime) {
+
+	const int rounds = 1000000;
+	volatile int indexBase = 0;
+	float sink = 0;
+
+	uint64_t start = getTestTimeMicros();
+	for (int r = 0; r < rounds; r++) {
+		int i = (r + indexBase) & (constexprTableSize - 1);
+		sink += constexprRotationTable[i].M[0][2];
+	}
+	double table = (getTestTimeMicros() - start) * 1000.0 / rounds;
+
+	start = getTestTimeMicros();
+	for (int r = 0; r < rounds; r++) {
+		int i = (r + indexBase) & (constexprTableSize - 1);
+		sink += Matrix4f::RotationY(constexprTableAngles[i]).M[0][2];
+	}
+	double runtime = (getTestTimeMicros() - start) * 1000.0 / rounds;
+
+	start = getTestTimeMicros();
+	for (int r = 0; r < rounds; r++) {
+		int i = (r + indexBase) & (constexprTableSize - 1);
+		sink += MathConstexpr::RotationY(constexprTableAngles[i]).M[0][2];
+	}
+	double constexprAtRuntime = (getTestTimeMicros() - start) * 1000.0 / rounds;
+
+	reportResult("  rotation: %6.2f ns from the constexpr table, %6.2f ns Matrix4f::RotationY, %6.2f ns MathConstexpr::RotationY at run time\n",
+		table, runtime, constexprAtRuntime);
+	constexprSink = sink;
+}
+
+#endif // OVR_MATH_CONSTEXPR_ENABLED
@@ -0,0 +1,262 @@
+#include "TestSuite.h"
+#include "OVR_Math.h"
+
+#include <cfloat>
+#include <vector>
+
+// Matrix4f's SIMD specializations (OVR_MATH_SIMD) against the scalar
+// templates they replace. The reference for Determinant and Inverted is the
+// scalar template evaluated in double.
+
+using namespace OVR;
+
+static const int MATRIX_COUNT = 4096;
+
+// Keeps the benchmark loops from being optimized away
+static volatile float benchmarkSink;
+
+// Deterministic, so a failure reproduces
+struct TestRandom {
+
+	TestRandom() : state(12345) {}
+
+	// Uniform in [-1, 1]
+	float next() {
+		state = state * 1664525u + 1013904223u;
+		return (float)(state >> 8) / (float)(1 << 23) - 1.0f;
+	}
+
+	uint32_t state;
+};
+
+static Matrix4f randomMatrix(TestRandom & random) {
+
+	Matrix4f m(Matrix4f::NoInit);
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			m.M[i][j] = random.next();
+	return m;
+}
+
+// The kind of matrix the addon actually inverts: scale, rotation and a
+// translation up to a few hundred meters
+static Matrix4f randomTransform(TestRandom & random) {
+
+	Vector3f axis(random.next(), random.next(), random.next());
+	if (axis.LengthSq() < 1e-4f) axis = Vector3f(0, 1, 0);
+
+	Posef pose(Quatf(axis.Normalized(), random.next() * MATH_FLOAT_PI),
+		Vector3f(random.next(), random.next(), random.next()) * 300.0f);
+
+	Matrix4f scale;
+	scale.M[0][0] = 1.5f + random.next();
+	scale.M[1][1] = 1.5f + random.next();
+	scale.M[2][2] = 1.5f + random.next();
+
+	return Matrix4f(pose) * scale;
+}
+
+static std::vector<Matrix4f> randomMatrices() {
+
+	TestRandom random;
+	std::vector<Matrix4f> matrices;
+
+	for (int i = 0; i < MATRIX_COUNT; i++)
+		matrices.push_back((i & 1) ? randomTransform(random) : randomMatrix(random));
+	return matrices;
+}
+
+// Element by element, in the scalar template's order
+static Matrix4f scalarMultiply(const Matrix4f & a, const Matrix4f & b) {
+
+	Matrix4f d(Matrix4f::NoInit);
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			d.M[i][j] = a.M[i][0] * b.M[0][j] + a.M[i][1] * b.M[1][j] + a.M[i][2] * b.M[2][j] + a.M[i][3] * b.M[3][j];
+	return d;
+}
+
+// What the scalar Inverted() computes; Cofactor and Adjugated aren't specialized
+static Matrix4f scalarInverse(const Matrix4f & m) {
+
+	float det = m.M[0][0] * m.Cofactor(0, 0) + m.M[0][1] * m.Cofactor(0, 1) + m.M[0][2] * m.Cofactor(0, 2) + m.M[0][3] * m.Cofactor(0, 3);
+	return m.Adjugated() * (1.0f / det);
+}
+
+static double maxAbs(const Matrix4d & m) {
+
+	double result = 0;
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			result = std::max(result, std::fabs(m.M[i][j]));
+	return result;
+}
+
+static double maxAbsDifference(const Matrix4d & a, const Matrix4d & b) {
+
+	double result = 0;
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			result = std::max(result, std::fabs(a.M[i][j] - b.M[i][j]));
+	return result;
+}
+
+// Largest absolute row sum
+static double normInf(const Matrix4d & m) {
+
+	double result = 0;
+	for (int i = 0; i < 4; i++)
+		result = std::max(result, std::fabs(m.M[i][0]) + std::fabs(m.M[i][1]) + std::fabs(m.M[i][2]) + std::fabs(m.M[i][3]));
+	return result;
+}
+
+TEST_CASE(mathSimd_backend) {
+
+#if defined(__SSE__) || defined(_M_X64) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+	CHECK(OVR_MATH_SIMD);
+#endif
+}
+
+TEST_CASE(mathSimd_multiply) {
+
+	std::vector<Matrix4f> matrices = randomMatrices();
+
+	for (int n = 0; n + 1 < MATRIX_COUNT; n++) {
+
+		const Matrix4f & a = matrices[n];
+		const Matrix4f & b = matrices[n + 1];
+		Matrix4f simd = a * b;
+		Matrix4f scalar = scalarMultiply(a, b);
+
+		// Same operations in the same order: identical, or 1 ULP per product
+		// if the compiler contracted the scalar version into fused multiply-adds
+		for (int i = 0; i < 4; i++) {
+			for (int j = 0; j < 4; j++) {
+				float magnitude = std::fabs(a.M[i][0] * b.M[0][j]) + std::fabs(a.M[i][1] * b.M[1][j]) +
+					std::fabs(a.M[i][2] * b.M[2][j]) + std::fabs(a.M[i][3] * b.M[3][j]);
+				CHECK_CLOSE(simd.M[i][j], scalar.M[i][j], 4 * FLT_EPSILON * magnitude);
+			}
+		}
+	}
+}
+
+TEST_CASE(mathSimd_transform) {
+
+	std::vector<Matrix4f> matrices = randomMatrices();
+	TestRandom random;
+
+	for (int n = 0; n < MATRIX_COUNT; n += 2) {
+
+		const Matrix4f & m = matrices[n + 1];
+		Vector4f v(random.next(), random.next(), random.next(), random.next());
+
+		Vector4f simd = m.Transform(v);
+		for (int i = 0; i < 4; i++) {
+			float scalar = m.M[i][0] * v.x + m.M[i][1] * v.y + m.M[i][2] * v.z + m.M[i][3] * v.w;
+			float magnitude = std::fabs(m.M[i][0] * v.x) + std::fabs(m.M[i][1] * v.y) + std::fabs(m.M[i][2] * v.z) + std::fabs(m.M[i][3] * v.w);
+			CHECK_CLOSE((&simd.x)[i], scalar, 4 * FLT_EPSILON * magnitude);
+		}
+
+		// Points through an affine transform come out unscaled
+		Vector3f p(v.x, v.y, v.z);
+		Vector3f simd3 = m.Transform(p);
+		Vector4f simd4 = m.Transform(Vector4f(p.x, p.y, p.z, 1.0f));
+		CHECK_CLOSE(simd3.x, simd4.x, 4 * FLT_EPSILON * std::fabs(simd4.x));
+		CHECK_CLOSE(simd3.y, simd4.y, 4 * FLT_EPSILON * std::fabs(simd4.y));
+		CHECK_CLOSE(simd3.z, simd4.z, 4 * FLT_EPSILON * std::fabs(simd4.z));
+	}
+}
+
+TEST_CASE(mathSimd_determinant) {
+
+	std::vector<Matrix4f> matrices = randomMatrices();
+
+	for (int n = 0; n < MATRIX_COUNT; n++) {
+
+		const Matrix4f & m = matrices[n];
+		Matrix4d md(m);
+
+		// Hadamard's bound on |det| scales the rounding error
+		double rowProduct = 1;
+		for (int i = 0; i < 4; i++)
+			rowProduct *= std::sqrt(md.M[i][0] * md.M[i][0] + md.M[i][1] * md.M[i][1] + md.M[i][2] * md.M[i][2] + md.M[i][3] * md.M[i][3]);
+
+		CHECK_CLOSE(m.Determinant(), md.Determinant(), 16 * FLT_EPSILON * rowProduct);
+	}
+}
+
+TEST_CASE(mathSimd_inverted) {
+
+	std::vector<Matrix4f> matrices = randomMatrices();
+
+	for (int n = 0; n < MATRIX_COUNT; n++) {
+
+		const Matrix4f & m = matrices[n];
+		Matrix4d reference = Matrix4d(m).Inverted();
+
+		// Norm-wise backward-stable bound, as documented on the specializations.
+		// The scalar version is held to the same bound.
+		double condition = normInf(Matrix4d(m)) * normInf(reference);
+		double bound = 16 * FLT_EPSILON * condition * maxAbs(reference);
+
+		CHECK(maxAbsDifference(Matrix4d(m.Inverted()), reference) <= bound);
+		CHECK(maxAbsDifference(Matrix4d(scalarInverse(m)), reference) <= bound);
+
+		// ...and the residual is small next to the sizes of the two factors
+		CHECK(maxAbsDifference(Matrix4d(m * m.Inverted()), Matrix4d()) <= 16 * FLT_EPSILON * condition);
+	}
+}
+
+BENCHMARK_CASE(mathSimd_throughput) {
+
+	std::vector<Matrix4f> matrices = randomMatrices();
+	std::vector<Matrix4f> results(MATRIX_COUNT);
+	const int rounds = 64;
+	const double operations = (double)rounds * (MATRIX_COUNT - 1);
+	float sink = 0;
+
+	uint64_t start = getTestTimeMicros();
+	for (int r = 0; r < rounds; r++) {
+		for (int n = 0; n + 1 < MATRIX_COUNT; n++) results[n] = matrices[n] * matrices[n + 1];
+		sink += results[r].M[0][0];
+	}
+	double simdMultiply = (getTestTimeMicros() - start) * 1000.0 / operations;
+
+	start = getTestTimeMicros();
+	for (int r = 0; r < rounds; r++) {
+		for (int n = 0; n + 1 < MATRIX_COUNT; n++) results[n] = scalarMultiply(matrices[n], matrices[n + 1]);
+		sink += results[r].M[0][0];
+	}
+	double scalarMultiplyTime = (getTestTimeMicros() - start) * 1000.0 / operations;
+
+	start = getTestTimeMicros();
+	for (int r = 0; r < rounds; r++) {
+		for (int n = 0; n + 1 < MATRIX_COUNT; n++) results[n] = matrices[n].Inverted();
+		sink += results[r].M[0][0];
+	}
+	double simdInverse = (getTestTimeMicros() - start) * 1000.0 / operations;
+
+	start = getTestTimeMicros();
+	for (int r = 0; r < rounds; r++) {
+		for (int n = 0; n + 1 < MATRIX_COUNT; n++) results[n] = scalarInverse(matrices[n]);
+		sink += results[r].M[0][0];
+	}
+	double scalarInverseTime = (getTestTimeMicros() - start) * 1000.0 / operations;
+
+	// How far apart the two inverses get element by element, relative to the
+	// element; small elements that are the difference of large cofactor terms
+	// can differ well beyond a few ULP even though both meet the norm-wise bound
+	double worstRelative = 0;
+	for (int n = 0; n < MATRIX_COUNT; n++) {
+		Matrix4f simd = matrices[n].Inverted(), scalar = scalarInverse(matrices[n]);
+		for (int i = 0; i < 4; i++)
+			for (int j = 0; j < 4; j++)
+				if (scalar.M[i][j] != 0)
+					worstRelative = std::max(worstRelative, std::fabs((double)simd.M[i][j] - scalar.M[i][j]) / std::fabs(scalar.M[i][j]));
+	}
+
+	reportResult("  multiply: %6.2f ns SIMD, %6.2f ns scalar (%.2fx)\n", simdMultiply, scalarMultiplyTime, scalarMultiplyTime / simdMultiply);
+	reportResult("  inverse:  %6.2f ns SIMD, %6.2f ns scalar (%.2fx)\n", simdInverse, scalarInverseTime, scalarInverseTime / simdInverse);
+	reportResult("  inverse, worst element-wise relative difference to scalar: %.2g\n", worstRelative);
+	benchmarkSink = sink;
+}
@@ -0,0 +1,154 @@
+#include "TestSuite.h"
+#include "ofxOculusRiftCV1MirrorReadback.h"
+
+// ofxOculusRiftCV1MirrorReadback against whatever GL the test app runs on.
+// Only core 3.2 is needed, so this also covers software GL (e.g. Mesa
+// llvmpipe or a GL-on-D3D layer) on machines without a GPU.
+
+static const int SOURCE_WIDTH = 64;
+static const int SOURCE_HEIGHT = 32;
+
+// Red is the column, green the row, so order and scaling can be checked
+static GLuint createSourceTexture() {
+
+	vector<unsigned char> pixels(SOURCE_WIDTH * SOURCE_HEIGHT * 4);
+	for (int y = 0; y < SOURCE_HEIGHT; y++) {
+		for (int x = 0; x < SOURCE_WIDTH; x++) {
+			unsigned char * p = &pixels[(y * SOURCE_WIDTH + x) * 4];
+			p[0] = x * 4;
+			p[1] = y * 8;
+			p[2] = 0x80;
+			p[3] = 0xff;
+		}
+	}
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, SOURCE_WIDTH, SOURCE_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return texture;
+}
+
+struct ReadbackResults {
+	std::mutex mutex;
+	vector<unsigned char> firstPixels;
+	vector<uint64_t> frameNumbers;
+	int width = 0;
+	int height = 0;
+};
+
+static ofxOculusRiftCV1MirrorReadback::Callback recordInto(ReadbackResults & results) {
+
+	return [&results](const ofxOculusRiftCV1MirrorReadback::Frame & frame) {
+		std::unique_lock<std::mutex> lock(results.mutex);
+		if (results.frameNumbers.empty()) {
+			results.firstPixels.assign(frame.pixels, frame.pixels + frame.width * frame.height * 4);
+			results.width = frame.width;
+			results.height = frame.height;
+		}
+		results.frameNumbers.push_back(frame.frameNumber);
+	};
+}
+
+static bool waitForDelivery(ofxOculusRiftCV1MirrorReadback & readback, uint64_t count) {
+
+	uint64_t start = ofGetElapsedTimeMillis();
+	while (readback.getFramesDelivered() < count) {
+		if (ofGetElapsedTimeMillis() - start > 2000) return false;
+		ofSleepMillis(1);
+	}
+	return true;
+}
+
+// Runs numFrames frames, letting the GL finish each one like a vsynced app
+// would. Each update() collects everything captured before it, and the
+// callback is given time to keep up so nothing is dropped for falling behind.
+static void runFrames(ofxOculusRiftCV1MirrorReadback & readback, GLuint texture, int numFrames) {
+
+	for (int i = 0; i < numFrames; i++) {
+		uint64_t captured = readback.getFramesCaptured();
+		readback.update(texture);
+		glFinish();
+		CHECK(waitForDelivery(readback, captured));
+	}
+}
+
+TEST_CASE(mirrorReadback_fullSize) {
+
+	GLuint texture = createSourceTexture();
+	ReadbackResults results;
+
+	ofxOculusRiftCV1MirrorReadback readback;
+	CHECK(readback.setup(SOURCE_WIDTH, SOURCE_HEIGHT, recordInto(results), 3, 1, 1));
+	CHECK(readback.getWidth() == SOURCE_WIDTH);
+	CHECK(readback.getHeight() == SOURCE_HEIGHT);
+
+	// Frame 10 collects what frame 9 captured
+	runFrames(readback, texture, 10);
+	CHECK(readback.getFramesCaptured() == 10);
+	CHECK(waitForDelivery(readback, 9));
+	CHECK(readback.getFramesDropped() == 0);
+	CHECK(readback.getFramesLate() == 0);
+
+	{
+		std::unique_lock<std::mutex> lock(results.mutex);
+		CHECK(results.frameNumbers.size() == 9);
+		CHECK(results.frameNumbers.front() == 1);
+		CHECK(results.width == SOURCE_WIDTH && results.height == SOURCE_HEIGHT);
+
+		// Row 0 of the texture comes back first, not flipped
+		bool bMatches = results.firstPixels.size() == SOURCE_WIDTH * SOURCE_HEIGHT * 4;
+		for (int y = 0; bMatches && y < SOURCE_HEIGHT; y++) {
+			for (int x = 0; bMatches && x < SOURCE_WIDTH; x++) {
+				const unsigned char * p = &results.firstPixels[(y * SOURCE_WIDTH + x) * 4];
+				bMatches = p[0] == x * 4 && p[1] == y * 8 && p[2] == 0x80 && p[3] == 0xff;
+			}
+		}
+		CHECK(bMatches);
+	}
+
+	readback.close();
+	CHECK(!readback.isSetup());
+	glDeleteTextures(1, &texture);
+}
+
+TEST_CASE(mirrorReadback_downscaleAndInterval) {
+
+	GLuint texture = createSourceTexture();
+	ReadbackResults results;
+
+	// One frame in four, at half size: each of the 3 buffers is reused every
+	// 12 frames, which is not late
+	ofxOculusRiftCV1MirrorReadback readback;
+	CHECK(readback.setup(SOURCE_WIDTH, SOURCE_HEIGHT, recordInto(results), 3, 2, 4));
+	CHECK(readback.getWidth() == SOURCE_WIDTH / 2);
+	CHECK(readback.getHeight() == SOURCE_HEIGHT / 2);
+
+	runFrames(readback, texture, 40);
+	CHECK(readback.getFramesCaptured() == 10);
+	CHECK(waitForDelivery(readback, 10));
+	CHECK(readback.getFramesDropped() == 0);
+	CHECK(readback.getFramesLate() == 0);
+
+	std::unique_lock<std::mutex> lock(results.mutex);
+	CHECK(results.frameNumbers.size() == 10);
+	for (size_t i = 0; i < results.frameNumbers.size(); i++) {
+		CHECK(results.frameNumbers[i] == 1 + i * 4);
+	}
+
+	// Linear filtering blends pairs of rows, but they stay in order
+	int w = results.width;
+	bool bIncreasing = results.firstPixels.size() == (size_t)(w * results.height * 4);
+	for (int y = 1; bIncreasing && y < results.height; y++) {
+		bIncreasing = results.firstPixels[(y * w) * 4 + 1] > results.firstPixels[((y - 1) * w) * 4 + 1];
+	}
+	CHECK(bIncreasing);
+	CHECK(results.firstPixels[1] < 16);
+
+	lock.unlock();
+	readback.close();
+	glDeleteTextures(1, &texture);
+}
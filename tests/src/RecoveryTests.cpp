@@ -0,0 +1,142 @@
+#include "TestSuite.h"
+#include "ovrStubRuntime.h"
+
+// Display-lost recovery, driven by failures injected into the stub runtime.
+
+// A little longer than the addon's retry interval (RECOVERY_RETRY_INTERVAL_US)
+static const int RECOVERY_RETRY_WAIT_MS = 550;
+
+static void initStub(ofxOculusRiftCV1 & cv1) {
+
+	stubRuntime.reset();
+	CHECK(cv1.init());
+	CHECK(cv1.isReady());
+
+	for (int i = 0; i < 3; i++) renderStubFrame(cv1);
+	CHECK(stubRuntime.submitCount == 3);
+}
+
+// The frame that recreates the session must render with poses fetched in that
+// same update(), not the ones left over from before the display was lost
+static void checkRecoveryFrame(ofxOculusRiftCV1 & cv1, int submitsBefore) {
+
+	double sampleTimeBefore = stubRuntime.sampleTime;
+
+	renderStubFrame(cv1);
+
+	CHECK(cv1.getRecoveryState() == ofxOculusRiftCV1::RECOVERY_NONE);
+	CHECK(cv1.isReady());
+	CHECK(stubRuntime.submitCount == submitsBefore + 1);
+	CHECK(stubRuntime.lastSubmitFrameIndex == 0);
+	CHECK(stubRuntime.sampleTime > sampleTimeBefore);
+	CHECK(stubRuntime.lastSubmitSampleTime == stubRuntime.sampleTime);
+}
+
+TEST_CASE(recovery_submitDisplayLost) {
+
+	ofxOculusRiftCV1 cv1;
+	initStub(cv1);
+
+	// The runtime reports the loss from ovr_SubmitFrame only
+	stubRuntime.submitResult = ovrError_DisplayLost;
+	renderStubFrame(cv1);
+
+	CHECK(cv1.getRecoveryState() == ofxOculusRiftCV1::RECOVERY_PENDING);
+	CHECK(!cv1.isReady());
+	CHECK(cv1.getMirrorTextureID() == 0);
+	CHECK(stubRuntime.sessionsAlive == 0);
+	CHECK(stubRuntime.swapChainsAlive == 0);
+	CHECK(stubRuntime.mirrorTexturesAlive == 0);
+
+	// The first attempt recreates the session right away
+	checkRecoveryFrame(cv1, 3);
+	CHECK(cv1.getRecoveryCount() == 1);
+	CHECK(stubRuntime.sessionsAlive == 1);
+	CHECK(stubRuntime.swapChainsAlive == 2);
+	CHECK(stubRuntime.mirrorTexturesAlive == 1);
+
+	cv1.close();
+	CHECK(stubRuntime.sessionsAlive == 0);
+}
+
+TEST_CASE(recovery_statusDisplayLostWithFailedCreates) {
+
+	ofxOculusRiftCV1 cv1;
+	initStub(cv1);
+
+	// The session status reports the loss before anything is submitted, and
+	// the headset takes two attempts to come back
+	stubRuntime.loseDisplay();
+	stubRuntime.createFailures = 2;
+	renderStubFrame(cv1);
+
+	CHECK(cv1.getRecoveryState() == ofxOculusRiftCV1::RECOVERY_PENDING);
+	CHECK(stubRuntime.submitCount == 3);
+
+	// First attempt fails, and nothing is rendered or submitted while waiting
+	renderStubFrame(cv1);
+	CHECK(stubRuntime.createFailures == 1);
+	CHECK(!cv1.isRenderingFrame());
+	for (int i = 0; i < 5; i++) renderStubFrame(cv1);
+	CHECK(stubRuntime.createFailures == 1);
+	CHECK(stubRuntime.submitCount == 3);
+
+	ofSleepMillis(RECOVERY_RETRY_WAIT_MS);
+	renderStubFrame(cv1);
+	CHECK(stubRuntime.createFailures == 0);
+	CHECK(cv1.getRecoveryState() == ofxOculusRiftCV1::RECOVERY_PENDING);
+
+	ofSleepMillis(RECOVERY_RETRY_WAIT_MS);
+	checkRecoveryFrame(cv1, 3);
+	CHECK(cv1.getRecoveryCount() == 1);
+	CHECK(cv1.getLastRecoveryTime() >= 2 * RECOVERY_RETRY_WAIT_MS * 1000);
+
+	// ...and it keeps rendering afterwards
+	renderStubFrame(cv1);
+	CHECK(stubRuntime.submitCount == 5);
+	CHECK(stubRuntime.lastSubmitFrameIndex == 1);
+}
+
+TEST_CASE(recovery_drawSceneDisplayLost) {
+
+	ofxOculusRiftCV1 cv1;
+	initStub(cv1);
+
+	// drawScene() submits on its own and takes the same recovery path as end(),
+	// here with the first re-creation failing
+	stubRuntime.submitResult = ovrError_DisplayLost;
+	stubRuntime.createFailures = 1;
+	cv1.update();
+	cv1.drawScene();
+	CHECK(cv1.getRecoveryState() == ofxOculusRiftCV1::RECOVERY_PENDING);
+	CHECK(stubRuntime.sessionsAlive == 0);
+	CHECK(stubRuntime.swapChainsAlive == 0);
+
+	renderStubFrame(cv1);
+	CHECK(stubRuntime.createFailures == 0);
+	CHECK(cv1.getRecoveryState() == ofxOculusRiftCV1::RECOVERY_PENDING);
+	CHECK(stubRuntime.submitCount == 3);
+
+	ofSleepMillis(RECOVERY_RETRY_WAIT_MS);
+	checkRecoveryFrame(cv1, 3);
+	CHECK(cv1.getRecoveryCount() == 1);
+}
+
+TEST_CASE(recovery_differentAdapter) {
+
+	ofxOculusRiftCV1 cv1;
+	initStub(cv1);
+
+	// Coming back on another adapter can't be recovered from; keep waiting
+	// rather than rendering into a context that can't reach the headset
+	stubRuntime.submitResult = ovrError_DisplayLost;
+	renderStubFrame(cv1);
+
+	stubRuntime.luid.Reserved[0] ^= 1;
+	renderStubFrame(cv1);
+
+	CHECK(cv1.getRecoveryState() == ofxOculusRiftCV1::RECOVERY_PENDING);
+	CHECK(cv1.getRecoveryCount() == 0);
+	CHECK(stubRuntime.sessionsAlive == 0);
+	CHECK(stubRuntime.submitCount == 3);
+}
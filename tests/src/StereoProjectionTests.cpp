@@ -0,0 +1,197 @@
+#include "TestSuite.h"
+#include "OVR_StereoProjection.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+
+// The batched point projections (OVR_StereoProjection.h) against the single
+// point functions they promise to match exactly, and those against the
+// CreateProjection() matrix they are meant to agree with.
+
+using namespace OVR;
+
+// Keeps the benchmark loops from being optimized away
+static volatile float projectionSink;
+
+// Deterministic, so a failure reproduces; uniform in [-1, 1]
+static float projectionRandom(uint32_t & state) {
+
+	state = state * 1664525u + 1013904223u;
+	return (float)(state >> 8) / (float)(1 << 23) - 1.0f;
+}
+
+static Posef randomEyePose(uint32_t & state) {
+
+	Vector3f axis(projectionRandom(state), projectionRandom(state), projectionRandom(state));
+	if (axis.LengthSq() < 1e-4f) axis = Vector3f(0, 1, 0);
+	return Posef(Quatf(axis.Normalized(), projectionRandom(state) * MATH_FLOAT_PI),
+		Vector3f(projectionRandom(state), projectionRandom(state) + 1.6f, projectionRandom(state)) * 2.0f);
+}
+
+// An asymmetric, CV1-like field of view
+static const FovPort eyeFov(1.33f, 1.47f, 1.06f, 1.09f);
+
+// World points that are in front of the eye, from 10 cm to 50 m, some of them
+// well outside the field of view
+static std::vector<Vector3f> pointsInFront(const Posef & eyePose, size_t count, uint32_t & state) {
+
+	std::vector<Vector3f> points(count);
+	for (Vector3f & p : points) {
+		float depth = 0.1f + 49.9f * std::fabs(projectionRandom(state));
+		p = eyePose.Transform(Vector3f(projectionRandom(state) * 2.0f * depth, projectionRandom(state) * 2.0f * depth, -depth));
+	}
+	return points;
+}
+
+static const size_t projectionCounts[] = { 0, 1, 3, 4, 5, 63, 64, 65, 129, 1027 };
+
+TEST_CASE(stereoProjection_batchMatchesScalar) {
+
+	uint32_t state = 2024;
+	const ScaleAndOffset2D eyeToNDC = CreateNDCScaleAndOffsetFromFov(eyeFov);
+
+	for (size_t count : projectionCounts) {
+
+		Posef eyePose = randomEyePose(state), nextEyePose = randomEyePose(state);
+		std::vector<Vector3f> points = pointsInFront(eyePose, count, state);
+
+		// One past count in each output, to catch a store past the end
+		std::vector<Vector2f> ndc(count + 1, Vector2f(-9, -9)), reprojected(count + 1, Vector2f(-9, -9));
+		std::vector<Vector3f> world(count + 1, Vector3f(-9, -9, -9));
+		std::vector<float> depths(count + 1, -9), newDepths(count + 1, -9);
+
+		ProjectPoints(eyePose, eyeToNDC, points.data(), ndc.data(), depths.data(), count);
+		UnprojectPoints(eyePose, eyeToNDC, ndc.data(), depths.data(), world.data(), count);
+		ReprojectPoints(eyePose, eyeToNDC, nextEyePose, eyeToNDC, ndc.data(), depths.data(), reprojected.data(), newDepths.data(), count);
+
+		int mismatches = 0;
+		for (size_t i = 0; i < count; i++) {
+			float depth, newDepth;
+			if (ProjectPoint(eyePose, eyeToNDC, points[i], &depth) != ndc[i] || depth != depths[i]) mismatches++;
+			if (UnprojectPoint(eyePose, eyeToNDC, ndc[i], depths[i]) != world[i]) mismatches++;
+			if (ReprojectPoint(eyePose, eyeToNDC, nextEyePose, eyeToNDC, ndc[i], depths[i], &newDepth) != reprojected[i] ||
+				newDepth != newDepths[i]) mismatches++;
+		}
+		CHECK(mismatches == 0);
+		CHECK(ndc[count] == Vector2f(-9, -9) && depths[count] == -9 && world[count] == Vector3f(-9, -9, -9));
+		CHECK(reprojected[count] == Vector2f(-9, -9) && newDepths[count] == -9);
+
+		// The depth outputs are optional
+		std::vector<Vector2f> ndcNoDepth(count), reprojectedNoDepth(count);
+		ProjectPoints(eyePose, eyeToNDC, points.data(), ndcNoDepth.data(), NULL, count);
+		ReprojectPoints(eyePose, eyeToNDC, nextEyePose, eyeToNDC, ndc.data(), depths.data(), reprojectedNoDepth.data(), NULL, count);
+		CHECK(std::equal(ndcNoDepth.begin(), ndcNoDepth.end(), ndc.begin()));
+		CHECK(std::equal(reprojectedNoDepth.begin(), reprojectedNoDepth.end(), reprojected.begin()));
+	}
+}
+
+// NDC against the projection matrix after the divide by w, and the round trips
+TEST_CASE(stereoProjection_matchesMatrix) {
+
+	uint32_t state = 7;
+	const ScaleAndOffset2D eyeToNDC = CreateNDCScaleAndOffsetFromFov(eyeFov);
+	const Matrix4f projection = CreateProjection(false, true, eyeFov, StereoEye_Left);
+
+	Posef eyePose = randomEyePose(state), nextEyePose = randomEyePose(state);
+	std::vector<Vector3f> points = pointsInFront(eyePose, 4096, state);
+	std::vector<Vector2f> ndc(points.size());
+	std::vector<float> depths(points.size());
+	ProjectPoints(eyePose, eyeToNDC, points.data(), ndc.data(), depths.data(), points.size());
+
+	double worstNDC = 0, worstDepth = 0, worstRoundTrip = 0, worstReprojection = 0;
+	for (size_t i = 0; i < points.size(); i++) {
+
+		Vector3f eyeSpace = eyePose.InverseTransform(points[i]);
+		Vector4f clip = projection.Transform(Vector4f(eyeSpace, 1.0f));
+		double scale = std::max(1.0f, std::max(std::fabs(ndc[i].x), std::fabs(ndc[i].y)));
+		worstNDC = std::max(worstNDC, std::max(std::fabs(clip.x / clip.w - ndc[i].x), std::fabs(clip.y / clip.w - ndc[i].y)) / scale);
+		worstDepth = std::max(worstDepth, (double)std::fabs(clip.w - depths[i]) / depths[i]);
+
+		// Back to the world point, to float rounding of its distance from the eye
+		Vector3f world = UnprojectPoint(eyePose, eyeToNDC, ndc[i], depths[i]);
+		worstRoundTrip = std::max(worstRoundTrip, (double)(world - points[i]).Length() / eyeSpace.Length());
+
+		// Reprojecting is projecting the same world point from the other eye
+		float newDepth, expectedDepth;
+		Vector2f reprojected = ReprojectPoint(eyePose, eyeToNDC, nextEyePose, eyeToNDC, ndc[i], depths[i], &newDepth);
+		Vector2f expected = ProjectPoint(nextEyePose, eyeToNDC, points[i], &expectedDepth);
+		if (expectedDepth > 0.05f) {
+			double size = std::max(1.0f, std::max(std::fabs(expected.x), std::fabs(expected.y))) * std::max(1.0f, (points[i] - nextEyePose.Translation).Length() / expectedDepth);
+			worstReprojection = std::max(worstReprojection, std::max(std::fabs(reprojected.x - expected.x), std::fabs(reprojected.y - expected.y)) / size);
+		}
+	}
+
+	CHECK(worstNDC < 8 * FLT_EPSILON);
+	CHECK(worstDepth < 4 * FLT_EPSILON);
+	CHECK(worstRoundTrip < 16 * FLT_EPSILON);
+	CHECK(worstReprojection < 1e-4);
+}
+
+#if OVR_MATH_CONSTEXPR_ENABLED
+// The compile-time projection builder gives the same matrices
+TEST_CASE(stereoProjection_constexprProjection) {
+
+	for (bool leftHanded : { false, true }) {
+		for (bool isOpenGL : { false, true }) {
+			for (int flags = 0; flags < 4; flags++) {
+				bool flipZ = (flags & 1) != 0, farAtInfinity = (flags & 2) != 0;
+				Matrix4f runtime = CreateProjection(leftHanded, isOpenGL, eyeFov, StereoEye_Right, 0.05f, 500.0f, flipZ, farAtInfinity);
+				Matrix4f compileTime = MathConstexpr::Projection(leftHanded, isOpenGL, eyeFov, 0.05f, 500.0f, flipZ, farAtInfinity);
+				CHECK(runtime == compileTime);
+			}
+		}
+	}
+}
+#endif
+
+// The batch calls against loops over the single point functions
+BENCHMARK_CASE(stereoProjection_throughput) {
+
+	uint32_t state = 2024;
+	const ScaleAndOffset2D eyeToNDC = CreateNDCScaleAndOffsetFromFov(eyeFov);
+	Posef eyePose = randomEyePose(state), nextEyePose = randomEyePose(state);
+	float sink = 0;
+
+	for (size_t count : { (size_t)1000, (size_t)100000 }) {
+
+		std::vector<Vector3f> points = pointsInFront(eyePose, count, state);
+		std::vector<Vector2f> ndc(count), reprojected(count);
+		std::vector<float> depths(count), newDepths(count);
+		const int rounds = (int)(10000000 / count);
+		const double operations = (double)rounds * count;
+
+		uint64_t start = getTestTimeMicros();
+		for (int r = 0; r < rounds; r++) {
+			ProjectPoints(eyePose, eyeToNDC, points.data(), ndc.data(), depths.data(), count);
+			sink += ndc[r % count].x;
+		}
+		double batchProject = (getTestTimeMicros() - start) * 1000.0 / operations;
+
+		start = getTestTimeMicros();
+		for (int r = 0; r < rounds; r++) {
+			for (size_t i = 0; i < count; i++) ndc[i] = ProjectPoint(eyePose, eyeToNDC, points[i], &depths[i]);
+			sink += ndc[r % count].x;
+		}
+		double scalarProject = (getTestTimeMicros() - start) * 1000.0 / operations;
+
+		start = getTestTimeMicros();
+		for (int r = 0; r < rounds; r++) {
+			ReprojectPoints(eyePose, eyeToNDC, nextEyePose, eyeToNDC, ndc.data(), depths.data(), reprojected.data(), newDepths.data(), count);
+			sink += reprojected[r % count].x;
+		}
+		double batchReproject = (getTestTimeMicros() - start) * 1000.0 / operations;
+
+		start = getTestTimeMicros();
+		for (int r = 0; r < rounds; r++) {
+			for (size_t i = 0; i < count; i++)
+				reprojected[i] = ReprojectPoint(eyePose, eyeToNDC, nextEyePose, eyeToNDC, ndc[i], depths[i], &newDepths[i]);
+			sink += reprojected[r % count].x;
+		}
+		double scalarReproject = (getTestTimeMicros() - start) * 1000.0 / operations;
+
+		reportResult("  %6zu points: project %5.2f ns batch, %5.2f ns single (%.2fx); reproject %5.2f ns batch, %5.2f ns single (%.2fx)\n",
+			count, batchProject, scalarProject, scalarProject / batchProject, batchReproject, scalarReproject, scalarReproject / batchReproject);
+	}
+	projectionSink = sink;
+}
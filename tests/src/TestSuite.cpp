@@ -0,0 +1,81 @@
+#include "TestSuite.h"
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+static TestCase * testCases = nullptr;
+static int failedChecks = 0;
+
+TestCase::TestCase(const char * name, Function function, bool bBenchmark)
+	: name(name)
+	, function(function)
+	, bBenchmark(bBenchmark)
+	, next(testCases) {
+
+	testCases = this;
+}
+
+int runTests(bool bBenchmarks, const char * filter) {
+
+	// Registration order is reversed within a file and unspecified across
+	// files, so run them in name order to keep the output stable
+	TestCase * sorted = nullptr;
+	for (TestCase * test = testCases; test; ) {
+		TestCase * next = test->next;
+		TestCase ** slot = &sorted;
+		while (*slot && strcmp((*slot)->name, test->name) < 0) slot = &(*slot)->next;
+		test->next = *slot;
+		*slot = test;
+		test = next;
+	}
+	testCases = sorted;
+
+	int run = 0;
+	int failed = 0;
+
+	for (TestCase * test = testCases; test; test = test->next) {
+
+		if (test->bBenchmark != bBenchmarks) continue;
+		if (filter && *filter && !strstr(test->name, filter)) continue;
+
+		printf("[ RUN  ] %s\n", test->name);
+		fflush(stdout);
+
+		failedChecks = 0;
+		test->function();
+		run++;
+
+		if (failedChecks) failed++;
+		printf("[ %s ] %s\n", failedChecks ? "FAIL" : "  OK", test->name);
+		fflush(stdout);
+	}
+
+	printf("%d of %d %s passed\n", run - failed, run, bBenchmarks ? "benchmarks" : "tests");
+	fflush(stdout);
+
+	return failed;
+}
+
+void reportFailure(const char * file, int line, const char * expression) {
+
+	failedChecks++;
+	printf("%s(%d): check failed: %s\n", file, line, expression);
+	fflush(stdout);
+}
+
+void reportResult(const char * format, ...) {
+
+	va_list args;
+	va_start(args, format);
+	vprintf(format, args);
+	va_end(args);
+	fflush(stdout);
+}
+
+uint64_t getTestTimeMicros() {
+
+	return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+// A minimal test registry shared by the oF test app (everything that needs a
+// GL context, the stub runtime or the Windows-only kernel code) and the
+// console runner built by tests/CMakeLists.txt (header-only kernel code).
+//
+// Tests register themselves at static init time:
+//
+//	TEST_CASE(lockless_spscOrder) {
+//		CHECK(queue.Dequeue(value));
+//		CHECK_CLOSE(value, 1.0f, 1e-6f);
+//	}
+//
+// Benchmarks are registered the same way with BENCHMARK_CASE and only run
+// when asked for, as their timings mean nothing under a debugger or TSan.
+
+#include <cmath>
+#include <cstdint>
+
+struct TestCase {
+
+	typedef void (*Function)();
+
+	TestCase(const char * name, Function function, bool bBenchmark);
+
+	const char *	name;
+	Function		function;
+	bool			bBenchmark;
+	TestCase *		next;
+};
+
+// Runs the tests (or the benchmarks) whose name contains filter, or all of
+// them for a null or empty filter. Returns the number of failed tests.
+int runTests(bool bBenchmarks, const char * filter);
+
+// Records a failed check in the running test.
+void reportFailure(const char * file, int line, const char * expression);
+
+// printf to stdout, flushed, so benchmark results interleave with test output.
+void reportResult(const char * format, ...);
+
+// Microseconds from an arbitrary starting point, for benchmarks.
+uint64_t getTestTimeMicros();
+
+#define TEST_CASE(name) \
+	static void name(); \
+	static TestCase name##Case(#name, name, false); \
+	static void name()
+
+#define BENCHMARK_CASE(name) \
+	static void name(); \
+	static TestCase name##Case(#name, name, true); \
+	static void name()
+
+#define CHECK(expression) \
+	do { if (!(expression)) reportFailure(__FILE__, __LINE__, #expression); } while (0)
+
+#define CHECK_CLOSE(a, b, tolerance) \
+	do { if (!(std::fabs((double)(a) - (double)(b)) <= (double)(tolerance))) reportFailure(__FILE__, __LINE__, #a " ~= " #b); } while (0)
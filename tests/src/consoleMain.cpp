@@ -0,0 +1,19 @@
+#include "TestSuite.h"
+
+#include <cstring>
+
+// Runs the tests that need neither openFrameworks nor a GL context. Same
+// arguments as the test app: --bench runs the benchmarks instead of the
+// tests, any other argument only runs the tests whose name contains it.
+int main(int argc, char * argv[]) {
+
+	bool bBenchmarks = false;
+	const char * filter = nullptr;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--bench") == 0) bBenchmarks = true;
+		else filter = argv[i];
+	}
+
+	return runTests(bBenchmarks, filter) ? 1 : 0;
+}
@@ -0,0 +1,22 @@
+#include "ofMain.h"
+#include "ofApp.h"
+
+//========================================================================
+int main(int argc, char * argv[]){
+
+	ofGLWindowSettings settings;
+	settings.setGLVersion(3, 2);	// core 3.2 is all the addon needs, so this also runs on a software GL
+	settings.width = 256;
+	settings.height = 128;
+	ofCreateWindow(settings);
+
+	// --bench runs the benchmarks instead of the tests, any other argument
+	// only runs the tests whose name contains it
+	ofApp * app = new ofApp();
+	for (int i = 1; i < argc; i++) {
+		if (string(argv[i]) == "--bench") app->bBenchmarks = true;
+		else app->filter = argv[i];
+	}
+
+	return ofRunApp(app);
+}
@@ -0,0 +1,16 @@
+#include "ofApp.h"
+#include "TestSuite.h"
+
+//--------------------------------------------------------------
+ofApp::ofApp(){
+
+	bBenchmarks = false;
+}
+
+//--------------------------------------------------------------
+void ofApp::setup(){
+
+	int failed = runTests(bBenchmarks, filter.c_str());
+
+	ofExit(failed ? 1 : 0);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "ofMain.h"
+
+// Runs every registered test once the GL context is up, then exits with a
+// non-zero status if any of them failed.
+class ofApp : public ofBaseApp{
+
+	public:
+		ofApp();
+
+		void setup();
+
+		bool bBenchmarks;
+		string filter;
+};
@@ -0,0 +1,307 @@
+#include "ovrStubRuntime.h"
+
+ovrStubRuntime stubRuntime;
+
+struct ovrHmdStruct {
+	int unused;
+};
+
+struct ovrTextureSwapChainData {
+	GLuint	textures[3];
+	int		currentIndex;
+};
+
+struct ovrMirrorTextureData {
+	GLuint	texture;
+};
+
+static ovrHmdStruct stubSession;
+
+// The addon only accepts the default adapter, so that's where the headset is
+static ovrGraphicsLuid getDefaultAdapterLuid() {
+
+	ovrGraphicsLuid luid = ovrGraphicsLuid();
+
+#if defined(_WIN32)
+	IDXGIFactory* factory = nullptr;
+
+	if (SUCCEEDED(CreateDXGIFactory(IID_PPV_ARGS(&factory))))
+	{
+		IDXGIAdapter* adapter = nullptr;
+
+		if (SUCCEEDED(factory->EnumAdapters(0, &adapter)))
+		{
+			DXGI_ADAPTER_DESC desc;
+
+			adapter->GetDesc(&desc);
+			memcpy(&luid, &desc.AdapterLuid, sizeof(luid));
+			adapter->Release();
+		}
+
+		factory->Release();
+	}
+#endif
+
+	return luid;
+}
+
+static GLuint createStubTexture(int width, int height) {
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return texture;
+}
+
+void ovrStubRuntime::reset() {
+
+	memset(this, 0, sizeof(*this));
+
+	status.IsVisible = ovrTrue;
+	status.HmdPresent = ovrTrue;
+	status.HmdMounted = ovrTrue;
+	submitResult = ovrSuccess;
+	luid = getDefaultAdapterLuid();
+	resolution.w = 256;
+	resolution.h = 128;
+	lastSubmitFrameIndex = -1;
+	headPosition.y = 1.7f;
+}
+
+void ovrStubRuntime::loseDisplay() {
+
+	status.DisplayLost = ovrTrue;
+	submitResult = ovrError_DisplayLost;
+}
+
+void renderStubFrame(ofxOculusRiftCV1 & cv1) {
+
+	cv1.update();
+
+	if (cv1.begin(ovrEye_Left)) ofClear(0, 255, 255);
+	cv1.end(ovrEye_Left);
+
+	if (cv1.begin(ovrEye_Right)) ofClear(255, 0, 255);
+	cv1.end(ovrEye_Right);
+
+	cv1.draw(0, 0);
+}
+
+//--------------------------------------------------------------
+// Runtime entry points used by the addon, OVR_CAPI_Util.cpp and TextureBuffer
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_Initialize(const ovrInitParams * params) {
+
+	stubRuntime.initializeCount++;
+	return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(void) ovr_Shutdown() {
+}
+
+OVR_PUBLIC_FUNCTION(void) ovr_GetLastErrorInfo(ovrErrorInfo * errorInfo) {
+
+	memset(errorInfo, 0, sizeof(*errorInfo));
+	strcpy(errorInfo->ErrorString, "stub runtime error");
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_Create(ovrSession * pSession, ovrGraphicsLuid * pLuid) {
+
+	if (stubRuntime.createFailures > 0) {
+		stubRuntime.createFailures--;
+		*pSession = nullptr;
+		return ovrError_NoHmd;
+	}
+
+	// A new session starts out healthy
+	stubRuntime.status.DisplayLost = ovrFalse;
+	if (stubRuntime.submitResult == ovrError_DisplayLost) stubRuntime.submitResult = ovrSuccess;
+
+	stubRuntime.sessionsCreated++;
+	stubRuntime.sessionsAlive++;
+
+	*pSession = &stubSession;
+	*pLuid = stubRuntime.luid;
+	return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(void) ovr_Destroy(ovrSession session) {
+
+	if (session) stubRuntime.sessionsAlive--;
+}
+
+OVR_PUBLIC_FUNCTION(ovrHmdDesc) ovr_GetHmdDesc(ovrSession session) {
+
+	ovrHmdDesc desc;
+	memset(&desc, 0, sizeof(desc));
+
+	desc.Type = ovrHmd_CV1;
+	desc.Resolution = stubRuntime.resolution;
+
+	for (int eye = 0; eye < 2; ++eye) {
+		ovrFovPort fov = { 1.0f, 1.0f, 1.0f, 1.0f };
+		desc.DefaultEyeFov[eye] = fov;
+		desc.MaxEyeFov[eye] = fov;
+	}
+
+	return desc;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_GetSessionStatus(ovrSession session, ovrSessionStatus * sessionStatus) {
+
+	stubRuntime.sessionStatusCount++;
+	*sessionStatus = stubRuntime.status;
+	return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_SetTrackingOriginType(ovrSession session, ovrTrackingOrigin origin) {
+
+	return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_RecenterTrackingOrigin(ovrSession session) {
+
+	stubRuntime.recenterCount++;
+	stubRuntime.status.ShouldRecenter = ovrFalse;
+	return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(ovrTrackingState) ovr_GetTrackingState(ovrSession session, double absTime, ovrBool latencyMarker) {
+
+	ovrTrackingState state;
+	memset(&state, 0, sizeof(state));
+
+	state.HeadPose.ThePose.Orientation.w = 1.0f;
+	state.HeadPose.ThePose.Position = stubRuntime.headPosition;
+	state.HeadPose.TimeInSeconds = absTime;
+	state.StatusFlags = ovrStatus_OrientationTracked | ovrStatus_PositionTracked;
+	return state;
+}
+
+OVR_PUBLIC_FUNCTION(double) ovr_GetPredictedDisplayTime(ovrSession session, long long frameIndex) {
+
+	return stubRuntime.sampleTime + 0.011;
+}
+
+// ovr_GetEyePoses (OVR_CAPI_Util.cpp) takes the sensor sample time from here,
+// so each call hands out a new, increasing one
+OVR_PUBLIC_FUNCTION(double) ovr_GetTimeInSeconds() {
+
+	stubRuntime.sampleTime += 0.001;
+	return stubRuntime.sampleTime;
+}
+
+OVR_PUBLIC_FUNCTION(ovrSizei) ovr_GetFovTextureSize(ovrSession session, ovrEyeType eye, ovrFovPort fov, float pixelsPerDisplayPixel) {
+
+	ovrSizei size = { stubRuntime.resolution.w / 2, stubRuntime.resolution.h };
+	return size;
+}
+
+OVR_PUBLIC_FUNCTION(ovrEyeRenderDesc) ovr_GetRenderDesc(ovrSession session, ovrEyeType eyeType, ovrFovPort fov) {
+
+	ovrEyeRenderDesc desc;
+	memset(&desc, 0, sizeof(desc));
+
+	desc.Eye = eyeType;
+	desc.Fov = fov;
+	desc.HmdToEyeOffset.x = (eyeType == ovrEye_Left) ? -0.032f : 0.032f;
+	desc.PixelsPerTanAngleAtCenter.x = 1.0f;
+	desc.PixelsPerTanAngleAtCenter.y = 1.0f;
+	return desc;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_SubmitFrame(ovrSession session, long long frameIndex, const ovrViewScaleDesc * viewScaleDesc,
+	ovrLayerHeader const * const * layerPtrList, unsigned int layerCount) {
+
+	if (stubRuntime.submitResult == ovrError_DisplayLost) return ovrError_DisplayLost;
+
+	ovrResult result = stubRuntime.submitResult;
+	stubRuntime.submitResult = ovrSuccess;
+	if (!OVR_SUCCESS(result)) return result;
+
+	const ovrLayerEyeFov * layer = (const ovrLayerEyeFov *)layerPtrList[0];
+
+	stubRuntime.submitCount++;
+	stubRuntime.lastSubmitFrameIndex = frameIndex;
+	stubRuntime.lastSubmitSampleTime = layer->SensorSampleTime;
+	stubRuntime.lastSubmitPose[0] = layer->RenderPose[0];
+	stubRuntime.lastSubmitPose[1] = layer->RenderPose[1];
+	return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_CreateTextureSwapChainGL(ovrSession session, const ovrTextureSwapChainDesc * desc,
+	ovrTextureSwapChain * out_TextureSwapChain) {
+
+	ovrTextureSwapChainData * chain = new ovrTextureSwapChainData;
+
+	for (int i = 0; i < 3; ++i) chain->textures[i] = createStubTexture(desc->Width, desc->Height);
+	chain->currentIndex = 0;
+
+	stubRuntime.swapChainsAlive++;
+	*out_TextureSwapChain = chain;
+	return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_GetTextureSwapChainLength(ovrSession session, ovrTextureSwapChain chain, int * out_Length) {
+
+	*out_Length = chain ? 3 : 0;
+	return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_GetTextureSwapChainCurrentIndex(ovrSession session, ovrTextureSwapChain chain, int * out_Index) {
+
+	*out_Index = chain->currentIndex;
+	return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_GetTextureSwapChainBufferGL(ovrSession session, ovrTextureSwapChain chain, int index,
+	unsigned int * out_TexId) {
+
+	*out_TexId = chain->textures[index];
+	return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_CommitTextureSwapChain(ovrSession session, ovrTextureSwapChain chain) {
+
+	chain->currentIndex = (chain->currentIndex + 1) % 3;
+	return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(void) ovr_DestroyTextureSwapChain(ovrSession session, ovrTextureSwapChain chain) {
+
+	if (!chain) return;
+
+	glDeleteTextures(3, chain->textures);
+	delete chain;
+	stubRuntime.swapChainsAlive--;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_CreateMirrorTextureGL(ovrSession session, const ovrMirrorTextureDesc * desc,
+	ovrMirrorTexture * out_MirrorTexture) {
+
+	ovrMirrorTextureData * mirror = new ovrMirrorTextureData;
+	mirror->texture = createStubTexture(desc->Width, desc->Height);
+
+	stubRuntime.mirrorTexturesAlive++;
+	*out_MirrorTexture = mirror;
+	return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(ovrResult) ovr_GetMirrorTextureBufferGL(ovrSession session, ovrMirrorTexture mirrorTexture, unsigned int * out_TexId) {
+
+	*out_TexId = mirrorTexture->texture;
+	return ovrSuccess;
+}
+
+OVR_PUBLIC_FUNCTION(void) ovr_DestroyMirrorTexture(ovrSession session, ovrMirrorTexture mirrorTexture) {
+
+	if (!mirrorTexture) return;
+
+	glDeleteTextures(1, &mirrorTexture->texture);
+	delete mirrorTexture;
+	stubRuntime.mirrorTexturesAlive--;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+// Stand-in for the Oculus runtime, linked in place of LibOVR.lib so the addon
+// runs on any machine with a GL 3.2 context and no headset. Swap chains and
+// the mirror texture are plain GL textures. Every call the addon makes is
+// counted, and the failures the real runtime can produce are injected by
+// setting the fields below between frames.
+
+#include "ofxOculusRiftCV1.h"
+
+struct ovrStubRuntime {
+
+	// Behaviour, reset to a healthy, visible, worn headset by reset()
+	ovrSessionStatus	status;				// returned by ovr_GetSessionStatus; DisplayLost is cleared by ovr_Create
+	int					createFailures;		// ovr_Create calls left to fail with ovrError_NoHmd
+	ovrResult			submitResult;		// returned by the next ovr_SubmitFrame, then back to ovrSuccess
+	ovrGraphicsLuid		luid;				// adapter reported by ovr_Create
+	ovrSizei			resolution;			// hmdDesc.Resolution; eye textures are half of it each
+
+	// Observations
+	int					initializeCount;
+	int					sessionsCreated;
+	int					sessionsAlive;
+	int					swapChainsAlive;
+	int					mirrorTexturesAlive;
+	int					recenterCount;
+	int					sessionStatusCount;
+	int					submitCount;		// successful ovr_SubmitFrame calls
+	long long			lastSubmitFrameIndex;
+	double				lastSubmitSampleTime;
+	ovrPosef			lastSubmitPose[2];
+	double				sampleTime;			// last sensor sample time handed out through ovr_GetEyePoses
+	ovrVector3f			headPosition;		// head position returned by ovr_GetTrackingState
+
+	void reset();
+
+	// Behaves as if the cable was pulled: the session reports DisplayLost and
+	// submits fail until a new session is created.
+	void loseDisplay();
+};
+
+extern ovrStubRuntime stubRuntime;
+
+// One frame the way an app drives the addon: update(), both eyes, draw().
+void renderStubFrame(ofxOculusRiftCV1 & cv1);